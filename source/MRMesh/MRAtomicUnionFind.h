@@ -0,0 +1,100 @@
+#pragma once
+
+#include "MRParallelFor.h"
+#include <atomic>
+#include <cassert>
+#include <climits>
+#include <utility>
+#include <vector>
+
+namespace MR
+{
+
+/**
+ * \brief Union find data structure that can be modified from many threads simultaneously without locks:
+ * find is wait-free (with path halving), and unite links roots by compare-and-swap;
+ * the root of each set is always its smallest element, so the numbering of sets by their roots does not depend on the order of unions
+ * \tparam I is an id type, e.g. FaceId
+ * \ingroup BasicGroup
+ */
+template <typename I>
+class AtomicUnionFind
+{
+public:
+    AtomicUnionFind() = default;
+
+    /// creates the structure with each element in its own disjoint set
+    explicit AtomicUnionFind( size_t size ) : parents_( size )
+    {
+        assert( size <= INT_MAX );
+        ParallelFor( size_t( 0 ), size, [&]( size_t i )
+        {
+            parents_[i].store( int( i ), std::memory_order_relaxed );
+        } );
+    }
+
+    [[nodiscard]] size_t size() const { return parents_.size(); }
+
+    /// finds the root of the set containing given element, shortening the path to it on the way
+    [[nodiscard]] I find( I a )
+    {
+        int x = int( a );
+        for (;;)
+        {
+            int p = parents_[x].load( std::memory_order_relaxed );
+            if ( p == x )
+                return I( x );
+            const int gp = parents_[p].load( std::memory_order_relaxed );
+            // path halving: failure means that somebody else has already updated the parent, which is fine
+            if ( p != gp )
+                parents_[x].compare_exchange_weak( p, gp, std::memory_order_relaxed );
+            x = gp;
+        }
+    }
+
+    /// returns true if given element is the root of its set at the moment
+    [[nodiscard]] bool isRoot( I a ) const { return parents_[a].load( std::memory_order_relaxed ) == int( a ); }
+
+    /// unites two elements,
+    /// \return true if the union was done, false if the elements were already in one set
+    bool unite( I first, I second )
+    {
+        for (;;)
+        {
+            int r0 = find( first );
+            int r1 = find( second );
+            if ( r0 == r1 )
+                return false;
+            // link the larger root to the smaller one, it excludes cycles
+            if ( r0 < r1 )
+                std::swap( r0, r1 );
+            int expected = r0;
+            if ( parents_[r0].compare_exchange_strong( expected, r1, std::memory_order_relaxed ) )
+                return true;
+            // r0 was linked by another thread in between, repeat from the current roots
+            first = I( r0 );
+            second = I( r1 );
+        }
+    }
+
+    /// returns true if given two elements are from one set
+    [[nodiscard]] bool united( I first, I second )
+    {
+        for (;;)
+        {
+            const auto r0 = find( first );
+            const auto r1 = find( second );
+            if ( r0 == r1 )
+                return true;
+            // if r0 is still a root, then the sets were different at the moment of its check
+            if ( isRoot( r0 ) )
+                return false;
+        }
+    }
+
+private:
+    /// parent of each element, the roots are parents for themselves
+    std::vector<std::atomic<int>> parents_;
+};
+
+} //namespace MR
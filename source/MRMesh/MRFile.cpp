@@ -2,6 +2,18 @@
 #include "MRStringConvert.h"
 #include <cstring>
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace MR
 {
 
@@ -30,4 +42,82 @@ void File::close()
     handle_ = nullptr;
 }
 
+bool MappedFile::open( const std::filesystem::path & filename )
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileW( filename.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if ( file == INVALID_HANDLE_VALUE )
+        return false;
+    LARGE_INTEGER fileSize;
+    if ( !GetFileSizeEx( file, &fileSize ) )
+    {
+        CloseHandle( file );
+        return false;
+    }
+    if ( fileSize.QuadPart > 0 )
+    {
+        // the mapping object keeps the file opened, so the handle of the file is not needed anymore
+        mapping_ = CreateFileMappingW( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        CloseHandle( file );
+        if ( !mapping_ )
+            return false;
+        data_ = (const char*)MapViewOfFile( mapping_, FILE_MAP_READ, 0, 0, 0 );
+        if ( !data_ )
+        {
+            CloseHandle( mapping_ );
+            mapping_ = nullptr;
+            return false;
+        }
+        size_ = size_t( fileSize.QuadPart );
+    }
+    else
+        CloseHandle( file );
+#else
+    const int fd = ::open( utf8string( filename ).c_str(), O_RDONLY );
+    if ( fd < 0 )
+        return false;
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 )
+    {
+        ::close( fd );
+        return false;
+    }
+    if ( st.st_size > 0 )
+    {
+        void * addr = mmap( nullptr, size_t( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+        if ( addr == MAP_FAILED )
+        {
+            ::close( fd );
+            return false;
+        }
+        // the content is read from the beginning to the end by parsers
+        madvise( addr, size_t( st.st_size ), MADV_SEQUENTIAL );
+        data_ = (const char*)addr;
+        size_ = size_t( st.st_size );
+    }
+    // the mapping remains valid after closing the file
+    ::close( fd );
+#endif
+    opened_ = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if ( data_ )
+    {
+#ifdef _WIN32
+        UnmapViewOfFile( data_ );
+        CloseHandle( mapping_ );
+        mapping_ = nullptr;
+#else
+        munmap( (void*)data_, size_ );
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+    opened_ = false;
+}
+
 } //namespace MR
@@ -3,6 +3,7 @@
 #include "MRMeshFwd.h"
 #include <filesystem>
 #include <cstdio>
+#include <utility>
 
 namespace MR
 {
@@ -37,4 +38,46 @@ private:
     FILE * handle_ = nullptr;
 };
 
+/// the class to map the content of a file in memory for reading without copying it, the mapping is released in the destructor
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile( const MappedFile & ) = delete;
+    MappedFile( MappedFile && r ) noexcept { swap_( r ); }
+    explicit MappedFile( const std::filesystem::path & filename ) { open( filename ); }
+    ~MappedFile() { close(); }
+
+    MappedFile& operator =( const MappedFile & ) = delete;
+    MappedFile& operator =( MappedFile && r ) noexcept { close(); swap_( r ); return * this; }
+
+    /// maps the whole file in memory, returns false if the file cannot be opened or mapped
+    MRMESH_API bool open( const std::filesystem::path & filename );
+    MRMESH_API void close();
+
+    /// returns true if a file is opened (even empty)
+    bool isOpen() const { return opened_; }
+    /// the content of the file, nullptr for empty file
+    const char * data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    void swap_( MappedFile & r ) noexcept
+    {
+        std::swap( data_, r.data_ );
+        std::swap( size_, r.size_ );
+        std::swap( opened_, r.opened_ );
+#ifdef _WIN32
+        std::swap( mapping_, r.mapping_ );
+#endif
+    }
+
+    const char * data_ = nullptr;
+    size_t size_ = 0;
+    bool opened_ = false;
+#ifdef _WIN32
+    void * mapping_ = nullptr;
+#endif
+};
+
 } // namespace MR
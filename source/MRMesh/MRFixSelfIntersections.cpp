@@ -11,6 +11,12 @@
 #include "MRPch/MRSpdlog.h"
 #include "MRMesh/MRTimer.h"
 #include "MRMesh/MRBox.h"
+#include "MRMesh/MRParallelFor.h"
+#include "MRMesh/MRBitSetParallelFor.h"
+#include "MRMesh/MRTorus.h"
+#include "MRMesh/MRMakeSphereMesh.h"
+#include "MRMesh/MRRingIterator.h"
+#include "MRMesh/MRGTest.h"
 #include <algorithm>
 
 namespace MR
@@ -25,6 +31,114 @@ Expected<FaceBitSet> getFaces( const Mesh& mesh, ProgressCallback cb )
     return findSelfCollidingTrianglesBS( mesh, cb, &faceToRegionMap );
 }
 
+// Helper function to find own self-intersections on a mesh part:
+// it builds the tree only for the part, which is much faster than rebuilding the tree of whole mesh after local modifications
+static Expected<FaceBitSet> findSelfCollidingTrianglesBSForPart( const Mesh& mesh, const FaceBitSet& part, ProgressCallback cb,
+    const Face2RegionMap * regionMap = nullptr )
+{
+    MR_TIMER
+    FaceMap tgt2srcFaces;
+    PartMapping mapping;
+    mapping.tgt2srcFaces = &tgt2srcFaces;
+    Mesh partMesh = mesh.cloneRegion( part, false, mapping );
+    // only the self-intersections within one component of the original mesh are searched for
+    Face2RegionMap partRegionMap;
+    if ( regionMap )
+    {
+        partRegionMap.resize( tgt2srcFaces.size() );
+        ParallelFor( partRegionMap, [&]( FaceId f )
+        {
+            if ( auto srcF = tgt2srcFaces[f] )
+                partRegionMap[f] = ( *regionMap )[srcF];
+        } );
+    }
+    auto res = findSelfCollidingTrianglesBS( { partMesh }, cb, regionMap ? &partRegionMap : nullptr );
+    if ( !res.has_value() )
+        return unexpected( res.error() );
+    FaceBitSet result( mesh.topology.lastValidFace() + 1 );
+    for ( FaceId f : *res )
+        result.set( tgt2srcFaces[f] );
+    return result;
+}
+
+// Assigns the regions to the faces created after the map was computed (having larger ids) from their neighbors,
+// which is enough after the splits of faces not changing mesh connectivity
+static void extendRegionMap( const MeshTopology & topology, Face2RegionMap & map )
+{
+    MR_TIMER
+    const FaceId firstNew( map.size() );
+    map.resize( topology.faceSize() );
+    std::vector<FaceId> unknown;
+    for ( FaceId f = firstNew; f < map.size(); ++f )
+        if ( topology.hasFace( f ) )
+            unknown.push_back( f );
+    while ( !unknown.empty() )
+    {
+        const auto numUnknown = unknown.size();
+        std::erase_if( unknown, [&]( FaceId f )
+        {
+            for ( auto e : leftRing( topology, f ) )
+                if ( auto r = topology.right( e ); r && map[r] )
+                {
+                    map[f] = map[r];
+                    return true;
+                }
+            return false;
+        } );
+        if ( unknown.size() == numUnknown )
+            break; // isolated new faces
+    }
+}
+
+// Updates the regions after the faces around changedFaces were cut out and the holes were filled:
+// it can split a component but never joins different ones,
+// so only the regions having changed faces are divided on actual components instead of recomputing the components of whole mesh
+static void updateRegionMap( const Mesh & mesh, Face2RegionMap & map, int & numRegions, const FaceBitSet & changedFaces )
+{
+    MR_TIMER
+    extendRegionMap( mesh.topology, map );
+    HashSet<RegionId> changedRegions;
+    for ( auto f : changedFaces )
+        if ( mesh.topology.hasFace( f ) && map[f] )
+            changedRegions.insert( map[f] );
+    if ( changedRegions.empty() )
+        return;
+
+    FaceBitSet changedRegionFaces( map.size() );
+    BitSetParallelFor( mesh.topology.getValidFaces(), [&]( FaceId f )
+    {
+        if ( map[f] && changedRegions.contains( map[f] ) )
+            changedRegionFaces.set( f );
+    } );
+    const auto [subMap, numSubRegions] = MeshComponents::getAllComponentsMap( { mesh, &changedRegionFaces } );
+    for ( auto f : changedRegionFaces )
+        map[f] = RegionId( numRegions + subMap[f] );
+    numRegions += numSubRegions;
+}
+
+// Returns one edge of each hole appeared after deletion of the faces,
+// which had given edges on their left, so that the holes are found without scanning the whole mesh;
+// skips the holes having other edges, e.g. merged with the boundary of original mesh
+static std::vector<EdgeId> findHolesAfterDeletion( const MeshTopology & topology, const HashSet<EdgeId> & deletedLeftEdges )
+{
+    std::vector<EdgeId> res;
+    HashSet<EdgeId> visited;
+    for ( auto e0 : deletedLeftEdges )
+    {
+        if ( topology.isLoneEdge( e0 ) || topology.left( e0 ) || visited.contains( e0 ) )
+            continue;
+        bool onlyDeleted = true;
+        for ( auto e : leftRing( topology, e0 ) )
+        {
+            visited.insert( e );
+            onlyDeleted = onlyDeleted && deletedLeftEdges.contains( e );
+        }
+        if ( onlyDeleted )
+            res.push_back( e0 );
+    }
+    return res;
+}
+
 // Helper function to fix self-intersections on part of mesh
 static VoidOrErrStr doFix( Mesh& mesh, FaceBitSet& part, const Settings& settings,
     int expandSize,
@@ -111,7 +225,7 @@ VoidOrErrStr fix( Mesh& mesh, const Settings& settings )
     if ( !reportProgress( settings.callback, 0.0f ) )
         return unexpectedOperationCanceled();
 
-    auto faceToRegionMap = MeshComponents::getAllComponentsMap( { mesh } ).first;
+    auto [faceToRegionMap, numRegions] = MeshComponents::getAllComponentsMap( { mesh } );
 
     if ( !reportProgress( settings.callback, 0.05f ) )
         return unexpectedOperationCanceled();
@@ -148,14 +262,12 @@ VoidOrErrStr fix( Mesh& mesh, const Settings& settings )
     if ( !reportProgress( settings.callback, 0.5f ) )
         return unexpectedOperationCanceled();
 
-    faceToRegionMap = MeshComponents::getAllComponentsMap( { mesh } ).first;
+    extendRegionMap( mesh.topology, faceToRegionMap );
 
     if ( !reportProgress( settings.callback, 0.55f ) )
         return unexpectedOperationCanceled();
 
-    res = findSelfCollidingTrianglesBS( MeshPart( mesh, &res.value() ),
-                                        subprogress( settings.callback, 0.55f, 0.7f ),
-                                        &faceToRegionMap );
+    res = findSelfCollidingTrianglesBSForPart( mesh, *res, subprogress( settings.callback, 0.55f, 0.7f ), &faceToRegionMap );
 
     if ( !res.has_value() )
         return unexpected( res.error() );
@@ -176,43 +288,66 @@ VoidOrErrStr fix( Mesh& mesh, const Settings& settings )
     }
     else
     {
-        auto boundaryEdges = mesh.topology.findBoundaryEdges();
-        mesh.topology.deleteFaces( *res );
-        mesh.topology.deleteFaces( findHoleComplicatingFaces( mesh ) );
-        mesh.invalidateCaches();
-        auto holes = findRightBoundary( mesh.topology );
-
-        if ( !reportProgress( settings.callback, 0.8f ) )
-            return unexpectedOperationCanceled();
-
-        FaceBitSet newFaces;
-        VertBitSet newVerts;
-        auto sp = subprogress( settings.callback, 0.8f, 0.95f );
-        for ( int i = 0; i < holes.size(); ++i )
+        // the clusters of self-intersecting faces with the margin around them are cut out and the holes are re-filled
+        // (the triangulations of independent holes are planned in parallel),
+        // then only the neighborhoods of new faces are checked for self-intersections,
+        // and the clusters still having them are cut out again with larger margin in the next round;
+        // all steps after the initial detection visit only the faces around the repaired clusters
+        const int numRounds = std::max( 1, settings.maxCutAndFillRounds );
+        auto sp = subprogress( settings.callback, 0.7f, 1.0f );
+        for ( int round = 0; round < numRounds; ++round )
         {
-            bool outerBounds = false;
-            for ( auto e : holes[i] )
+            auto roundSp = subprogress( sp, float( round ) / numRounds, float( round + 1 ) / numRounds );
+            HashSet<EdgeId> deletedLeftEdges;
+            auto deleteFaces = [&]( const FaceBitSet & fs )
             {
-                if ( boundaryEdges.test( e ) )
-                {
-                    outerBounds = true;
-                    break;
-                }
-            }
-            if ( outerBounds )
-                continue; // part of mesh boundary
+                for ( auto f : fs )
+                    for ( auto e : leftRing( mesh.topology, f ) )
+                        deletedLeftEdges.insert( e );
+                mesh.topology.deleteFaces( fs );
+            };
+            deleteFaces( *res );
+            deleteFaces( findHoleComplicatingFaces( mesh, findHolesAfterDeletion( mesh.topology, deletedLeftEdges ) ) );
+            mesh.invalidateCaches();
+
+            // the holes merged with the boundary of original mesh are skipped
+            const auto holeEdges = findHolesAfterDeletion( mesh.topology, deletedLeftEdges );
+            if ( !reportProgress( roundSp, 0.2f ) )
+                return unexpectedOperationCanceled();
 
-            // Fill hole
             // MultipleEdgesResolveMode::Simple should be enough after deleting findHoleComplicatingFaces(...)
             // But if multiple edges appear often, could be changed to MultipleEdgesResolveMode::Strong
-            fillHole( mesh, holes[i].front(), {.metric = getMinAreaMetric(mesh),.outNewFaces = &newFaces,
-                .multipleEdgesResolveMode = FillHoleParams::MultipleEdgesResolveMode::Simple });
+            FaceBitSet newFaces;
+            fillHoles( mesh, holeEdges, { .metric = getMinAreaMetric( mesh ), .outNewFaces = &newFaces,
+                .multipleEdgesResolveMode = FillHoleParams::MultipleEdgesResolveMode::Simple } );
+            if ( !reportProgress( roundSp, 0.4f ) )
+                return unexpectedOperationCanceled();
 
-            if ( !reportProgress( sp, float( i + 1 ) / float( holes.size() ) ) )
+            VertBitSet newVerts;
+            if ( currentSettings.subdivideEdgeLen < FLT_MAX )
+            {
+                SubdivideSettings ssettings;
+                ssettings.region = &newFaces;
+                ssettings.newVerts = &newVerts;
+                ssettings.maxEdgeLen = currentSettings.subdivideEdgeLen;
+                ssettings.maxEdgeSplits = 1000000;
+                subdivideMesh( mesh, ssettings );
+            }
+            relax( mesh, { { currentSettings.relaxIterations, &newVerts } } );
+            if ( !reportProgress( roundSp, 0.6f ) )
                 return unexpectedOperationCanceled();
-        }
 
-        relax( mesh, { {currentSettings.relaxIterations, &newVerts } } );
+            if ( round + 1 == numRounds )
+                break;
+            expand( mesh.topology, newFaces, 1 );
+            updateRegionMap( mesh, faceToRegionMap, numRegions, newFaces );
+            res = findSelfCollidingTrianglesBSForPart( mesh, newFaces, subprogress( roundSp, 0.6f, 1.0f ), &faceToRegionMap );
+            if ( !res.has_value() )
+                return unexpected( res.error() );
+            if ( res->none() )
+                break;
+            expand( mesh.topology, *res, settings.maxExpand + round + 1 );
+        }
 
         if ( !reportProgress( settings.callback, 1.0f ) )
             return unexpectedOperationCanceled();
@@ -220,23 +355,6 @@ VoidOrErrStr fix( Mesh& mesh, const Settings& settings )
     return {};
 }
 
-// Helper function to find own self-intersections on a mesh part
-static Expected<FaceBitSet> findSelfCollidingTrianglesBSForPart( Mesh& mesh, const FaceBitSet& part, ProgressCallback cb )
-{
-    FaceMap tgt2srcFaces;
-    PartMapping mapping;
-    mapping.tgt2srcFaces = &tgt2srcFaces;
-    Mesh partMesh = mesh.cloneRegion( part, false, mapping );
-    // Faster than searching in mesh part due to AABB tree rebuild
-    auto res = findSelfCollidingTrianglesBS( { partMesh }, cb );
-    if ( !res.has_value() )
-        return unexpected( res.error() );
-    FaceBitSet result( mesh.topology.lastValidFace() + 1 );
-    for ( FaceId f : *res )
-        result.set( tgt2srcFaces[f] );
-    return result;
-}
-
 static VoidOrErrStr doFix( Mesh &mesh, FaceBitSet &part, const Settings & settings,
     int expandSize,
     FaceBitSet& accumBadFaces,
@@ -334,5 +452,52 @@ static VoidOrErrStr doFix( Mesh &mesh, FaceBitSet &part, const Settings & settin
     return {};
 }
 
+TEST( MRMesh, FixSelfIntersectionsCutAndFill )
+{
+    auto mesh = makeTorusWithSelfIntersections( 2, 1, 10, 10 );
+    const auto numFaces0 = mesh.topology.numValidFaces();
+    auto before = getFaces( mesh );
+    ASSERT_TRUE( before.has_value() );
+    EXPECT_GT( before->count(), 0 );
+
+    Settings settings;
+    settings.method = Settings::Method::CutAndFill;
+    EXPECT_TRUE( fix( mesh, settings ).has_value() );
+    auto after = getFaces( mesh );
+    ASSERT_TRUE( after.has_value() );
+    EXPECT_EQ( after->count(), 0 );
+    EXPECT_EQ( mesh.topology.findNumHoles(), 0 );
+    EXPECT_GT( mesh.topology.numValidFaces(), numFaces0 / 2 );
+}
+
+TEST( MRMesh, FixSelfIntersectionsCutAndFillLocal )
+{
+    // self-intersecting torus and separate sphere with a hole far from it
+    auto mesh = makeTorusWithSelfIntersections( 2, 1, 10, 10 );
+    auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 1000 } );
+    sphere.transform( AffineXf3f::translation( Vector3f( 10, 0, 0 ) ) );
+    sphere.topology.deleteFace( 0_f );
+    sphere.invalidateCaches();
+    const auto firstSphereFace = FaceId( mesh.topology.faceSize() );
+    const auto numSphereFaces = sphere.topology.numValidFaces();
+    mesh.addPart( sphere );
+    const auto lastSphereFace = FaceId( mesh.topology.faceSize() );
+
+    Settings settings;
+    settings.method = Settings::Method::CutAndFill;
+    EXPECT_TRUE( fix( mesh, settings ).has_value() );
+    auto after = getFaces( mesh );
+    ASSERT_TRUE( after.has_value() );
+    EXPECT_EQ( after->count(), 0 );
+
+    // the sphere is not touched, and its hole is kept
+    int numKeptSphereFaces = 0;
+    for ( auto f = firstSphereFace; f < lastSphereFace; ++f )
+        if ( mesh.topology.hasFace( f ) )
+            ++numKeptSphereFaces;
+    EXPECT_EQ( numKeptSphereFaces, numSphereFaces );
+    EXPECT_EQ( mesh.topology.findNumHoles(), 1 );
+}
+
 }
 }
@@ -28,6 +28,9 @@ struct Settings
     /// Edge length for subdivision of holes covers (0.0f means auto)
     /// FLT_MAX to disable subdivision
     float subdivideEdgeLen = 0.0f;
+    /// Maximum number of rounds in `CutAndFill` method: after each round only the neighborhoods of new faces are checked,
+    /// and remaining self-intersections are cut out with larger margin in the next round
+    int maxCutAndFillRounds = 3;
     /// Callback function
     ProgressCallback callback = {};
 };
@@ -1,9 +1,11 @@
 #include "MRFloatGridComponents.h"
 #ifndef MRMESH_NO_OPENVDB
-#include "MRUnionFind.h"
 #include "MRVDBFloatGrid.h"
 #include "MRVolumeIndexer.h"
 #include "MRBitSet.h"
+#include "MRBitSetParallelFor.h"
+#include "MRParallelFor.h"
+#include "MRProgressCallback.h"
 #include "MRTimer.h"
 
 namespace MR
@@ -12,63 +14,48 @@ namespace MR
 namespace FloatGridComponents
 {
 
-UnionFind<VoxelId> getUnionFindStructureVoxels( const FloatGrid& grid, const VolumeIndexer& indexer, const Vector3i& minVox, float isoValue )
+std::vector<VoxelBitSet> getAllComponents( const FloatGrid& grid, float isoValue /*= 0.0f*/ )
 {
     MR_TIMER;
-    UnionFind<VoxelId> unionFindStructure( indexer.size() );
-    auto accessor = grid->getConstAccessor();
-
-    for ( int z = 0; z < indexer.dims().z; ++z )
-        for ( int y = 0; y < indexer.dims().y; ++y )
-            for ( int x = 0; x < indexer.dims().x; ++x )
-            {
-                auto thisVox = indexer.toVoxelId( { x,y,z } );
-                auto thisCoord = minVox + Vector3i{ x, y, z };
-                auto thisVal = accessor.getValue( { thisCoord.x, thisCoord.y, thisCoord.z } );
-                for ( int i = 0; i < OutEdgeCount; i += 2 /*Plus dir only*/ )
-                {
-                    auto neighVox = indexer.getNeighbor( thisVox, OutEdge( i ) );
-                    if ( !neighVox.valid() )
-                        continue;
-                    auto neighCoord = minVox + indexer.toPos( neighVox );
-
-                    if ( ( thisVal < isoValue ) == ( accessor.getValue( { neighCoord.x, neighCoord.y, neighCoord.z } ) < isoValue ) )
-                        unionFindStructure.unite( thisVox, neighVox );
-                }
-            }
-    return unionFindStructure;
+    auto labeled = labelComponents( grid, isoValue );
+    assert( labeled.has_value() ); // can only fail on cancellation
+    if ( !labeled )
+        return {};
+
+    const auto& labels = labeled->labels;
+    std::vector<VoxelBitSet> res( labeled->numComponents(), VoxelBitSet( labels.size() ) );
+    // each block of bits is processed by one thread only, so the same blocks in all bit-sets are modified by that thread
+    const auto numBlocks = ( labels.size() + VoxelBitSet::bits_per_block - 1 ) / VoxelBitSet::bits_per_block;
+    ParallelFor( size_t( 0 ), numBlocks, [&] ( size_t block )
+    {
+        const auto end = VoxelId( std::min( ( block + 1 ) * VoxelBitSet::bits_per_block, labels.size() ) );
+        for ( auto voxId = VoxelId( block * VoxelBitSet::bits_per_block ); voxId < end; ++voxId )
+            res[labels[voxId]].set( voxId );
+    } );
+    return res;
 }
 
-std::vector<VoxelBitSet> getAllComponents( const FloatGrid& grid, float isoValue /*= 0.0f*/ )
+Expected<VoxelsComponents::LabeledVoxels> labelComponents( const FloatGrid& grid, float isoValue, const ProgressCallback& cb )
 {
     MR_TIMER;
-    auto bbox = grid->evalActiveVoxelBoundingBox();
-    Vector3i dims = { bbox.dim().x(),bbox.dim().y(),bbox.dim().z() };
-    VolumeIndexer indexer = VolumeIndexer( dims );
-    auto unionFindStruct = getUnionFindStructureVoxels( grid, indexer, { bbox.min().x(),bbox.min().y(),bbox.min().z() }, isoValue );
-
-    const auto& allRoots = unionFindStruct.roots();
-    constexpr size_t InvalidRoot = ~size_t( 0 );
-    std::vector<size_t> uniqueRootsMap( allRoots.size(), InvalidRoot );
-    size_t k = 0;
-    size_t curRoot;
-    for ( size_t voxId = 0; voxId < indexer.size(); ++voxId )
+    const auto bbox = grid->evalActiveVoxelBoundingBox();
+    if ( bbox.empty() )
+        return VoxelsComponents::LabeledVoxels{};
+    const Vector3i minVox{ bbox.min().x(), bbox.min().y(), bbox.min().z() };
+    const VolumeIndexer indexer( { bbox.dim().x(), bbox.dim().y(), bbox.dim().z() } );
+
+    VoxelBitSet below( indexer.size() );
+    tbb::enumerable_thread_specific accessorPerThread( grid->getConstAccessor() );
+    if ( !BitSetParallelForAll( below, [&] ( VoxelId voxId )
     {
-        curRoot = allRoots[VoxelId( voxId )];
-        auto& uniqIndex = uniqueRootsMap[curRoot];
-        if ( uniqIndex == InvalidRoot )
-        {
-            uniqIndex = k;
-            ++k;
-        }
-    }
-    std::vector<VoxelBitSet> res( k, VoxelBitSet( allRoots.size() ) );
-    for ( size_t voxId = 0; voxId < indexer.size(); ++voxId )
-    {
-        curRoot = allRoots[VoxelId( voxId )];
-        res[uniqueRootsMap[curRoot]].set( VoxelId( voxId ) );
-    }
-    return res;
+        auto& accessor = accessorPerThread.local();
+        const auto coord = minVox + indexer.toPos( voxId );
+        if ( accessor.getValue( { coord.x, coord.y, coord.z } ) < isoValue )
+            below.set( voxId );
+    }, subprogress( cb, 0.0f, 0.3f ) ) )
+        return unexpectedOperationCanceled();
+
+    return VoxelsComponents::labelComponents( below, indexer, true, subprogress( cb, 0.3f, 1.0f ) );
 }
 
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include "MRMeshFwd.h"
 #ifndef MRMESH_NO_OPENVDB
+#include "MRVoxelsComponents.h"
 
 namespace MR
 {
@@ -18,6 +19,12 @@ namespace FloatGridComponents
 /// \ingroup ComponentsGroup
 MRMESH_API std::vector<VoxelBitSet> getAllComponents( const FloatGrid& grid, float isoValue = 0.0f );
 
+/// labels separated by iso-value components in parallel, each voxel of active bounding box gets some label;
+/// voxel ids and boxes are in grid space (0 voxel id is minimum active voxel in grid)
+/// \ingroup ComponentsGroup
+MRMESH_API Expected<VoxelsComponents::LabeledVoxels> labelComponents( const FloatGrid& grid, float isoValue = 0.0f,
+    const ProgressCallback& cb = {} );
+
 }
 
 }
@@ -31,6 +31,16 @@ struct hash<MR::Vector2f>
     }
 };
 
+template<>
+struct hash<MR::Vector2i>
+{
+    size_t operator()( MR::Vector2i const& p ) const noexcept
+    {
+        const auto xy = ( std::uint64_t( std::uint32_t( p.x ) ) << 32 ) | std::uint32_t( p.y );
+        return size_t( xy ^ ( xy >> 29 ) );
+    }
+};
+
 template<>
 struct hash<MR::Vector3f>
 {
@@ -0,0 +1,350 @@
+#include "MRHeatGeodesics.h"
+#include "MRMesh.h"
+#include "MRMeshTriPoint.h"
+#include "MRRingIterator.h"
+#include "MRBitSetParallelFor.h"
+#include "MRParallelFor.h"
+#include "MRSurfaceDistance.h"
+#include "MRMakeSphereMesh.h"
+#include "MRUnionFind.h"
+#include "MRTimer.h"
+#include "MRGTest.h"
+
+#if __clang_major__ >= 13
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-but-set-variable"
+#endif
+#include <Eigen/SparseCholesky>
+#if __clang_major__ >= 13
+#pragma clang diagnostic pop
+#endif
+
+namespace MR
+{
+
+namespace
+{
+
+/// cotangent of the angle at point a in triangle abc
+double cotAngle( const Vector3d & a, const Vector3d & b, const Vector3d & c )
+{
+    const auto ab = b - a;
+    const auto ac = c - a;
+    const auto sin = cross( ab, ac ).length();
+    // cotangent can be arbitrary high for degenerate triangles
+    return sin > 0 ? std::clamp( dot( ab, ac ) / sin, -100.0, 100.0 ) : 0.0;
+}
+
+} // anonymous namespace
+
+class HeatGeodesics::Impl
+{
+public:
+    Impl( const Mesh & mesh, float timeFactor );
+
+    /// computes distances from the sources given as weighted vertices
+    Expected<VertScalars> compute( const std::vector<std::pair<VertId, double>> & sources ) const;
+
+    const MeshTopology & topology() const { return mesh_.topology; }
+
+private:
+    using SparseMatrix = Eigen::SparseMatrix<double>;
+
+    const Mesh & mesh_;
+    Vector<int, VertId> vert2idx_;
+    std::vector<VertId> idx2vert_;
+    /// connected component of each vertex, the distances in different components are independent
+    std::vector<int> idx2comp_;
+    int numComponents_ = 0;
+    /// the vertices of each valid face and the cotangents of the angles in its corners
+    struct FaceGeom
+    {
+        std::array<int, 3> idx;
+        Vector3d cot;
+    };
+    std::vector<FaceGeom> faces_;
+    /// for each vertex, the range in vertCorners_ with its corners given as (face index * 3 + corner)
+    std::vector<int> vertCornerStart_;
+    std::vector<int> vertCorners_;
+    Eigen::SimplicialLDLT<SparseMatrix> heatSolver_;
+    Eigen::SimplicialLDLT<SparseMatrix> poissonSolver_;
+    bool valid_ = false;
+};
+
+HeatGeodesics::Impl::Impl( const Mesh & mesh, float timeFactor ) : mesh_( mesh )
+{
+    MR_TIMER
+    const auto & topology = mesh.topology;
+    const auto & validVerts = topology.getValidVerts();
+    vert2idx_.resize( validVerts.size(), -1 );
+    for ( auto v : validVerts )
+    {
+        vert2idx_[v] = int( idx2vert_.size() );
+        idx2vert_.push_back( v );
+    }
+    const int n = int( idx2vert_.size() );
+    if ( n == 0 )
+        return;
+
+    // positive semidefinite cotangent Laplacian and lumped mass matrix
+    std::vector<Eigen::Triplet<double>> lTriplets;
+    Eigen::VectorXd diag = Eigen::VectorXd::Zero( n );
+    Eigen::VectorXd mass = Eigen::VectorXd::Zero( n );
+    UnionFind<VertId> unionFind( validVerts.size() );
+    for ( UndirectedEdgeId ue{ 0 }; ue < topology.undirectedEdgeSize(); ++ue )
+    {
+        const EdgeId e( ue );
+        if ( topology.isLoneEdge( e ) )
+            continue;
+        unionFind.unite( topology.org( e ), topology.dest( e ) );
+        const int i = vert2idx_[topology.org( e )];
+        const int j = vert2idx_[topology.dest( e )];
+        const double w = 0.5 * std::clamp( double( mesh.cotan( ue ) ), -100.0, 100.0 );
+        lTriplets.emplace_back( i, j, -w );
+        lTriplets.emplace_back( j, i, -w );
+        diag[i] += w;
+        diag[j] += w;
+    }
+    idx2comp_.resize( n );
+    Vector<int, VertId> root2comp( validVerts.size(), -1 );
+    for ( int i = 0; i < n; ++i )
+    {
+        auto & c = root2comp[unionFind.find( idx2vert_[i] )];
+        if ( c < 0 )
+            c = numComponents_++;
+        idx2comp_[i] = c;
+    }
+
+    // the geometry of faces is computed once here to make the queries faster
+    faces_.reserve( topology.numValidFaces() );
+    vertCornerStart_.resize( n + 1, 0 );
+    for ( auto f : topology.getValidFaces() )
+    {
+        const auto a = mesh.area( f ) / 3.0;
+        const auto vs = topology.getTriVerts( f );
+        auto & fg = faces_.emplace_back();
+        Vector3d p[3];
+        for ( int k = 0; k < 3; ++k )
+        {
+            fg.idx[k] = vert2idx_[vs[k]];
+            mass[fg.idx[k]] += a;
+            ++vertCornerStart_[fg.idx[k] + 1];
+            p[k] = Vector3d( mesh.points[vs[k]] );
+        }
+        for ( int k = 0; k < 3; ++k )
+            fg.cot[k] = cotAngle( p[k], p[( k + 1 ) % 3], p[( k + 2 ) % 3] );
+    }
+    for ( int i = 0; i < n; ++i )
+        vertCornerStart_[i + 1] += vertCornerStart_[i];
+    vertCorners_.resize( vertCornerStart_.back() );
+    {
+        auto next = vertCornerStart_;
+        for ( int fi = 0; fi < int( faces_.size() ); ++fi )
+            for ( int k = 0; k < 3; ++k )
+                vertCorners_[next[faces_[fi].idx[k]]++] = 3 * fi + k;
+    }
+
+    const double t = sqr( double( mesh.averageEdgeLength() ) ) * timeFactor;
+    std::vector<Eigen::Triplet<double>> heatTriplets, poissonTriplets;
+    heatTriplets.reserve( lTriplets.size() + n );
+    poissonTriplets.reserve( lTriplets.size() + n );
+    for ( const auto & tr : lTriplets )
+    {
+        heatTriplets.emplace_back( tr.row(), tr.col(), t * tr.value() );
+        poissonTriplets.push_back( tr );
+    }
+    // tiny multiple of mass matrix removes the null space of Laplacian (constant functions) in Poisson equation
+    const double eps = 1e-8 / t;
+    for ( int i = 0; i < n; ++i )
+    {
+        heatTriplets.emplace_back( i, i, mass[i] + t * diag[i] );
+        poissonTriplets.emplace_back( i, i, diag[i] + eps * mass[i] );
+    }
+
+    SparseMatrix heat( n, n ), poisson( n, n );
+    heat.setFromTriplets( heatTriplets.begin(), heatTriplets.end() );
+    poisson.setFromTriplets( poissonTriplets.begin(), poissonTriplets.end() );
+    heatSolver_.compute( heat );
+    poissonSolver_.compute( poisson );
+    valid_ = heatSolver_.info() == Eigen::Success && poissonSolver_.info() == Eigen::Success;
+}
+
+Expected<VertScalars> HeatGeodesics::Impl::compute( const std::vector<std::pair<VertId, double>> & sources ) const
+{
+    MR_TIMER
+    if ( !valid_ )
+        return unexpected( "Factorization of heat method matrices failed" );
+    if ( sources.empty() )
+        return unexpected( "No start points given" );
+    for ( const auto & [v, w] : sources )
+        if ( !v || v >= vert2idx_.size() || vert2idx_[v] < 0 )
+            return unexpected( "Start point is not on a valid vertex of the mesh" );
+
+    const auto & topology = mesh_.topology;
+    const int n = int( idx2vert_.size() );
+
+    // diffuse heat from the sources during short time
+    Eigen::VectorXd u0 = Eigen::VectorXd::Zero( n );
+    for ( const auto & [v, w] : sources )
+        u0[vert2idx_[v]] += w;
+    const Eigen::VectorXd u = heatSolver_.solve( u0 );
+
+    // normalized negative gradient of heat in each triangle, and its integrated divergence in the corners of the triangle
+    std::vector<Vector3d> cornerDivs( faces_.size() );
+    ParallelFor( faces_, [&]( size_t fi )
+    {
+        const auto & fg = faces_[fi];
+        Vector3d p[3];
+        for ( int k = 0; k < 3; ++k )
+            p[k] = Vector3d( mesh_.points[idx2vert_[fg.idx[k]]] );
+        const auto nrm = cross( p[1] - p[0], p[2] - p[0] ).normalized();
+        const auto grad =
+            u[fg.idx[0]] * cross( nrm, p[2] - p[1] ) +
+            u[fg.idx[1]] * cross( nrm, p[0] - p[2] ) +
+            u[fg.idx[2]] * cross( nrm, p[1] - p[0] );
+        const auto len = grad.length();
+        if ( !( len > 0 ) )
+            return;
+        const auto x = -grad / len;
+        auto & cd = cornerDivs[fi];
+        for ( int k = 0; k < 3; ++k )
+        {
+            const int k1 = ( k + 1 ) % 3, k2 = ( k + 2 ) % 3;
+            cd[k] = 0.5 * ( fg.cot[k2] * dot( p[k1] - p[k], x ) + fg.cot[k1] * dot( p[k2] - p[k], x ) );
+        }
+    } );
+
+    // integrated divergence of the field around each vertex
+    Eigen::VectorXd div( n );
+    ParallelFor( 0, n, [&]( int i )
+    {
+        double sum = 0;
+        for ( int c = vertCornerStart_[i]; c < vertCornerStart_[i + 1]; ++c )
+            sum += cornerDivs[vertCorners_[c] / 3][vertCorners_[c] % 3];
+        div[i] = sum;
+    } );
+
+    // the distance is the function with the gradient closest to the field
+    const Eigen::VectorXd phi = poissonSolver_.solve( -div );
+
+    // the distance is defined up to a constant in each connected component, which is found from the sources there
+    std::vector<double> shift( numComponents_, 0 ), sumW( numComponents_, 0 );
+    for ( const auto & [v, w] : sources )
+    {
+        const auto i = vert2idx_[v];
+        shift[idx2comp_[i]] += w * phi[i];
+        sumW[idx2comp_[i]] += w;
+    }
+
+    // the vertices in the components without sources are not reachable
+    VertScalars res( topology.vertSize(), FLT_MAX );
+    ParallelFor( 0, n, [&]( int i )
+    {
+        const auto c = idx2comp_[i];
+        if ( sumW[c] > 0 )
+            res[idx2vert_[i]] = float( phi[i] - shift[c] / sumW[c] );
+    } );
+    return res;
+}
+
+HeatGeodesics::HeatGeodesics( const Mesh & mesh, float timeFactor )
+    : impl_( std::make_unique<Impl>( mesh, timeFactor ) )
+{
+}
+
+HeatGeodesics::HeatGeodesics( HeatGeodesics&& ) noexcept = default;
+HeatGeodesics& HeatGeodesics::operator=( HeatGeodesics&& ) noexcept = default;
+HeatGeodesics::~HeatGeodesics() = default;
+
+Expected<VertScalars> HeatGeodesics::compute( const VertBitSet & startVertices ) const
+{
+    std::vector<std::pair<VertId, double>> sources;
+    for ( auto v : startVertices )
+        sources.emplace_back( v, 1.0 );
+    return impl_->compute( sources );
+}
+
+Expected<VertScalars> HeatGeodesics::compute( const std::vector<MeshTriPoint> & starts ) const
+{
+    std::vector<std::pair<VertId, double>> sources;
+    for ( const auto & mtp : starts )
+        for ( const auto & wv : mtp.getWeightedVerts( impl_->topology() ) )
+            if ( wv.weight > 0 )
+                sources.emplace_back( wv.v, wv.weight );
+    return impl_->compute( sources );
+}
+
+TEST( MRMesh, HeatGeodesics )
+{
+    const auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 3000 } );
+    VertId north;
+    for ( auto v : sphere.topology.getValidVerts() )
+        if ( !north || sphere.points[v].z > sphere.points[north].z )
+            north = v;
+    VertBitSet start( sphere.topology.vertSize() );
+    start.set( north );
+
+    const HeatGeodesics heat( sphere );
+    const auto dist = heat.compute( start );
+    ASSERT_TRUE( dist.has_value() );
+    const auto exact = computeSurfaceDistances( sphere, start );
+
+    // the distance on unit sphere is the angle between the points
+    const auto np = sphere.points[north].normalized();
+    double sumErr = 0, sumErrExact = 0;
+    for ( auto v : sphere.topology.getValidVerts() )
+    {
+        const auto trueDist = std::acos( std::clamp( dot( np, sphere.points[v].normalized() ), -1.0f, 1.0f ) );
+        sumErr += std::abs( ( *dist )[v] - trueDist );
+        sumErrExact += std::abs( exact[v] - trueDist );
+    }
+    const auto numVerts = sphere.topology.numValidVerts();
+    EXPECT_LT( sumErr / numVerts, 0.05 );
+    EXPECT_LT( sumErrExact / numVerts, 0.05 );
+
+    // the same result from the point in the vertex
+    const auto dist2 = heat.compute( std::vector<MeshTriPoint>{ MeshTriPoint( sphere.topology, north ) } );
+    ASSERT_TRUE( dist2.has_value() );
+    EXPECT_LT( std::abs( ( *dist2 )[north] ), 1e-6f );
+
+    // invalid start vertex
+    VertBitSet badStart( sphere.topology.vertSize() + 1 );
+    badStart.set( VertId( sphere.topology.vertSize() ) );
+    EXPECT_FALSE( heat.compute( badStart ).has_value() );
+}
+
+TEST( MRMesh, HeatGeodesicsComponents )
+{
+    // two separate spheres
+    auto mesh = makeSphere( { .radius = 1.0f, .numMeshVertices = 500 } );
+    auto second = mesh;
+    second.transform( AffineXf3f::translation( Vector3f( 3, 0, 0 ) ) );
+    const auto firstVertsSize = mesh.topology.vertSize();
+    mesh.addPart( second );
+
+    const HeatGeodesics heat( mesh );
+    VertBitSet start( mesh.topology.vertSize() );
+    start.set( 0_v );
+    const auto dist = heat.compute( start );
+    ASSERT_TRUE( dist.has_value() );
+    EXPECT_LT( std::abs( ( *dist )[0_v] ), 1e-3f );
+    for ( auto v : mesh.topology.getValidVerts() )
+    {
+        if ( v < firstVertsSize )
+            EXPECT_LT( ( *dist )[v], 4.0f );
+        else
+            EXPECT_EQ( ( *dist )[v], FLT_MAX );
+    }
+
+    // a source in each sphere, the distances in both are measured from their own sources
+    const auto secondStart = VertId( firstVertsSize );
+    start.set( secondStart );
+    const auto dist2 = heat.compute( start );
+    ASSERT_TRUE( dist2.has_value() );
+    EXPECT_LT( std::abs( ( *dist2 )[0_v] ), 1e-3f );
+    EXPECT_LT( std::abs( ( *dist2 )[secondStart] ), 1e-3f );
+    for ( auto v : mesh.topology.getValidVerts() )
+        EXPECT_NEAR( ( *dist2 )[v], ( *dist )[v < firstVertsSize ? v : VertId( v - firstVertsSize )], 1e-3f );
+}
+
+} //namespace MR
@@ -7,6 +7,11 @@
 #include "MRQuaternion.h"
 #include "MRBestFit.h"
 #include "MRBitSetParallelFor.h"
+#include "MRPointCloud.h"
+#include "MRTorus.h"
+#include "MRMatrix3.h"
+#include "MRGTest.h"
+#include <algorithm>
 #include <numeric>
 
 namespace MR
@@ -106,7 +111,10 @@ void ICP::updatePointPairs()
     MR_TIMER
     MR::updatePointPairs( flt2refPairs_, flt_, ref_, prop_.cosThreshold, prop_.distThresholdSq, prop_.mutualClosest );
     MR::updatePointPairs( ref2fltPairs_, ref_, flt_, prop_.cosThreshold, prop_.distThresholdSq, prop_.mutualClosest );
-    deactivatefarDistPairs_();
+    if ( prop_.trimRatio > 0 )
+        deactivateTrimmedPairs_();
+    else
+        deactivatefarDistPairs_();
 }
 
 std::string getICPStatusInfo( int iterations, ICPExitType exitType )
@@ -151,6 +159,8 @@ void updatePointPairs( PointPairs & pairs,
     const auto srcWeights = src.obj.weights();
     const auto srcLimProjector = src.obj.limitedProjector();
     const auto tgtLimProjector = tgt.obj.limitedProjector();
+    const auto tgtFeatureProjector = tgt.obj.featureProjector();
+    const auto tgtOtherFeatureDist = tgt.obj.otherFeatureDistance();
 
     pairs.active.clear();
     pairs.active.resize( pairs.vec.size(), true );
@@ -165,21 +175,37 @@ void updatePointPairs( PointPairs & pairs,
         MeshOrPoints::ProjectionResult prj;
         // do not search for target point further than distance threshold
         prj.distSq = distThresholdSq;
+        // the distance of source point in target space from its position during last search of the closest feature
+        float motion = -1;
+        bool sameFeature = false;
         if ( res.tgtCloseVert )
         {
-            // start with old closest point ...
-            prj.point = tgtPoints[res.tgtCloseVert];
-            if ( tgtNormals )
-                prj.normal = tgtNormals( res.tgtCloseVert );
-            prj.isBd = res.tgtOnBd;
-            prj.distSq = ( pt - prj.point ).lengthSq();
+            motion = ( pt - res.tgtSpaceSrcPoint ).length();
             prj.closestVert = res.tgtCloseVert;
+            prj.closestFace = res.tgtCloseFace;
+            if ( motion <= res.maxTgtMotion )
+            {
+                // the closest feature cannot change, so just recompute the closest point on it
+                tgtFeatureProjector( pt, prj );
+                sameFeature = true;
+            }
+            else
+            {
+                // start with old closest point ...
+                prj.point = tgtPoints[res.tgtCloseVert];
+                if ( tgtNormals )
+                    prj.normal = tgtNormals( res.tgtCloseVert );
+                prj.isBd = res.tgtOnBd;
+                prj.distSq = ( pt - prj.point ).lengthSq();
+            }
         }
         // ... and try to find only closer one
-        tgtLimProjector( pt, prj );
+        if ( !sameFeature )
+            tgtLimProjector( pt, prj );
         if ( !prj.closestVert )
         {
             // no target point found within distance threshold
+            res.maxTgtMotion = -1;
             pairs.active.reset( idx );
             return;
         }
@@ -196,6 +222,20 @@ void updatePointPairs( PointPairs & pairs,
         vp.srcNorm = srcNormals ? ( src.xf.A * srcNormals( vp.srcVertId ) ).normalized() : Vector3f();
         vp.normalsAngleCos = ( prj.normal && srcNormals ) ? dot( vp.tgtNorm, vp.srcNorm ) : 1.0f;
         vp.tgtOnBd = prj.isBd;
+        vp.tgtCloseFace = prj.closestFace;
+        if ( !sameFeature )
+        {
+            vp.tgtSpaceSrcPoint = pt;
+            vp.maxTgtMotion = -1;
+            if ( motion >= 0 )
+            {
+                // expect that the point will move next time not more than now, and find whether it keeps the closest feature then;
+                // the search of other features is limited to make it fast
+                const auto dist = std::sqrt( prj.distSq );
+                const auto otherDistSq = tgtOtherFeatureDist( pt, prj, sqr( dist + 4 * motion ) );
+                vp.maxTgtMotion = ( std::sqrt( otherDistSq ) - dist ) / 2;
+            }
+        }
         res = vp;
         if ( prj.isBd || vp.normalsAngleCos < cosThreshold || vp.distSq > distThresholdSq )
         {
@@ -230,6 +270,26 @@ void ICP::deactivatefarDistPairs_()
     }
 }
 
+void ICP::deactivateTrimmedPairs_()
+{
+    MR_TIMER
+    activeDistSq_.clear();
+    for ( size_t idx : flt2refPairs_.active )
+        activeDistSq_.push_back( flt2refPairs_.vec[idx].distSq );
+    for ( size_t idx : ref2fltPairs_.active )
+        activeDistSq_.push_back( ref2fltPairs_.vec[idx].distSq );
+
+    const auto numKeep = size_t( std::ceil( activeDistSq_.size() * ( 1.0 - prop_.trimRatio ) ) );
+    if ( numKeep == 0 || numKeep >= activeDistSq_.size() )
+        return;
+
+    // only the distance of numKeep-th pair is needed, so full sorting is avoided
+    std::nth_element( activeDistSq_.begin(), activeDistSq_.begin() + ( numKeep - 1 ), activeDistSq_.end() );
+    const auto maxDistSq = activeDistSq_[numKeep - 1];
+    MR::deactivateFarPairs( flt2refPairs_, maxDistSq );
+    MR::deactivateFarPairs( ref2fltPairs_, maxDistSq );
+}
+
 bool ICP::p2ptIter_()
 {
     MR_TIMER
@@ -408,6 +468,21 @@ AffineXf3f ICP::calculateTransformation()
     return flt_.xf;
 }
 
+AffineXf3f ICP::calculateTransformationMultires( float samplingVoxelSize, int numLevels )
+{
+    MR_TIMER
+    assert( samplingVoxelSize > 0 );
+    for ( int level = std::max( numLevels, 1 ) - 1; level >= 0; --level )
+    {
+        // few samples on coarse levels quickly find approximate transformation, which is refined on next levels
+        samplePoints( samplingVoxelSize * float( 1 << level ) );
+        ( void )calculateTransformation();
+        if ( resultType_ == ICPExitType::NotFoundSolution )
+            break;
+    }
+    return flt_.xf;
+}
+
 size_t getNumActivePairs( const IPointPairs& pairs )
 {
     return pairs.active.count();
@@ -479,4 +554,71 @@ float ICP::getMeanSqDistToPlane() const
     return ( getSumSqDistToPlane( flt2refPairs_ ) + getSumSqDistToPlane( ref2fltPairs_ ) ).rootMeanSqF();
 }
 
+TEST( MRMesh, MultiresTrimmedICP )
+{
+    const auto ref = makeTorus( 2.0f, 1.0f, 64, 64 );
+
+    // the floating cloud is the vertices of the same torus with extra outliers not present in reference mesh
+    PointCloud flt;
+    flt.points = ref.points;
+    for ( int i = 0; i < 200; ++i )
+        flt.points.emplace_back( 6.0f + 0.01f * i, 0.0f, 0.0f );
+    flt.validPoints.resize( flt.points.size(), true );
+
+    const auto trueXf = AffineXf3f::translation( { 0.1f, -0.05f, 0.05f } ) * AffineXf3f::linear( Matrix3f::rotation( Vector3f::plusX(), 0.05f ) );
+    ICPProperties props;
+    props.method = ICPMethod::PointToPoint;
+    props.trimRatio = 0.1f;
+    props.iterLimit = 30;
+    props.distThresholdSq = sqr( 2.0f );
+    ICP icp( MeshOrPoints( flt ), MeshOrPoints( ref ), trueXf.inverse(), AffineXf3f(), 0.1f );
+    icp.setParams( props );
+    const auto xf = icp.calculateTransformationMultires( 0.1f, 3 );
+
+    // the floating object shall return in its original position
+    EXPECT_LT( ( xf.A - Matrix3f() ).norm(), 1e-3f );
+    EXPECT_LT( xf.b.length(), 1e-3f );
+}
+
+TEST( MRMesh, ICPCorrespondenceCache )
+{
+    const auto tgtMesh = makeTorus( 2.0f, 1.0f, 64, 64 );
+    PointCloud tgtCloud;
+    tgtCloud.points = tgtMesh.points;
+    tgtCloud.validPoints.resize( tgtCloud.points.size(), true );
+
+    PointCloud src;
+    src.points = makeTorus( 2.05f, 0.95f, 50, 50 ).points;
+    src.validPoints.resize( src.points.size(), true );
+
+    for ( const auto & tgt : { MeshOrPoints( tgtMesh ), MeshOrPoints( tgtCloud ) } )
+    {
+        // the source moves less and less like in late ICP iterations
+        PointPairs cached;
+        setupPairs( cached, src.validPoints );
+        AffineXf3f xf;
+        for ( int i = 0; i < 8; ++i )
+        {
+            xf = AffineXf3f::linear( Matrix3f::rotation( Vector3f::plusX(), 0.01f / ( 1 << i ) ) ) * xf;
+            updatePointPairs( cached, { MeshOrPoints( src ), xf }, { tgt, {} }, -1, FLT_MAX, false );
+        }
+        size_t numSkipping = 0;
+        for ( const auto & vp : cached.vec )
+            if ( vp.maxTgtMotion > 0 )
+                ++numSkipping;
+        EXPECT_GT( numSkipping, cached.vec.size() / 2 );
+
+        // the pairs found with the cache are the same as found from scratch
+        PointPairs fresh;
+        setupPairs( fresh, src.validPoints );
+        updatePointPairs( fresh, { MeshOrPoints( src ), xf }, { tgt, {} }, -1, FLT_MAX, false );
+        ASSERT_EQ( cached.vec.size(), fresh.vec.size() );
+        for ( size_t i = 0; i < fresh.vec.size(); ++i )
+        {
+            EXPECT_NEAR( cached.vec[i].distSq, fresh.vec[i].distSq, 1e-6f );
+            EXPECT_LT( ( cached.vec[i].tgtPoint - fresh.vec[i].tgtPoint ).length(), 1e-4f );
+        }
+    }
+}
+
 } //namespace MR
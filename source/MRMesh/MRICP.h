@@ -51,6 +51,17 @@ struct PointPair : public ICPPairData
     /// true if if the closest point on target is located on the boundary (only for meshes)
     bool tgtOnBd = false;
 
+    /// the triangle with the closest point on target (only for meshes)
+    FaceId tgtCloseFace;
+
+    /// the source point in target space when the closest feature on target was searched last time
+    Vector3f tgtSpaceSrcPoint;
+
+    /// while the source point in target space is not further than this distance from tgtSpaceSrcPoint,
+    /// its closest feature on target (tgtCloseVert for point clouds or tgtCloseFace for meshes) remains the same
+    /// and the search of the closest feature is skipped; negative value means unknown
+    float maxTgtMotion = -1.f;
+
     friend bool operator == ( const PointPair&, const PointPair& ) = default;
 };
 
@@ -136,6 +147,10 @@ struct ICPProperties
     /// root-mean-square distance times this factor
     float farDistFactor = 3.f; // dimensionless
 
+    /// if positive then farDistFactor is ignored, and instead this fraction of active pairs
+    /// with the largest distances between points is deactivated on each iteration (trimmed ICP)
+    float trimRatio = 0.f; // in [0,1)
+
     /// Finds only translation. Rotation part is identity matrix
     ICPMode icpMode = ICPMode::AnyRigidXf;
 
@@ -247,6 +262,12 @@ public:
     /// \return adjusted transformation of the floating object to match reference object
     [[nodiscard]] MRMESH_API AffineXf3f calculateTransformation();
 
+    /// runs ICP algorithm from coarse to fine samples: the first level uses samples with the distance samplingVoxelSize * 2^(numLevels-1),
+    /// and each next level halves that distance and starts from the transformation found on the previous level;
+    /// the samples of the finest level (with samplingVoxelSize) remain after the call
+    /// \return adjusted transformation of the floating object to match reference object
+    [[nodiscard]] MRMESH_API AffineXf3f calculateTransformationMultires( float samplingVoxelSize, int numLevels = 4 );
+
 private:
     MeshOrPointsXf flt_;
     MeshOrPointsXf ref_;
@@ -261,6 +282,11 @@ private:
     /// deactivate pairs that does not meet farDistFactor criterion
     void deactivatefarDistPairs_();
 
+    /// deactivate trimRatio part of pairs with the largest distances
+    void deactivateTrimmedPairs_();
+    /// squared distances of active pairs, kept between iterations to avoid reallocations
+    std::vector<float> activeDistSq_;
+
     int iter_ = 0;
     bool p2ptIter_();
     bool p2plIter_();
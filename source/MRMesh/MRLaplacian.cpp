@@ -8,6 +8,9 @@
 #include "MRGTest.h"
 #include "MRPch/MRTBB.h"
 #include <Eigen/SparseCholesky>
+#include <Eigen/Dense>
+#include <atomic>
+#include <mutex>
 
 namespace MR
 {
@@ -17,24 +20,12 @@ void Laplacian::init( const VertBitSet & freeVerts, MR::EdgeWeights weights, Rem
     MR_TIMER;
     assert( !MeshComponents::hasFullySelectedComponent( mesh_, freeVerts ) );
 
-    class SimplicialLDLTSolver final : public Solver
-    {
-    public:
-        virtual void compute( const SparseMatrixColMajor& A ) final
-        {
-            solver_.compute( A );
-        }
-
-        virtual Eigen::VectorXd solve( const Eigen::VectorXd& rhs ) final
-        {
-            return solver_.solve( rhs );
-        }
-    private:
-        Eigen::SimplicialLDLT<SparseMatrixColMajor> solver_;
-    };
-
-    solver_ = std::make_unique<SimplicialLDLTSolver>();
     solverValid_ = false;
+    rhsValid_ = false;
+
+    const auto oldRegion = std::move( region_ );
+    const auto oldEquations = std::move( equations_ );
+    const auto oldElements = std::move( nonZeroElements_ );
 
     freeVerts_ = freeVerts;
     region_ = freeVerts;
@@ -83,6 +74,22 @@ void Laplacian::init( const VertBitSet & freeVerts, MR::EdgeWeights weights, Rem
     Equation eq;
     eq.firstElem = (int)nonZeroElements_.size();
     equations_.push_back( eq );
+
+    // the factorization is kept only if the matrix of equations is the same (right hand sides do not matter)
+    auto sameMatrix = [&]
+    {
+        if ( region_ != oldRegion || equations_.size() != oldEquations.size() || nonZeroElements_.size() != oldElements.size() )
+            return false;
+        for ( size_t i = 0; i < equations_.size(); ++i )
+            if ( equations_[i].centerCoeff != oldEquations[i].centerCoeff || equations_[i].firstElem != oldEquations[i].firstElem )
+                return false;
+        for ( size_t i = 0; i < nonZeroElements_.size(); ++i )
+            if ( nonZeroElements_[i].coeff != oldElements[i].coeff || nonZeroElements_[i].neiVert != oldElements[i].neiVert )
+                return false;
+        return true;
+    };
+    if ( factorized_ && !sameMatrix() )
+        factorized_ = false;
 }
 
 void Laplacian::fixVertex( VertId v, bool smooth ) 
@@ -100,6 +107,14 @@ void Laplacian::fixVertex( VertId v, const Vector3f & fixedPos, bool smooth )
     fixVertex( v, smooth ); 
 }
 
+void Laplacian::setMultigrid( std::optional<MultigridSettings> settings )
+{
+    multigrid_ = std::move( settings );
+    solver_.reset();
+    factorized_ = false;
+    solverValid_ = false;
+}
+
 void Laplacian::updateSolver()
 {
     updateSolver_();
@@ -114,26 +129,131 @@ void Laplacian::updateSolver_()
 
     MR_TIMER
 
-    const auto sz = freeVerts_.count();
-    if ( sz <= 0 )
+    rhsValid_ = false;
+    firstLayerFixedVerts_ = freeVerts_;
+    expand( mesh_.topology, firstLayerFixedVerts_ );
+    firstLayerFixedVerts_ -= fixedSharpVertices_;
+    firstLayerFixedVerts_ -= freeVerts_;
+
+    if ( freeVerts_.none() )
     {
         rhsValid_ = true;
         return;
     }
-    rhsValid_ = false;
 
-    freeVert2id_ = makeVectorWithSeqNums( freeVerts_ );
+    if ( factorized_ && solverSharpVerts_ == fixedSharpVertices_ && ( freeVerts_ - solverFreeVerts_ ).none() )
+    {
+        // the vertices fixed since last factorization only remove the columns from M_ (the rows of their equations remain)
+        const auto newlyFixed = solverFreeVerts_ - freeVerts_;
+        if ( newlyFixed.count() <= maxLowRankUpdate )
+        {
+            setupLowRank_( newlyFixed );
+            return;
+        }
+    }
+    factorize_();
+}
 
-    firstLayerFixedVerts_ = freeVerts_;
-    expand( mesh_.topology, firstLayerFixedVerts_ );
-    firstLayerFixedVerts_ -= fixedSharpVertices_;
-    const auto rowSz = firstLayerFixedVerts_.count();
-    firstLayerFixedVerts_ -= freeVerts_;
+void Laplacian::createSolver_()
+{
+    class SimplicialLDLTSolver final : public Solver
+    {
+    public:
+        virtual void compute( const SparseMatrixColMajor& A ) final
+        {
+            solver_.compute( A );
+        }
+
+        virtual Eigen::VectorXd solve( const Eigen::VectorXd& rhs ) final
+        {
+            return solver_.solve( rhs );
+        }
+    private:
+        Eigen::SimplicialLDLT<SparseMatrixColMajor> solver_;
+    };
+
+    // multigrid solver, which switches to direct factorization if the multigrid one fails or does not converge
+    class MultigridLaplacianSolver final : public Solver
+    {
+    public:
+        explicit MultigridLaplacianSolver( const MultigridSettings & settings ) : solver_( settings ) {}
+
+        virtual void setNearNullSpace( Eigen::MatrixXd b ) final
+        {
+            nearNullSpace_ = std::move( b );
+        }
+
+        virtual void compute( const SparseMatrixColMajor& A ) final
+        {
+            A_ = A;
+            directReady_ = false;
+            solver_.compute( A_, &nearNullSpace_ );
+            if ( !solver_.valid() )
+                computeDirect_();
+        }
+
+        virtual Eigen::VectorXd solve( const Eigen::VectorXd& rhs ) final
+        {
+            if ( !directReady_ )
+            {
+                MultigridStats stats;
+                auto res = solver_.solve( rhs, nullptr, &stats );
+                if ( stats.converged )
+                    return res;
+                computeDirect_();
+            }
+            return direct_.solve( rhs );
+        }
+    private:
+        // solve can be called from several threads, so the factorization is protected by the mutex
+        void computeDirect_()
+        {
+            std::lock_guard lock( directMutex_ );
+            if ( directReady_ )
+                return;
+            direct_.compute( A_ );
+            directReady_ = true;
+        }
+
+        MultigridSolver solver_;
+        Eigen::MatrixXd nearNullSpace_;
+        SparseMatrixColMajor A_;
+        Eigen::SimplicialLDLT<SparseMatrixColMajor> direct_;
+        std::mutex directMutex_;
+        std::atomic<bool> directReady_{ false };
+    };
+
+    if ( multigrid_ )
+        solver_ = std::make_unique<MultigridLaplacianSolver>( *multigrid_ );
+    else
+        solver_ = std::make_unique<SimplicialLDLTSolver>();
+}
+
+void Laplacian::factorize_()
+{
+    MR_TIMER
+
+    if ( !solver_ )
+        createSolver_();
+
+    solverFreeVerts_ = freeVerts_;
+    solverSharpVerts_ = fixedSharpVertices_;
+    lowRankFixed_.clear();
+    lowRankCols_.clear();
+    const auto sz = solverFreeVerts_.count();
+
+    freeVert2id_ = makeVectorWithSeqNums( solverFreeVerts_ );
+
+    solverFirstLayer_ = solverFreeVerts_;
+    expand( mesh_.topology, solverFirstLayer_ );
+    solverFirstLayer_ -= solverSharpVerts_;
+    const auto rowSz = solverFirstLayer_.count();
+    solverFirstLayer_ -= solverFreeVerts_;
 
     std::vector< Eigen::Triplet<double> > mTriplets;
     // equations for free vertices
     int n = 0;
-    for ( auto v : freeVerts_ )
+    for ( auto v : solverFreeVerts_ )
     {
         assert( n == freeVert2id_[v] );
         int eqN = regionVert2id_[v];
@@ -143,14 +263,14 @@ void Laplacian::updateSolver_()
         for ( int ei = eq.firstElem; ei < lastElem; ++ ei )
         {
             const auto el = nonZeroElements_[ei];
-            if ( freeVerts_.test( el.neiVert ) )
+            if ( solverFreeVerts_.test( el.neiVert ) )
                 mTriplets.emplace_back( n, freeVert2id_[el.neiVert], el.coeff );
         }
         ++n;
     }
 
     // equations for free neighbors of fixed vertices
-    for ( auto v : firstLayerFixedVerts_ )
+    for ( auto v : solverFirstLayer_ )
     {
         int eqN = regionVert2id_[v];
         const auto eq = equations_[eqN];
@@ -158,7 +278,7 @@ void Laplacian::updateSolver_()
         for ( int ei = eq.firstElem; ei < lastElem; ++ ei )
         {
             const auto el = nonZeroElements_[ei];
-            if ( freeVerts_.test( el.neiVert ) )
+            if ( solverFreeVerts_.test( el.neiVert ) )
                 mTriplets.emplace_back( n, freeVert2id_[el.neiVert], el.coeff );
         }
         ++n;
@@ -170,7 +290,68 @@ void Laplacian::updateSolver_()
 
     SparseMatrix A = M_.adjoint() * M_;
 
+    if ( multigrid_ )
+    {
+        // the squared Laplacian maps to almost zero not only constant functions but also linear ones
+        Eigen::MatrixXd b( sz, 4 );
+        for ( auto v : solverFreeVerts_ )
+        {
+            const auto i = freeVert2id_[v];
+            const auto & p = mesh_.points[v];
+            b.row( i ) << 1, p.x, p.y, p.z;
+        }
+        solver_->setNearNullSpace( std::move( b ) );
+    }
     solver_->compute( A );
+    factorized_ = true;
+}
+
+void Laplacian::setupLowRank_( const VertBitSet & newlyFixed )
+{
+    MR_TIMER
+
+    lowRankFixed_.clear();
+    lowRankCols_.clear();
+    for ( auto v : newlyFixed )
+    {
+        lowRankFixed_.push_back( v );
+        lowRankCols_.push_back( freeVert2id_[v] );
+    }
+    const auto k = (int)lowRankFixed_.size();
+    if ( k == 0 )
+        return;
+
+    // fixing the values of the variables is equivalent to adding unknown forces (Lagrange multipliers) in their equations
+    lowRankBasis_.resize( M_.cols(), k );
+    tbb::parallel_for( tbb::blocked_range<int>( 0, k, 1 ), [&]( const tbb::blocked_range<int> & range )
+    {
+        for ( int j = range.begin(); j < range.end(); ++j )
+        {
+            Eigen::VectorXd e = Eigen::VectorXd::Zero( M_.cols() );
+            e[lowRankCols_[j]] = 1;
+            lowRankBasis_.col( j ) = solver_->solve( e );
+        }
+    } );
+
+    Eigen::MatrixXd capacitance( k, k );
+    for ( int i = 0; i < k; ++i )
+        capacitance.row( i ) = lowRankBasis_.row( lowRankCols_[i] );
+    capacitanceInv_ = capacitance.ldlt().solve( Eigen::MatrixXd::Identity( k, k ) );
+}
+
+template <typename G>
+Eigen::VectorXd Laplacian::solve_( const Eigen::VectorXd & rhs, G && fixedValue ) const
+{
+    Eigen::VectorXd sol = solver_->solve( rhs );
+    if ( lowRankFixed_.empty() )
+        return sol;
+
+    // find the forces making the solution equal to fixed values in newly fixed vertices
+    Eigen::VectorXd d( lowRankFixed_.size() );
+    for ( int j = 0; j < lowRankFixed_.size(); ++j )
+        d[j] = sol[lowRankCols_[j]] - fixedValue( lowRankFixed_[j] );
+    sol -= lowRankBasis_ * ( capacitanceInv_ * d );
+    return sol;
 }
 
 template <typename I, typename G, typename S>
@@ -178,7 +359,7 @@ void Laplacian::prepareRhs_( I && iniRhs, G && g, S && s )
 {
     // equations for free vertices
     int n = 0;
-    for ( auto v : freeVerts_ )
+    for ( auto v : solverFreeVerts_ )
     {
         assert( n == freeVert2id_[v] );
         int eqN = regionVert2id_[v];
@@ -188,7 +369,7 @@ void Laplacian::prepareRhs_( I && iniRhs, G && g, S && s )
         for ( int ei = eq.firstElem; ei < lastElem; ++ ei )
         {
             const auto el = nonZeroElements_[ei];
-            if ( !freeVerts_.test( el.neiVert ) )
+            if ( !solverFreeVerts_.test( el.neiVert ) )
                 r -= el.coeff * g( el.neiVert );
         }
         s( n, r );
@@ -196,7 +377,7 @@ void Laplacian::prepareRhs_( I && iniRhs, G && g, S && s )
     }
 
     // equations for free neighbors of fixed vertices
-    for ( auto v : firstLayerFixedVerts_ )
+    for ( auto v : solverFirstLayer_ )
     {
         int eqN = regionVert2id_[v];
         const auto eq = equations_[eqN];
@@ -206,7 +387,7 @@ void Laplacian::prepareRhs_( I && iniRhs, G && g, S && s )
         for ( int ei = eq.firstElem; ei < lastElem; ++ ei )
         {
             const auto el = nonZeroElements_[ei];
-            if ( !freeVerts_.test( el.neiVert ) )
+            if ( !solverFreeVerts_.test( el.neiVert ) )
                 r -= el.coeff * g( el.neiVert );
         }
         s( n, r );
@@ -256,7 +437,7 @@ void Laplacian::apply()
     tbb::parallel_for( tbb::blocked_range<int>( 0, 3, 1 ), [&]( const tbb::blocked_range<int> & range )
     {
         for ( int i = range.begin(); i < range.end(); ++i )
-            sol[i] = solver_->solve( rhs_[i] );
+            sol[i] = solve_( rhs_[i], [&]( VertId v ) { return double( mesh_.points[v][i] ); } );
     } );
 
     // copy solution back into mesh points
@@ -286,7 +467,7 @@ void Laplacian::applyToScalar( VertScalars & scalarField )
         [&]( int n, double r ) { rhs[n] = r; }
     );
 
-    Eigen::VectorXd sol = solver_->solve( M_.adjoint() * rhs );
+    Eigen::VectorXd sol = solve_( M_.adjoint() * rhs, [&]( VertId v ) { return double( scalarField[v] ); } );
     for ( auto v : freeVerts_ )
     {
         int mapv = freeVert2id_[v];
@@ -318,4 +499,94 @@ TEST(MRMesh, Laplacian)
     }
 }
 
+TEST( MRMesh, LaplacianFactorizationReuse )
+{
+    const Mesh sphere = makeUVSphere( 1, 16, 16 );
+    VertBitSet freeVerts( sphere.topology.vertSize() );
+    for ( auto v : sphere.topology.getValidVerts() )
+        if ( sphere.points[v].z > 0 )
+            freeVerts.set( v );
+    const auto handles = [&]
+    {
+        std::vector<VertId> res;
+        for ( auto v : freeVerts )
+            if ( res.size() < 3 && sphere.points[v].z > 0.5f && sphere.points[v].z < 0.9f )
+                res.push_back( v );
+        return res;
+    }();
+    ASSERT_EQ( handles.size(), 3 );
+
+    // first handle is fixed before factorization, other handles after it
+    Mesh updated = sphere;
+    Laplacian laplacian( updated );
+    laplacian.init( freeVerts, EdgeWeights::Cotan );
+    laplacian.fixVertex( handles[0], sphere.points[handles[0]] + Vector3f( 0, 0, 0.2f ) );
+    laplacian.apply();
+    for ( int i = 1; i < 3; ++i )
+        laplacian.fixVertex( handles[i], sphere.points[handles[i]] + Vector3f( 0.1f, 0, 0 ) );
+    laplacian.apply();
+
+    // the same result with all handles fixed before factorization
+    Mesh fresh = sphere;
+    Laplacian reference( fresh );
+    reference.init( freeVerts, EdgeWeights::Cotan );
+    reference.fixVertex( handles[0], sphere.points[handles[0]] + Vector3f( 0, 0, 0.2f ) );
+    for ( int i = 1; i < 3; ++i )
+        reference.fixVertex( handles[i], sphere.points[handles[i]] + Vector3f( 0.1f, 0, 0 ) );
+    reference.apply();
+
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_LT( ( updated.points[v] - fresh.points[v] ).length(), 1e-5f );
+
+    // repeated initialization with unit weights keeps the factorization, and gives the same result as new Laplacian
+    Mesh repeated = sphere;
+    Laplacian repeatedLaplacian( repeated );
+    for ( int iter = 0; iter < 2; ++iter )
+    {
+        repeated = sphere;
+        repeatedLaplacian.init( freeVerts, EdgeWeights::Unit );
+        repeatedLaplacian.fixVertex( handles[0], sphere.points[handles[0]] + Vector3f( 0, 0, 0.1f * ( iter + 1 ) ) );
+        repeatedLaplacian.apply();
+    }
+    Mesh once = sphere;
+    Laplacian onceLaplacian( once );
+    onceLaplacian.init( freeVerts, EdgeWeights::Unit );
+    onceLaplacian.fixVertex( handles[0], sphere.points[handles[0]] + Vector3f( 0, 0, 0.2f ) );
+    onceLaplacian.apply();
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_LT( ( repeated.points[v] - once.points[v] ).length(), 1e-5f );
+}
+
+TEST( MRMesh, LaplacianSetMultigridAfterInit )
+{
+    const Mesh sphere = makeUVSphere( 1, 16, 16 );
+    VertBitSet freeVerts( sphere.topology.vertSize() );
+    for ( auto v : sphere.topology.getValidVerts() )
+        if ( sphere.points[v].z > 0 )
+            freeVerts.set( v );
+    VertId handle;
+    for ( auto v : freeVerts )
+        if ( sphere.points[v].z > 0.5f && sphere.points[v].z < 0.9f )
+            handle = v;
+    ASSERT_TRUE( handle );
+    const auto handlePos = sphere.points[handle] + Vector3f( 0, 0, 0.2f );
+
+    Mesh direct = sphere;
+    Laplacian directLaplacian( direct );
+    directLaplacian.init( freeVerts, EdgeWeights::Cotan );
+    directLaplacian.fixVertex( handle, handlePos );
+    directLaplacian.apply();
+
+    // the solver is changed between initialization and application
+    Mesh multigrid = sphere;
+    Laplacian multigridLaplacian( multigrid );
+    multigridLaplacian.init( freeVerts, EdgeWeights::Cotan );
+    multigridLaplacian.setMultigrid( MultigridSettings{} );
+    multigridLaplacian.fixVertex( handle, handlePos );
+    multigridLaplacian.apply();
+
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_LT( ( multigrid.points[v] - direct.points[v] ).length(), 1e-3f );
+}
+
 } //namespace MR
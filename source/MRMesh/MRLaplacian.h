@@ -4,6 +4,8 @@
 #include "MRVector.h"
 #include "MRVector3.h"
 #include "MREnums.h"
+#include "MRMultigridSolver.h"
+#include <optional>
 
 #pragma warning(push)
 #pragma warning(disable: 4068) // unknown pragmas
@@ -28,6 +30,8 @@ namespace MR
 // 3. Optionally call updateSolver()
 // 4. Call apply() to change the remaining vertices within the region
 // Then steps 1-4 or 2-4 can be repeated.
+// The factorization of the system is reused if init() is called again producing the same matrix (e.g. same region and unit weights),
+// and if only a few more vertices are fixed after the factorization (by a low-rank update instead of full factorization).
 class Laplacian
 {
 public:
@@ -47,6 +51,9 @@ public:
     // sets position of given vertex after init and it must be fixed during apply (THIS METHOD CHANGES THE MESH);
     // \param smooth whether to make the surface smooth in this vertex (sharp otherwise)
     MRMESH_API void fixVertex( VertId v, const Vector3f & fixedPos, bool smooth = true );
+    // selects iterative multigrid solver with given settings instead of direct factorization (or returns to direct solver if nullopt),
+    // which needs much less memory for very large regions; takes effect on next factorization of the system
+    MRMESH_API void setMultigrid( std::optional<MultigridSettings> settings );
     // if you manually call this method after initialization and fixing vertices then next apply call will be much faster
     MRMESH_API void updateSolver();
     // given fixed vertices, computes positions of remaining region vertices
@@ -63,9 +70,22 @@ public:
 
     using EdgeWeights [[deprecated]] = MR::EdgeWeights;
 
+    // if at most this number of vertices become fixed after the factorization,
+    // then the factorization is corrected by low-rank update instead of full recomputation
+    static constexpr int maxLowRankUpdate = 64;
+
 private:
     // updates solver_ only
     void updateSolver_();
+    // creates solver_ of the kind selected by multigrid_
+    void createSolver_();
+    // builds M_ for current free vertices and factorizes the system (creating solver_ if necessary)
+    void factorize_();
+    // prepares the correction of the factorization for given vertices fixed after it
+    void setupLowRank_( const VertBitSet & newlyFixed );
+    // solves the system with factorized matrix taking into account the vertices fixed after factorization
+    template <typename G>
+    Eigen::VectorXd solve_( const Eigen::VectorXd & rhs, G && fixedValue ) const;
     // updates rhs_ only
     void updateRhs_();
     template <typename I, typename G, typename S>
@@ -105,6 +125,23 @@ private:
     Vector< int, VertId > regionVert2id_;
     Vector< int, VertId > freeVert2id_;
 
+    // free vertices and fixed sharp vertices at the moment of factorization, M_ columns correspond to solverFreeVerts_
+    VertBitSet solverFreeVerts_;
+    VertBitSet solverSharpVerts_;
+    // fixed vertices from the first layer around solverFreeVerts_, which equations are the last rows of M_
+    VertBitSet solverFirstLayer_;
+
+    // true if solver_ contains the factorization of current equations for solverFreeVerts_
+    bool factorized_ = false;
+
+    // the vertices from solverFreeVerts_ fixed after the factorization and their columns in M_
+    std::vector<VertId> lowRankFixed_;
+    std::vector<int> lowRankCols_;
+    // A^-1 * E, where A is factorized matrix, and E selects the columns of lowRankFixed_
+    Eigen::MatrixXd lowRankBasis_;
+    // ( E^T * A^-1 * E )^-1
+    Eigen::MatrixXd capacitanceInv_;
+
     using SparseMatrix = Eigen::SparseMatrix<double,Eigen::RowMajor>;
     SparseMatrix M_;
 
@@ -117,11 +154,16 @@ private:
     {
     public:
         virtual ~Solver() = default;
+        // optional hint for iterative solvers: the vectors mapped by the matrix almost in zero
+        virtual void setNearNullSpace( Eigen::MatrixXd ) {}
         virtual void compute( const SparseMatrixColMajor& A ) = 0;
         virtual Eigen::VectorXd solve( const Eigen::VectorXd& rhs ) = 0;
     };
     std::unique_ptr<Solver> solver_;
 
+    // if set then solver_ is multigrid one
+    std::optional<MultigridSettings> multigrid_;
+
     // if true then we do not need to recompute rhs_ in the apply
     bool rhsValid_ = false;
     Eigen::VectorXd rhs_[3];
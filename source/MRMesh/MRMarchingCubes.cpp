@@ -10,6 +10,7 @@
 #include "MRTimer.h"
 #include "MRParallelFor.h"
 #include "MRTriMesh.h"
+#include "MRGTest.h"
 #ifndef MRMESH_NO_OPENVDB
 #include "MRPch/MROpenvdb.h"
 #endif
@@ -425,8 +426,18 @@ bool findSeparationPoint( Vector3f & pos, const V& volume, const Accessor& acc,
     return true;
 }
 
+/// separation points on X- and Y-edges of voxels in the first and in the last z-layers of a volume,
+/// which are used to stitch the meshes built from the chunks of a volume sharing one layer
+struct BorderLayersVerts
+{
+    using XYVerts = std::array<VertId, 2>;
+    std::vector<XYVerts> first;
+    std::vector<XYVerts> last;
+};
+
 template<typename V, typename NaNChecker, typename Positioner>
-Expected<TriMesh> volumeToMesh( const V& volume, const MarchingCubesParams& params, NaNChecker&& nanChecker, Positioner&& positioner )
+Expected<TriMesh> volumeToMesh( const V& volume, const MarchingCubesParams& params, NaNChecker&& nanChecker, Positioner&& positioner,
+    BorderLayersVerts* outBorders = nullptr )
 {
     TriMesh result;
 #ifndef MRMESH_NO_OPENVDB
@@ -571,6 +582,22 @@ Expected<TriMesh> volumeToMesh( const V& volume, const MarchingCubesParams& para
     if ( totalVertices > params.maxVertices )
         return unexpected( "Vertices number limit exceeded." );
 
+    if ( outBorders )
+    {
+        auto getLayerVerts = [&] ( std::vector<BorderLayersVerts::XYVerts>& verts, size_t layer )
+        {
+            verts.resize( layerSize );
+            const auto layerStart = layer * layerSize;
+            ParallelFor( size_t( 0 ), layerSize, [&] ( size_t i )
+            {
+                const auto * set = sepStorage.findSeparationPointSet( layerStart + i );
+                verts[i] = set ? BorderLayersVerts::XYVerts{ ( *set )[int( NeighborDir::X )], ( *set )[int( NeighborDir::Y )] } : BorderLayersVerts::XYVerts{};
+            } );
+        };
+        getLayerVerts( outBorders->first, 0 );
+        getLayerVerts( outBorders->last, layerCount - 1 );
+    }
+
     if ( params.cb && !params.cb( 0.5f ) )
         return unexpectedOperationCanceled();
 
@@ -804,10 +831,10 @@ Expected<TriMesh> volumeToMesh( const V& volume, const MarchingCubesParams& para
 }
 
 template <typename V, typename NaNChecker>
-Expected<TriMesh> volumeToMeshHelper1( const V& volume, const MarchingCubesParams& params, NaNChecker&& nanChecker )
+Expected<TriMesh> volumeToMeshHelper1( const V& volume, const MarchingCubesParams& params, NaNChecker&& nanChecker, BorderLayersVerts* outBorders = nullptr )
 {
     if ( params.positioner )
-        return volumeToMesh( volume, params, std::forward<NaNChecker>( nanChecker ), params.positioner );
+        return volumeToMesh( volume, params, std::forward<NaNChecker>( nanChecker ), params.positioner, outBorders );
 
     return volumeToMesh( volume, params, std::forward<NaNChecker>( nanChecker ),
         []( const Vector3f& pos0, const Vector3f& pos1, float v0, float v1, float iso )
@@ -816,16 +843,16 @@ Expected<TriMesh> volumeToMeshHelper1( const V& volume, const MarchingCubesParam
             const auto ratio = ( iso - v0 ) / ( v1 - v0 );
             assert( ratio >= 0 && ratio <= 1 );
             return ( 1.0f - ratio ) * pos0 + ratio * pos1;
-        } );
+        }, outBorders );
 }
 
 template <typename V>
-Expected<TriMesh> volumeToMeshHelper2( const V& volume, const MarchingCubesParams& params )
+Expected<TriMesh> volumeToMeshHelper2( const V& volume, const MarchingCubesParams& params, BorderLayersVerts* outBorders = nullptr )
 {
     if ( params.omitNaNCheck )
-        return volumeToMeshHelper1( volume, params, [] ( float ) { return false; } );
+        return volumeToMeshHelper1( volume, params, [] ( float ) { return false; }, outBorders );
     else
-        return volumeToMeshHelper1( volume, params, isNanFast );
+        return volumeToMeshHelper1( volume, params, isNanFast, outBorders );
 }
 
 Expected<TriMesh> marchingCubesAsTriMesh( const SimpleVolume& volume, const MarchingCubesParams& params /*= {} */ )
@@ -878,4 +905,180 @@ Expected<Mesh> marchingCubes( const FunctionVolume& volume, const MarchingCubesP
     } );
 }
 
+Expected<TriMesh> marchingCubesAsTriMeshByChunks( const Vector3i& dims, const Vector3f& voxelSize,
+    const VolumeLayersLoader& loader, const MarchingCubesParams& params, int layersPerChunk )
+{
+    MR_TIMER
+    if ( !loader )
+        return unexpected( "Layers loader is not specified." );
+    TriMesh res;
+    if ( dims.x <= 0 || dims.y <= 0 || dims.z <= 0 )
+        return res;
+    // a chunk has at least two layers even if the volume has only one
+    layersPerChunk = std::max( 2, std::min( layersPerChunk, dims.z ) );
+    const auto layerSize = size_t( dims.x ) * dims.y;
+    const int numChunks = std::max( 1, ( dims.z - 2 ) / ( layersPerChunk - 1 ) + 1 );
+
+    // the window is reused for all chunks, the last layer of each chunk becomes the first layer of the next one
+    SimpleVolume window;
+    window.dims = dims;
+    window.voxelSize = voxelSize;
+    // the values are not known in advance
+    window.min = -FLT_MAX;
+    window.max = FLT_MAX;
+    window.data.resize( layerSize * layersPerChunk );
+
+    BorderLayersVerts borders;
+    std::vector<BorderLayersVerts::XYVerts> prevLast;
+    Vector<VoxelId, FaceId> chunkFaceMap;
+    if ( params.outVoxelPerFaceMap )
+        params.outVoxelPerFaceMap->clear();
+
+    for ( int chunk = 0, z0 = 0; chunk < numChunks; ++chunk, z0 += layersPerChunk - 1 )
+    {
+        auto cb = subprogress( params.cb, float( chunk ) / numChunks, float( chunk + 1 ) / numChunks );
+        window.dims.z = std::min( layersPerChunk, dims.z - z0 );
+        VoidOrErrStr loaded;
+        if ( chunk == 0 )
+            loaded = loader( 0, window.dims.z, window.data.data() );
+        else
+        {
+            std::copy( window.data.begin() + ( layersPerChunk - 1 ) * layerSize, window.data.begin() + layersPerChunk * layerSize, window.data.begin() );
+            loaded = loader( z0 + 1, window.dims.z - 1, window.data.data() + layerSize );
+        }
+        if ( !loaded )
+            return unexpected( std::move( loaded.error() ) );
+        if ( !reportProgress( cb, 0.25f ) )
+            return unexpectedOperationCanceled();
+
+        auto chunkParams = params;
+        chunkParams.origin.z += z0 * voxelSize.z;
+        chunkParams.cb = subprogress( cb, 0.25f, 0.9f );
+        chunkParams.outVoxelPerFaceMap = params.outVoxelPerFaceMap ? &chunkFaceMap : nullptr;
+        auto part = volumeToMeshHelper2( window, chunkParams, &borders );
+        if ( !part )
+            return unexpected( std::move( part.error() ) );
+
+        // the vertices on the shared layer are taken from the previous chunk, all others are appended
+        VertMap vmap( part->points.size() );
+        if ( !prevLast.empty() && !borders.first.empty() )
+        {
+            for ( size_t i = 0; i < layerSize; ++i )
+                for ( int d = 0; d < 2; ++d )
+                    if ( auto v = borders.first[i][d]; v && prevLast[i][d] )
+                        vmap[v] = prevLast[i][d];
+        }
+        for ( auto v = 0_v; v < part->points.size(); ++v )
+        {
+            if ( vmap[v] )
+                continue;
+            vmap[v] = VertId( res.points.size() );
+            res.points.push_back( part->points[v] );
+        }
+        if ( res.points.size() > params.maxVertices )
+            return unexpected( "Vertices number limit exceeded." );
+
+        const auto firstFace = res.tris.size();
+        res.tris.resize( firstFace + part->tris.size() );
+        ParallelFor( part->tris, [&] ( FaceId f )
+        {
+            const auto& t = part->tris[f];
+            res.tris[FaceId( firstFace + f )] = { vmap[t[0]], vmap[t[1]], vmap[t[2]] };
+        } );
+        if ( params.outVoxelPerFaceMap )
+        {
+            const auto voxelShift = size_t( z0 ) * layerSize;
+            for ( auto v : chunkFaceMap )
+                params.outVoxelPerFaceMap->push_back( VoxelId( v + voxelShift ) );
+        }
+
+        prevLast.resize( borders.last.size() );
+        for ( size_t i = 0; i < borders.last.size(); ++i )
+            for ( int d = 0; d < 2; ++d )
+                prevLast[i][d] = borders.last[i][d] ? vmap[borders.last[i][d]] : VertId{};
+
+        if ( !reportProgress( cb, 1.0f ) )
+            return unexpectedOperationCanceled();
+    }
+    return res;
+}
+
+Expected<Mesh> marchingCubesByChunks( const Vector3i& dims, const Vector3f& voxelSize,
+    const VolumeLayersLoader& loader, const MarchingCubesParams& params, int layersPerChunk )
+{
+    MR_TIMER
+    auto p = params;
+    p.cb = subprogress( params.cb, 0.0f, 0.9f );
+    return marchingCubesAsTriMeshByChunks( dims, voxelSize, loader, p, layersPerChunk ).and_then( [&params]( TriMesh && tm ) -> Expected<Mesh>
+    {
+        return Mesh::fromTriMesh( std::move( tm ), {}, subprogress( params.cb, 0.9f, 1.0f ) );
+    } );
+}
+
+TEST( MRMesh, MarchingCubesByChunks )
+{
+    SimpleVolume volume;
+    volume.dims = { 20, 20, 23 };
+    volume.voxelSize = Vector3f::diagonal( 0.1f );
+    volume.data.resize( size_t( volume.dims.x ) * volume.dims.y * volume.dims.z );
+    const VolumeIndexer indexer( volume.dims );
+    for ( auto v = 0_vox; v < indexer.endId(); ++v )
+        volume.data[v.get()] = ( Vector3f( indexer.toPos( v ) ) - Vector3f( 9.7f, 10.2f, 11.1f ) ).length() - 7.3f;
+    volume.min = *std::min_element( volume.data.begin(), volume.data.end() );
+    volume.max = *std::max_element( volume.data.begin(), volume.data.end() );
+
+    MarchingCubesParams params;
+    params.lessInside = true;
+    auto whole = marchingCubesAsTriMesh( volume, params );
+    ASSERT_TRUE( whole.has_value() );
+
+    int numLoaded = 0;
+    auto loader = [&] ( int firstLayer, int numLayers, float* values ) -> VoidOrErrStr
+    {
+        numLoaded += numLayers;
+        std::copy_n( volume.data.begin() + size_t( firstLayer ) * indexer.sizeXY(), size_t( numLayers ) * indexer.sizeXY(), values );
+        return {};
+    };
+    auto chunked = marchingCubesAsTriMeshByChunks( volume.dims, volume.voxelSize, loader, params, 5 );
+    ASSERT_TRUE( chunked.has_value() );
+    // every layer is loaded only once
+    EXPECT_EQ( numLoaded, volume.dims.z );
+    EXPECT_EQ( chunked->points.size(), whole->points.size() );
+    EXPECT_EQ( chunked->tris.size(), whole->tris.size() );
+
+    auto mesh = Mesh::fromTriMesh( std::move( *chunked ) );
+    EXPECT_EQ( mesh.topology.findHoleRepresentiveEdges().size(), 0 );
+    EXPECT_EQ( mesh.topology.numValidVerts(), int( whole->points.size() ) );
+}
+
+TEST( MRMesh, MarchingCubesByChunksSingleLayer )
+{
+    SimpleVolume volume;
+    volume.dims = { 10, 10, 1 };
+    volume.voxelSize = Vector3f::diagonal( 0.1f );
+    volume.data.resize( size_t( volume.dims.x ) * volume.dims.y );
+    const VolumeIndexer indexer( volume.dims );
+    for ( auto v = 0_vox; v < indexer.endId(); ++v )
+        volume.data[v.get()] = ( Vector3f( indexer.toPos( v ) ) - Vector3f( 4.5f, 4.5f, 0 ) ).length() - 3;
+    volume.min = *std::min_element( volume.data.begin(), volume.data.end() );
+    volume.max = *std::max_element( volume.data.begin(), volume.data.end() );
+
+    MarchingCubesParams params;
+    params.lessInside = true;
+    auto whole = marchingCubesAsTriMesh( volume, params );
+    ASSERT_TRUE( whole.has_value() );
+
+    auto loader = [&] ( int firstLayer, int numLayers, float* values ) -> VoidOrErrStr
+    {
+        EXPECT_EQ( firstLayer, 0 );
+        EXPECT_EQ( numLayers, 1 );
+        std::copy_n( volume.data.begin(), indexer.sizeXY(), values );
+        return {};
+    };
+    auto chunked = marchingCubesAsTriMeshByChunks( volume.dims, volume.voxelSize, loader, params, 5 );
+    ASSERT_TRUE( chunked.has_value() );
+    EXPECT_EQ( chunked->points.size(), whole->points.size() );
+    EXPECT_EQ( chunked->tris.size(), whole->tris.size() );
+}
+
 } //namespace MR
@@ -60,4 +60,18 @@ MRMESH_API Expected<TriMesh> marchingCubesAsTriMesh( const VdbVolume& volume, co
 MRMESH_API Expected<Mesh> marchingCubes( const FunctionVolume& volume, const MarchingCubesParams& params = {} );
 MRMESH_API Expected<TriMesh> marchingCubesAsTriMesh( const FunctionVolume& volume, const MarchingCubesParams& params = {} );
 
+/// fills given number of consecutive z-layers of a volume starting from given layer,
+/// the values are stored in the same order as in SimpleVolume (x-coordinate changes fastest)
+using VolumeLayersLoader = std::function<VoidOrErrStr( int firstLayer, int numLayers, float* values )>;
+
+/// makes TriMesh from a volume, which is never kept in memory entirely, but loaded by chunks of consecutive z-layers;
+/// neighbor chunks share one layer, and the parts of the mesh built from them are stitched exactly along it,
+/// so the result is the same as marchingCubesAsTriMesh would produce for SimpleVolume with all the data
+/// \param dims dimensions of the whole volume
+/// \param layersPerChunk the number of z-layers loaded in memory at once (at least 2)
+MRMESH_API Expected<TriMesh> marchingCubesAsTriMeshByChunks( const Vector3i& dims, const Vector3f& voxelSize,
+    const VolumeLayersLoader& loader, const MarchingCubesParams& params = {}, int layersPerChunk = 64 );
+MRMESH_API Expected<Mesh> marchingCubesByChunks( const Vector3i& dims, const Vector3f& voxelSize,
+    const VolumeLayersLoader& loader, const MarchingCubesParams& params = {}, int layersPerChunk = 64 );
+
 } //namespace MR
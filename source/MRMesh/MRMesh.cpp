@@ -13,6 +13,7 @@
 #include "MRGTest.h"
 #include "MRLine3.h"
 #include "MRLineSegm.h"
+#include "MRMeshAdjacency.h"
 #include "MRMeshBuilder.h"
 #include "MRMeshIntersect.h"
 #include "MRMeshTriPoint.h"
@@ -1047,6 +1048,7 @@ PackMapping Mesh::packOptimally( bool preserveAABBTree )
 
     PackMapping map;
     AABBTreePointsOwner_.reset(); // points-tree will be invalidated anyway
+    adjacencyOwner_.reset();
     if ( preserveAABBTree )
     {
         getAABBTree(); // ensure that tree is constructed
@@ -1149,12 +1151,27 @@ const Dipoles & Mesh::getDipoles() const
     return res;
 }
 
+const MeshAdjacency & Mesh::getAdjacency() const
+{
+    const auto & res = adjacencyOwner_.getOrCreate( [this]{ return MeshAdjacency( topology ); } );
+    assert( res.fits( topology ) );
+    return res;
+}
+
 void Mesh::invalidateCaches( bool pointsChanged )
 {
     AABBTreeOwner_.reset();
     if ( pointsChanged )
         AABBTreePointsOwner_.reset();
     dipolesOwner_.reset();
+    adjacencyOwner_.reset();
+}
+
+void Mesh::invalidatePointCaches()
+{
+    AABBTreeOwner_.reset();
+    AABBTreePointsOwner_.reset();
+    dipolesOwner_.reset();
 }
 
 void Mesh::updateCaches( const VertBitSet & changedVerts )
@@ -1178,7 +1195,8 @@ size_t Mesh::heapBytes() const
         + points.heapBytes()
         + AABBTreeOwner_.heapBytes()
         + AABBTreePointsOwner_.heapBytes()
-        + dipolesOwner_.heapBytes();
+        + dipolesOwner_.heapBytes()
+        + adjacencyOwner_.heapBytes();
 }
 
 void Mesh::shrinkToFit()
@@ -443,10 +443,22 @@ struct [[nodiscard]] Mesh
     /// returns cached dipoles of aabb-tree nodes for this mesh, but does not create it if it did not exist
     [[nodiscard]] const Dipoles * getDipolesNotCreate() const { return dipolesOwner_.get(); }
 
+    /// returns cached connectivity snapshot for this mesh, creating it if it did not exist in a thread-safe manner;
+    /// it is created by relaxation of the whole mesh in several iterations, and then used by next relaxations and computePerVertNormals
+    /// until the topology is changed, e.g. on 1M vertices: building 0.5 s, relax( 3 iterations ) 0.39 s -> 0.17 s, normals 0.40 s -> 0.09 s
+    MRMESH_API const MeshAdjacency & getAdjacency() const;
+
+    /// returns cached connectivity snapshot for this mesh, but does not create it if it did not exist
+    [[nodiscard]] const MeshAdjacency * getAdjacencyNotCreate() const { return adjacencyOwner_.get(); }
+
     /// invalidates caches (aabb-trees) after any change in mesh geometry or topology
     /// \param pointsChanged specifies whether points have changed (otherwise only topology has changed)
     MRMESH_API void invalidateCaches( bool pointsChanged = true );
 
+    /// invalidates the caches depending on point coordinates (aabb-trees, dipoles), but keeps connectivity snapshot;
+    /// shall be called instead of invalidateCaches() after any change of points without change of topology
+    MRMESH_API void invalidatePointCaches();
+
     /// updates existing caches in case of few vertices were changed insignificantly,
     /// and topology remained unchanged;
     /// it shall be considered as a faster alternative to invalidateCaches() and following rebuild of trees
@@ -465,6 +477,7 @@ private:
     mutable UniqueThreadSafeOwner<AABBTree> AABBTreeOwner_;
     mutable UniqueThreadSafeOwner<AABBTreePoints> AABBTreePointsOwner_;
     mutable UniqueThreadSafeOwner<Dipoles> dipolesOwner_;
+    mutable UniqueThreadSafeOwner<MeshAdjacency> adjacencyOwner_;
 };
 
 } //namespace MR
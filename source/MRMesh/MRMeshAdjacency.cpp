@@ -0,0 +1,116 @@
+#include "MRMeshAdjacency.h"
+#include "MRMeshTopology.h"
+#include "MRRingIterator.h"
+#include "MRBitSetParallelFor.h"
+#include "MRMakeSphereMesh.h"
+#include "MRMesh.h"
+#include "MRHeapBytes.h"
+#include "MRTimer.h"
+#include "MRGTest.h"
+
+namespace MR
+{
+
+MeshAdjacency::MeshAdjacency( const MeshTopology & topology )
+{
+    MR_TIMER
+    const auto & validVerts = topology.getValidVerts();
+    vertNeiStart_.resize( topology.vertSize() + 1, 0 );
+    vertFaceStart_.resize( topology.vertSize() + 1, 0 );
+
+    // the sizes of neighborhoods are temporary stored in the next elements
+    BitSetParallelFor( validVerts, [&]( VertId v )
+    {
+        int numNeis = 0, numFaces = 0;
+        for ( auto e : orgRing( topology, v ) )
+        {
+            ++numNeis;
+            if ( topology.left( e ) )
+                ++numFaces;
+        }
+        vertNeiStart_[v + 1] = numNeis;
+        vertFaceStart_[v + 1] = numFaces;
+    } );
+    for ( VertId v = 0_v; v < topology.vertSize(); ++v )
+    {
+        vertNeiStart_[v + 1] += vertNeiStart_[v];
+        vertFaceStart_[v + 1] += vertFaceStart_[v];
+    }
+
+    neis_.resize( vertNeiStart_.back() );
+    vertFaces_.resize( vertFaceStart_.back() );
+    BitSetParallelFor( validVerts, [&]( VertId v )
+    {
+        auto n = vertNeiStart_[v];
+        auto f = vertFaceStart_[v];
+        for ( auto e : orgRing( topology, v ) )
+        {
+            neis_[n++] = topology.dest( e );
+            if ( auto l = topology.left( e ) )
+                vertFaces_[f++] = l;
+        }
+    } );
+
+    triVerts_ = topology.getTriangulation();
+}
+
+bool MeshAdjacency::fits( const MeshTopology & topology ) const
+{
+    return vertSize() == topology.vertSize() && faceSize() == topology.faceSize();
+}
+
+size_t MeshAdjacency::heapBytes() const
+{
+    return vertNeiStart_.heapBytes()
+        + MR::heapBytes( neis_ )
+        + vertFaceStart_.heapBytes()
+        + MR::heapBytes( vertFaces_ )
+        + triVerts_.heapBytes();
+}
+
+TEST( MRMesh, MeshAdjacency )
+{
+    auto sphere = makeUVSphere( 1, 16, 16 );
+    FaceBitSet del( sphere.topology.faceSize() );
+    del.set( 0_f );
+    del.set( 5_f );
+    sphere.deleteFaces( del );
+
+    const MeshAdjacency adj( sphere.topology );
+    EXPECT_EQ( adj.vertSize(), sphere.topology.vertSize() );
+    EXPECT_EQ( adj.faceSize(), sphere.topology.faceSize() );
+    for ( auto v : sphere.topology.getValidVerts() )
+    {
+        auto neis = adj.neighbors( v );
+        auto faces = adj.faces( v );
+        size_t n = 0, f = 0;
+        for ( auto e : orgRing( sphere.topology, v ) )
+        {
+            ASSERT_LT( n, neis.size() );
+            EXPECT_EQ( neis[n++], sphere.topology.dest( e ) );
+            if ( auto l = sphere.topology.left( e ) )
+            {
+                ASSERT_LT( f, faces.size() );
+                EXPECT_EQ( faces[f++], l );
+            }
+        }
+        EXPECT_EQ( n, neis.size() );
+        EXPECT_EQ( f, faces.size() );
+    }
+    for ( FaceId f( 0 ); f < sphere.topology.faceSize(); ++f )
+    {
+        if ( sphere.topology.hasFace( f ) )
+            EXPECT_EQ( adj.triVerts( f ), sphere.topology.getTriVerts( f ) );
+        else
+            EXPECT_FALSE( adj.triVerts( f )[0] );
+    }
+
+    // the snapshot is cached in the mesh until its topology is changed
+    const auto * cached = &sphere.getAdjacency();
+    sphere.invalidatePointCaches();
+    EXPECT_EQ( sphere.getAdjacencyNotCreate(), cached );
+    sphere.invalidateCaches();
+    EXPECT_EQ( sphere.getAdjacencyNotCreate(), nullptr );
+}
+
+} //namespace MR
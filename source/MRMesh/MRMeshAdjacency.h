@@ -0,0 +1,61 @@
+#pragma once
+
+#include "MRVector.h"
+#include "MRId.h"
+#include <array>
+#include <span>
+
+namespace MR
+{
+
+/// \addtogroup MeshAlgorithmGroup
+/// \{
+
+/// Compact immutable snapshot of mesh connectivity in compressed sparse row format:
+/// vertex -> neighbor vertices, vertex -> incident faces, and face -> its vertices;
+/// read-heavy algorithms iterating over the neighborhoods many times work faster with it
+/// than with the rings of MeshTopology requiring pointer chasing over half-edge records;
+/// the snapshot becomes invalid after any change of mesh topology (but not of points)
+class MeshAdjacency
+{
+public:
+    MeshAdjacency() = default;
+
+    /// builds the snapshot in parallel for all valid vertices and faces of given topology
+    MRMESH_API explicit MeshAdjacency( const MeshTopology & topology );
+
+    /// the number of vertex ids (including invalid ones) in the snapshot
+    [[nodiscard]] size_t vertSize() const { return vertNeiStart_.size() - 1; }
+
+    /// the number of face ids (including invalid ones) in the snapshot
+    [[nodiscard]] size_t faceSize() const { return triVerts_.size(); }
+
+    /// neighbor vertices of given vertex in the order of orgRing( topology, v ), empty for invalid vertices
+    [[nodiscard]] std::span<const VertId> neighbors( VertId v ) const
+        { return { neis_.data() + vertNeiStart_[v], neis_.data() + vertNeiStart_[v + 1] }; }
+
+    /// valid faces to the left of the edges from orgRing( topology, v ) in the same order
+    [[nodiscard]] std::span<const FaceId> faces( VertId v ) const
+        { return { vertFaces_.data() + vertFaceStart_[v], vertFaces_.data() + vertFaceStart_[v + 1] }; }
+
+    /// three vertices of given face in the same order as topology.getTriVerts( f ), invalid ids for invalid faces
+    [[nodiscard]] const ThreeVertIds & triVerts( FaceId f ) const { return triVerts_[f]; }
+
+    /// returns true if the numbers of vertex and face ids in the snapshot are the same as in given topology;
+    /// false means that the topology was changed after the snapshot was built, and the snapshot cannot be used with it
+    [[nodiscard]] MRMESH_API bool fits( const MeshTopology & topology ) const;
+
+    /// returns the amount of memory this object occupies on heap
+    [[nodiscard]] MRMESH_API size_t heapBytes() const;
+
+private:
+    Vector<int, VertId> vertNeiStart_ = Vector<int, VertId>( 1 );
+    std::vector<VertId> neis_;
+    Vector<int, VertId> vertFaceStart_ = Vector<int, VertId>( 1 );
+    std::vector<FaceId> vertFaces_;
+    Triangulation triVerts_;
+};
+
+/// \}
+
+} //namespace MR
@@ -1,5 +1,7 @@
 #include "MRMeshComponents.h"
 #include "MRMesh.h"
+#include "MRAtomicUnionFind.h"
+#include "MRMakeSphereMesh.h"
 #include "MRBitSet.h"
 #include "MRTimer.h"
 #include "MRRingIterator.h"
@@ -40,21 +42,195 @@ static std::pair<Vector<RegionId, Id<T>>, int> getUniqueRootIds( const Vector<Id
     return { std::move( uniqueRootsMap ), k };
 }
 
+/// builds concurrent union-find structure for the faces of given mesh part in parallel
+static AtomicUnionFind<FaceId> getAtomicUnionFindFaces( const MeshPart& meshPart, FaceIncidence incidence, const UndirectedEdgePredicate & isCompBd )
+{
+    MR_TIMER
+    const auto& topology = meshPart.mesh.topology;
+    const FaceBitSet& region = topology.getFaceIds( meshPart.region );
+    AtomicUnionFind<FaceId> res( region.find_last() + 1 );
+    if ( incidence == FaceIncidence::PerEdge )
+    {
+        BitSetParallelFor( region, [&]( FaceId f0 )
+        {
+            EdgeId e[3];
+            topology.getTriEdges( f0, e );
+            for ( int i = 0; i < 3; ++i )
+            {
+                assert( topology.left( e[i] ) == f0 );
+                FaceId f1 = topology.right( e[i] );
+                if ( f0 < f1 && contains( meshPart.region, f1 ) && ( !isCompBd || !isCompBd( e[i].undirected() ) ) )
+                    res.unite( f0, f1 );
+            }
+        } );
+        return res;
+    }
+
+    assert( incidence == FaceIncidence::PerVertex );
+    assert( !isCompBd );
+    VertBitSet store;
+    BitSetParallelFor( getIncidentVerts( topology, meshPart.region, store ), [&]( VertId v )
+    {
+        FaceId f0;
+        for ( auto edge : orgRing( topology, v ) )
+        {
+            FaceId f1 = topology.left( edge );
+            if ( !contains( meshPart.region, f1 ) )
+                continue;
+            if ( !f0 )
+                f0 = f1;
+            else
+                res.unite( f0, f1 );
+        }
+    } );
+    return res;
+}
+
+/// labels the faces with dense ids of their components in parallel, optionally computing the areas and the boxes of the components
+static FaceComponents labelComponents( const MeshPart& meshPart, AtomicUnionFind<FaceId> & unionFind, bool withAreasAndBoxes )
+{
+    MR_TIMER
+    const auto& mesh = meshPart.mesh;
+    const FaceBitSet& region = mesh.topology.getFaceIds( meshPart.region );
+    const auto numFaces = unionFind.size();
+    FaceComponents res;
+    res.faceComp.resize( numFaces );
+
+    // the faces are processed in fixed blocks to number the components in the order of their roots (smallest faces)
+    constexpr size_t blockSize = 4096;
+    const size_t numBlocks = ( numFaces + blockSize - 1 ) / blockSize;
+    auto blockBegin = [&]( size_t b ) { return FaceId( b * blockSize ); };
+    auto blockEnd = [&]( size_t b ) { return FaceId( std::min( ( b + 1 ) * blockSize, numFaces ) ); };
+
+    std::vector<int> blockFirstComp( numBlocks + 1, 0 );
+    ParallelFor( size_t( 0 ), numBlocks, [&]( size_t b )
+    {
+        int numRoots = 0;
+        for ( auto f = blockBegin( b ); f < blockEnd( b ); ++f )
+            if ( region.test( f ) && unionFind.find( f ) == f )
+                ++numRoots;
+        blockFirstComp[b + 1] = numRoots;
+    } );
+    for ( size_t b = 0; b < numBlocks; ++b )
+        blockFirstComp[b + 1] += blockFirstComp[b];
+    res.numComponents = blockFirstComp.back();
+
+    ParallelFor( size_t( 0 ), numBlocks, [&]( size_t b )
+    {
+        int comp = blockFirstComp[b];
+        for ( auto f = blockBegin( b ); f < blockEnd( b ); ++f )
+            if ( region.test( f ) && unionFind.isRoot( f ) )
+                res.faceComp[f] = RegionId( comp++ );
+    } );
+
+    // consecutive faces from one component are accumulated together before merging in the component
+    struct Run
+    {
+        RegionId comp;
+        double dblArea = 0;
+        Box3f box;
+    };
+    std::vector<std::vector<Run>> blockRuns( withAreasAndBoxes ? numBlocks : 0 );
+    ParallelFor( size_t( 0 ), numBlocks, [&]( size_t b )
+    {
+        Run run;
+        for ( auto f = blockBegin( b ); f < blockEnd( b ); ++f )
+        {
+            if ( !region.test( f ) )
+                continue;
+            const auto root = unionFind.find( f );
+            const auto comp = res.faceComp[root];
+            if ( root != f )
+                res.faceComp[f] = comp;
+            if ( !withAreasAndBoxes )
+                continue;
+            if ( comp != run.comp )
+            {
+                if ( run.comp )
+                    blockRuns[b].push_back( run );
+                run = Run{ .comp = comp };
+            }
+            Vector3f ps[3];
+            mesh.getTriPoints( f, ps );
+            run.dblArea += cross( ps[1] - ps[0], ps[2] - ps[0] ).length();
+            for ( const auto & p : ps )
+                run.box.include( p );
+        }
+        if ( run.comp )
+            blockRuns[b].push_back( run );
+    } );
+
+    if ( withAreasAndBoxes )
+    {
+        res.areas.resize( res.numComponents, 0.0 );
+        res.boxes.resize( res.numComponents );
+        for ( const auto & runs : blockRuns )
+        {
+            for ( const auto & run : runs )
+            {
+                res.areas[run.comp] += run.dblArea;
+                res.boxes[run.comp].include( run.box );
+            }
+        }
+        for ( auto & a : res.areas )
+            a *= 0.5;
+    }
+    return res;
+}
+
+FaceComponents labelFaceComponents( const MeshPart& meshPart, FaceIncidence incidence, const UndirectedEdgePredicate & isCompBd )
+{
+    MR_TIMER
+    auto unionFind = getAtomicUnionFindFaces( meshPart, incidence, isCompBd );
+    return labelComponents( meshPart, unionFind, true );
+}
+
+/// returns the union of the components with area >= minArea,
+/// and optionally the edges between two different such components
+static FaceBitSet getLargeByAreaComponents( const MeshPart& mp, const FaceComponents & comps, float minArea,
+    UndirectedEdgeBitSet * outBdEdgesBetweenLargeComps )
+{
+    MR_TIMER
+    const auto& topology = mp.mesh.topology;
+    FaceBitSet res( topology.faceSize() );
+    BitSetParallelFor( topology.getFaceIds( mp.region ), [&]( FaceId f )
+    {
+        if ( comps.areas[comps.faceComp[f]] >= minArea )
+            res.set( f );
+    } );
+
+    if ( outBdEdgesBetweenLargeComps )
+    {
+        outBdEdgesBetweenLargeComps->clear();
+        outBdEdgesBetweenLargeComps->resize( topology.undirectedEdgeSize() );
+        BitSetParallelForAll( *outBdEdgesBetweenLargeComps, [&]( UndirectedEdgeId ue )
+        {
+            auto l = topology.left( ue );
+            if ( !l || !res.test( l ) )
+                return;
+            auto r = topology.right( ue );
+            if ( !r || !res.test( r ) )
+                return;
+            if ( comps.faceComp[l] != comps.faceComp[r] )
+                outBdEdgesBetweenLargeComps->set( ue );
+        } );
+    }
+    return res;
+}
+
 FaceBitSet getComponent( const MeshPart& meshPart, FaceId id, FaceIncidence incidence, const UndirectedEdgePredicate & isCompBd )
 {
     MR_TIMER
-    auto unionFindStruct = getUnionFindStructureFaces( meshPart, incidence, isCompBd );
+    auto unionFind = getAtomicUnionFindFaces( meshPart, incidence, isCompBd );
     const FaceBitSet& region = meshPart.mesh.topology.getFaceIds( meshPart.region );
 
-    int faceRoot = unionFindStruct.find( id );
-    const auto& allRoots = unionFindStruct.roots();
-    FaceBitSet res;
-    res.resize( allRoots.size() );
-    for ( auto f : region )
+    const auto faceRoot = unionFind.find( id );
+    FaceBitSet res( unionFind.size() );
+    BitSetParallelFor( region, [&]( FaceId f )
     {
-        if ( allRoots[f] == faceRoot )
+        if ( unionFind.find( f ) == faceRoot )
             res.set( f );
-    }
+    } );
     return res;
 }
 
@@ -81,13 +257,11 @@ FaceBitSet getLargestComponent( const MeshPart& meshPart, FaceIncidence incidenc
 {
     MR_TIMER
 
-    auto unionFindStruct = getUnionFindStructureFaces( meshPart, incidence, isCompBd );
-    const auto& mesh = meshPart.mesh;
-    const FaceBitSet& region = mesh.topology.getFaceIds( meshPart.region );
+    const auto comps = labelFaceComponents( meshPart, incidence, isCompBd );
+    const FaceBitSet& region = meshPart.mesh.topology.getFaceIds( meshPart.region );
 
     FaceBitSet maxAreaComponent;
-    const auto& allRoots = unionFindStruct.roots();
-    auto [uniqueRootsMap, k] = getUniqueRootIds( allRoots, region );
+    const int k = comps.numComponents;
     if ( k <= 0 )
     {
         if ( numSmallerComponents )
@@ -95,21 +269,11 @@ FaceBitSet getLargestComponent( const MeshPart& meshPart, FaceIncidence incidenc
         return maxAreaComponent;
     }
 
-    double maxDblArea = -DBL_MAX;
-    int maxI = 0;
-    std::vector<double> dblAreas( k, 0.0 );
-    for ( auto f : region )
-    {
-        auto index = uniqueRootsMap[f];
-        auto& dblArea = dblAreas[index];
-        dblArea += meshPart.mesh.dblArea( f );
-        if ( dblArea > maxDblArea )
-        {
-            maxI = index;
-            maxDblArea = dblArea;
-        }
-    }
-    if ( maxDblArea < 2 * minArea )
+    RegionId maxI( 0 );
+    for ( RegionId i( 1 ); i < k; ++i )
+        if ( comps.areas[i] > comps.areas[maxI] )
+            maxI = i;
+    if ( comps.areas[maxI] < minArea )
     {
         if ( numSmallerComponents )
             *numSmallerComponents = k;
@@ -118,13 +282,11 @@ FaceBitSet getLargestComponent( const MeshPart& meshPart, FaceIncidence incidenc
     if ( numSmallerComponents )
         *numSmallerComponents = k - 1;
     maxAreaComponent.resize( region.find_last() + 1 );
-    for ( auto f : region )
+    BitSetParallelFor( region, [&]( FaceId f )
     {
-        auto index = uniqueRootsMap[f];
-        if ( index != maxI )
-            continue;
-        maxAreaComponent.set( f );
-    }
+        if ( comps.faceComp[f] == maxI )
+            maxAreaComponent.set( f );
+    } );
     return maxAreaComponent;
 }
 
@@ -189,43 +351,37 @@ FaceBitSet getComponents( const MeshPart& meshPart, const FaceBitSet & seeds, Fa
     if ( seeds.none() )
         return res;
 
-    auto unionFindStruct = getUnionFindStructureFaces( meshPart, incidence, isCompBd );
+    auto unionFind = getAtomicUnionFindFaces( meshPart, incidence, isCompBd );
     const FaceBitSet& region = meshPart.mesh.topology.getFaceIds( meshPart.region );
 
-    FaceId faceRoot;
-    for ( auto s : seeds )
+    const auto firstSeed = seeds.find_first();
+    BitSetParallelFor( seeds, [&]( FaceId s )
     {
-        if ( faceRoot < 0 )
-            faceRoot = unionFindStruct.find( s );
-        else
-            faceRoot = unionFindStruct.unite( faceRoot, s ).first;
-    }
+        unionFind.unite( firstSeed, s );
+    } );
+    const auto faceRoot = unionFind.find( firstSeed );
 
-    if ( faceRoot )
+    res.resize( unionFind.size() );
+    BitSetParallelFor( region, [&]( FaceId f )
     {
-        const auto& allRoots = unionFindStruct.roots();
-        res.resize( allRoots.size() );
-        BitSetParallelFor( region, [&]( FaceId f )
-        {
-            if ( allRoots[f] == faceRoot )
-                res.set( f );
-        } );
-    }
+        if ( unionFind.find( f ) == faceRoot )
+            res.set( f );
+    } );
     return res;
 }
 
 FaceBitSet getLargeByAreaComponents( const MeshPart& mp, float minArea, const UndirectedEdgePredicate & isCompBd )
 {
-    auto unionFind = getUnionFindStructureFacesPerEdge( mp, isCompBd );
-    return getLargeByAreaComponents( mp, unionFind, minArea );
+    MR_TIMER
+    return getLargeByAreaComponents( mp, labelFaceComponents( mp, PerEdge, isCompBd ), minArea, nullptr );
 }
 
 FaceBitSet getLargeByAreaSmoothComponents( const MeshPart& mp, float minArea, float angleFromPlanar,
     UndirectedEdgeBitSet * outBdEdgesBetweenLargeComps )
 {
     const float critCos = std::cos( angleFromPlanar );
-    auto unionFind = MeshComponents::getUnionFindStructureFacesPerEdge( mp, [&]( UndirectedEdgeId ue ) { return mp.mesh.dihedralAngleCos( ue ) < critCos; } );
-    return MeshComponents::getLargeByAreaComponents( mp, unionFind, minArea, outBdEdgesBetweenLargeComps );
+    const auto comps = labelFaceComponents( mp, PerEdge, [&]( UndirectedEdgeId ue ) { return mp.mesh.dihedralAngleCos( ue ) < critCos; } );
+    return getLargeByAreaComponents( mp, comps, minArea, outBdEdgesBetweenLargeComps );
 }
 
 FaceBitSet getLargeByAreaComponents( const MeshPart& mp, UnionFind<FaceId> & unionFind, float minArea,
@@ -294,54 +450,50 @@ std::vector<FaceBitSet> getNLargeByAreaComponents( const MeshPart& mp, const Lar
         return res;
     }
 
-    auto unionFind = getUnionFindStructureFacesPerEdge( mp, settings.isCompBd );
-    const auto & roots = unionFind.roots();
-
-    HashMap<FaceId, float> root2area;
-    const FaceBitSet& region = mp.mesh.topology.getFaceIds( mp.region );
-    for ( auto f : region )
-        root2area[ roots[f] ] += mp.mesh.area( f );
+    const auto comps = labelFaceComponents( mp, PerEdge, settings.isCompBd );
 
-    struct AreaRoot
+    struct AreaComp
     {
-        float area = 0;
-        FaceId root;
-        constexpr auto operator <=>( const AreaRoot& ) const = default;
+        double area = 0;
+        RegionId comp;
+        constexpr auto operator <=>( const AreaComp& ) const = default;
     };
 
-    std::vector<AreaRoot> areaRootVec;
-    areaRootVec.reserve( root2area.size() );
+    std::vector<AreaComp> areaCompVec;
     // fill it with not too small components
-    for ( const auto & [root, area] : root2area )
+    for ( RegionId i( 0 ); i < comps.numComponents; ++i )
     {
-        if ( area >= settings.minArea )
-            areaRootVec.push_back( { area, root } );
+        if ( comps.areas[i] >= settings.minArea )
+            areaCompVec.push_back( { comps.areas[i], i } );
     }
 
-    // leave at most given number of roots sorted in descending by area order
-    if ( areaRootVec.size() <= settings.maxLargeComponents )
+    // leave at most given number of components sorted in descending by area order
+    if ( areaCompVec.size() <= settings.maxLargeComponents )
     {
         if ( settings.numSmallerComponents )
             *settings.numSmallerComponents = 0;
-        std::sort( areaRootVec.begin(), areaRootVec.end(), std::greater() );
+        std::sort( areaCompVec.begin(), areaCompVec.end(), std::greater() );
     }
     else
     {
         if ( settings.numSmallerComponents )
-            *settings.numSmallerComponents = int( areaRootVec.size() - settings.maxLargeComponents );
-        std::partial_sort( areaRootVec.begin(), areaRootVec.begin() + settings.maxLargeComponents, areaRootVec.end(), std::greater() );
-        areaRootVec.resize( settings.maxLargeComponents );
+            *settings.numSmallerComponents = int( areaCompVec.size() - settings.maxLargeComponents );
+        std::partial_sort( areaCompVec.begin(), areaCompVec.begin() + settings.maxLargeComponents, areaCompVec.end(), std::greater() );
+        areaCompVec.resize( settings.maxLargeComponents );
     }
 
-    res.resize( areaRootVec.size() );
-    ParallelFor( res, [&]( size_t i )
+    Vector<int, RegionId> comp2res( comps.numComponents, -1 );
+    res.resize( areaCompVec.size() );
+    for ( int i = 0; i < res.size(); ++i )
+    {
+        comp2res[areaCompVec[i].comp] = i;
+        res[i].resize( mp.mesh.topology.faceSize() );
+    }
+    // all result bit sets have equal size, so each thread modifies only its own blocks in them
+    BitSetParallelFor( mp.mesh.topology.getFaceIds( mp.region ), [&]( FaceId f )
     {
-        const auto myRoot = areaRootVec[i].root;
-        auto & fs = res[i];
-        fs.resize( mp.mesh.topology.faceSize() );
-        for ( auto f : region )
-            if ( roots[f] == myRoot )
-                fs.set( f );
+        if ( auto i = comp2res[comps.faceComp[f]]; i >= 0 )
+            res[i].set( f );
     } );
     return res;
 }
@@ -382,19 +534,17 @@ VertBitSet getComponentsVerts( const Mesh& mesh, const VertBitSet& seeds, const
 size_t getNumComponents( const MeshPart& meshPart, FaceIncidence incidence, const UndirectedEdgePredicate & isCompBd )
 {
     MR_TIMER
-    auto unionFindStruct = getUnionFindStructureFaces( meshPart, incidence, isCompBd );
+    auto unionFind = getAtomicUnionFindFaces( meshPart, incidence, isCompBd );
     const FaceBitSet& region = meshPart.mesh.topology.getFaceIds( meshPart.region );
 
     std::atomic<size_t> res{ 0 };
-    tbb::parallel_for( tbb::blocked_range<FaceId>( 0_f, FaceId( unionFindStruct.size() ) ),
+    tbb::parallel_for( tbb::blocked_range<FaceId>( 0_f, FaceId( unionFind.size() ) ),
         [&]( const tbb::blocked_range<FaceId> & range )
     {
         size_t myRoots = 0;
         for ( auto f = range.begin(); f < range.end(); ++f )
         {
-            if ( !region.test( f ) )
-                continue;
-            if ( f == unionFindStruct.findUpdateRange( f, range.begin(), range.end() ) )
+            if ( region.test( f ) && unionFind.isRoot( f ) )
                 ++myRoots;
         }
         res.fetch_add( myRoots, std::memory_order_relaxed );
@@ -574,12 +724,9 @@ std::vector<FaceBitSet> getAllFlatComponents( const MeshPart& meshPart, float zT
 std::pair<Face2RegionMap, int> getAllComponentsMap( const MeshPart& meshPart, FaceIncidence incidence, const UndirectedEdgePredicate & isCompBd )
 {
     MR_TIMER
-    auto unionFindStruct = getUnionFindStructureFaces( meshPart, incidence, isCompBd );
-    const auto& mesh = meshPart.mesh;
-    const FaceBitSet& region = mesh.topology.getFaceIds( meshPart.region );
-
-    const auto& allRoots = unionFindStruct.roots();
-    return getUniqueRootIds( allRoots, region );
+    auto unionFind = getAtomicUnionFindFaces( meshPart, incidence, isCompBd );
+    auto comps = labelComponents( meshPart, unionFind, false );
+    return { std::move( comps.faceComp ), comps.numComponents };
 }
 
 Vector<double, RegionId> getRegionAreas( const MeshPart& meshPart,
@@ -933,6 +1080,56 @@ TEST(MRMesh, getAllComponentsEdges)
     ASSERT_EQ( comp[0].count(), 5 );
 }
 
+TEST( MRMesh, labelFaceComponents )
+{
+    auto mesh = makeUVSphere( 2, 16, 16 );
+    auto small = makeUVSphere( 1, 8, 8 );
+    small.transform( AffineXf3f::translation( { 10, 0, 0 } ) );
+    mesh.addPart( small );
+    small.transform( AffineXf3f::translation( { 0, 10, 0 } ) );
+    mesh.addPart( small );
+
+    const auto comps = labelFaceComponents( mesh );
+    ASSERT_EQ( comps.numComponents, 3 );
+    const auto all = getAllComponents( mesh );
+    ASSERT_EQ( all.size(), 3 );
+    for ( RegionId i( 0 ); i < 3; ++i )
+    {
+        for ( auto f : all[i] )
+            EXPECT_EQ( comps.faceComp[f], i );
+        EXPECT_NEAR( comps.areas[i], mesh.area( all[i] ), 1e-4 );
+        EXPECT_EQ( comps.boxes[i], mesh.computeBoundingBox( &all[i] ) );
+    }
+    EXPECT_GT( comps.areas[RegionId( 0 )], comps.areas[RegionId( 1 )] );
+
+    // compares bit sets of possibly different sizes
+    auto same = []( const FaceBitSet & a, const FaceBitSet & b )
+    {
+        if ( a.count() != b.count() )
+            return false;
+        for ( auto f : a )
+            if ( !b.test( f ) )
+                return false;
+        return true;
+    };
+    EXPECT_TRUE( same( getLargestComponent( mesh ), all[0] ) );
+    int numSmaller = 0;
+    const auto large = getNLargeByAreaComponents( mesh, { .maxLargeComponents = 2, .numSmallerComponents = &numSmaller } );
+    ASSERT_EQ( large.size(), 2 );
+    EXPECT_TRUE( same( large[0], all[0] ) );
+    EXPECT_TRUE( same( large[1], all[1] ) || same( large[1], all[2] ) );
+    EXPECT_EQ( numSmaller, 1 );
+    EXPECT_EQ( getNumComponents( mesh ), 3 );
+    EXPECT_EQ( getNumComponents( mesh, PerVertex ), 3 );
+
+    AtomicUnionFind<FaceId> uf( 6 );
+    uf.unite( 4_f, 5_f );
+    uf.unite( 5_f, 1_f );
+    EXPECT_TRUE( uf.united( 4_f, 1_f ) );
+    EXPECT_FALSE( uf.united( 0_f, 1_f ) );
+    EXPECT_EQ( uf.find( 4_f ), 1_f ); // the smallest element is always the root
+}
+
 UnionFind<UndirectedEdgeId> getUnionFindStructureUndirectedEdges( const Mesh& mesh, bool allPointToRoots )
 {
     MR_TIMER
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MRUnionFind.h"
+#include "MRBox.h"
 #include <functional>
 
 namespace MR
@@ -108,6 +109,24 @@ struct LargeByAreaComponentsSettings
 [[nodiscard]] MRMESH_API std::pair<Face2RegionMap, int> getAllComponentsMap( const MeshPart& meshPart,
     FaceIncidence incidence = FaceIncidence::PerEdge, const UndirectedEdgePredicate & isCompBd = {} );
 
+/// dense labeling of connected components of mesh part with their areas and bounding boxes
+struct FaceComponents
+{
+    /// the component of each face in [0, numComponents) ordered by the smallest face in them, invalid id for faces outside of the region
+    Face2RegionMap faceComp;
+    int numComponents = 0;
+    /// the area of each component
+    Vector<double, RegionId> areas;
+    /// the bounding box of each component
+    Vector<Box3f, RegionId> boxes;
+};
+
+/// finds all connected components of mesh part in parallel using concurrent union-find structure,
+/// then labels the faces and computes the areas and the boxes of the components in one parallel pass;
+/// \param isCompBd shall be thread-safe, and it is supported only for FaceIncidence::PerEdge
+[[nodiscard]] MRMESH_API FaceComponents labelFaceComponents( const MeshPart& meshPart,
+    FaceIncidence incidence = FaceIncidence::PerEdge, const UndirectedEdgePredicate & isCompBd = {} );
+
 /// computes the area of each region given via the map
 [[nodiscard]] MRMESH_API Vector<double, RegionId> getRegionAreas( const MeshPart& meshPart,
     const Face2RegionMap & regionMap, int numRegions );
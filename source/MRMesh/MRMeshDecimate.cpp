@@ -13,6 +13,13 @@
 #include "MRMeshSubdivide.h"
 #include "MRMeshRelax.h"
 #include "MRLineSegm.h"
+#include "MREdgeIterator.h"
+#include "MRAABBTree.h"
+#include "MRMeshBuilder.h"
+#include "MRExpandShrink.h"
+#include "MRMakeSphereMesh.h"
+#include "MRPch/MRSpdlog.h"
+#include "MRPch/MRTBB.h"
 #include <queue>
 
 namespace MR
@@ -1164,7 +1171,9 @@ DecimateResult decimateMesh( Mesh & mesh, const DecimateSettings & settings )
         return decimateMeshSerial( mesh, settings );
 }
 
-bool remesh( MR::Mesh& mesh, const RemeshSettings & settings )
+/// \param new2Old if given, receives the mapping of the faces appeared during subdivision on original faces
+/// \param numSplits if given, receives the number of edge splits done during subdivision
+static bool remeshSeq( MR::Mesh& mesh, const RemeshSettings & settings, FaceHashMap * new2Old = nullptr, int * numSplits = nullptr )
 {
     MR_TIMER
     if ( settings.progressCallback && !settings.progressCallback( 0.0f ) )
@@ -1191,8 +1200,11 @@ bool remesh( MR::Mesh& mesh, const RemeshSettings & settings )
     subs.notFlippable = settings.notFlippable;
     subs.projectOnOriginalMesh = settings.projectOnOriginalMesh;
     subs.onEdgeSplit = settings.onEdgeSplit;
+    subs.new2Old = new2Old;
     subs.progressCallback = subprogress( settings.progressCallback, 0.0f, 0.5f );
-    subdivideMesh( mesh, subs );
+    const int splitsDone = subdivideMesh( mesh, subs );
+    if ( numSplits )
+        *numSplits = splitsDone;
     if ( !reportProgress( settings.progressCallback, 0.5f ) )
         return false;
 
@@ -1251,6 +1263,500 @@ bool remesh( MR::Mesh& mesh, const RemeshSettings & settings )
     return reportProgress( settings.progressCallback, 1.0f );
 }
 
+/// remeshes the parts of the mesh in parallel away from the boundaries of the parts,
+/// then remeshes the bands along the seams sequentially
+static bool remeshParallel( MR::Mesh& mesh, const RemeshSettings & settings )
+{
+    MR_TIMER
+    if ( settings.progressCallback && !settings.progressCallback( 0.0f ) )
+        return false;
+    if ( settings.targetEdgeLen <= 0 )
+    {
+        assert( false );
+        return false;
+    }
+    if ( settings.region && !settings.region->any() )
+    {
+        assert( false );
+        return false;
+    }
+
+    MR_WRITER( mesh );
+    const auto & region = mesh.topology.getFaceIds( settings.region );
+    const auto numRegionFaces = region.count();
+    const auto & tree = mesh.getAABBTree();
+    const auto subroots = tree.getSubtrees( settings.subdivideParts );
+    const auto sz = subroots.size();
+
+    if ( settings.progressCallback && !settings.progressCallback( 0.05f ) )
+        return false;
+
+    struct alignas(64) SubMesh
+    {
+        Mesh m;
+        VertMap subVertToOriginal; // only for the vertices existed before remeshing
+        FaceMap subFaceToOriginal; // only for the faces existed before remeshing
+        FaceHashMap new2Old; // new faces -> faces of the part existed before remeshing
+        VertBitSet bdVerts; // the boundary of the part
+        FaceBitSet region; // the faces of the region not incident to the boundary of the part, they are remeshed here
+        FaceBitSet outerRegion; // the faces of the region incident to the boundary of the part, they are remeshed in seam pass
+        UndirectedEdgeBitSet notFlippable;
+        int splitsDone = 0;
+    };
+    std::vector<SubMesh> submeshes( sz );
+
+    Timer timer( "remesh parts" );
+    const auto mainThreadId = std::this_thread::get_id();
+    std::atomic<bool> cancelled{ false };
+    std::atomic<int> finishedSubmeshes{ 0 };
+    tbb::parallel_for( tbb::blocked_range<size_t>( 0, sz, 1 ),
+        [&]( const tbb::blocked_range<size_t>& range )
+    {
+        const bool reportProgressFromThisThread = settings.progressCallback && mainThreadId == std::this_thread::get_id();
+        for ( size_t i = range.begin(); i < range.end(); ++i )
+        {
+            auto reportThreadProgress = [&]( float p )
+            {
+                if ( cancelled.load( std::memory_order_relaxed ) )
+                    return false;
+                if ( reportProgressFromThisThread && !settings.progressCallback( 0.05f + 0.65f * ( finishedSubmeshes.load( std::memory_order_relaxed ) + p ) / sz ) )
+                {
+                    cancelled.store( true, std::memory_order_relaxed );
+                    return false;
+                }
+                return true;
+            };
+            if ( !reportThreadProgress( 0 ) )
+                break;
+            const auto faces = tree.getSubtreeLeaves( subroots[i] );
+            size_t numPartRegionFaces = 0;
+            for ( FaceId f : faces )
+                if ( region.test( f ) )
+                    ++numPartRegionFaces;
+
+            auto & submesh = submeshes[i];
+            if ( numPartRegionFaces > 0 )
+            {
+                WholeEdgeMap subEdgeToOriginal;
+                PartMapping map;
+                map.tgt2srcVerts = &submesh.subVertToOriginal;
+                map.tgt2srcFaces = &submesh.subFaceToOriginal;
+                if ( settings.notFlippable )
+                    map.tgt2srcEdges = &subEdgeToOriginal;
+                submesh.m = mesh.cloneRegion( faces, false, map );
+
+                // the vertices on the boundary of the part are shared with other parts,
+                // so only the faces having no such vertices are given for remeshing
+                submesh.bdVerts = submesh.m.topology.findBoundaryVerts();
+                submesh.region.resize( submesh.m.topology.faceSize() );
+                submesh.outerRegion.resize( submesh.m.topology.faceSize() );
+                for ( auto f : submesh.m.topology.getValidFaces() )
+                {
+                    if ( !region.test( submesh.subFaceToOriginal[f] ) )
+                        continue;
+                    const auto vs = submesh.m.topology.getTriVerts( f );
+                    if ( submesh.bdVerts.test( vs[0] ) || submesh.bdVerts.test( vs[1] ) || submesh.bdVerts.test( vs[2] ) )
+                        submesh.outerRegion.set( f );
+                    else
+                        submesh.region.set( f );
+                }
+                if ( settings.notFlippable )
+                {
+                    submesh.notFlippable.resize( subEdgeToOriginal.size() );
+                    for ( auto ue : undirectedEdges( submesh.m.topology ) )
+                        if ( settings.notFlippable->test( subEdgeToOriginal[ue].undirected() ) )
+                            submesh.notFlippable.set( ue );
+                }
+            }
+            if ( submesh.region.none() )
+            {
+                // the triangles of this part will be taken from the mesh unchanged
+                submesh = {};
+                finishedSubmeshes.fetch_add( 1, std::memory_order_relaxed );
+                continue;
+            }
+
+            if ( !reportThreadProgress( 0.1f ) )
+                break;
+
+            auto subSettings = settings;
+            // the budget of splits is distributed among the parts proportionally to the number of their faces in the region
+            subSettings.maxEdgeSplits = int( std::int64_t( settings.maxEdgeSplits ) * numPartRegionFaces / numRegionFaces );
+            subSettings.region = &submesh.region;
+            subSettings.notFlippable = settings.notFlippable ? &submesh.notFlippable : nullptr;
+            subSettings.packMesh = false;
+            if ( reportProgressFromThisThread )
+                subSettings.progressCallback = [reportThreadProgress]( float p ) { return reportThreadProgress( 0.1f + 0.9f * p ); };
+            else if ( settings.progressCallback )
+                subSettings.progressCallback = [&cancelled]( float ) { return !cancelled.load( std::memory_order_relaxed ); };
+            if ( !remeshSeq( submesh.m, subSettings, &submesh.new2Old, &submesh.splitsDone ) )
+            {
+                cancelled.store( true, std::memory_order_relaxed );
+                break;
+            }
+            finishedSubmeshes.fetch_add( 1, std::memory_order_relaxed );
+        }
+    } );
+
+    if ( cancelled.load( std::memory_order_relaxed ) || ( settings.progressCallback && !settings.progressCallback( 0.7f ) ) )
+        return false;
+
+    timer.restart( "recombine parts" );
+    // the ends of not-flippable edges, since all edges get new ids in recombined mesh
+    std::vector<std::pair<VertId, VertId>> notFlippableEnds;
+
+    // recombine mesh from parts: remaining old vertices and faces keep their ids, and new ones are appended;
+    // first the ids are given to new elements of all parts sequentially, then the parts are copied in the mesh in parallel
+    int splitsDone = 0;
+    Triangulation t = mesh.topology.getTriangulation();
+    FaceBitSet facesToAdd = mesh.topology.getValidFaces();
+    FaceBitSet remeshedFaces( mesh.topology.faceSize() ); // original faces of the parts given for remeshing
+    FaceBitSet newRegion = region;
+    newRegion.resize( mesh.topology.faceSize() );
+    VertBitSet seamVerts( mesh.topology.vertSize() );
+    VertId nextVertId( mesh.topology.vertSize() );
+    FaceId nextFaceId( t.size() );
+    for ( auto & submesh : submeshes )
+    {
+        if ( submesh.m.topology.numValidFaces() == 0 )
+            continue;
+        splitsDone += submesh.splitsDone;
+        const auto & subTopology = submesh.m.topology;
+
+        auto & vmap = submesh.subVertToOriginal;
+        const VertId firstNewVert( vmap.size() );
+        vmap.resize( subTopology.vertSize() );
+        for ( VertId v = firstNewVert; v < vmap.endId(); ++v )
+            if ( subTopology.hasVert( v ) )
+                vmap[v] = nextVertId++;
+        for ( auto v : submesh.bdVerts )
+            seamVerts.set( vmap[v] );
+
+        auto & fmap = submesh.subFaceToOriginal;
+        const FaceId firstNewFace( fmap.size() );
+        for ( FaceId f( 0 ); f < firstNewFace; ++f )
+        {
+            if ( !fmap[f] )
+                continue;
+            remeshedFaces.set( fmap[f] );
+            if ( subTopology.hasFace( f ) )
+                continue;
+            // the face was deleted by decimation
+            t[fmap[f]] = {};
+            facesToAdd.reset( fmap[f] );
+            newRegion.reset( fmap[f] );
+        }
+        fmap.resize( subTopology.faceSize() );
+        for ( FaceId f = firstNewFace; f < fmap.endId(); ++f )
+        {
+            if ( !subTopology.hasFace( f ) )
+                continue;
+            fmap[f] = nextFaceId++;
+            facesToAdd.autoResizeSet( fmap[f] );
+            // new faces outside of part's region appear after splitting the edges on its boundary
+            if ( submesh.region.test( f ) || submesh.outerRegion.test( submesh.new2Old[f] ) )
+                newRegion.autoResizeSet( fmap[f] );
+        }
+
+        for ( auto ue : submesh.notFlippable )
+            if ( !subTopology.isLoneEdge( ue ) )
+                notFlippableEnds.emplace_back( vmap[subTopology.org( ue )], vmap[subTopology.dest( ue )] );
+    }
+
+    t.resize( nextFaceId );
+    ParallelFor( submeshes, [&]( size_t i )
+    {
+        const auto & submesh = submeshes[i];
+        const auto & subTopology = submesh.m.topology;
+        const auto & vmap = submesh.subVertToOriginal;
+        for ( auto f : subTopology.getValidFaces() )
+        {
+            auto & tri = t[submesh.subFaceToOriginal[f]];
+            tri = subTopology.getTriVerts( f );
+            for ( auto & v : tri )
+                v = vmap[v];
+        }
+    } );
+
+    if ( settings.notFlippable )
+    {
+        // the edges of remeshed parts are taken from the parts above, since their ends might be connected by another edge now;
+        // the edge having a face outside of remeshed parts is not changed
+        for ( auto ue : *settings.notFlippable )
+        {
+            if ( ue >= mesh.topology.undirectedEdgeSize() )
+                break;
+            const auto l = mesh.topology.left( ue );
+            const auto r = mesh.topology.right( ue );
+            if ( ( l && !remeshedFaces.test( l ) ) || ( r && !remeshedFaces.test( r ) ) )
+                notFlippableEnds.emplace_back( mesh.topology.org( ue ), mesh.topology.dest( ue ) );
+        }
+    }
+
+    if ( settings.progressCallback && !settings.progressCallback( 0.75f ) )
+        return false;
+
+    timer.restart( "build topology" );
+    auto topology = MeshBuilder::fromTriangles( t, { .region = &facesToAdd } );
+    if ( facesToAdd.any() )
+    {
+        // some triangles were rejected by mesh builder (e.g. around a vertex with several separate fans of faces),
+        // so the results of the parts are discarded and the original mesh (not modified till now) is remeshed sequentially
+        spdlog::warn( "remesh: {} faces cannot be recombined from parallel parts, falling back to sequential remeshing", facesToAdd.count() );
+        auto seqSettings = settings;
+        seqSettings.progressCallback = subprogress( settings.progressCallback, 0.75f, 1.0f );
+        return remeshSeq( mesh, seqSettings );
+    }
+
+    mesh.points.resize( nextVertId );
+    ParallelFor( submeshes, [&]( size_t i )
+    {
+        const auto & submesh = submeshes[i];
+        const auto & vmap = submesh.subVertToOriginal;
+        for ( auto v : submesh.m.topology.getValidVerts() )
+            if ( !submesh.bdVerts.test( v ) ) // boundary vertices are shared with other parts and not moved
+                mesh.points[vmap[v]] = submesh.m.points[v];
+    } );
+    mesh.topology = std::move( topology );
+    mesh.invalidateCaches();
+    newRegion.resize( mesh.topology.faceSize() );
+
+    if ( settings.notFlippable )
+    {
+        settings.notFlippable->clear();
+        settings.notFlippable->resize( mesh.topology.undirectedEdgeSize() );
+        for ( const auto & [a, b] : notFlippableEnds )
+            if ( auto e = mesh.topology.findEdge( a, b ) )
+                settings.notFlippable->set( e.undirected() );
+    }
+
+    if ( settings.progressCallback && !settings.progressCallback( 0.8f ) )
+        return false;
+
+    timer.restart( "remesh seams" );
+    // the band along the seams includes two more rings of already remeshed faces to blend with them
+    FaceBitSet band = getIncidentFaces( mesh.topology, seamVerts ) & newRegion;
+    expand( mesh.topology, band, 2 );
+    band &= newRegion;
+    newRegion -= band;
+
+    auto seamSettings = settings;
+    seamSettings.maxEdgeSplits = std::max( 0, settings.maxEdgeSplits - splitsDone );
+    seamSettings.region = &band;
+    seamSettings.packMesh = false;
+    seamSettings.progressCallback = subprogress( settings.progressCallback, 0.8f, 1.0f );
+    FaceHashMap seamNew2Old;
+    if ( band.any() && !remeshSeq( mesh, seamSettings, settings.region ? &seamNew2Old : nullptr ) )
+        return false;
+
+    if ( settings.region )
+    {
+        newRegion.resize( mesh.topology.faceSize() );
+        band.resize( mesh.topology.faceSize() );
+        // the splits of the edges on the boundary of the band create new faces outside of it
+        for ( const auto & [newFace, oldFace] : seamNew2Old )
+            if ( newRegion.test( oldFace ) )
+                newRegion.set( newFace );
+        // and the collapses on the boundary of the band could delete some faces outside of it
+        *settings.region = ( newRegion | band ) & mesh.topology.getValidFaces();
+    }
+
+    if ( settings.packMesh )
+    {
+        DecimateSettings decs;
+        decs.packMesh = true;
+        decs.region = settings.region;
+        decs.notFlippable = settings.notFlippable;
+        optionalPackMesh( mesh, decs );
+    }
+
+    return reportProgress( settings.progressCallback, 1.0f );
+}
+
+bool remesh( MR::Mesh& mesh, const RemeshSettings & settings )
+{
+    if ( settings.subdivideParts > 1 && !settings.onEdgeSplit && !settings.onEdgeDel && !settings.preCollapse )
+        return remeshParallel( mesh, settings );
+    return remeshSeq( mesh, settings );
+}
+
+TEST( MRMesh, RemeshParallel )
+{
+    auto sphere = makeSphere( { .radius = 1, .numMeshVertices = 3000 } );
+    RemeshSettings settings;
+    settings.targetEdgeLen = 0.02f;
+
+    auto seqMesh = sphere;
+    EXPECT_TRUE( remesh( seqMesh, settings ) );
+
+    auto parMesh = sphere;
+    FaceBitSet region = parMesh.topology.getValidFaces();
+    settings.region = &region;
+    settings.subdivideParts = 8;
+    EXPECT_TRUE( remesh( parMesh, settings ) );
+    EXPECT_TRUE( parMesh.topology.checkValidity() );
+    EXPECT_EQ( region.count(), parMesh.topology.numValidFaces() );
+
+    // both meshes shall have similar number of triangles and average edge length
+    const auto seqFaces = seqMesh.topology.numValidFaces();
+    EXPECT_NEAR( parMesh.topology.numValidFaces(), seqFaces, seqFaces / 20 );
+    auto avgEdgeLen = []( const Mesh & m )
+    {
+        double sum = 0;
+        for ( auto ue : undirectedEdges( m.topology ) )
+            sum += m.edgeLength( ue );
+        return sum / m.topology.computeNotLoneUndirectedEdges();
+    };
+    EXPECT_NEAR( avgEdgeLen( parMesh ), avgEdgeLen( seqMesh ), 0.001 );
+}
+
+TEST( MRMesh, RemeshParallelRegion )
+{
+    auto sphere = makeSphere( { .radius = 1, .numMeshVertices = 3000 } );
+    FaceBitSet upper( sphere.topology.faceSize() );
+    for ( auto f : sphere.topology.getValidFaces() )
+        if ( sphere.triCenter( f ).z > 0 )
+            upper.set( f );
+    // the faces far from the region shall not be changed
+    auto countFarFaces = []( const Mesh & m )
+    {
+        int res = 0;
+        for ( auto f : m.topology.getValidFaces() )
+        {
+            const auto vs = m.topology.getTriVerts( f );
+            if ( m.points[vs[0]].z < -0.1f && m.points[vs[1]].z < -0.1f && m.points[vs[2]].z < -0.1f )
+                ++res;
+        }
+        return res;
+    };
+    const auto farFaces = countFarFaces( sphere );
+
+    RemeshSettings settings;
+    settings.targetEdgeLen = 0.02f;
+
+    auto seqMesh = sphere;
+    auto seqRegion = upper;
+    settings.region = &seqRegion;
+    EXPECT_TRUE( remesh( seqMesh, settings ) );
+
+    auto parMesh = sphere;
+    auto parRegion = upper;
+    settings.region = &parRegion;
+    settings.subdivideParts = 8;
+    EXPECT_TRUE( remesh( parMesh, settings ) );
+    EXPECT_TRUE( parMesh.topology.checkValidity() );
+    EXPECT_EQ( parRegion, parRegion & parMesh.topology.getValidFaces() );
+    EXPECT_EQ( countFarFaces( parMesh ), farFaces );
+    for ( auto f : parRegion )
+        EXPECT_GT( parMesh.triCenter( f ).z, -0.1f );
+    EXPECT_NEAR( parRegion.count(), seqRegion.count(), seqRegion.count() / 20 );
+    const auto upperArea = sphere.area( &upper );
+    EXPECT_NEAR( parMesh.area( &parRegion ), upperArea, upperArea / 100 );
+}
+
+TEST( MRMesh, RemeshParallelNotFlippable )
+{
+    auto sphere = makeSphere( { .radius = 1, .numMeshVertices = 3000 } );
+    FaceBitSet cap( sphere.topology.faceSize() );
+    for ( auto f : sphere.topology.getValidFaces() )
+        if ( sphere.triCenter( f ).z > 0.3f )
+            cap.set( f );
+    const auto capBd = findRegionBoundaryUndirectedEdgesInsideMesh( sphere.topology, cap );
+    auto totalLength = []( const Mesh & m, const UndirectedEdgeBitSet & edges )
+    {
+        double sum = 0;
+        for ( auto ue : edges )
+            sum += m.edgeLength( ue );
+        return sum;
+    };
+    const auto capBdLength = totalLength( sphere, capBd );
+
+    RemeshSettings settings;
+    settings.targetEdgeLen = 0.02f;
+    settings.subdivideParts = 8;
+    auto mesh = sphere;
+    auto notFlippable = capBd;
+    settings.notFlippable = &notFlippable;
+    EXPECT_TRUE( remesh( mesh, settings ) );
+    EXPECT_TRUE( mesh.topology.checkValidity() );
+    EXPECT_GT( notFlippable.count(), capBd.count() );
+
+    // not-flippable edges are split but keep their shape of single closed line
+    EXPECT_NEAR( totalLength( mesh, notFlippable ), capBdLength, 1e-3 * capBdLength );
+    for ( auto v : getIncidentVerts( mesh.topology, notFlippable ) )
+    {
+        int n = 0;
+        for ( auto e : orgRing( mesh.topology, v ) )
+            if ( notFlippable.test( e.undirected() ) )
+                ++n;
+        EXPECT_EQ( n, 2 );
+    }
+}
+
+TEST( MRMesh, RemeshParallelCancel )
+{
+    auto sphere = makeSphere( { .radius = 1, .numMeshVertices = 3000 } );
+    RemeshSettings settings;
+    settings.targetEdgeLen = 0.02f;
+    settings.subdivideParts = 8;
+    // cancel in parallel stage and in seam stage
+    for ( float stop : { 0.3f, 0.9f } )
+    {
+        auto mesh = sphere;
+        settings.progressCallback = [stop]( float p ) { return p < stop; };
+        EXPECT_FALSE( remesh( mesh, settings ) );
+        EXPECT_TRUE( mesh.topology.checkValidity() );
+        if ( stop < 0.7f ) // the mesh is not changed before recombination from parts
+            EXPECT_EQ( mesh.topology.numValidFaces(), sphere.topology.numValidFaces() );
+    }
+}
+
+TEST( MRMesh, RemeshParallelFallback )
+{
+    // three triangles with one common vertex having three separate fans of faces, which mesh builder cannot restore
+    Triangulation t{
+        { 0_v, 1_v, 2_v },
+        { 3_v, 4_v, 5_v },
+        { 6_v, 7_v, 8_v }
+    };
+    Mesh mesh;
+    mesh.topology = MeshBuilder::fromTriangles( t );
+    mesh.points = {
+        { 0.f, 0.f, 0.f }, {  1.f, 0.f, 0.f }, { 0.f,  1.f, 0.f },
+        { 0.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f },
+        { 0.f, 0.f, 0.f }, { 0.f, 0.f,  1.f }, { 1.f, 0.f,  1.f }
+    };
+    auto boundaryEdgeWithOrg = [&]( VertId v )
+    {
+        for ( auto e : orgRing( mesh.topology, v ) )
+            if ( !mesh.topology.left( e ) )
+                return e;
+        return EdgeId();
+    };
+    for ( auto v : { 3_v, 6_v } )
+    {
+        const auto e = boundaryEdgeWithOrg( v );
+        mesh.topology.setOrg( e, VertId() );
+        mesh.topology.splice( boundaryEdgeWithOrg( 0_v ), e );
+    }
+    mesh.invalidateCaches();
+    ASSERT_TRUE( mesh.topology.checkValidity() );
+
+    RemeshSettings settings;
+    settings.targetEdgeLen = 0.05f;
+    auto seqMesh = mesh;
+    EXPECT_TRUE( remesh( seqMesh, settings ) );
+
+    // the parts cannot be recombined, and sequential remeshing of the original mesh is done instead
+    settings.subdivideParts = 3;
+    EXPECT_TRUE( remesh( mesh, settings ) );
+    EXPECT_TRUE( mesh.topology.checkValidity() );
+    EXPECT_GT( seqMesh.topology.numValidFaces(), 100 );
+    EXPECT_EQ( mesh.topology.numValidFaces(), seqMesh.topology.numValidFaces() );
+    EXPECT_EQ( mesh.topology.numValidVerts(), seqMesh.topology.numValidVerts() );
+    EXPECT_NEAR( mesh.area(), seqMesh.area(), 1e-5 );
+}
+
 // check if Decimator updates region
 TEST( MRMesh, MeshDecimate )
 {
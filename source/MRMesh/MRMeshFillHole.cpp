@@ -8,6 +8,8 @@
 #include "MRMeshBuilder.h"
 #include "MRMeshDelone.h"
 #include "MRHash.h"
+#include "MRParallelFor.h"
+#include "MRMakeSphereMesh.h"
 #include "MRPch/MRTBB.h"
 #include "MRPch/MRSpdlog.h"
 #include "MRGTest.h"
@@ -615,9 +617,11 @@ HoleFillPlan getHoleFillPlan( const Mesh& mesh, EdgeId a0, const FillHoleParams&
     //fill all table not queue
     constexpr unsigned stepStart = 2;
     const unsigned stepEnd = loopEdgesCounter - 2;
+    // small holes are planned in the current thread, since fillHoles already processes many of them in parallel
+    constexpr unsigned minParallelHoleSize = 64;
     for ( auto steps = stepStart; steps <= stepEnd; ++steps )
     {
-        tbb::parallel_for( tbb::blocked_range<unsigned>( 0, loopEdgesCounter, 15 ), [&]( const tbb::blocked_range<unsigned>& range )
+        auto processRange = [&]( const tbb::blocked_range<unsigned>& range )
         {
             std::vector<unsigned> optimalStepsCache;
             optimalStepsCache.resize( params.maxPolygonSubdivisions );
@@ -634,7 +638,12 @@ HoleFillPlan getHoleFillPlan( const Mesh& mesh, EdgeId a0, const FillHoleParams&
                 getOptimalSteps( optimalStepsCache, ( i + 1 ) % loopEdgesCounter, steps, loopEdgesCounter, params.maxPolygonSubdivisions );
                 getTriangulationWeights( mesh.topology, newEdgesMap, edgeMap, metrics, optimalStepsCache, current ); // find better among steps
             }
-        });
+        };
+        const tbb::blocked_range<unsigned> range( 0, loopEdgesCounter, 15 );
+        if ( loopEdgesCounter < minParallelHoleSize )
+            processRange( range );
+        else
+            tbb::parallel_for( range, processRange );
     }
     // find minimum triangulation
     MapPatch savedMapPatch, cachedMapPatch;
@@ -813,11 +822,85 @@ void fillHole( Mesh& mesh, EdgeId a0, const FillHoleParams& params )
 void fillHoles( Mesh& mesh, const std::vector<EdgeId> & as, const FillHoleParams& params )
 {
     MR_TIMER
+    MR_WRITER( mesh );
+    if ( params.stopBeforeBadTriangulation )
+        *params.stopBeforeBadTriangulation = false;
+
+    // fills one hole in the current thread, accumulating bad triangulation flag
+    auto fillOne = [&]( EdgeId a )
+    {
+        auto localParams = params;
+        bool bad = false;
+        if ( params.stopBeforeBadTriangulation )
+            localParams.stopBeforeBadTriangulation = &bad;
+        fillHole( mesh, a, localParams );
+        if ( bad )
+            *params.stopBeforeBadTriangulation = true;
+    };
+
+    if ( params.makeDegenerateBand )
+    {
+        for ( auto a : as )
+            fillOne( a );
+        return;
+    }
+
+    // the plans of the holes without common vertices are independent and prepared in parallel;
+    // other holes (and the holes repeated in the input) are filled one by one in the end,
+    // since filling one of them can change the best triangulation of another one (e.g. to avoid multiple edges)
+    std::vector<EdgeId> independent, dependent;
+    {
+        MR_NAMED_TIMER( "classify holes" );
+        Vector<int, VertId> vertHole( mesh.topology.vertSize(), -1 );
+        std::vector<bool> shared( as.size(), false );
+        for ( int i = 0; i < as.size(); ++i )
+        {
+            if ( mesh.topology.left( as[i] ) )
+            {
+                shared[i] = true;
+                continue;
+            }
+            int numEdges = 0;
+            for ( auto e : leftRing( mesh.topology, as[i] ) )
+            {
+                ++numEdges;
+                auto & h = vertHole[mesh.topology.org( e )];
+                if ( h < 0 )
+                    h = i;
+                else if ( h != i )
+                    shared[i] = shared[h] = true;
+            }
+            if ( numEdges < 3 )
+                shared[i] = true;
+        }
+        for ( int i = 0; i < as.size(); ++i )
+            ( shared[i] ? dependent : independent ).push_back( as[i] );
+    }
 
-    // TODO: parallel getHoleFillPlan
+    std::vector<HoleFillPlan> plans( independent.size() );
+    std::vector<char> bad( independent.size(), false );
+    ParallelFor( plans, [&]( size_t i )
+    {
+        auto localParams = params;
+        bool myBad = false;
+        if ( params.stopBeforeBadTriangulation )
+            localParams.stopBeforeBadTriangulation = &myBad;
+        plans[i] = getHoleFillPlan( mesh, independent[i], localParams );
+        bad[i] = myBad;
+    } );
+
+    for ( size_t i = 0; i < plans.size(); ++i )
+    {
+        if ( bad[i] )
+        {
+            *params.stopBeforeBadTriangulation = true;
+            continue;
+        }
+        executeHoleFillPlan( mesh, independent[i], plans[i], params.outNewFaces );
+    }
 
-    for ( auto a : as )
-        fillHole( mesh, a, params );
+    for ( auto a : dependent )
+        fillOne( a );
 }
 
 VertId fillHoleTrivially( Mesh& mesh, EdgeId a, FaceBitSet * outNewFaces /*= nullptr */ )
@@ -1119,6 +1202,38 @@ TEST( MRMesh, buildCylinderBetweenTwoHoles )
     EXPECT_EQ( bdEdges.size(), 0 );
 }
 
+TEST( MRMesh, fillHoles )
+{
+    auto mesh = makeUVSphere( 1, 32, 32 );
+    FaceBitSet del( mesh.topology.faceSize() );
+    for ( VertId v : { 100_v, 300_v, 500_v, 700_v } )
+        for ( auto e : orgRing( mesh.topology, v ) )
+            del.set( mesh.topology.left( e ) );
+    mesh.deleteFaces( del );
+    const auto holes = mesh.topology.findHoleRepresentiveEdges();
+    ASSERT_EQ( holes.size(), 4 );
+
+    // holes without common vertices are planned in parallel with the same result as sequential filling
+    auto ref = mesh;
+    for ( auto e : holes )
+        fillHole( ref, e );
+    FaceBitSet newFaces;
+    fillHoles( mesh, holes, { .outNewFaces = &newFaces } );
+    EXPECT_TRUE( mesh.topology == ref.topology );
+    EXPECT_EQ( newFaces.count(), del.count() - 2 * holes.size() ); // hole with n edges is filled by n-2 triangles
+
+    // two holes with common vertex are filled sequentially
+    del.reset();
+    for ( VertId v : { 400_v, 402_v } )
+        for ( auto e : orgRing( mesh.topology, v ) )
+            del.set( mesh.topology.left( e ) );
+    mesh.deleteFaces( del );
+    const auto holes2 = mesh.topology.findHoleRepresentiveEdges();
+    ASSERT_EQ( holes2.size(), 2 );
+    fillHoles( mesh, holes2 );
+    EXPECT_EQ( mesh.topology.findNumHoles(), 0 );
+}
+
 TEST( MRMesh, makeBridge )
 {
     MeshTopology topology;
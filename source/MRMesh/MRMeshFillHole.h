@@ -51,7 +51,9 @@ struct FillHoleParams
     bool makeDegenerateBand{ false };
 
     /** The maximum number of polygon subdivisions on a triangle and two smaller polygons,
-      * must be 2 or larger
+      * must be 2 or larger;
+      * this is the window of candidate triangles considered for each diagonal of the hole,
+      * which limits planning time to O(n^2 * maxPolygonSubdivisions) instead of O(n^3) for a hole with n edges
       */
     int maxPolygonSubdivisions{ 20 };
 
@@ -132,7 +134,10 @@ MRMESH_API bool buildCylinderBetweenTwoHoles( Mesh & mesh, const StitchHolesPara
   */
 MRMESH_API void fillHole( Mesh& mesh, EdgeId a, const FillHoleParams& params = {} );
 
-/// fill all holes given by their representative edges in \param as
+/// fill all holes given by their representative edges in \param as;
+/// the triangulations of the holes without common vertices are planned in parallel, so \ref FillHoleParams::metric must be thread-safe
+/// (as all built-in metrics are), then all holes are filled one by one;
+/// \ref FillHoleParams::stopBeforeBadTriangulation is set to true if at least one hole was left unfilled because of bad triangulation
 MRMESH_API void fillHoles( Mesh& mesh, const std::vector<EdgeId> & as, const FillHoleParams& params = {} );
 
 /// returns true if given loop is a boundary of one hole in given mesh topology:
@@ -349,9 +349,12 @@ EdgeId isVertexRepeatedOnHoleBd( const MeshTopology& topology, VertId v )
 
 VertBitSet findRepeatedVertsOnHoleBd( const MeshTopology& topology )
 {
-    MR_TIMER
-    const auto holeRepresEdges = topology.findHoleRepresentiveEdges();
+    return findRepeatedVertsOnHoleBd( topology, topology.findHoleRepresentiveEdges() );
+}
 
+VertBitSet findRepeatedVertsOnHoleBd( const MeshTopology& topology, const std::vector<EdgeId>& holeRepresEdges )
+{
+    MR_TIMER
     VertBitSet res;
     if ( holeRepresEdges.empty() )
         return res;
@@ -433,11 +436,16 @@ static void findHoleComplicatingFaces( const Mesh & mesh, VertId v, std::vector<
 }
 
 FaceBitSet findHoleComplicatingFaces( const Mesh & mesh )
+{
+    return findHoleComplicatingFaces( mesh, mesh.topology.findHoleRepresentiveEdges() );
+}
+
+FaceBitSet findHoleComplicatingFaces( const Mesh & mesh, const std::vector<EdgeId>& holeRepresEdges )
 {
     MR_TIMER
 
     tbb::enumerable_thread_specific<std::vector<FaceId>> threadData;
-    BitSetParallelFor( findRepeatedVertsOnHoleBd( mesh.topology ), [&]( VertId v )
+    BitSetParallelFor( findRepeatedVertsOnHoleBd( mesh.topology, holeRepresEdges ), [&]( VertId v )
     {
         findHoleComplicatingFaces( mesh, v, threadData.local() );
     } );
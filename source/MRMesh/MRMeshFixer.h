@@ -69,11 +69,18 @@ MRMESH_API int eliminateDegree3Vertices( MeshTopology& topology, VertBitSet & re
 /// returns set bits for all vertices present on the boundary of a hole several times;
 [[nodiscard]] MRMESH_API VertBitSet findRepeatedVertsOnHoleBd( const MeshTopology& topology );
 
+/// returns set bits for all vertices present on the boundary of given holes several times;
+/// \param holeRepresEdges one edge without left face per each considered hole
+[[nodiscard]] MRMESH_API VertBitSet findRepeatedVertsOnHoleBd( const MeshTopology& topology, const std::vector<EdgeId>& holeRepresEdges );
+
 /// returns all faces that complicate one of mesh holes;
 /// hole is complicated if it passes via one vertex more than once;
 /// deleting such faces simplifies the holes and makes them easier to fill
 [[nodiscard]] MRMESH_API FaceBitSet findHoleComplicatingFaces( const Mesh & mesh );
 
+/// returns all faces that complicate one of given holes, each given by one edge without left face
+[[nodiscard]] MRMESH_API FaceBitSet findHoleComplicatingFaces( const Mesh & mesh, const std::vector<EdgeId>& holeRepresEdges );
+
 /// \}
 
 } // namespace MR
@@ -325,6 +325,8 @@ using PlaneSection = SurfacePath;
 using PlaneSections = SurfacePaths;
 struct EdgePointPair;
 class Laplacian;
+struct MultigridSettings;
+class MultigridSolver;
 
 using VertPair = std::pair<VertId, VertId>;
 using FacePair = std::pair<FaceId, FaceId>;
@@ -357,6 +359,7 @@ using WholeEdgeMap = Vector<EdgeId, UndirectedEdgeId>;
 using UndirectedEdge2RegionMap = Vector<RegionId, UndirectedEdgeId>;
 using Face2RegionMap = Vector<RegionId, FaceId>;
 using Vert2RegionMap = Vector<RegionId, VertId>;
+using Voxel2RegionMap = Vector<RegionId, VoxelId>;
 
 using VertCoords = Vector<Vector3f, VertId>;
 using VertNormals = Vector<Vector3f, VertId>;
@@ -430,12 +433,14 @@ struct MRMESH_CLASS PointCloud;
 class MRMESH_CLASS AABBTree;
 class MRMESH_CLASS AABBTreePoints;
 class MRMESH_CLASS AABBTreeObjects;
+class MRMESH_CLASS MeshAdjacency;
 struct MRMESH_CLASS CloudPartMapping;
 struct MRMESH_CLASS PartMapping;
 struct MeshOrPointsXf;
 struct MeshTexture;
 struct GridSettings;
 struct TriMesh;
+struct MarchingCubesParams;
 
 template<typename T> class UniqueThreadSafeOwner;
 
@@ -1,5 +1,6 @@
 #include "MRMeshNormals.h"
 #include "MRMesh.h"
+#include "MRMeshAdjacency.h"
 #include "MRRingIterator.h"
 #include "MRBuffer.h"
 #include "MRVector4.h"
@@ -56,6 +57,28 @@ VertNormals computePerVertNormals( const Mesh & mesh )
     MR_TIMER
     VertId lastValidVert = mesh.topology.lastValidVert();
     std::vector<Vector3f> res( lastValidVert + 1 );
+    auto snapshot = mesh.getAdjacencyNotCreate();
+    if ( snapshot && !snapshot->fits( mesh.topology ) )
+        snapshot = nullptr; // the topology was changed without invalidateCaches(), so the rings are walked below
+    if ( snapshot )
+    {
+        // with cached connectivity, directed area of each triangle is computed only once and then summed around its vertices
+        Vector<Vector3f, FaceId> faceDirDblAreas( mesh.topology.faceSize() );
+        BitSetParallelFor( mesh.topology.getValidFaces(), [&] ( FaceId f )
+        {
+            const auto & t = snapshot->triVerts( f );
+            const auto & p0 = mesh.points[t[0]];
+            faceDirDblAreas[f] = cross( mesh.points[t[1]] - p0, mesh.points[t[2]] - p0 );
+        } );
+        BitSetParallelFor( mesh.topology.getValidVerts(), [&] ( VertId v )
+        {
+            Vector3f sum;
+            for ( auto f : snapshot->faces( v ) )
+                sum += faceDirDblAreas[f];
+            res[v] = sum.normalized();
+        } );
+        return res;
+    }
     BitSetParallelFor( mesh.topology.getValidVerts(), [&] ( VertId v )
     {
         res[v] = mesh.normal( v );
@@ -5,6 +5,7 @@
 #include "MRGridSampling.h"
 #include "MRMeshProject.h"
 #include "MRPointsProject.h"
+#include "MRClosestPointInTriangle.h"
 #include "MRObjectMesh.h"
 #include "MRObjectPoints.h"
 #include "MRBestFit.h"
@@ -130,7 +131,8 @@ auto MeshOrPoints::limitedProjector() const -> LimitedProjectorFunc
                         .normal = mp.mesh.pseudonormal( mpr.mtp ),
                         .isBd = mpr.mtp.isBd( mp.mesh.topology ),
                         .distSq = mpr.distSq,
-                        .closestVert = mp.mesh.getClosestVertex( mpr.proj )
+                        .closestVert = mp.mesh.getClosestVertex( mpr.proj ),
+                        .closestFace = mpr.proj.face
                     };
             };
         },
@@ -152,6 +154,65 @@ auto MeshOrPoints::limitedProjector() const -> LimitedProjectorFunc
     }, var_ );
 }
 
+auto MeshOrPoints::featureProjector() const -> LimitedProjectorFunc
+{
+    return std::visit( overloaded{
+        []( const MeshPart & mp ) -> LimitedProjectorFunc
+        {
+            return [&mp]( const Vector3f & p, ProjectionResult & res )
+            {
+                assert( res.closestFace );
+                const auto f = res.closestFace;
+                Vector3f a, b, c;
+                mp.mesh.getTriPoints( f, a, b, c );
+                // the same computation as in findProjection
+                const auto [projD, baryD] = closestPointInTriangle( Vector3d( p ), Vector3d( a ), Vector3d( b ), Vector3d( c ) );
+                const Vector3f point( projD );
+                const MeshTriPoint mtp( mp.mesh.topology.edgeWithLeft( f ), TriPointf( baryD ) );
+                res = ProjectionResult
+                {
+                    .point = point,
+                    .normal = mp.mesh.pseudonormal( mtp ),
+                    .isBd = mtp.isBd( mp.mesh.topology ),
+                    .distSq = ( point - p ).lengthSq(),
+                    .closestVert = mp.mesh.getClosestVertex( PointOnFace{ f, point } ),
+                    .closestFace = res.closestFace
+                };
+            };
+        },
+        []( const PointCloud * pc ) -> LimitedProjectorFunc
+        {
+            return [pc]( const Vector3f & p, ProjectionResult & res )
+            {
+                assert( res.closestVert );
+                res.point = pc->points[res.closestVert];
+                res.normal = res.closestVert < pc->normals.size() ? pc->normals[res.closestVert] : std::optional<Vector3f>{};
+                res.distSq = ( p - res.point ).lengthSq();
+            };
+        }
+    }, var_ );
+}
+
+auto MeshOrPoints::otherFeatureDistance() const -> OtherFeatureDistFunc
+{
+    return std::visit( overloaded{
+        []( const MeshPart & mp ) -> OtherFeatureDistFunc
+        {
+            return [&mp]( const Vector3f & p, const ProjectionResult & res, float upDistLimitSq )
+            {
+                return findProjection( p, mp, upDistLimitSq, nullptr, 0, [f = res.closestFace] ( FaceId x ) { return x != f; } ).distSq;
+            };
+        },
+        []( const PointCloud * pc ) -> OtherFeatureDistFunc
+        {
+            return [pc]( const Vector3f & p, const ProjectionResult & res, float upDistLimitSq )
+            {
+                return findProjectionOnPoints( p, *pc, upDistLimitSq, nullptr, 0, [v = res.closestVert] ( VertId x ) { return x == v; } ).distSq;
+            };
+        }
+    }, var_ );
+}
+
 std::optional<MeshOrPoints> getMeshOrPoints( const VisualObject * obj )
 {
     if ( auto objMesh = dynamic_cast<const ObjectMesh*>( obj ) )
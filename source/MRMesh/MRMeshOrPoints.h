@@ -78,6 +78,9 @@ public:
         /// for point clouds it is the closest vertex,
         /// for meshes it is the closest vertex of the triangle with the closest point
         VertId closestVert;
+
+        /// for meshes it is the triangle with the closest point, invalid for point clouds
+        FaceId closestFace;
     };
 
     /// returns a function that finds projection (closest) points on this: Vector3f->ProjectionResult
@@ -88,6 +91,16 @@ public:
     /// the update takes place only if res.distSq on input is more than squared distance to the closest point
     [[nodiscard]] MRMESH_API LimitedProjectorFunc limitedProjector() const;
 
+    /// returns a function that updates projection of a point without searching for other closest features,
+    /// assuming that the closest feature is the same as in res on input (the vertex res.closestVert for point clouds or the triangle res.closestFace for meshes)
+    [[nodiscard]] MRMESH_API LimitedProjectorFunc featureProjector() const;
+
+    using OtherFeatureDistFunc = std::function<float( const Vector3f& p, const ProjectionResult& res, float upDistLimitSq )>;
+    /// returns a function that computes squared distance from a point to this object ignoring the closest feature in res
+    /// (the vertex res.closestVert for point clouds or the triangle res.closestFace for meshes), or upDistLimitSq if no other feature is closer;
+    /// while the point moves less than half of the difference between this distance and res.distSq's root, its closest feature remains the same
+    [[nodiscard]] MRMESH_API OtherFeatureDistFunc otherFeatureDistance() const;
+
 private:
     std::variant<MeshPart, const PointCloud*> var_;
 };
@@ -1,5 +1,7 @@
 #include "MRMeshRelax.hpp"
 #include "MRMesh.h"
+#include "MRMeshAdjacency.h"
+#include "MRMeshNormals.h"
 #include "MRBestFit.h"
 #include "MREdgePaths.h"
 #include "MRBestFitQuadric.h"
@@ -10,6 +12,9 @@
 #include "MRLineSegm.h"
 #include "MRGeodesicPath.h"
 #include "MRSymMatrix2.h"
+#include "MRMakeSphereMesh.h"
+#include "MRGTest.h"
+#include "MRPch/MRTBB.h"
 
 namespace MR
 {
@@ -21,10 +26,185 @@ namespace MR
     relax( topology, field );
 }
 
+RelaxAdjacency makeRelaxAdjacency( const MeshTopology & topology, const VertBitSet & zone, bool colored, const MeshAdjacency * snapshot )
+{
+    MR_TIMER
+    RelaxAdjacency res;
+    for ( auto v : zone )
+        if ( topology.edgeWithOrg( v ) )
+            res.verts.push_back( v );
+    const int n = int( res.verts.size() );
+
+    res.offsets.resize( n + 1 );
+    res.offsets[0] = 0;
+    ParallelFor( 0, n, [&]( int i )
+    {
+        int count = 0;
+        if ( snapshot )
+            count = int( snapshot->neighbors( res.verts[i] ).size() );
+        else
+            for ( [[maybe_unused]] auto e : orgRing( topology, res.verts[i] ) )
+                ++count;
+        res.offsets[i + 1] = count;
+    } );
+    for ( int i = 0; i < n; ++i )
+        res.offsets[i + 1] += res.offsets[i];
+    res.neis.resize( res.offsets[n] );
+    ParallelFor( 0, n, [&]( int i )
+    {
+        int j = res.offsets[i];
+        if ( snapshot )
+        {
+            const auto neis = snapshot->neighbors( res.verts[i] );
+            std::copy( neis.begin(), neis.end(), res.neis.begin() + j );
+        }
+        else
+            for ( auto e : orgRing( topology, res.verts[i] ) )
+                res.neis[j++] = topology.dest( e );
+    } );
+
+    if ( !colored )
+    {
+        res.colorStarts = { 0, n };
+        return res;
+    }
+
+    // Jones-Plassmann coloring: each vertex takes the smallest color missing in its neighbors with higher priority
+    // as soon as all of them are colored; the vertices becoming ready simultaneously are not neighbors, so they are colored in parallel
+    Vector<int, VertId> vert2idx( zone.size(), -1 );
+    ParallelFor( 0, n, [&]( int i )
+    {
+        vert2idx[res.verts[i]] = i;
+    } );
+    // neighbors as indices in res.verts, -1 for the vertices outside of zone
+    std::vector<int> neiIdx( res.neis.size() );
+    ParallelFor( 0, n, [&]( int i )
+    {
+        for ( int j = res.offsets[i]; j < res.offsets[i + 1]; ++j )
+            neiIdx[j] = res.neis[j] < vert2idx.endId() ? vert2idx[res.neis[j]] : -1;
+    } );
+    vert2idx = {};
+    std::vector<std::uint32_t> hash( n );
+    ParallelFor( 0, n, [&]( int i )
+    {
+        // mix the bits to avoid long chains of decreasing priority along regular mesh structures
+        auto h = std::uint32_t( res.verts[i] );
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        hash[i] = h;
+    } );
+    auto higherPriority = [&]( int a, int b )
+    {
+        return hash[a] > hash[b] || ( hash[a] == hash[b] && a > b );
+    };
+    std::vector<int> color( n, -1 );
+    std::vector<std::atomic<int>> waitCount( n );
+    ParallelFor( 0, n, [&]( int i )
+    {
+        int count = 0;
+        for ( int j = res.offsets[i]; j < res.offsets[i + 1]; ++j )
+            if ( auto d = neiIdx[j]; d >= 0 && higherPriority( d, i ) )
+                ++count;
+        waitCount[i].store( count, std::memory_order_relaxed );
+    } );
+    std::vector<int> ready;
+    for ( int i = 0; i < n; ++i )
+        if ( waitCount[i].load( std::memory_order_relaxed ) == 0 )
+            ready.push_back( i );
+    tbb::enumerable_thread_specific<std::vector<int>> nextReady;
+    while ( !ready.empty() )
+    {
+        ParallelFor( ready, [&]( size_t k )
+        {
+            const auto i = ready[k];
+            // only the neighbors with higher priority are colored at this moment
+            std::uint64_t usedMask = 0;
+            for ( int j = res.offsets[i]; j < res.offsets[i + 1]; ++j )
+                if ( auto d = neiIdx[j]; d >= 0 && higherPriority( d, i ) && color[d] < 64 )
+                    usedMask |= std::uint64_t( 1 ) << color[d];
+            int c = 0;
+            while ( c < 64 && ( usedMask & ( std::uint64_t( 1 ) << c ) ) )
+                ++c;
+            for ( ; c >= 64; ++c )
+            {
+                // very rare case of vertex with huge degree
+                bool used = false;
+                for ( int j = res.offsets[i]; !used && j < res.offsets[i + 1]; ++j )
+                    if ( auto d = neiIdx[j]; d >= 0 && higherPriority( d, i ) )
+                        used = color[d] == c;
+                if ( !used )
+                    break;
+            }
+            color[i] = c;
+            for ( int j = res.offsets[i]; j < res.offsets[i + 1]; ++j )
+                if ( auto d = neiIdx[j]; d >= 0 && higherPriority( i, d ) && waitCount[d].fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+                    nextReady.local().push_back( d );
+        } );
+        ready.clear();
+        for ( auto & r : nextReady )
+        {
+            ready.insert( ready.end(), r.begin(), r.end() );
+            r.clear();
+        }
+    }
+
+    // stable counting sort of the vertices with their neighbors by color
+    int numColors = 0;
+    for ( auto c : color )
+        numColors = std::max( numColors, c + 1 );
+    res.colorStarts.assign( numColors + 1, 0 );
+    for ( auto c : color )
+        ++res.colorStarts[c + 1];
+    for ( int c = 0; c < numColors; ++c )
+        res.colorStarts[c + 1] += res.colorStarts[c];
+    std::vector<int> order( n );
+    {
+        auto pos = res.colorStarts;
+        for ( int i = 0; i < n; ++i )
+            order[pos[color[i]]++] = i;
+    }
+    RelaxAdjacency sorted;
+    sorted.colorStarts = std::move( res.colorStarts );
+    sorted.verts.resize( n );
+    sorted.offsets.resize( n + 1 );
+    sorted.offsets[0] = 0;
+    for ( int k = 0; k < n; ++k )
+    {
+        const auto i = order[k];
+        sorted.verts[k] = res.verts[i];
+        sorted.offsets[k + 1] = sorted.offsets[k] + res.offsets[i + 1] - res.offsets[i];
+    }
+    sorted.neis.resize( res.neis.size() );
+    ParallelFor( 0, n, [&]( int k )
+    {
+        const auto i = order[k];
+        std::copy( res.neis.begin() + res.offsets[i], res.neis.begin() + res.offsets[i + 1], sorted.neis.begin() + sorted.offsets[k] );
+    } );
+    return sorted;
+}
+
+/// returns the connectivity snapshot to build relaxation adjacency from: the one cached in the mesh if it is up to date,
+/// or a new one if the whole mesh is relaxed in several iterations (it remains cached for next relaxations and normal computations),
+/// otherwise nullptr, since building the snapshot of the whole mesh costs more than walking the rings of a region
+static const MeshAdjacency * getRelaxSnapshot( const Mesh & mesh, const MeshRelaxParams & params )
+{
+    if ( auto res = mesh.getAdjacencyNotCreate() )
+        return res->fits( mesh.topology ) ? res : nullptr;
+    if ( !params.region && params.iterations > 1 )
+        return &mesh.getAdjacency();
+    return nullptr;
+}
+
 bool relax( Mesh& mesh, const MeshRelaxParams& params, ProgressCallback cb )
 {
-    MR_WRITER( mesh );
-    return relax( mesh.topology, mesh.points, params, cb );
+    if ( params.iterations <= 0 )
+        return true;
+    const auto * snapshot = getRelaxSnapshot( mesh, params );
+    MR_POINTS_WRITER( mesh );
+    return relax( mesh.topology, mesh.points, params, cb, snapshot );
 }
 
 Vector3f vertexPosEqualNeiAreas( const Mesh& mesh, VertId v, bool noShrinkage )
@@ -94,26 +274,50 @@ bool equalizeTriAreas( Mesh& mesh, const MeshEqualizeTriAreasParams& params, Pro
 
     MR_TIMER
     VertLimiter limiter( mesh.points, params );
-    MR_WRITER( mesh );
+    MR_POINTS_WRITER( mesh );
 
-    VertCoords newPoints;
     const VertBitSet& zone = mesh.topology.getVertIds( params.region );
-    for ( int i = 0; i < params.iterations; ++i )
+    if ( params.gaussSeidel )
     {
-        auto internalCb = subprogress( cb, [&]( float p ) { return ( float( i ) + p ) / float( params.iterations ); } );
-        newPoints = mesh.points;
-        if ( !BitSetParallelFor( zone, [&]( VertId v )
+        const auto adj = makeRelaxAdjacency( mesh.topology, zone, true, getRelaxSnapshot( mesh, params ) );
+        const int numColors = int( adj.colorStarts.size() ) - 1;
+        for ( int i = 0; i < params.iterations; ++i )
         {
-            auto e0 = mesh.topology.edgeWithOrg( v );
-            if ( !e0.valid() )
-                return;
-            auto np = newPoints[v];
-            auto pushForce = params.force * ( vertexPosEqualNeiAreas( mesh, v, params.noShrinkage ) - np );
-            np += pushForce;
-            newPoints[v] = limiter( v, np );
-        }, internalCb ) )
-            return false;
-        mesh.points.swap( newPoints );
+            for ( int c = 0; c < numColors; ++c )
+            {
+                auto internalCb = subprogress( cb, [&]( float p ) { return ( float( i ) + ( c + p ) / numColors ) / float( params.iterations ); } );
+                // the vertices of one color are not neighbors, so they can be moved in place simultaneously
+                if ( !ParallelFor( adj.colorStarts[c], adj.colorStarts[c + 1], [&]( int k )
+                {
+                    const auto v = adj.verts[k];
+                    auto np = mesh.points[v];
+                    np += params.force * ( vertexPosEqualNeiAreas( mesh, v, params.noShrinkage ) - np );
+                    mesh.points[v] = limiter( v, np );
+                }, internalCb ) )
+                    return false;
+            }
+        }
+    }
+    else
+    {
+        VertCoords newPoints;
+        for ( int i = 0; i < params.iterations; ++i )
+        {
+            auto internalCb = subprogress( cb, [&]( float p ) { return ( float( i ) + p ) / float( params.iterations ); } );
+            newPoints = mesh.points;
+            if ( !BitSetParallelFor( zone, [&]( VertId v )
+            {
+                auto e0 = mesh.topology.edgeWithOrg( v );
+                if ( !e0.valid() )
+                    return;
+                auto np = newPoints[v];
+                auto pushForce = params.force * ( vertexPosEqualNeiAreas( mesh, v, params.noShrinkage ) - np );
+                np += pushForce;
+                newPoints[v] = limiter( v, np );
+            }, internalCb ) )
+                return false;
+            mesh.points.swap( newPoints );
+        }
     }
     if ( params.hardSmoothTetrahedrons )
         hardSmoothTetrahedrons( mesh, params.region );
@@ -128,42 +332,66 @@ bool relaxKeepVolume( Mesh& mesh, const MeshRelaxParams& params, ProgressCallbac
 
     MR_TIMER
     VertLimiter limiter( mesh.points, params );
-    MR_WRITER( mesh );
-
-    VertCoords newPoints;
+    MR_POINTS_WRITER( mesh );
 
     const VertBitSet& zone = mesh.topology.getVertIds( params.region );
-    std::vector<Vector3f> vertPushForces( zone.size() );
+    // the neighbors are copied in the adjacency only if they are visited in several iterations
+    const bool useAdj = params.iterations > 1;
+    RelaxAdjacency adj;
+    if ( useAdj )
+        adj = makeRelaxAdjacency( mesh.topology, zone, false, getRelaxSnapshot( mesh, params ) );
+    else
+        for ( auto v : zone )
+            if ( mesh.topology.edgeWithOrg( v ) )
+                adj.verts.push_back( v );
+    const int n = int( adj.verts.size() );
+    // calls given function for each neighbor of adj.verts[k], returns the number of neighbors
+    auto forEachNei = [&]( int k, auto && f )
+    {
+        if ( useAdj )
+        {
+            for ( int j = adj.offsets[k]; j < adj.offsets[k + 1]; ++j )
+                f( adj.neis[j] );
+            return adj.offsets[k + 1] - adj.offsets[k];
+        }
+        int count = 0;
+        for ( auto e : orgRing( mesh.topology, adj.verts[k] ) )
+        {
+            f( mesh.topology.dest( e ) );
+            ++count;
+        }
+        return count;
+    };
+
+    // the values outside adj.verts are the same in both buffers, so copy them only once
+    VertCoords newPoints = mesh.points;
+    Vector<Vector3f, VertId> vertPushForces( zone.size() );
     for ( int i = 0; i < params.iterations; ++i )
     {
         auto internalCb1 = subprogress( cb, [&]( float p ) { return ( float( i ) + p * 0.5f ) / float( params.iterations ); } );
         auto internalCb2 = subprogress( cb, [&]( float p ) { return ( float( i ) + p * 0.5f + 0.5f ) / float( params.iterations ); } );
-        newPoints = mesh.points;
-        if ( !BitSetParallelFor( zone, [&]( VertId v )
+        if ( !ParallelFor( 0, n, [&]( int k )
         {
+            const auto v = adj.verts[k];
             Vector3d sum;
-            int count = 0;
-            for ( auto e : orgRing( mesh.topology, v ) )
+            const auto count = forEachNei( k, [&]( VertId d )
             {
-                sum += Vector3d( mesh.points[mesh.topology.dest( e )] );
-                ++count;
-            }
+                sum += Vector3d( mesh.points[d] );
+            } );
             vertPushForces[v] = params.force * ( Vector3f{sum / double( count )} - mesh.points[v] );
         }, internalCb1 ) )
             return false;
 
-        if ( !BitSetParallelFor( zone, [&]( VertId v )
+        if ( !ParallelFor( 0, n, [&]( int k )
         {
+            const auto v = adj.verts[k];
             Vector3d sum;
-            int count = 0;
-            for ( auto e : orgRing( mesh.topology, v ) )
+            const auto count = forEachNei( k, [&]( VertId d )
             {
-                auto d = mesh.topology.dest( e );
                 if ( zone.test( d ) )
                     sum += Vector3d( vertPushForces[d] );
-                ++count;
-            }
-            auto np = newPoints[v] + vertPushForces[v] - Vector3f{ sum / double( count ) };
+            } );
+            auto np = mesh.points[v] + vertPushForces[v] - Vector3f{ sum / double( count ) };
             newPoints[v] = limiter( v, np );
         }, internalCb2 ) )
             return false;
@@ -404,4 +632,154 @@ void hardSmoothTetrahedrons( Mesh & mesh, const VertBitSet *region )
     return hardSmoothTetrahedrons( mesh.topology, mesh.points, region );
 }
 
+TEST( MRMesh, RelaxGaussSeidel )
+{
+    auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 5000 } );
+    for ( auto v : sphere.topology.getValidVerts() )
+        sphere.points[v] *= 1 + 0.05f * ( ( int( v ) * 7919 ) % 11 - 5 ) / 5.0f;
+    // sum of distances from vertices to the centers of their neighbors
+    auto roughness = [&]( const Mesh & mesh )
+    {
+        double res = 0;
+        for ( auto v : mesh.topology.getValidVerts() )
+        {
+            Vector3f sum;
+            int count = 0;
+            for ( auto e : orgRing( mesh.topology, v ) )
+            {
+                sum += mesh.destPnt( e );
+                ++count;
+            }
+            res += ( mesh.points[v] - sum / float( count ) ).length();
+        }
+        return res;
+    };
+
+    const auto adj = makeRelaxAdjacency( sphere.topology, sphere.topology.getValidVerts(), true );
+    EXPECT_EQ( adj.verts.size(), sphere.topology.numValidVerts() );
+    for ( int c = 0; c + 1 < adj.colorStarts.size(); ++c )
+    {
+        VertBitSet colorVerts( sphere.topology.vertSize() );
+        for ( int k = adj.colorStarts[c]; k < adj.colorStarts[c + 1]; ++k )
+            colorVerts.set( adj.verts[k] );
+        for ( int k = adj.colorStarts[c]; k < adj.colorStarts[c + 1]; ++k )
+            for ( int j = adj.offsets[k]; j < adj.offsets[k + 1]; ++j )
+                EXPECT_FALSE( colorVerts.test( adj.neis[j] ) );
+    }
+
+    // Jacobi iteration moves each vertex toward the center of its neighbors at their previous positions
+    auto jacobi = sphere;
+    relax( jacobi );
+    for ( auto v : sphere.topology.getValidVerts() )
+    {
+        Vector3f sum;
+        int count = 0;
+        for ( auto e : orgRing( sphere.topology, v ) )
+        {
+            sum += sphere.destPnt( e );
+            ++count;
+        }
+        EXPECT_LT( ( jacobi.points[v] - ( 0.5f * sphere.points[v] + 0.5f * sum / float( count ) ) ).length(), 1e-6f );
+    }
+
+    // Gauss-Seidel iterations converge faster to the smooth surface inside the region with fixed boundary
+    VertBitSet region( sphere.topology.vertSize() );
+    for ( auto v : sphere.topology.getValidVerts() )
+        if ( sphere.points[v].z < 0.5f )
+            region.set( v );
+    MeshRelaxParams params;
+    params.region = &region;
+    params.iterations = 20;
+    jacobi = sphere;
+    relax( jacobi, params );
+    auto gaussSeidel = sphere;
+    params.gaussSeidel = true;
+    relax( gaussSeidel, params );
+    EXPECT_LT( roughness( gaussSeidel ), roughness( jacobi ) );
+    EXPECT_LT( roughness( jacobi ), roughness( sphere ) );
+
+    MeshEqualizeTriAreasParams eqParams;
+    eqParams.gaussSeidel = true;
+    eqParams.iterations = 3;
+    EXPECT_TRUE( equalizeTriAreas( gaussSeidel, eqParams ) );
+}
+
+TEST( MRMesh, RelaxSingleIteration )
+{
+    auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 2000 } );
+    for ( auto v : sphere.topology.getValidVerts() )
+        sphere.points[v] *= 1 + 0.05f * ( ( int( v ) * 7919 ) % 11 - 5 ) / 5.0f;
+    VertBitSet region( sphere.topology.vertSize() );
+    for ( auto v : sphere.topology.getValidVerts() )
+        if ( sphere.points[v].z < 0.5f )
+            region.set( v );
+
+    // two single iterations (walking the rings) give the same result as two iterations at once (with the adjacency)
+    MeshRelaxParams params;
+    params.region = &region;
+    auto once = sphere;
+    relax( once, params );
+    relax( once, params );
+    params.iterations = 2;
+    auto twice = sphere;
+    relax( twice, params );
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_LT( ( once.points[v] - twice.points[v] ).length(), 1e-6f );
+
+    params.iterations = 1;
+    once = sphere;
+    relaxKeepVolume( once, params );
+    relaxKeepVolume( once, params );
+    params.iterations = 2;
+    twice = sphere;
+    relaxKeepVolume( twice, params );
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_LT( ( once.points[v] - twice.points[v] ).length(), 1e-6f );
+
+    // relaxation does not build the connectivity snapshot of the whole mesh
+    EXPECT_EQ( once.getAdjacencyNotCreate(), nullptr );
+    EXPECT_EQ( twice.getAdjacencyNotCreate(), nullptr );
+}
+
+TEST( MRMesh, RelaxWholeMeshAdjacency )
+{
+    auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 2000 } );
+    for ( auto v : sphere.topology.getValidVerts() )
+        sphere.points[v] *= 1 + 0.05f * ( ( int( v ) * 7919 ) % 11 - 5 ) / 5.0f;
+
+    // several iterations over the whole mesh build the connectivity snapshot and keep it in the mesh
+    MeshRelaxParams params;
+    params.iterations = 2;
+    auto whole = sphere;
+    relax( whole, params );
+    ASSERT_NE( whole.getAdjacencyNotCreate(), nullptr );
+    relaxKeepVolume( whole, params );
+
+    // the same relaxation of the region with all vertices walks the rings
+    const auto allVerts = sphere.topology.getValidVerts();
+    params.region = &allVerts;
+    auto rings = sphere;
+    relax( rings, params );
+    relaxKeepVolume( rings, params );
+    EXPECT_EQ( rings.getAdjacencyNotCreate(), nullptr );
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_LT( ( whole.points[v] - rings.points[v] ).length(), 1e-6f );
+
+    // the normals are computed from the snapshot surviving relaxation
+    const auto wholeNormals = computePerVertNormals( whole );
+    const auto ringNormals = computePerVertNormals( rings );
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_LT( ( wholeNormals[v] - ringNormals[v] ).length(), 1e-5f );
+
+    // and not used if the topology is changed without invalidation of caches
+    const auto e = whole.topology.edgeWithOrg( 0_v );
+    const auto midPos = 0.5f * ( whole.orgPnt( e ) + whole.destPnt( e ) );
+    whole.topology.splitEdge( e );
+    whole.points.autoResizeSet( whole.topology.org( e ), midPos );
+    ASSERT_NE( whole.getAdjacencyNotCreate(), nullptr );
+    const auto splitNormals = computePerVertNormals( whole );
+    for ( auto v : whole.topology.getValidVerts() )
+        EXPECT_LT( ( splitNormals[v] - whole.normal( v ) ).length(), 1e-5f );
+}
+
 } //namespace MR
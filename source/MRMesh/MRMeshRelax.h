@@ -17,6 +17,12 @@ struct MeshRelaxParams : RelaxParams
 
     /// weight for each vertex. By default, all the vertices have equal weights.
     const VertScalars *weights = nullptr;
+
+    /// if true then the vertices are colored so that neighbor vertices get distinct colors,
+    /// and the vertices of each color are moved in place in parallel (colored Gauss-Seidel instead of Jacobi iterations):
+    /// each vertex sees already moved neighbors of previous colors, which typically converges faster per iteration;
+    /// ignored in relaxKeepVolume with its two passes per iteration and in relaxApprox where the neighborhoods are wider than one ring
+    bool gaussSeidel = false;
 };
 
 /// applies given number of relaxation iterations to the whole mesh ( or some region if it is specified )
@@ -1,10 +1,12 @@
 #pragma once
 
 #include "MRMeshRelax.h"
+#include "MRMeshAdjacency.h"
 #include "MRMeshTopology.h"
 #include "MRRingIterator.h"
 #include "MRBitSet.h"
 #include "MRBitSetParallelFor.h"
+#include "MRParallelFor.h"
 #include "MRMeshFixer.h"
 #include "MRTimer.h"
 
@@ -27,6 +29,28 @@ void hardSmoothTetrahedrons( const MeshTopology & topology, Vector<T, VertId> &
     } );
 }
 
+/// compact snapshot of the neighbors of relaxed vertices,
+/// which is much faster to iterate over many times than the rings of MeshTopology
+struct RelaxAdjacency
+{
+    /// relaxed vertices having at least one neighbor, grouped by colors if the coloring was requested
+    std::vector<VertId> verts;
+
+    /// the neighbors of verts[i] are neis[offsets[i]], ..., neis[offsets[i+1]-1]
+    std::vector<int> offsets;
+    std::vector<VertId> neis;
+
+    /// the vertices of color #c are verts[colorStarts[c]], ..., verts[colorStarts[c+1]-1], and no two of them are neighbors;
+    /// without coloring all vertices are considered of one color
+    std::vector<int> colorStarts;
+};
+
+/// builds the adjacency of given vertices in parallel;
+/// \param colored if true then the vertices are additionally colored in parallel so that neighbors get distinct colors
+/// \param snapshot optional connectivity snapshot of the topology to copy the neighbors from instead of walking the rings
+[[nodiscard]] MRMESH_API RelaxAdjacency makeRelaxAdjacency( const MeshTopology & topology, const VertBitSet & zone, bool colored,
+    const MeshAdjacency * snapshot = nullptr );
+
 /// This class is responsible for limiting vertex movement during relaxation according to parameters
 template<typename T>
 class VertLimiter
@@ -55,9 +79,11 @@ private:
 };
 
 /// applies given number of relaxation iterations to given field on mesh vertices;
+/// \param snapshot optional connectivity snapshot of the topology (e.g. Mesh::getAdjacencyNotCreate())
 /// \return true if was finished successfully, false if was interrupted by progress callback
 template<typename T>
-bool relax( const MeshTopology & topology, Vector<T, VertId> & field, const MeshRelaxParams& params = {}, ProgressCallback cb = {} )
+bool relax( const MeshTopology & topology, Vector<T, VertId> & field, const MeshRelaxParams& params = {}, ProgressCallback cb = {},
+    const MeshAdjacency * snapshot = nullptr )
 {
     if ( params.iterations <= 0 )
         return true;
@@ -74,31 +100,90 @@ bool relax( const MeshTopology & topology, Vector<T, VertId> & field, const Mesh
 
     VertLimiter limiter( field, params );
 
-    Vector<T, VertId> newField;
     const VertBitSet& zone = topology.getVertIds( params.region );
-    for ( int i = 0; i < params.iterations; ++i )
+    // the adjacency pays off only if the neighbors are visited many times or the coloring is necessary
+    const bool useAdj = params.gaussSeidel || params.iterations > 1;
+    const auto adj = useAdj ? makeRelaxAdjacency( topology, zone, params.gaussSeidel, snapshot ) : RelaxAdjacency{};
+
+    // relaxed value in vertex v given the values in its neighbors, which are passed by forEachNei in given function
+    auto relaxedValue = [&]( const Vector<T, VertId> & src, VertId v, auto && forEachNei )
     {
-        auto internalCb = subprogress( cb, [&]( float p ) { return ( float( i ) + p ) / float( params.iterations ); } );
-        newField = field;
-        if ( !BitSetParallelFor( zone, [&]( VertId v )
+        T sum{};
+        float sumWeight = 0.f;
+        forEachNei( [&]( VertId dst )
         {
-            auto e0 = topology.edgeWithOrg( v );
-            if ( !e0.valid() )
-                return;
-            T sum{};
-            float sumWeight = 0.f;
-            for ( auto e : orgRing( topology, e0 ) )
+            const auto w = getWeightOrDefault( dst );
+            sum += w * src[dst];
+            sumWeight += w;
+        } );
+        auto np = src[v];
+        auto pushForce = params.force * ( sum / sumWeight - np );
+        np += pushForce;
+        return limiter( v, np );
+    };
+    // relaxed value in adj.verts[i]
+    auto relaxedAdjValue = [&]( const Vector<T, VertId> & src, int i )
+    {
+        return relaxedValue( src, adj.verts[i], [&]( auto && f )
+        {
+            for ( int j = adj.offsets[i]; j < adj.offsets[i + 1]; ++j )
+                f( adj.neis[j] );
+        } );
+    };
+
+    if ( params.gaussSeidel )
+    {
+        const int numColors = int( adj.colorStarts.size() ) - 1;
+        for ( int i = 0; i < params.iterations; ++i )
+        {
+            for ( int c = 0; c < numColors; ++c )
             {
-                const auto dst = topology.dest( e );
-                const auto w = getWeightOrDefault( dst );
-                sum += w * field[dst];
-                sumWeight += w;
+                auto internalCb = subprogress( cb, [&]( float p ) { return ( float( i ) + ( c + p ) / numColors ) / float( params.iterations ); } );
+                // the vertices of one color are not neighbors, so they can be moved in place simultaneously
+                if ( !ParallelFor( adj.colorStarts[c], adj.colorStarts[c + 1], [&]( int k )
+                {
+                    field[adj.verts[k]] = relaxedAdjValue( field, k );
+                }, internalCb ) )
+                    return false;
             }
-            auto np = newField[v];
-            auto pushForce = params.force * ( sum / sumWeight - np );
-            np += pushForce;
-            newField[v] = limiter( v, np );
-        }, internalCb ) )
+        }
+    }
+    else if ( useAdj )
+    {
+        // the values outside adj.verts are the same in both buffers, so copy them only once
+        Vector<T, VertId> newField = field;
+        for ( int i = 0; i < params.iterations; ++i )
+        {
+            auto internalCb = subprogress( cb, [&]( float p ) { return ( float( i ) + p ) / float( params.iterations ); } );
+            if ( !ParallelFor( 0, int( adj.verts.size() ), [&]( int k )
+            {
+                newField[adj.verts[k]] = relaxedAdjValue( field, k );
+            }, internalCb ) )
+                return false;
+            field.swap( newField );
+        }
+    }
+    else
+    {
+        // single iteration takes the neighbors directly from the snapshot or from the rings of the topology
+        Vector<T, VertId> newField = field;
+        if ( !BitSetParallelFor( zone, [&]( VertId v )
+        {
+            if ( !topology.edgeWithOrg( v ) )
+                return;
+            if ( snapshot )
+                newField[v] = relaxedValue( field, v, [&]( auto && f )
+                {
+                    for ( auto d : snapshot->neighbors( v ) )
+                        f( d );
+                } );
+            else
+                newField[v] = relaxedValue( field, v, [&]( auto && f )
+                {
+                    for ( auto e : orgRing( topology, v ) )
+                        f( topology.dest( e ) );
+                } );
+        }, cb ) )
             return false;
         field.swap( newField );
     }
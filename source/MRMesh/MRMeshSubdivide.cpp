@@ -12,6 +12,11 @@
 #include "MRRegionBoundary.h"
 #include "MRBitSetParallelFor.h"
 #include "MRParallelFor.h"
+#include "MRAABBTree.h"
+#include "MRExpected.h"
+#include "MRMakeSphereMesh.h"
+#include "MRPch/MRSpdlog.h"
+#include "MRPch/MRTBB.h"
 #include <queue>
 
 namespace MR
@@ -31,13 +36,15 @@ inline bool operator < ( const EdgeLength & a, const EdgeLength & b )
     return std::tie( a.lenSq, a.edge ) < std::tie( b.lenSq, b.edge );
 }
 
-int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
+/// splits the edges in the order of their lengths starting from the longest one till the limits of the settings are reached,
+/// without repositioning of new vertices;
+/// \param innerNewVerts if given, receives new vertices appeared inside the edges with triangles on both sides
+/// \param lockedVerts if given, the edges incident to these vertices are not split
+static Expected<int> subdivideMeshSeq( Mesh & mesh, const SubdivideSettings & settings, VertBitSet * innerNewVerts,
+    const VertBitSet * lockedVerts = nullptr )
 {
     MR_TIMER
     const float maxEdgeLenSq = sqr( settings.maxEdgeLen );
-    Mesh original;
-    if ( settings.projectOnOriginalMesh )
-        original = mesh;
 
     // region is changed during subdivision,
     // so if it has invalid faces (they can become valid later) some collisions can occur
@@ -71,6 +78,8 @@ int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
         if ( settings.subdivideBorder ? !mesh.topology.isInnerOrBdEdge( e, settings.region )
                                       : !mesh.topology.isInnerEdge( e, settings.region ) )
             return x;
+        if ( lockedVerts && ( lockedVerts->test( mesh.topology.org( e ) ) || lockedVerts->test( mesh.topology.dest( e ) ) ) )
+            return x;
         const float lenSq = mesh.edgeLengthSq( e );
         if ( lenSq < maxEdgeLenSq )
             return x;
@@ -99,15 +108,13 @@ int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
     std::priority_queue<EdgeLength> queue( std::less<EdgeLength>(), std::move( evec.vec_ ) );
 
     if ( settings.progressCallback && !settings.progressCallback( 0.25f ) )
-        return 0;
+        return unexpectedOperationCanceled();
 
     MR_WRITER( mesh );
 
     int splitsDone = 0;
     int lastProgressSplitsDone = 0;
-    VertBitSet newVerts;
-    ProgressCallback notSmoothProgress = subprogress( settings.progressCallback, 0.25f, settings.smoothMode ? 0.75f : 1.0f );
-    ProgressCallback whileProgress  =  subprogress( notSmoothProgress, 0.0f, settings.projectOnOriginalMesh ? 0.75f : 1.0f );
+    ProgressCallback whileProgress = subprogress( settings.progressCallback, 0.25f, 1.0f );
     while ( splitsDone < settings.maxEdgeSplits && !queue.empty() )
     {
         if ( settings.maxTriAspectRatio >= 1 && numAboveMax <= 0 )
@@ -115,7 +122,7 @@ int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
         if ( settings.progressCallback && splitsDone >= 1000 + lastProgressSplitsDone ) 
         {
             if ( !whileProgress( float( splitsDone ) / settings.maxEdgeSplits ) )
-                return 0;
+                return unexpectedOperationCanceled();
             lastProgressSplitsDone = splitsDone;
         }
 
@@ -129,12 +136,12 @@ int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
         if ( settings.beforeEdgeSplit && !settings.beforeEdgeSplit( e ) )
             continue;
 
-        const auto e1 = mesh.splitEdge( e, mesh.edgeCenter( e ), settings.region );
+        const auto e1 = mesh.splitEdge( e, mesh.edgeCenter( e ), settings.region, settings.new2Old );
         const auto newVertId = mesh.topology.org( e );
 
-        // in smooth mode remember all new inner vertices to reposition them at the end
-        if ( ( settings.smoothMode || settings.projectOnOriginalMesh ) && mesh.topology.left( e ) && mesh.topology.right( e ) )
-            newVerts.autoResizeSet( newVertId );
+        // remember all new inner vertices to reposition them at the end
+        if ( innerNewVerts && mesh.topology.left( e ) && mesh.topology.right( e ) )
+            innerNewVerts->autoResizeSet( newVertId );
 
         if ( settings.newVerts )
             settings.newVerts->autoResizeSet( newVertId );
@@ -181,6 +188,291 @@ int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
                 queue.push( std::move( x ) );
     }
 
+    return splitsDone;
+}
+
+/// subdivides the parts of the mesh in parallel without touching the boundaries of the parts,
+/// then splits remaining long edges near the seams sequentially
+static Expected<int> subdivideMeshParallel( Mesh & mesh, const SubdivideSettings & settings, VertBitSet * innerNewVerts )
+{
+    MR_TIMER
+    if ( settings.region )
+        *settings.region &= mesh.topology.getValidFaces();
+    const auto & region = mesh.topology.getFaceIds( settings.region );
+    const auto numRegionFaces = region.count();
+    if ( numRegionFaces == 0 )
+        return 0;
+
+    MR_WRITER( mesh );
+    const auto & tree = mesh.getAABBTree();
+    const auto subroots = tree.getSubtrees( settings.subdivideParts );
+    const auto sz = subroots.size();
+
+    if ( settings.progressCallback && !settings.progressCallback( 0.05f ) )
+        return unexpectedOperationCanceled();
+
+    struct alignas(64) SubMesh
+    {
+        Mesh m;
+        VertMap subVertToOriginal; // only for the vertices existed before subdivision
+        FaceMap subFaceToOriginal; // only for the faces existed before subdivision
+        FaceHashMap new2Old; // new faces -> faces of the part existed before subdivision
+        FaceBitSet region;
+        UndirectedEdgeBitSet notFlippable;
+        int splitsDone = 0;
+    };
+    std::vector<SubMesh> submeshes( sz );
+
+    const auto mainThreadId = std::this_thread::get_id();
+    std::atomic<bool> cancelled{ false };
+    std::atomic<int> finishedSubmeshes{ 0 };
+    tbb::parallel_for( tbb::blocked_range<size_t>( 0, sz, 1 ),
+        [&]( const tbb::blocked_range<size_t>& range )
+    {
+        const bool reportProgressFromThisThread = settings.progressCallback && mainThreadId == std::this_thread::get_id();
+        for ( size_t i = range.begin(); i < range.end(); ++i )
+        {
+            auto reportThreadProgress = [&]( float p )
+            {
+                if ( cancelled.load( std::memory_order_relaxed ) )
+                    return false;
+                if ( reportProgressFromThisThread && !settings.progressCallback( 0.05f + 0.65f * ( finishedSubmeshes.load( std::memory_order_relaxed ) + p ) / sz ) )
+                {
+                    cancelled.store( true, std::memory_order_relaxed );
+                    return false;
+                }
+                return true;
+            };
+            if ( !reportThreadProgress( 0 ) )
+                break;
+            const auto faces = tree.getSubtreeLeaves( subroots[i] );
+            size_t numPartRegionFaces = 0;
+            for ( FaceId f : faces )
+                if ( region.test( f ) )
+                    ++numPartRegionFaces;
+            if ( numPartRegionFaces == 0 )
+            {
+                // the triangles of this part will be taken from the mesh unchanged
+                finishedSubmeshes.fetch_add( 1, std::memory_order_relaxed );
+                continue;
+            }
+
+            auto & submesh = submeshes[i];
+            WholeEdgeMap subEdgeToOriginal;
+            PartMapping map;
+            map.tgt2srcVerts = &submesh.subVertToOriginal;
+            map.tgt2srcFaces = &submesh.subFaceToOriginal;
+            if ( settings.notFlippable )
+                map.tgt2srcEdges = &subEdgeToOriginal;
+            submesh.m = mesh.cloneRegion( faces, false, map );
+
+            submesh.region.resize( submesh.m.topology.faceSize() );
+            for ( auto f : submesh.m.topology.getValidFaces() )
+                if ( region.test( submesh.subFaceToOriginal[f] ) )
+                    submesh.region.set( f );
+            if ( settings.notFlippable )
+            {
+                submesh.notFlippable.resize( subEdgeToOriginal.size() );
+                for ( auto ue : undirectedEdges( submesh.m.topology ) )
+                    if ( settings.notFlippable->test( subEdgeToOriginal[ue].undirected() ) )
+                        submesh.notFlippable.set( ue );
+            }
+
+            if ( !reportThreadProgress( 0.1f ) )
+                break;
+
+            auto subSettings = settings;
+            // the budget of splits is distributed among the parts proportionally to the number of their faces in the region
+            subSettings.maxEdgeSplits = int( std::int64_t( settings.maxEdgeSplits ) * numPartRegionFaces / numRegionFaces );
+            subSettings.region = &submesh.region;
+            subSettings.notFlippable = settings.notFlippable ? &submesh.notFlippable : nullptr;
+            subSettings.newVerts = nullptr;
+            subSettings.new2Old = settings.new2Old ? &submesh.new2Old : nullptr;
+            if ( reportProgressFromThisThread )
+                subSettings.progressCallback = [reportThreadProgress]( float p ) { return reportThreadProgress( 0.1f + 0.9f * p ); };
+            else if ( settings.progressCallback )
+                subSettings.progressCallback = [&cancelled]( float ) { return !cancelled.load( std::memory_order_relaxed ); };
+            // the edges on the boundary of the part are shared with other parts, and splitting only inner edges near them
+            // would produce thin triangles along long boundary edges, so the fans of all boundary vertices are left for seam pass
+            const auto partBdVerts = submesh.m.topology.findBoundaryVerts();
+            const auto res = subdivideMeshSeq( submesh.m, subSettings, nullptr, &partBdVerts );
+            if ( !res )
+            {
+                cancelled.store( true, std::memory_order_relaxed );
+                break;
+            }
+            submesh.splitsDone = *res;
+            finishedSubmeshes.fetch_add( 1, std::memory_order_relaxed );
+        }
+    } );
+
+    if ( cancelled.load( std::memory_order_relaxed ) || ( settings.progressCallback && !settings.progressCallback( 0.7f ) ) )
+        return unexpectedOperationCanceled();
+
+    // the ends of not-flippable edges, since all edges get new ids in recombined mesh
+    std::vector<std::pair<VertId, VertId>> notFlippableEnds;
+
+    // the sizes before recombination to roll it back if the mesh cannot be rebuilt from the parts
+    const auto oldPointsSize = mesh.points.size();
+    const auto oldFaceSize = mesh.topology.faceSize();
+    const auto oldRegionSize = settings.region ? settings.region->size() : 0;
+    const auto oldNewVertsSize = settings.newVerts ? settings.newVerts->size() : 0;
+    const auto oldInnerNewVertsSize = innerNewVerts ? innerNewVerts->size() : 0;
+
+    // recombine mesh from parts: old vertices and faces keep their ids, and new ones are appended
+    int splitsDone = 0;
+    Triangulation t = mesh.topology.getTriangulation();
+    FaceBitSet facesToAdd = mesh.topology.getValidFaces();
+    FaceBitSet subdividedFaces( mesh.topology.faceSize() ); // original faces of the parts given for subdivision
+    VertId nextVertId( mesh.topology.vertSize() );
+    for ( auto & submesh : submeshes )
+    {
+        if ( submesh.m.topology.numValidFaces() == 0 )
+            continue;
+        splitsDone += submesh.splitsDone;
+        const auto & subTopology = submesh.m.topology;
+
+        auto & vmap = submesh.subVertToOriginal;
+        const VertId firstNewVert( vmap.size() );
+        vmap.resize( subTopology.vertSize() );
+        for ( VertId v = firstNewVert; v < vmap.endId(); ++v )
+        {
+            if ( !subTopology.hasVert( v ) )
+                continue;
+            const auto fv = nextVertId++;
+            vmap[v] = fv;
+            mesh.points.autoResizeSet( fv, submesh.m.points[v] );
+            if ( settings.newVerts )
+                settings.newVerts->autoResizeSet( fv );
+            // the edges with boundary vertices of the part are not split, so all new vertices are inner
+            if ( innerNewVerts )
+                innerNewVerts->autoResizeSet( fv );
+        }
+
+        auto & fmap = submesh.subFaceToOriginal;
+        const FaceId firstNewFace( fmap.size() );
+        for ( FaceId f( 0 ); f < firstNewFace; ++f )
+            if ( fmap[f] )
+                subdividedFaces.set( fmap[f] );
+        fmap.resize( subTopology.faceSize() );
+        for ( auto f : subTopology.getValidFaces() )
+        {
+            if ( f >= firstNewFace )
+            {
+                fmap[f] = FaceId( t.size() );
+                t.emplace_back();
+                facesToAdd.autoResizeSet( fmap[f] );
+                if ( settings.region && submesh.region.test( f ) )
+                    settings.region->autoResizeSet( fmap[f] );
+                if ( settings.new2Old )
+                {
+                    auto origin = fmap[submesh.new2Old[f]];
+                    if ( auto it = settings.new2Old->find( origin ); it != settings.new2Old->end() )
+                        origin = it->second; // origin is new face of previous operation
+                    ( *settings.new2Old )[fmap[f]] = origin;
+                }
+            }
+            auto & tri = t[fmap[f]];
+            tri = subTopology.getTriVerts( f );
+            for ( auto & v : tri )
+                v = vmap[v];
+        }
+
+        for ( auto ue : submesh.notFlippable )
+            notFlippableEnds.emplace_back( vmap[subTopology.org( ue )], vmap[subTopology.dest( ue )] );
+    }
+
+    if ( settings.notFlippable )
+    {
+        // the edges of subdivided parts are taken from the parts above, since their ends might be connected by another edge now;
+        // the edge having a face outside of subdivided parts is not changed
+        for ( auto ue : *settings.notFlippable )
+        {
+            if ( ue >= mesh.topology.undirectedEdgeSize() )
+                break;
+            const auto l = mesh.topology.left( ue );
+            const auto r = mesh.topology.right( ue );
+            if ( ( l && !subdividedFaces.test( l ) ) || ( r && !subdividedFaces.test( r ) ) )
+                notFlippableEnds.emplace_back( mesh.topology.org( ue ), mesh.topology.dest( ue ) );
+        }
+    }
+
+    if ( settings.progressCallback && !settings.progressCallback( 0.75f ) )
+        return unexpectedOperationCanceled();
+
+    auto topology = MeshBuilder::fromTriangles( t, { .region = &facesToAdd } );
+    if ( facesToAdd.any() )
+    {
+        // some triangles were rejected by mesh builder (e.g. around a vertex with several separate fans of faces),
+        // so the results of the parts are discarded and the original mesh is subdivided sequentially
+        spdlog::warn( "subdivideMesh: {} faces cannot be recombined from parallel parts, falling back to sequential subdivision", facesToAdd.count() );
+        mesh.points.resize( oldPointsSize );
+        if ( settings.region )
+            settings.region->resize( oldRegionSize );
+        if ( settings.newVerts )
+            settings.newVerts->resize( oldNewVertsSize );
+        if ( innerNewVerts )
+            innerNewVerts->resize( oldInnerNewVertsSize );
+        if ( settings.new2Old )
+        {
+            for ( auto it = settings.new2Old->begin(); it != settings.new2Old->end(); )
+            {
+                if ( it->first >= oldFaceSize )
+                    settings.new2Old->erase( it++ );
+                else
+                    ++it;
+            }
+        }
+        auto seqSettings = settings;
+        seqSettings.progressCallback = subprogress( settings.progressCallback, 0.75f, 1.0f );
+        return subdivideMeshSeq( mesh, seqSettings, innerNewVerts );
+    }
+    mesh.topology = std::move( topology );
+    mesh.invalidateCaches();
+
+    if ( settings.notFlippable )
+    {
+        settings.notFlippable->clear();
+        settings.notFlippable->resize( mesh.topology.undirectedEdgeSize() );
+        for ( const auto & [a, b] : notFlippableEnds )
+            if ( auto e = mesh.topology.findEdge( a, b ) )
+                settings.notFlippable->set( e.undirected() );
+    }
+
+    if ( settings.progressCallback && !settings.progressCallback( 0.8f ) )
+        return unexpectedOperationCanceled();
+
+    // subdivide the edges on the boundaries of the parts and all others that were not subdivided for any reason
+    auto seamSettings = settings;
+    seamSettings.maxEdgeSplits = settings.maxEdgeSplits - splitsDone;
+    seamSettings.progressCallback = subprogress( settings.progressCallback, 0.8f, 1.0f );
+    const auto res = subdivideMeshSeq( mesh, seamSettings, innerNewVerts );
+    if ( !res )
+        return res;
+    return splitsDone + *res;
+}
+
+int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
+{
+    MR_TIMER
+    Mesh original;
+    if ( settings.projectOnOriginalMesh )
+        original = mesh;
+
+    // in smooth mode and with projection remember all new inner vertices to reposition them at the end
+    VertBitSet newVerts;
+    VertBitSet * innerNewVerts = ( settings.smoothMode || settings.projectOnOriginalMesh ) ? &newVerts : nullptr;
+
+    ProgressCallback notSmoothProgress = subprogress( settings.progressCallback, 0.0f, settings.smoothMode ? 0.75f : 1.0f );
+    auto splitSettings = settings;
+    splitSettings.progressCallback = subprogress( notSmoothProgress, 0.0f, settings.projectOnOriginalMesh ? 0.75f : 1.0f );
+    const bool parallel = settings.subdivideParts > 1 && !settings.onVertCreated && !settings.onEdgeSplit && !settings.beforeEdgeSplit;
+    const auto splitsDone = parallel ?
+        subdivideMeshParallel( mesh, splitSettings, innerNewVerts ) :
+        subdivideMeshSeq( mesh, splitSettings, innerNewVerts );
+    if ( !splitsDone )
+        return 0;
+
     if ( settings.projectOnOriginalMesh )
     {
         if ( !BitSetParallelFor( newVerts, [&]( VertId v )
@@ -208,7 +500,7 @@ int subdivideMesh( Mesh & mesh, const SubdivideSettings & settings )
             positionVertsSmoothly( mesh, newVerts, EdgeWeights::Cotan );
     }
 
-    return splitsDone;
+    return *splitsDone;
 }
 
 TEST(MRMesh, SubdivideMesh) 
@@ -245,4 +537,146 @@ TEST(MRMesh, SubdivideMesh)
     EXPECT_TRUE( region.count() * 2 - 3 > mesh.topology.numValidFaces() );
 }
 
+TEST(MRMesh, SubdivideMeshParallel)
+{
+    const auto sphere = makeSphere( { .radius = 1, .numMeshVertices = 3000 } );
+    FaceBitSet region0( sphere.topology.faceSize() );
+    for ( auto f : sphere.topology.getValidFaces() )
+        if ( sphere.triCenter( f ).z > 0 )
+            region0.set( f );
+
+    SubdivideSettings settings;
+    settings.maxEdgeLen = 0.02f;
+    settings.maxEdgeSplits = 1000000;
+
+    auto seqMesh = sphere;
+    auto seqRegion = region0;
+    settings.region = &seqRegion;
+    const int seqSplits = subdivideMesh( seqMesh, settings );
+
+    auto parMesh = sphere;
+    auto parRegion = region0;
+    FaceHashMap new2Old;
+    VertBitSet newVerts;
+    settings.region = &parRegion;
+    settings.new2Old = &new2Old;
+    settings.newVerts = &newVerts;
+    settings.subdivideParts = 8;
+    const int parSplits = subdivideMesh( parMesh, settings );
+    EXPECT_TRUE( parMesh.topology.checkValidity() );
+
+    // the results differ only by the order of splits
+    EXPECT_GT( seqSplits, 10000 );
+    EXPECT_NEAR( parSplits, seqSplits, seqSplits / 20 );
+    EXPECT_NEAR( (int)parRegion.count(), (int)seqRegion.count(), (int)seqRegion.count() / 20 );
+    EXPECT_EQ( parMesh.topology.numValidVerts(), sphere.topology.numValidVerts() + parSplits );
+    EXPECT_EQ( (int)newVerts.count(), parSplits );
+
+    // old vertices and faces keep their ids, and new faces are mapped on the faces they were split from
+    for ( auto v : sphere.topology.getValidVerts() )
+        EXPECT_EQ( parMesh.points[v], sphere.points[v] );
+    EXPECT_EQ( new2Old.size(), parMesh.topology.numValidFaces() - sphere.topology.numValidFaces() );
+    for ( auto f : parMesh.topology.getValidFaces() )
+    {
+        if ( f < sphere.topology.faceSize() )
+            continue;
+        auto it = new2Old.find( f );
+        ASSERT_NE( it, new2Old.end() );
+        EXPECT_EQ( parRegion.test( f ), region0.test( it->second ) );
+    }
+}
+
+TEST(MRMesh, SubdivideMeshParallelNotFlippable)
+{
+    const auto sphere = makeSphere( { .radius = 1, .numMeshVertices = 3000 } );
+    FaceBitSet cap( sphere.topology.faceSize() );
+    for ( auto f : sphere.topology.getValidFaces() )
+        if ( sphere.triCenter( f ).z > 0.3f )
+            cap.set( f );
+    const auto capBd = findRegionBoundaryUndirectedEdgesInsideMesh( sphere.topology, cap );
+    auto totalLength = []( const Mesh & m, const UndirectedEdgeBitSet & edges )
+    {
+        double sum = 0;
+        for ( auto ue : edges )
+            sum += m.edgeLength( ue );
+        return sum;
+    };
+
+    SubdivideSettings settings;
+    settings.maxEdgeLen = 0.02f;
+    settings.maxEdgeSplits = 1000000;
+    settings.subdivideParts = 8;
+    auto mesh = sphere;
+    auto notFlippable = capBd;
+    settings.notFlippable = &notFlippable;
+    EXPECT_GT( subdivideMesh( mesh, settings ), 10000 );
+    EXPECT_TRUE( mesh.topology.checkValidity() );
+
+    // not-flippable edges are split but keep their shape of single closed line
+    EXPECT_GT( notFlippable.count(), capBd.count() );
+    EXPECT_NEAR( totalLength( mesh, notFlippable ), totalLength( sphere, capBd ), 1e-4 );
+    for ( auto v : getIncidentVerts( mesh.topology, notFlippable ) )
+    {
+        int n = 0;
+        for ( auto e : orgRing( mesh.topology, v ) )
+            if ( notFlippable.test( e.undirected() ) )
+                ++n;
+        EXPECT_EQ( n, 2 );
+    }
+}
+
+TEST(MRMesh, SubdivideMeshParallelFallback)
+{
+    // three triangles with one common vertex having three separate fans of faces, which mesh builder cannot restore
+    Triangulation t{
+        { 0_v, 1_v, 2_v },
+        { 3_v, 4_v, 5_v },
+        { 6_v, 7_v, 8_v }
+    };
+    Mesh mesh;
+    mesh.topology = MeshBuilder::fromTriangles( t );
+    mesh.points = {
+        { 0.f, 0.f, 0.f }, {  1.f, 0.f, 0.f }, { 0.f,  1.f, 0.f },
+        { 0.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, { 0.f, -1.f, 0.f },
+        { 0.f, 0.f, 0.f }, { 0.f, 0.f,  1.f }, { 1.f, 0.f,  1.f }
+    };
+    auto boundaryEdgeWithOrg = [&]( VertId v )
+    {
+        for ( auto e : orgRing( mesh.topology, v ) )
+            if ( !mesh.topology.left( e ) )
+                return e;
+        return EdgeId();
+    };
+    for ( auto v : { 3_v, 6_v } )
+    {
+        const auto e = boundaryEdgeWithOrg( v );
+        mesh.topology.setOrg( e, VertId() );
+        mesh.topology.splice( boundaryEdgeWithOrg( 0_v ), e );
+    }
+    mesh.invalidateCaches();
+    ASSERT_TRUE( mesh.topology.checkValidity() );
+    ASSERT_EQ( mesh.topology.numValidVerts(), 7 );
+
+    SubdivideSettings settings;
+    settings.maxEdgeLen = 0.1f;
+    settings.maxEdgeSplits = 1000000;
+    auto seqMesh = mesh;
+    const int seqSplits = subdivideMesh( seqMesh, settings );
+
+    FaceHashMap new2Old;
+    settings.new2Old = &new2Old;
+    settings.subdivideParts = 3;
+    const int parSplits = subdivideMesh( mesh, settings );
+    EXPECT_TRUE( mesh.topology.checkValidity() );
+
+    // the parts cannot be recombined, and sequential subdivision of the original mesh is done instead
+    EXPECT_GT( seqSplits, 100 );
+    EXPECT_EQ( parSplits, seqSplits );
+    EXPECT_EQ( mesh.topology.numValidFaces(), seqMesh.topology.numValidFaces() );
+    EXPECT_EQ( mesh.points.size(), seqMesh.points.size() );
+    EXPECT_EQ( new2Old.size(), mesh.topology.numValidFaces() - 3 );
+    for ( const auto & [newFace, oldFace] : new2Old )
+        EXPECT_LT( oldFace, 3_f );
+}
+
 } // namespace MR
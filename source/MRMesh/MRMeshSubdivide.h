@@ -33,6 +33,8 @@ struct SubdivideSettings
     UndirectedEdgeBitSet* notFlippable = nullptr;
     /// New vertices appeared during subdivision will be added here
     VertBitSet * newVerts = nullptr;
+    /// If given, receives the mapping of each new face to the original face it was split from
+    FaceHashMap * new2Old = nullptr;
     /// If false do not touch border edges (cannot subdivide lone faces)\n
     /// use \ref MR::findRegionOuterFaces to find boundary faces
     bool subdivideBorder = true;
@@ -58,6 +60,14 @@ struct SubdivideSettings
     std::function<bool(EdgeId e)> beforeEdgeSplit;
     /// callback to report algorithm progress and cancel it by user request
     ProgressCallback progressCallback = {};
+    /// If this value is more than 1, then the mesh is partitioned on approximately this number of parts (using its AABB tree),
+    /// the parts are subdivided in parallel without touching their boundaries, and then the edges near the seams are subdivided sequentially;
+    /// the vertices and the faces existed before keep their ids, but edge ids are changed (region, notFlippable and new2Old are updated accordingly);
+    /// the mesh shall be manifold, and its lone vertices are lost;
+    /// the parallel mode is not used if any of onVertCreated, onEdgeSplit, beforeEdgeSplit callbacks is set, since they work with edge ids;
+    /// the parts are copied in separate meshes and merged back, which costs extra time in comparison with sequential mode
+    /// (e.g. 12.5 s with 16 parts vs 9.1 s sequentially on one CPU core for 2.1M splits), so use it only on multi-core machines
+    int subdivideParts = 1;
 };
 
 /// Split edges in mesh region according to the settings;\n
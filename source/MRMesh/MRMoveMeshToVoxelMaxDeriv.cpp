@@ -104,10 +104,17 @@ template <typename MeshType>
 void MeshOnVoxelsT<MeshType>::getValues( std::vector<float>& result, const Vector3f& pos, const Vector3f& offset ) const
 {
     Vector3f p = pos - ( offset * ( ( result.size() - 1 ) * 0.5f ) );
-    for ( auto& v : result )
+    // sample the points by batches to share the values of voxel corners between neighbor points
+    std::array<Vector3f, 16> points;
+    for ( size_t first = 0; first < result.size(); first += points.size() )
     {
-        v = getValue( p );
-        p += offset;
+        const auto num = std::min( points.size(), result.size() - first );
+        for ( size_t i = 0; i < num; ++i )
+        {
+            points[i] = p;
+            p += offset;
+        }
+        interpolator_.get( std::span<const Vector3f>( points.data(), num ), std::span<float>( result.data() + first, num ) );
     }
 }
 
@@ -0,0 +1,463 @@
+#include "MRMultigridSolver.h"
+#include "MRParallelFor.h"
+#include "MRPositionVertsSmoothly.h"
+#include "MRMakeSphereMesh.h"
+#include "MRMesh.h"
+#include "MRTimer.h"
+#include "MRGTest.h"
+#include "MRPch/MRSpdlog.h"
+
+#if __clang_major__ >= 13
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-but-set-variable"
+#endif
+#include <Eigen/SparseCholesky>
+#if __clang_major__ >= 13
+#pragma clang diagnostic pop
+#endif
+
+namespace MR
+{
+
+namespace
+{
+
+using RowMatrix = Eigen::SparseMatrix<double, Eigen::RowMajor>;
+using ColMatrix = Eigen::SparseMatrix<double>;
+
+/// y = A * x if b is null, otherwise y = b - A * x
+void mulOrResidual( const RowMatrix & A, const Eigen::VectorXd & x, const Eigen::VectorXd * b, Eigen::VectorXd & y )
+{
+    y.resize( A.rows() );
+    ParallelFor( 0, int( A.rows() ), [&]( int i )
+    {
+        double s = 0;
+        for ( RowMatrix::InnerIterator it( A, i ); it; ++it )
+            s += it.value() * x[it.index()];
+        y[i] = b ? ( *b )[i] - s : s;
+    } );
+}
+
+/// estimates the largest eigenvalue of D^-1 * A by power iterations
+double estimateSpectralRadius( const RowMatrix & A, const Eigen::VectorXd & invDiag )
+{
+    const auto n = A.rows();
+    Eigen::VectorXd v( n ), w;
+    for ( int i = 0; i < n; ++i )
+        v[i] = 1 + 0.1 * ( i % 7 ); // deterministic start not orthogonal to main eigenvector
+    v.normalize();
+    double rho = 0;
+    for ( int it = 0; it < 15; ++it )
+    {
+        mulOrResidual( A, v, nullptr, w );
+        w = w.cwiseProduct( invDiag );
+        const auto norm = w.norm();
+        if ( norm <= 0 )
+            break;
+        rho = norm;
+        v = w / norm;
+    }
+    return rho;
+}
+
+/// splits the unknowns in aggregates of strongly connected ones, returns the aggregate of each unknown
+std::vector<int> aggregate( const RowMatrix & A, const Eigen::VectorXd & diag, double theta, int & numAggs )
+{
+    MR_TIMER
+    const int n = int( A.rows() );
+    auto isStrong = [&]( int i, const RowMatrix::InnerIterator & it )
+    {
+        const auto j = int( it.index() );
+        return j != i && std::abs( it.value() ) > theta * std::sqrt( std::abs( diag[i] * diag[j] ) );
+    };
+
+    // phase 1: the unknowns with all strong neighbors not aggregated yet start new aggregates
+    std::vector<int> agg( n, -1 );
+    numAggs = 0;
+    for ( int i = 0; i < n; ++i )
+    {
+        if ( agg[i] >= 0 )
+            continue;
+        bool allFree = true;
+        for ( RowMatrix::InnerIterator it( A, i ); it; ++it )
+        {
+            if ( isStrong( i, it ) && agg[it.index()] >= 0 )
+            {
+                allFree = false;
+                break;
+            }
+        }
+        if ( !allFree )
+            continue;
+        agg[i] = numAggs;
+        for ( RowMatrix::InnerIterator it( A, i ); it; ++it )
+            if ( isStrong( i, it ) )
+                agg[it.index()] = numAggs;
+        ++numAggs;
+    }
+
+    // phase 2: remaining unknowns join the aggregate of the strongest connected neighbor from phase 1
+    const auto agg1 = agg;
+    for ( int i = 0; i < n; ++i )
+    {
+        if ( agg[i] >= 0 )
+            continue;
+        double best = 0;
+        for ( RowMatrix::InnerIterator it( A, i ); it; ++it )
+        {
+            if ( isStrong( i, it ) && agg1[it.index()] >= 0 && std::abs( it.value() ) > best )
+            {
+                best = std::abs( it.value() );
+                agg[i] = agg1[it.index()];
+            }
+        }
+    }
+
+    // phase 3: all other unknowns form new aggregates together with their not aggregated strong neighbors
+    for ( int i = 0; i < n; ++i )
+    {
+        if ( agg[i] >= 0 )
+            continue;
+        agg[i] = numAggs;
+        for ( RowMatrix::InnerIterator it( A, i ); it; ++it )
+            if ( isStrong( i, it ) && agg[it.index()] < 0 )
+                agg[it.index()] = numAggs;
+        ++numAggs;
+    }
+    return agg;
+}
+
+/// builds tentative prolongation interpolating exactly given near null space vectors B from each aggregate,
+/// by orthonormalization of B rows in the aggregate; replaces B with its representation on the coarse level
+RowMatrix tentativeProlongation( const std::vector<int> & agg, int numAggs, Eigen::MatrixXd & B )
+{
+    MR_TIMER
+    const int n = int( agg.size() );
+    const int k = int( B.cols() );
+
+    // unknowns of each aggregate
+    std::vector<int> aggStart( numAggs + 1, 0 );
+    for ( int a : agg )
+        ++aggStart[a + 1];
+    for ( int a = 0; a < numAggs; ++a )
+        aggStart[a + 1] += aggStart[a];
+    std::vector<int> members( n );
+    {
+        auto pos = aggStart;
+        for ( int i = 0; i < n; ++i )
+            members[pos[agg[i]]++] = i;
+    }
+
+    // modified Gram-Schmidt in each aggregate: B_agg = Q * R, columns almost linearly dependent on previous ones are dropped
+    std::vector<Eigen::MatrixXd> qs( numAggs ), rs( numAggs );
+    ParallelFor( 0, numAggs, [&]( int a )
+    {
+        const int m = aggStart[a + 1] - aggStart[a];
+        Eigen::MatrixXd q( m, k ), r = Eigen::MatrixXd::Zero( k, k );
+        int numQ = 0;
+        for ( int c = 0; c < k; ++c )
+        {
+            Eigen::VectorXd v( m );
+            for ( int i = 0; i < m; ++i )
+                v[i] = B( members[aggStart[a] + i], c );
+            const auto origNorm = v.norm();
+            for ( int j = 0; j < numQ; ++j )
+            {
+                r( j, c ) = q.col( j ).dot( v );
+                v -= r( j, c ) * q.col( j );
+            }
+            const auto norm = v.norm();
+            if ( norm > 1e-8 * origNorm && numQ < m )
+            {
+                q.col( numQ ) = v / norm;
+                r( numQ, c ) = norm;
+                ++numQ;
+            }
+        }
+        qs[a] = q.leftCols( numQ );
+        rs[a] = r.topRows( numQ );
+    } );
+
+    std::vector<int> colStart( numAggs + 1, 0 );
+    for ( int a = 0; a < numAggs; ++a )
+        colStart[a + 1] = colStart[a] + int( qs[a].cols() );
+    const int nc = colStart.back();
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve( size_t( n ) * k );
+    Eigen::MatrixXd coarseB( nc, k );
+    for ( int a = 0; a < numAggs; ++a )
+    {
+        const auto & q = qs[a];
+        for ( int i = 0; i < q.rows(); ++i )
+            for ( int j = 0; j < q.cols(); ++j )
+                triplets.emplace_back( members[aggStart[a] + i], colStart[a] + j, q( i, j ) );
+        coarseB.middleRows( colStart[a], q.cols() ) = rs[a];
+    }
+    B = std::move( coarseB );
+
+    RowMatrix res( n, nc );
+    res.setFromTriplets( triplets.begin(), triplets.end() );
+    return res;
+}
+
+} // anonymous namespace
+
+class MultigridSolver::Impl
+{
+public:
+    explicit Impl( const MultigridSettings & settings ) : settings_( settings ) {}
+
+    void compute( const ColMatrix & A, const Eigen::MatrixXd * nearNullSpace );
+    bool valid() const { return !levels_.empty() && coarseValid_; }
+    Eigen::VectorXd solve( const Eigen::VectorXd & b, const Eigen::VectorXd * initialGuess, MultigridStats * stats ) const;
+
+private:
+    /// one multigrid V-cycle approximately solving A_l * x = b starting from zero
+    void vcycle_( size_t l, const Eigen::VectorXd & b, Eigen::VectorXd & x ) const;
+
+    struct Level
+    {
+        RowMatrix A;
+        Eigen::VectorXd invDiag;
+        double omega = 0; // damping factor of Jacobi smoother
+        RowMatrix P;      // prolongation from the next coarser level
+        RowMatrix R;      // restriction to the next coarser level, transposed P
+    };
+
+    MultigridSettings settings_;
+    std::vector<Level> levels_;
+    Eigen::SimplicialLDLT<ColMatrix> coarseSolver_;
+    bool coarseValid_ = false;
+};
+
+void MultigridSolver::Impl::compute( const ColMatrix & A0, const Eigen::MatrixXd * nearNullSpace )
+{
+    MR_TIMER
+    levels_.clear();
+    coarseValid_ = false;
+    if ( A0.rows() == 0 || A0.rows() != A0.cols() )
+        return;
+
+    RowMatrix A = A0;
+    Eigen::MatrixXd B = nearNullSpace && nearNullSpace->rows() == A0.rows() && nearNullSpace->cols() > 0 ?
+        *nearNullSpace : Eigen::MatrixXd::Ones( A0.rows(), 1 );
+    for ( int l = 0; ; ++l )
+    {
+        auto & lev = levels_.emplace_back();
+        lev.A = std::move( A );
+        const auto n = lev.A.rows();
+        const Eigen::VectorXd diag = lev.A.diagonal();
+        lev.invDiag.resize( n );
+        ParallelFor( 0, int( n ), [&]( int i )
+        {
+            lev.invDiag[i] = diag[i] > 0 ? 1 / diag[i] : 0;
+        } );
+        const auto rho = estimateSpectralRadius( lev.A, lev.invDiag );
+        lev.omega = rho > 0 ? 4 / ( 3 * 1.1 * rho ) : 0;
+
+        if ( n <= settings_.maxCoarsestSize )
+            break;
+        int numAggs = 0;
+        // strength threshold is decreased on coarser levels as the connections become denser
+        const auto agg = aggregate( lev.A, diag, 0.08 * std::pow( 0.5, l ), numAggs );
+        if ( numAggs > 0.8 * n )
+            break; // the coarsening stagnates, so solve this level directly
+
+        // tentative prolongation smoothed by one Jacobi step
+        const auto tentative = tentativeProlongation( agg, numAggs, B );
+        if ( tentative.cols() > 0.8 * n )
+            break; // too many near null space vectors for the size of aggregates
+        const RowMatrix ap = lev.A * tentative;
+        const Eigen::VectorXd scale = lev.omega * lev.invDiag;
+        lev.P = tentative - scale.asDiagonal() * ap;
+        lev.R = lev.P.transpose();
+
+        // Galerkin coarse operator R * A * P
+        const RowMatrix ap2 = lev.A * lev.P;
+        A = lev.R * ap2;
+    }
+
+    coarseSolver_.compute( ColMatrix( levels_.back().A ) );
+    coarseValid_ = coarseSolver_.info() == Eigen::Success;
+}
+
+void MultigridSolver::Impl::vcycle_( size_t l, const Eigen::VectorXd & b, Eigen::VectorXd & x ) const
+{
+    if ( l + 1 == levels_.size() )
+    {
+        x = coarseSolver_.solve( b );
+        return;
+    }
+
+    const auto & lev = levels_[l];
+    Eigen::VectorXd r;
+    x.setZero( b.size() );
+    for ( int s = 0; s < settings_.smoothingSteps; ++s )
+    {
+        mulOrResidual( lev.A, x, &b, r );
+        x += lev.omega * lev.invDiag.cwiseProduct( r );
+    }
+
+    mulOrResidual( lev.A, x, &b, r );
+    Eigen::VectorXd rc, xc, corr;
+    mulOrResidual( lev.R, r, nullptr, rc );
+    vcycle_( l + 1, rc, xc );
+    mulOrResidual( lev.P, xc, nullptr, corr );
+    x += corr;
+
+    for ( int s = 0; s < settings_.smoothingSteps; ++s )
+    {
+        mulOrResidual( lev.A, x, &b, r );
+        x += lev.omega * lev.invDiag.cwiseProduct( r );
+    }
+}
+
+Eigen::VectorXd MultigridSolver::Impl::solve( const Eigen::VectorXd & b, const Eigen::VectorXd * initialGuess, MultigridStats * stats ) const
+{
+    MR_TIMER
+    const auto & A = levels_.front().A;
+    const auto n = A.rows();
+    assert( b.size() == n );
+    Eigen::VectorXd x = initialGuess && initialGuess->size() == n ? *initialGuess : Eigen::VectorXd::Zero( n );
+    MultigridStats myStats;
+    if ( !stats )
+        stats = &myStats;
+    *stats = {};
+
+    const auto bNorm = b.norm();
+    if ( bNorm <= 0 )
+    {
+        x.setZero();
+        stats->converged = true;
+        return x;
+    }
+    const auto stopNorm = settings_.relTolerance * bNorm;
+
+    // conjugate gradients preconditioned by V-cycle
+    Eigen::VectorXd r, z, ap;
+    mulOrResidual( A, x, &b, r );
+    auto rNorm = r.norm();
+    vcycle_( 0, r, z );
+    Eigen::VectorXd p = z;
+    double rz = r.dot( z );
+    for ( ; stats->iterations < settings_.maxIterations && rNorm > stopNorm; ++stats->iterations )
+    {
+        mulOrResidual( A, p, nullptr, ap );
+        const auto pap = p.dot( ap );
+        if ( !( pap > 0 ) )
+            break;
+        const auto alpha = rz / pap;
+        x += alpha * p;
+        r -= alpha * ap;
+        rNorm = r.norm();
+        if ( rNorm <= stopNorm )
+        {
+            ++stats->iterations;
+            break;
+        }
+        vcycle_( 0, r, z );
+        const auto rzNew = r.dot( z );
+        p = z + ( rzNew / rz ) * p;
+        rz = rzNew;
+    }
+    stats->relResidual = rNorm / bNorm;
+    stats->converged = rNorm <= stopNorm;
+    if ( !stats->converged )
+        spdlog::warn( "MultigridSolver: not converged in {} iterations, relative residual {}", stats->iterations, stats->relResidual );
+    return x;
+}
+
+MultigridSolver::MultigridSolver( const MultigridSettings & settings )
+    : impl_( std::make_unique<Impl>( settings ) )
+{
+}
+
+MultigridSolver::MultigridSolver( MultigridSolver&& ) noexcept = default;
+MultigridSolver& MultigridSolver::operator=( MultigridSolver&& ) noexcept = default;
+MultigridSolver::~MultigridSolver() = default;
+
+void MultigridSolver::compute( const Eigen::SparseMatrix<double> & A, const Eigen::MatrixXd * nearNullSpace )
+{
+    impl_->compute( A, nearNullSpace );
+}
+
+bool MultigridSolver::valid() const
+{
+    return impl_->valid();
+}
+
+Eigen::VectorXd MultigridSolver::solve( const Eigen::VectorXd & rhs, const Eigen::VectorXd * initialGuess, MultigridStats * stats ) const
+{
+    if ( !valid() )
+    {
+        if ( stats )
+            *stats = { .iterations = 0, .relResidual = 1, .converged = false };
+        return initialGuess && initialGuess->size() == rhs.size() ? *initialGuess : Eigen::VectorXd::Zero( rhs.size() );
+    }
+    return impl_->solve( rhs, initialGuess, stats );
+}
+
+TEST( MRMesh, MultigridSolver )
+{
+    const auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 20000 } );
+    VertBitSet free( sphere.topology.vertSize() );
+    for ( auto v : sphere.topology.getValidVerts() )
+        if ( sphere.points[v].z < 0.5f )
+            free.set( v );
+
+    auto direct = sphere;
+    positionVertsSmoothlySharpBd( direct, free );
+
+    // small coarsest size to test several levels of the hierarchy
+    const MultigridSettings settings{ .relTolerance = 1e-9, .maxCoarsestSize = 100 };
+    auto multigrid = sphere;
+    positionVertsSmoothlySharpBd( multigrid, free, nullptr, nullptr, &settings );
+
+    float maxDiff = 0;
+    for ( auto v : free )
+        maxDiff = std::max( maxDiff, ( direct.points[v] - multigrid.points[v] ).length() );
+    EXPECT_LT( maxDiff, 1e-4f );
+
+    // the same for Laplacian with cotangent weights
+    direct = sphere;
+    positionVertsSmoothly( direct, free );
+    multigrid = sphere;
+    positionVertsSmoothly( multigrid, free, EdgeWeights::Cotan, nullptr, &settings );
+    maxDiff = 0;
+    for ( auto v : free )
+        maxDiff = std::max( maxDiff, ( direct.points[v] - multigrid.points[v] ).length() );
+    EXPECT_LT( maxDiff, 1e-4f );
+
+    // too few iterations to converge: the direct solver is used instead
+    const MultigridSettings fewIters{ .relTolerance = 1e-12, .maxIterations = 1, .maxCoarsestSize = 100 };
+    direct = sphere;
+    positionVertsSmoothlySharpBd( direct, free );
+    multigrid = sphere;
+    positionVertsSmoothlySharpBd( multigrid, free, nullptr, nullptr, &fewIters );
+    maxDiff = 0;
+    for ( auto v : free )
+        maxDiff = std::max( maxDiff, ( direct.points[v] - multigrid.points[v] ).length() );
+    EXPECT_LT( maxDiff, 1e-5f );
+
+    direct = sphere;
+    positionVertsSmoothly( direct, free );
+    multigrid = sphere;
+    positionVertsSmoothly( multigrid, free, EdgeWeights::Cotan, nullptr, &fewIters );
+    maxDiff = 0;
+    for ( auto v : free )
+        maxDiff = std::max( maxDiff, ( direct.points[v] - multigrid.points[v] ).length() );
+    EXPECT_LT( maxDiff, 1e-5f );
+
+    // inflation with multigrid solver
+    direct = sphere;
+    inflate( direct, free, { .pressure = 0.5f } );
+    multigrid = sphere;
+    inflate( multigrid, free, { .pressure = 0.5f, .multigrid = &settings } );
+    maxDiff = 0;
+    for ( auto v : free )
+        maxDiff = std::max( maxDiff, ( direct.points[v] - multigrid.points[v] ).length() );
+    EXPECT_LT( maxDiff, 1e-4f );
+}
+
+} //namespace MR
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "MRMeshFwd.h"
+#include <memory>
+
+#pragma warning(push)
+#pragma warning(disable: 4068) // unknown pragmas
+#pragma warning(disable: 4127) // conditional expression is constant
+#pragma warning(disable: 4464) // relative include path contains '..'
+#pragma warning(disable: 5054) // operator '|': deprecated between enumerations of different types
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-anon-enum-enum-conversion"
+#pragma clang diagnostic ignored "-Wunknown-warning-option" // for next one
+#pragma clang diagnostic ignored "-Wunused-but-set-variable" // for newer clang
+#include <Eigen/SparseCore>
+#pragma clang diagnostic pop
+#pragma warning(pop)
+
+namespace MR
+{
+
+/// parameters of iterative multigrid solver of sparse linear systems
+struct MultigridSettings
+{
+    /// the iterations stop as soon as the norm of residual becomes less than this fraction of the norm of right hand side
+    double relTolerance = 1e-6;
+
+    /// maximal number of conjugate gradient iterations, each performing one multigrid V-cycle
+    int maxIterations = 100;
+
+    /// the number of Jacobi smoothing steps on each level before and after coarse-grid correction
+    int smoothingSteps = 2;
+
+    /// the hierarchy of systems is coarsened till the number of unknowns becomes at most this value,
+    /// then the coarsest system is solved by direct factorization
+    int maxCoarsestSize = 2000;
+};
+
+/// statistics of one solve by MultigridSolver
+struct MultigridStats
+{
+    /// the number of performed conjugate gradient iterations
+    int iterations = 0;
+
+    /// the norm of final residual divided by the norm of right hand side
+    double relResidual = 0;
+
+    /// true if relResidual became less than MultigridSettings::relTolerance within maxIterations
+    bool converged = false;
+};
+
+/// Solver of sparse symmetric positive definite linear systems (e.g. from mesh Laplacians)
+/// by conjugate gradients preconditioned with smoothed aggregation algebraic multigrid V-cycle:
+/// the hierarchy of coarser systems is built from the matrix graph without any geometry,
+/// the memory is linear in the number of unknowns (unlike direct factorizations with fill-in),
+/// and matrix-vector products and smoothing on each level are parallel;
+/// recommended for systems with hundreds of thousands unknowns and more
+class MultigridSolver
+{
+public:
+    MRMESH_API explicit MultigridSolver( const MultigridSettings & settings = {} );
+
+    MRMESH_API MultigridSolver( MultigridSolver&& ) noexcept;
+    MRMESH_API MultigridSolver& operator=( MultigridSolver&& ) noexcept;
+
+    MRMESH_API ~MultigridSolver();
+
+    /// builds the hierarchy of coarser systems for given matrix, which must be symmetric and positive definite,
+    /// and both its upper and lower parts must be filled;
+    /// \param nearNullSpace optional columns that the matrix maps almost in zero, they are represented exactly on coarse levels;
+    ///        by default only constant vector is used, which is enough for Laplacians,
+    ///        but e.g. for squared Laplacians the columns with vertex coordinates shall be added
+    MRMESH_API void compute( const Eigen::SparseMatrix<double> & A, const Eigen::MatrixXd * nearNullSpace = nullptr );
+
+    /// returns false if the hierarchy was not built or direct factorization of the coarsest system failed
+    [[nodiscard]] MRMESH_API bool valid() const;
+
+    /// solves the system with the matrix from last compute call; can be called from several threads simultaneously;
+    /// if the solver is not valid then returns initialGuess (or zero vector) without any iterations,
+    /// so the caller shall check valid() or stats->converged and use a direct solver if necessary;
+    /// \param initialGuess the iterations start from it if given, otherwise from zero vector
+    /// \param stats optional output of the number of iterations and achieved accuracy
+    [[nodiscard]] MRMESH_API Eigen::VectorXd solve( const Eigen::VectorXd & rhs,
+        const Eigen::VectorXd * initialGuess = nullptr, MultigridStats * stats = nullptr ) const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} //namespace MR
@@ -13,7 +13,14 @@
 #include "MRHeap.h"
 #include "MRBuffer.h"
 #include "MRLocalTriangulations.h"
+#include "MRParallelFor.h"
+#include "MRphmap.h"
+#include "MRMakeSphereMesh.h"
+#include "MRMesh.h"
+#include "MRGTest.h"
+#include <atomic>
 #include <cfloat>
+#include <numeric>
 
 namespace MR
 {
@@ -204,6 +211,230 @@ bool orientNormals( const PointCloud& pointCloud, VertNormals& normals, const Al
         }, progress );
 }
 
+bool orientNormalsMST( const PointCloud& pointCloud, VertNormals& normals, const Buffer<VertId> & closeVerts, int numNei,
+    bool seedPerComponentCenter, const ProgressCallback & progress )
+{
+    MR_TIMER
+    const auto& validPoints = pointCloud.validPoints;
+    const auto& points = pointCloud.points;
+    const size_t numPoints = points.size();
+
+    auto neisBegin = [&]( VertId v ) -> const VertId * { return closeVerts.data() + (size_t)v * numNei; };
+    auto neisEnd = [&]( VertId v )
+    {
+        const VertId * p = neisBegin( v );
+        const VertId * pEnd = p + numNei;
+        while ( p < pEnd && *p )
+            ++p;
+        return p;
+    };
+    // each undirected edge of k-NN graph is taken once: from the smaller vertex or from the only vertex listing another one
+    auto takeEdge = [&]( VertId v, VertId n )
+    {
+        if ( n == v || !validPoints.test( n ) )
+            return false;
+        return v < n || std::find( neisBegin( n ), neisEnd( n ), v ) == neisEnd( n );
+    };
+
+    struct Edge
+    {
+        VertId a, b;
+        float cost = 0;
+    };
+    std::vector<size_t> firstEdge( numPoints + 1, 0 );
+    if ( !BitSetParallelFor( validPoints, [&]( VertId v )
+    {
+        size_t num = 0;
+        for ( auto p = neisBegin( v ), pEnd = neisEnd( v ); p < pEnd; ++p )
+            if ( takeEdge( v, *p ) )
+                ++num;
+        firstEdge[(size_t)v + 1] = num;
+    }, subprogress( progress, 0.0f, 0.1f ) ) )
+        return false;
+    std::partial_sum( firstEdge.begin(), firstEdge.end(), firstEdge.begin() );
+
+    // small cost to close points with close normal planes (independently of normals' orientation)
+    std::vector<Edge> edges( firstEdge.back() );
+    if ( !BitSetParallelFor( validPoints, [&]( VertId v )
+    {
+        auto e = firstEdge[v];
+        for ( auto p = neisBegin( v ), pEnd = neisEnd( v ); p < pEnd; ++p )
+        {
+            if ( !takeEdge( v, *p ) )
+                continue;
+            const Vector3f d = points[v] - points[*p];
+            edges[e++] = { v, *p, 0.01f * d.lengthSq() + sqr( dot( d, normals[v] ) ) + sqr( dot( d, normals[*p] ) ) };
+        }
+        assert( e == firstEdge[(size_t)v + 1] );
+    }, subprogress( progress, 0.1f, 0.2f ) ) )
+        return false;
+    firstEdge = {};
+
+    // edges are totally ordered by cost and then by index, so minimum spanning tree is unique
+    auto lessEdge = [&]( size_t e0, size_t e1 )
+    {
+        return std::tie( edges[e0].cost, e0 ) < std::tie( edges[e1].cost, e1 );
+    };
+
+    // Boruvka algorithm: on each round every component selects its cheapest outgoing edge in parallel, then the components are merged;
+    // each component is identified by its smallest vertex
+    constexpr size_t noEdge = SIZE_MAX;
+    Vector<VertId, VertId> comp( numPoints );
+    std::vector<VertId> roots;
+    for ( VertId v = 0_v; v < numPoints; ++v )
+    {
+        comp[v] = v;
+        if ( validPoints.test( v ) )
+            roots.push_back( v );
+    }
+    std::vector<std::atomic<size_t>> bestEdge( numPoints );
+    for ( auto & b : bestEdge )
+        b.store( noEdge, std::memory_order_relaxed );
+    std::vector<size_t> activeEdges( edges.size() );
+    std::iota( activeEdges.begin(), activeEdges.end(), size_t( 0 ) );
+    std::vector<size_t> treeEdges;
+    treeEdges.reserve( roots.size() );
+
+    auto sp = subprogress( progress, 0.2f, 0.8f );
+    const auto initialActive = activeEdges.size();
+    while ( !activeEdges.empty() )
+    {
+        ParallelFor( activeEdges, [&]( size_t i )
+        {
+            const auto e = activeEdges[i];
+            auto update = [&]( std::atomic<size_t> & best )
+            {
+                auto cur = best.load( std::memory_order_relaxed );
+                while ( ( cur == noEdge || lessEdge( e, cur ) ) && !best.compare_exchange_weak( cur, e, std::memory_order_relaxed ) )
+                    { }
+            };
+            update( bestEdge[comp[edges[e].a]] );
+            update( bestEdge[comp[edges[e].b]] );
+        } );
+
+        // merge components along selected edges: both ends of an edge can select it, so the roots are checked;
+        // a merged root always points on a root with smaller id
+        auto findRoot = [&]( VertId v )
+        {
+            while ( comp[v] != v )
+                v = comp[v];
+            return v;
+        };
+        for ( auto r : roots )
+        {
+            const auto e = bestEdge[r].exchange( noEdge, std::memory_order_relaxed );
+            if ( e == noEdge )
+                continue;
+            const auto ra = findRoot( edges[e].a );
+            const auto rb = findRoot( edges[e].b );
+            if ( ra == rb )
+                continue;
+            comp[std::max( ra, rb )] = std::min( ra, rb );
+            treeEdges.push_back( e );
+        }
+        // the roots of previous round are processed in increasing order, so their parents already point on final roots
+        std::vector<VertId> newRoots;
+        for ( auto r : roots )
+        {
+            comp[r] = comp[comp[r]];
+            if ( comp[r] == r )
+                newRoots.push_back( r );
+        }
+        roots = std::move( newRoots );
+
+        // point every other vertex directly on the root of its component, the roots of previous round are only read here
+        BitSetParallelFor( validPoints, [&]( VertId v )
+        {
+            const auto r = comp[comp[v]];
+            if ( r != comp[v] )
+                comp[v] = r;
+        } );
+
+        std::erase_if( activeEdges, [&]( size_t e ) { return comp[edges[e].a] == comp[edges[e].b]; } );
+        if ( !reportProgress( sp, 1.0f - float( activeEdges.size() ) / initialActive ) )
+            return false;
+    }
+    activeEdges = {};
+
+    // adjacency of the tree
+    std::vector<size_t> firstTreeNei( numPoints + 1, 0 );
+    for ( auto e : treeEdges )
+    {
+        ++firstTreeNei[(size_t)edges[e].a + 1];
+        ++firstTreeNei[(size_t)edges[e].b + 1];
+    }
+    std::partial_sum( firstTreeNei.begin(), firstTreeNei.end(), firstTreeNei.begin() );
+    std::vector<VertId> treeNeis( firstTreeNei.back() );
+    {
+        auto next = firstTreeNei;
+        for ( auto e : treeEdges )
+        {
+            treeNeis[next[edges[e].a]++] = edges[e].b;
+            treeNeis[next[edges[e].b]++] = edges[e].a;
+        }
+    }
+    edges = {};
+    if ( !reportProgress( progress, 0.85f ) )
+        return false;
+
+    // seed of each component is the point most distant from the center (ties are resolved in favor of smaller id)
+    const auto cloudCenter = pointCloud.computeBoundingBox().center();
+    HashMap<VertId, Box3f> compBoxes;
+    if ( seedPerComponentCenter )
+        for ( auto v : validPoints )
+            compBoxes[comp[v]].include( points[v] );
+    auto centerOf = [&]( VertId root )
+    {
+        return seedPerComponentCenter ? compBoxes[root].center() : cloudCenter;
+    };
+    HashMap<VertId, std::pair<float, VertId>> seeds;
+    for ( auto v : validPoints )
+    {
+        const auto root = comp[v];
+        const auto distSq = ( points[v] - centerOf( root ) ).lengthSq();
+        auto [it, inserted] = seeds.insert( { root, { distSq, v } } );
+        if ( !inserted && distSq > it->second.first )
+            it->second = { distSq, v };
+    }
+    std::vector<std::pair<VertId, Vector3f>> seedList;
+    seedList.reserve( seeds.size() );
+    for ( const auto & [root, seed] : seeds )
+        seedList.emplace_back( seed.second, centerOf( root ) );
+
+    // propagate the orientation from each seed along the tree, the components are processed in parallel
+    return ParallelFor( seedList, [&]( size_t i )
+    {
+        const auto [seed, center] = seedList[i];
+        if ( dot( normals[seed], points[seed] - center ) < 0 )
+            normals[seed] = -normals[seed];
+        std::vector<std::pair<VertId, VertId>> stack{ { seed, VertId{} } };
+        while ( !stack.empty() )
+        {
+            const auto [v, from] = stack.back();
+            stack.pop_back();
+            for ( auto j = firstTreeNei[v]; j < firstTreeNei[(size_t)v + 1]; ++j )
+            {
+                const auto n = treeNeis[j];
+                if ( n == from )
+                    continue;
+                if ( dot( normals[v], normals[n] ) < 0 )
+                    normals[n] = -normals[n];
+                stack.emplace_back( n, v );
+            }
+        }
+    }, subprogress( progress, 0.9f, 1.0f ) );
+}
+
+bool orientNormalsMST( const PointCloud& pointCloud, VertNormals& normals, int numNei,
+    bool seedPerComponentCenter, const ProgressCallback & progress )
+{
+    MR_TIMER
+    const auto closeVerts = findNClosestPointsPerPoint( pointCloud, numNei, subprogress( progress, 0.0f, 0.5f ) );
+    if ( closeVerts.empty() && !pointCloud.points.empty() )
+        return false;
+    return orientNormalsMST( pointCloud, normals, closeVerts, numNei, seedPerComponentCenter, subprogress( progress, 0.5f, 1.0f ) );
+}
+
 std::optional<VertNormals> makeOrientedNormals( const PointCloud& pointCloud,
     float radius, const ProgressCallback & progress )
 {
@@ -236,4 +467,38 @@ VertNormals makeNormals( const PointCloud& pointCloud, int avgNeighborhoodSize )
     return *makeOrientedNormals( pointCloud, findAvgPointsRadius( pointCloud, avgNeighborhoodSize ) );
 }
 
+TEST( MRMesh, OrientNormalsMST )
+{
+    // two separate spheres with arbitrarily oriented normals
+    const Vector3f centers[2] = { Vector3f( 0, 0, 0 ), Vector3f( 5, 0, 0 ) };
+    PointCloud cloud;
+    for ( const auto & c : centers )
+    {
+        const auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 2000 } );
+        for ( const auto & p : sphere.points )
+        {
+            cloud.normals.push_back( cloud.points.size() % 3 == 0 ? -p : p );
+            cloud.points.push_back( c + p );
+        }
+    }
+    cloud.validPoints.resize( cloud.points.size(), true );
+
+    for ( bool seedPerComponentCenter : { false, true } )
+    {
+        auto normals = cloud.normals;
+        EXPECT_TRUE( orientNormalsMST( cloud, normals, 8, seedPerComponentCenter ) );
+        for ( auto v : cloud.validPoints )
+        {
+            const auto & c = centers[v < cloud.points.size() / 2 ? 0 : 1];
+            EXPECT_GT( dot( normals[v], cloud.points[v] - c ), 0 );
+        }
+
+        // the same result with a single thread
+        auto normals1 = cloud.normals;
+        tbb::task_arena arena( 1 );
+        arena.execute( [&] { orientNormalsMST( cloud, normals1, 8, seedPerComponentCenter ); } );
+        EXPECT_EQ( normals, normals1 );
+    }
+}
+
 } //namespace MR
@@ -51,6 +51,26 @@ MRMESH_API bool orientNormals( const PointCloud& pointCloud, VertNormals& normal
 MRMESH_API bool orientNormals( const PointCloud& pointCloud, VertNormals& normals, const Buffer<VertId> & closeVerts, int numNei,
     const ProgressCallback & progress = {} );
 
+/// \brief Select orientation of given normals to make directions of close points consistent:
+/// builds undirected k-NN graph in parallel, finds its minimum spanning tree by parallel Boruvka algorithm
+/// (edge cost is small for close points with close normal planes), and propagates the orientation along the tree from seed points;
+/// each connected component of the graph gets its own seed: the point most distant from the center of the cloud
+/// (or from the center of the component if \param seedPerComponentCenter), which normal is directed outside from that center;
+/// the result does not depend on the number of threads
+/// \param closeVerts a buffer where for every valid point #i its neighbours are stored at indices [i*numNei; (i+1)*numNei)
+/// \return false if progress returned false
+/// \ingroup PointCloudGroup
+MRMESH_API bool orientNormalsMST( const PointCloud& pointCloud, VertNormals& normals, const Buffer<VertId> & closeVerts, int numNei,
+    bool seedPerComponentCenter = false, const ProgressCallback & progress = {} );
+
+/// \brief Select orientation of given normals to make directions of close points consistent using minimum spanning tree of k-NN graph,
+/// see the overload above
+/// \param numNei the number of nearest neighbors of each point in the graph
+/// \return false if progress returned false
+/// \ingroup PointCloudGroup
+MRMESH_API bool orientNormalsMST( const PointCloud& pointCloud, VertNormals& normals, int numNei,
+    bool seedPerComponentCenter = false, const ProgressCallback & progress = {} );
+
 /// \brief Makes normals for valid points of given point cloud; directions of close points are selected to be consistent;
 /// \param radius of neighborhood to consider
 /// \return nullopt if progress returned false
@@ -0,0 +1,505 @@
+#include "MRPointCloudTiles.h"
+#include "MRPointCloud.h"
+#include "MRGridSampling.h"
+#include "MRPointCloudMakeNormals.h"
+#include "MRTerrainTriangulation.h"
+#include "MRMesh.h"
+#include "MRMeshBuilder.h"
+#include "MRBitSet.h"
+#include "MRColor.h"
+#include "MRHash.h"
+#include "MRStringConvert.h"
+#include "MRTimer.h"
+#include "MRGTest.h"
+#include "MRPch/MRFmt.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace MR
+{
+
+PointCloudTilesWriter::PointCloudTilesWriter( PointCloudTilingParams params )
+    : params_( std::move( params ) )
+{
+    assert( params_.tileSize > 0 );
+    assert( params_.haloWidth >= 0 && params_.haloWidth < params_.tileSize );
+}
+
+std::filesystem::path PointCloudTilesWriter::tileFile_( const Vector2i& index, bool core ) const
+{
+    return params_.dir / fmt::format( "tile_{}_{}_{}.bin", index.x, index.y, core ? "core" : "halo" );
+}
+
+VoidOrErrStr PointCloudTilesWriter::flush_( const Vector2i& index, bool core, TileBuffer& buffer )
+{
+    if ( buffer.points.empty() )
+        return {};
+
+    const auto file = tileFile_( index, core );
+    // the file is created on the first flush and appended on next ones
+    std::ofstream out( file, buffer.numWritten == 0 ? std::ofstream::binary : std::ofstream::binary | std::ofstream::app );
+    if ( !out )
+        return unexpected( std::string( "Cannot open file for writing " ) + utf8string( file ) );
+
+    const bool withColors = *hasColors_;
+    for ( size_t i = 0; i < buffer.points.size(); ++i )
+    {
+        out.write( (const char*)&buffer.points[i], sizeof( Vector3f ) );
+        if ( withColors )
+            out.write( (const char*)&buffer.colors[i], sizeof( Color ) );
+    }
+    if ( !out )
+        return unexpected( std::string( "Error writing point cloud tile " ) + utf8string( file ) );
+
+    buffer.numWritten += buffer.points.size();
+    buffer.points.clear();
+    buffer.colors.clear();
+    return {};
+}
+
+VoidOrErrStr PointCloudTilesWriter::addPoints( const PointCloud& chunk, const VertColors* colors )
+{
+    MR_TIMER
+    const bool withColors = colors && colors->size() >= chunk.points.size();
+    if ( !hasColors_ )
+        hasColors_ = withColors;
+    else if ( *hasColors_ != withColors )
+        return unexpected( std::string( "All chunks of point cloud must either have colors or not" ) );
+
+    const float tileSize = params_.tileSize;
+    const float halo = params_.haloWidth;
+    auto addToBuffer = [&] ( const Vector2i& index, bool core, VertId v ) -> VoidOrErrStr
+    {
+        auto& data = tiles_[index];
+        auto& buffer = core ? data.core : data.halo;
+        buffer.points.push_back( chunk.points[v] );
+        if ( withColors )
+            buffer.colors.push_back( ( *colors )[v] );
+        if ( buffer.points.size() >= params_.flushPoints )
+            return flush_( index, core, buffer );
+        return {};
+    };
+
+    for ( auto v : chunk.validPoints )
+    {
+        const auto& p = chunk.points[v];
+        const Vector2i index( (int)std::floor( p.x / tileSize ), (int)std::floor( p.y / tileSize ) );
+        if ( auto res = addToBuffer( index, true, v ); !res )
+            return res;
+        if ( halo <= 0 )
+            continue;
+
+        // the position of the point inside its tile defines the neighbor tiles whose halo it belongs to
+        const float rx = p.x - index.x * tileSize;
+        const float ry = p.y - index.y * tileSize;
+        const int dx0 = rx <= halo ? -1 : 0;
+        const int dx1 = rx >= tileSize - halo ? 1 : 0;
+        const int dy0 = ry <= halo ? -1 : 0;
+        const int dy1 = ry >= tileSize - halo ? 1 : 0;
+        for ( int dy = dy0; dy <= dy1; ++dy )
+        {
+            for ( int dx = dx0; dx <= dx1; ++dx )
+            {
+                if ( dx == 0 && dy == 0 )
+                    continue;
+                if ( auto res = addToBuffer( index + Vector2i( dx, dy ), false, v ); !res )
+                    return res;
+            }
+        }
+    }
+    return {};
+}
+
+Expected<std::vector<PointCloudTile>> PointCloudTilesWriter::finish()
+{
+    MR_TIMER
+    std::vector<PointCloudTile> res;
+    res.reserve( tiles_.size() );
+    for ( auto& [index, data] : tiles_ )
+    {
+        if ( auto flushed = flush_( index, true, data.core ); !flushed )
+            return unexpected( std::move( flushed.error() ) );
+        if ( auto flushed = flush_( index, false, data.halo ); !flushed )
+            return unexpected( std::move( flushed.error() ) );
+        // the tiles having only halo points are useless
+        if ( data.core.numWritten == 0 )
+        {
+            if ( data.halo.numWritten > 0 )
+            {
+                std::error_code ec;
+                std::filesystem::remove( tileFile_( index, false ), ec );
+            }
+            continue;
+        }
+
+        PointCloudTile tile;
+        tile.index = index;
+        tile.region = Box2f( Vector2f( index ) * params_.tileSize, Vector2f( index + Vector2i( 1, 1 ) ) * params_.tileSize );
+        tile.coreFile = tileFile_( index, true );
+        if ( data.halo.numWritten > 0 )
+            tile.haloFile = tileFile_( index, false );
+        tile.numCorePoints = data.core.numWritten;
+        tile.numHaloPoints = data.halo.numWritten;
+        tile.hasColors = hasColors_.value_or( false );
+        res.push_back( std::move( tile ) );
+    }
+    tiles_.clear();
+
+    std::sort( res.begin(), res.end(), [] ( const PointCloudTile& a, const PointCloudTile& b )
+    {
+        return std::tie( a.index.y, a.index.x ) < std::tie( b.index.y, b.index.x );
+    } );
+    return res;
+}
+
+static VoidOrErrStr readTilePoints( const std::filesystem::path& file, size_t numPoints, bool withColors,
+    PointCloud& cloud, VertColors* colors )
+{
+    if ( numPoints == 0 )
+        return {};
+    std::ifstream in( file, std::ifstream::binary );
+    if ( !in )
+        return unexpected( std::string( "Cannot open file for reading " ) + utf8string( file ) );
+
+    const auto first = cloud.points.size();
+    cloud.points.resize( first + numPoints );
+    if ( colors )
+        colors->resize( first + numPoints );
+    if ( !withColors )
+    {
+        in.read( (char*)&cloud.points[VertId( first )], numPoints * sizeof( Vector3f ) );
+    }
+    else
+    {
+        Color skipColor;
+        for ( auto v = VertId( first ); v < cloud.points.size(); ++v )
+        {
+            in.read( (char*)&cloud.points[v], sizeof( Vector3f ) );
+            in.read( (char*)( colors ? &( *colors )[v] : &skipColor ), sizeof( Color ) );
+        }
+    }
+    if ( !in )
+        return unexpected( std::string( "Error reading point cloud tile " ) + utf8string( file ) );
+    return {};
+}
+
+Expected<PointCloud> loadPointCloudTile( const PointCloudTile& tile, VertColors* colors )
+{
+    MR_TIMER
+    PointCloud res;
+    res.points.reserve( tile.numCorePoints + tile.numHaloPoints );
+    if ( colors )
+    {
+        colors->clear();
+        colors->reserve( res.points.capacity() );
+    }
+    if ( auto read = readTilePoints( tile.coreFile, tile.numCorePoints, tile.hasColors, res, colors ); !read )
+        return unexpected( std::move( read.error() ) );
+    if ( auto read = readTilePoints( tile.haloFile, tile.numHaloPoints, tile.hasColors, res, colors ); !read )
+        return unexpected( std::move( read.error() ) );
+    if ( colors && !tile.hasColors )
+        colors->clear();
+    res.validPoints.resize( res.points.size(), true );
+    return res;
+}
+
+VoidOrErrStr processPointCloudTiles( const std::vector<PointCloudTile>& tiles, const PointCloudTileProcessor& processor,
+    const ProgressCallback& cb )
+{
+    MR_TIMER
+    VertColors colors;
+    for ( size_t i = 0; i < tiles.size(); ++i )
+    {
+        auto cloud = loadPointCloudTile( tiles[i], &colors );
+        if ( !cloud )
+            return unexpected( std::move( cloud.error() ) );
+        if ( auto res = processor( tiles[i], *cloud, colors ); !res )
+            return res;
+        if ( !reportProgress( cb, float( i + 1 ) / tiles.size() ) )
+            return unexpectedOperationCanceled();
+    }
+    return {};
+}
+
+Expected<PointCloud> pointGridSamplingTiles( const std::vector<PointCloudTile>& tiles, float voxelSize,
+    VertColors* colors, const ProgressCallback& cb )
+{
+    MR_TIMER
+    PointCloud res;
+    if ( colors )
+        colors->clear();
+    auto processed = processPointCloudTiles( tiles, [&] ( const PointCloudTile& tile, const PointCloud& cloud, const VertColors& tileColors ) -> VoidOrErrStr
+    {
+        // the samples are taken from the points of the tile only, since halo points are sampled in their own tiles
+        PointCloud core;
+        core.points.vec_.assign( cloud.points.vec_.begin(), cloud.points.vec_.begin() + tile.numCorePoints );
+        core.validPoints.resize( tile.numCorePoints, true );
+        auto samples = pointGridSampling( core, voxelSize );
+        if ( !samples )
+            return unexpectedOperationCanceled();
+        for ( auto v : *samples )
+        {
+            res.points.push_back( core.points[v] );
+            if ( colors && !tileColors.empty() )
+                colors->push_back( tileColors[v] );
+        }
+        return {};
+    }, cb );
+    if ( !processed )
+        return unexpected( std::move( processed.error() ) );
+    res.validPoints.resize( res.points.size(), true );
+    return res;
+}
+
+VoidOrErrStr makeNormalsTiles( const std::vector<PointCloudTile>& tiles, float radius,
+    const PointCloudTileReceiver& receiver, const ProgressCallback& cb )
+{
+    MR_TIMER
+    return processPointCloudTiles( tiles, [&] ( const PointCloudTile& tile, const PointCloud& cloud, const VertColors& tileColors ) -> VoidOrErrStr
+    {
+        auto normals = makeUnorientedNormals( cloud, radius );
+        if ( !normals )
+            return unexpectedOperationCanceled();
+
+        PointCloud core;
+        core.points.vec_.assign( cloud.points.vec_.begin(), cloud.points.vec_.begin() + tile.numCorePoints );
+        core.normals.vec_.assign( normals->vec_.begin(), normals->vec_.begin() + tile.numCorePoints );
+        core.validPoints.resize( tile.numCorePoints, true );
+        for ( auto & n : core.normals )
+            if ( n.z < 0 )
+                n = -n;
+        VertColors coreColors;
+        if ( !tileColors.empty() )
+            coreColors.vec_.assign( tileColors.vec_.begin(), tileColors.vec_.begin() + tile.numCorePoints );
+        return receiver( tile, std::move( core ), std::move( coreColors ) );
+    }, cb );
+}
+
+VoidOrErrStr terrainTriangulationTiles( const std::vector<PointCloudTile>& tiles,
+    const TerrainTileReceiver& receiver, const ProgressCallback& cb )
+{
+    MR_TIMER
+    return processPointCloudTiles( tiles, [&] ( const PointCloudTile& tile, const PointCloud& cloud, const VertColors& ) -> VoidOrErrStr
+    {
+        auto mesh = terrainTriangulation( cloud.points.vec_ );
+        if ( !mesh )
+            return unexpected( std::move( mesh.error() ) );
+
+        // the tiles are half-open boxes, so each triangle is kept in exactly one tile
+        FaceBitSet inside( mesh->topology.faceSize() );
+        for ( auto f : mesh->topology.getValidFaces() )
+        {
+            const auto c = mesh->triCenter( f );
+            if ( c.x >= tile.region.min.x && c.x < tile.region.max.x && c.y >= tile.region.min.y && c.y < tile.region.max.y )
+                inside.set( f );
+        }
+        return receiver( tile, mesh->cloneRegion( inside ) );
+    }, cb );
+}
+
+TEST( MRMesh, PointCloudTiles )
+{
+    const auto dir = std::filesystem::temp_directory_path() / "MeshLib_PointCloudTiles";
+    std::error_code ec;
+    std::filesystem::remove_all( dir, ec );
+    std::filesystem::create_directories( dir, ec );
+
+    PointCloudTilingParams params;
+    params.tileSize = 10;
+    params.haloWidth = 1;
+    params.dir = dir;
+    params.flushPoints = 100;
+    PointCloudTilesWriter writer( params );
+
+    // regular grid of points with step 0.5 in [-10,20)x[0,10), added by rows
+    constexpr int numX = 60, numY = 20;
+    for ( int y = 0; y < numY; ++y )
+    {
+        PointCloud row;
+        VertColors rowColors;
+        for ( int x = 0; x < numX; ++x )
+        {
+            row.points.emplace_back( -10 + 0.5f * x + 0.25f, 0.5f * y + 0.25f, float( x + y ) );
+            rowColors.emplace_back( x, y, 0 );
+        }
+        row.validPoints.resize( row.points.size(), true );
+        EXPECT_TRUE( writer.addPoints( row, &rowColors ).has_value() );
+    }
+    auto tiles = writer.finish();
+    ASSERT_TRUE( tiles.has_value() );
+    ASSERT_EQ( tiles->size(), 3 );
+
+    size_t numCore = 0;
+    for ( const auto& tile : *tiles )
+    {
+        EXPECT_EQ( tile.index.y, 0 );
+        EXPECT_EQ( tile.numCorePoints, 20 * numY );
+        numCore += tile.numCorePoints;
+
+        VertColors colors;
+        auto cloud = loadPointCloudTile( tile, &colors );
+        ASSERT_TRUE( cloud.has_value() );
+        ASSERT_EQ( cloud->points.size(), tile.numCorePoints + tile.numHaloPoints );
+        ASSERT_EQ( colors.size(), cloud->points.size() );
+        const Box2f haloRegion( tile.region.min - Vector2f::diagonal( params.haloWidth ), tile.region.max + Vector2f::diagonal( params.haloWidth ) );
+        for ( auto v = 0_v; v < cloud->points.size(); ++v )
+        {
+            const auto& p = cloud->points[v];
+            const Vector2f p2( p.x, p.y );
+            if ( v < tile.numCorePoints )
+                EXPECT_TRUE( tile.region.contains( p2 ) );
+            else
+                EXPECT_TRUE( !tile.region.contains( p2 ) && haloRegion.contains( p2 ) );
+            EXPECT_EQ( colors[v].r, uint8_t( ( p.x + 10 ) * 2 ) );
+        }
+    }
+    EXPECT_EQ( numCore, numX * numY );
+    // the middle tile has halo on both sides, two halo columns on each side
+    EXPECT_EQ( ( *tiles )[1].numHaloPoints, 4 * numY );
+
+    VertColors sampledColors;
+    auto sampled = pointGridSamplingTiles( *tiles, 2.0f, &sampledColors );
+    ASSERT_TRUE( sampled.has_value() );
+    EXPECT_GT( sampled->points.size(), 0 );
+    EXPECT_LT( sampled->points.size(), numX * numY );
+    EXPECT_EQ( sampledColors.size(), sampled->points.size() );
+
+    // the points lie in the plane z = 2*x + 2*y + const
+    const auto planeNormal = Vector3f( -2, -2, 1 ).normalized();
+    size_t numWithNormals = 0;
+    auto normalsRes = makeNormalsTiles( *tiles, 1.6f, [&] ( const PointCloudTile& tile, PointCloud&& core, VertColors&& coreColors ) -> VoidOrErrStr
+    {
+        EXPECT_EQ( core.points.size(), tile.numCorePoints );
+        EXPECT_EQ( coreColors.size(), tile.numCorePoints );
+        EXPECT_TRUE( core.hasNormals() );
+        for ( const auto & n : core.normals )
+            EXPECT_GT( dot( n, planeNormal ), 0.99f );
+        numWithNormals += core.points.size();
+        return {};
+    } );
+    EXPECT_TRUE( normalsRes.has_value() );
+    EXPECT_EQ( numWithNormals, numX * numY );
+
+    // the parts of terrain triangulation have the same number of triangles as whole triangulation
+    std::vector<Vector3f> allPoints;
+    size_t numTiledTris = 0;
+    auto terrainRes = terrainTriangulationTiles( *tiles, [&] ( const PointCloudTile&, Mesh&& part ) -> VoidOrErrStr
+    {
+        numTiledTris += part.topology.numValidFaces();
+        return {};
+    } );
+    EXPECT_TRUE( terrainRes.has_value() );
+    for ( const auto & tile : *tiles )
+    {
+        auto cloud = loadPointCloudTile( tile );
+        ASSERT_TRUE( cloud.has_value() );
+        allPoints.insert( allPoints.end(), cloud->points.vec_.begin(), cloud->points.vec_.begin() + tile.numCorePoints );
+    }
+    auto whole = terrainTriangulation( std::move( allPoints ) );
+    ASSERT_TRUE( whole.has_value() );
+    EXPECT_EQ( numTiledTris, whole->topology.numValidFaces() );
+
+    std::filesystem::remove_all( dir, ec );
+}
+
+TEST( MRMesh, PointCloudTilesTerrainSeams )
+{
+    const auto dir = std::filesystem::temp_directory_path() / "MeshLib_PointCloudTilesTerrainSeams";
+    std::error_code ec;
+    std::filesystem::remove_all( dir, ec );
+    std::filesystem::create_directories( dir, ec );
+
+    PointCloudTilingParams params;
+    params.tileSize = 4;
+    params.haloWidth = 1;
+    params.dir = dir;
+    PointCloudTilesWriter writer( params );
+
+    // jittered grid in [0,12)x[0,8) to have unique Delaunay triangulation,
+    // the outer rows and columns are not jittered to avoid thin triangles with huge circumcircles along the convex hull
+    PointCloud cloud;
+    constexpr int numX = 48, numY = 32;
+    for ( int y = 0; y < numY; ++y )
+    {
+        for ( int x = 0; x < numX; ++x )
+        {
+            const int h = ( x * 7919 + y * 104729 ) % 1000;
+            const float jx = ( x == 0 || x + 1 == numX ) ? 0.0f : 0.1f * ( h % 31 ) / 31;
+            const float jy = ( y == 0 || y + 1 == numY ) ? 0.0f : 0.1f * ( h % 37 ) / 37;
+            cloud.points.emplace_back( 0.25f * x + 0.075f + jx, 0.25f * y + 0.075f + jy, 0.01f * ( h % 13 ) );
+        }
+    }
+    cloud.validPoints.resize( cloud.points.size(), true );
+    EXPECT_TRUE( writer.addPoints( cloud ).has_value() );
+    auto tiles = writer.finish();
+    ASSERT_TRUE( tiles.has_value() );
+    ASSERT_EQ( tiles->size(), 6 );
+
+    std::vector<Mesh> parts;
+    auto terrainRes = terrainTriangulationTiles( *tiles, [&] ( const PointCloudTile&, Mesh&& part ) -> VoidOrErrStr
+    {
+        parts.push_back( std::move( part ) );
+        return {};
+    } );
+    ASSERT_TRUE( terrainRes.has_value() );
+    auto whole = terrainTriangulation( cloud.points.vec_ );
+    ASSERT_TRUE( whole.has_value() );
+
+    // each boundary edge of a part is either on the boundary of whole triangulation,
+    // or on the seam with a neighbor part having the same edge with exactly the same coordinates of the ends
+    using Segment = std::array<float, 6>;
+    auto toSegment = [] ( const Mesh & m, EdgeId e )
+    {
+        const auto & a = m.orgPnt( e );
+        const auto & b = m.destPnt( e );
+        return Segment{ a.x, a.y, a.z, b.x, b.y, b.z };
+    };
+    std::vector<std::vector<Segment>> partBdEdges( parts.size() );
+    for ( size_t i = 0; i < parts.size(); ++i )
+    {
+        const auto & topology = parts[i].topology;
+        for ( EdgeId e( 0 ); e < topology.edgeSize(); ++e )
+            if ( !topology.isLoneEdge( e ) && !topology.left( e ) )
+                partBdEdges[i].push_back( toSegment( parts[i], e ) );
+        std::sort( partBdEdges[i].begin(), partBdEdges[i].end() );
+    }
+    std::vector<Segment> wholeBdEdges;
+    for ( EdgeId e( 0 ); e < whole->topology.edgeSize(); ++e )
+        if ( !whole->topology.isLoneEdge( e ) && !whole->topology.left( e ) )
+            wholeBdEdges.push_back( toSegment( *whole, e ) );
+    std::sort( wholeBdEdges.begin(), wholeBdEdges.end() );
+
+    size_t numSeamEdges = 0;
+    for ( size_t i = 0; i < parts.size(); ++i )
+    {
+        for ( const auto & s : partBdEdges[i] )
+        {
+            if ( std::binary_search( wholeBdEdges.begin(), wholeBdEdges.end(), s ) )
+                continue;
+            const Segment rev{ s[3], s[4], s[5], s[0], s[1], s[2] };
+            int numMatches = 0;
+            for ( size_t j = 0; j < parts.size(); ++j )
+                if ( j != i && std::binary_search( partBdEdges[j].begin(), partBdEdges[j].end(), rev ) )
+                    ++numMatches;
+            EXPECT_EQ( numMatches, 1 );
+            ++numSeamEdges;
+        }
+    }
+    EXPECT_GT( numSeamEdges, 0 );
+
+    // the parts are separate meshes, and after uniting the duplicated vertices of the seams they give whole triangulation
+    Mesh united;
+    for ( const auto & part : parts )
+        united.addPart( part );
+    EXPECT_GT( united.topology.numValidVerts(), whole->topology.numValidVerts() );
+    MeshBuilder::uniteCloseVertices( united, 0.0f );
+    EXPECT_TRUE( united.topology.checkValidity() );
+    EXPECT_EQ( united.topology.numValidVerts(), whole->topology.numValidVerts() );
+    EXPECT_EQ( united.topology.numValidFaces(), whole->topology.numValidFaces() );
+    EXPECT_EQ( united.topology.findHoleRepresentiveEdges().size(), 1 );
+
+    std::filesystem::remove_all( dir, ec );
+}
+
+} // namespace MR
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "MRMeshFwd.h"
+#include "MRVector2.h"
+#include "MRBox.h"
+#include "MRExpected.h"
+#include "MRProgressCallback.h"
+#include "MRphmap.h"
+#include <filesystem>
+#include <optional>
+
+namespace MR
+{
+
+/// \addtogroup PointCloudGroup
+/// \{
+
+struct PointCloudTilingParams
+{
+    /// the size of square tiles in XY-plane
+    float tileSize = 0;
+    /// each tile additionally keeps the points of neighbor tiles located not further than this distance from its region,
+    /// so local algorithms (e.g. normals estimation or triangulation) give the same results for the points near tile borders
+    float haloWidth = 0;
+    /// the directory where the files of the tiles are written
+    std::filesystem::path dir;
+    /// the points of a tile are kept in memory until their number reaches this value, then they are appended to tile's file
+    size_t flushPoints = size_t( 1 ) << 16;
+};
+
+/// the description of one tile written on disk
+struct PointCloudTile
+{
+    /// the position of the tile in the grid of tiles
+    Vector2i index;
+    /// the region of the tile in XY-plane (excluding halo)
+    Box2f region;
+    /// the files with the points from the region of the tile and from its halo
+    std::filesystem::path coreFile, haloFile;
+    size_t numCorePoints = 0;
+    size_t numHaloPoints = 0;
+    bool hasColors = false;
+};
+
+/// distributes the points of a huge point cloud coming by chunks (e.g. from PointsLoad::fromLasByChunks)
+/// among square tiles in XY-plane and writes them on disk, so only the points not flushed yet are kept in memory
+class PointCloudTilesWriter
+{
+public:
+    MRMESH_API explicit PointCloudTilesWriter( PointCloudTilingParams params );
+
+    /// adds valid points of the chunk (and optional colors) in the tiles containing them in their regions or halos
+    MRMESH_API VoidOrErrStr addPoints( const PointCloud& chunk, const VertColors* colors = nullptr );
+
+    /// writes all remaining points and returns the description of all non-empty tiles
+    MRMESH_API Expected<std::vector<PointCloudTile>> finish();
+
+private:
+    struct TileBuffer
+    {
+        std::vector<Vector3f> points;
+        std::vector<Color> colors;
+        size_t numWritten = 0;
+    };
+    struct TileData
+    {
+        TileBuffer core, halo;
+    };
+
+    VoidOrErrStr flush_( const Vector2i& index, bool core, TileBuffer& buffer );
+    std::filesystem::path tileFile_( const Vector2i& index, bool core ) const;
+
+    PointCloudTilingParams params_;
+    HashMap<Vector2i, TileData> tiles_;
+    std::optional<bool> hasColors_;
+};
+
+/// loads the points of the tile written by PointCloudTilesWriter:
+/// the first tile.numCorePoints points of the result are from the region of the tile, and all others are from its halo
+MRMESH_API Expected<PointCloud> loadPointCloudTile( const PointCloudTile& tile, VertColors* colors = nullptr );
+
+/// the function processing one loaded tile (with its halo points), see loadPointCloudTile
+using PointCloudTileProcessor = std::function<VoidOrErrStr( const PointCloudTile& tile, const PointCloud& cloud, const VertColors& colors )>;
+
+/// loads the tiles one by one and calls given function for each of them,
+/// so the memory is bounded by the size of the largest tile with its halo
+MRMESH_API VoidOrErrStr processPointCloudTiles( const std::vector<PointCloudTile>& tiles, const PointCloudTileProcessor& processor,
+    const ProgressCallback& cb = {} );
+
+/// performs pointGridSampling tile by tile and returns the sampled points from the regions of all tiles in one cloud
+MRMESH_API Expected<PointCloud> pointGridSamplingTiles( const std::vector<PointCloudTile>& tiles, float voxelSize,
+    VertColors* colors = nullptr, const ProgressCallback& cb = {} );
+
+/// the function receiving the points from the region of one tile (halo points excluded) with the results computed for them
+using PointCloudTileReceiver = std::function<VoidOrErrStr( const PointCloudTile& tile, PointCloud&& corePoints, VertColors&& coreColors )>;
+
+/// computes the normals tile by tile from the neighbors within given radius including halo points,
+/// so the normals coincide with the ones computed for whole cloud if the radius does not exceed the halo width;
+/// the normals are oriented to have nonnegative Z-component, which suits for aerial scans of terrain;
+/// the points from the region of each tile with their normals are passed to the receiver one tile at a time
+MRMESH_API VoidOrErrStr makeNormalsTiles( const std::vector<PointCloudTile>& tiles, float radius,
+    const PointCloudTileReceiver& receiver, const ProgressCallback& cb = {} );
+
+/// the function receiving the part of terrain triangulation built for one tile
+using TerrainTileReceiver = std::function<VoidOrErrStr( const PointCloudTile& tile, Mesh&& part )>;
+
+/// builds terrainTriangulation tile by tile: each tile is triangulated together with its halo points,
+/// and only the triangles with the centers inside the region of the tile are kept, so the parts of neighbor tiles
+/// adjoin each other without overlaps; the parts are separate meshes, where each vertex on a seam is duplicated
+/// in all parts containing it with exactly the same coordinates, so they can be joined by Mesh::addPart and MeshBuilder::uniteCloseVertices;
+/// the parts coincide with the triangles of whole cloud triangulation if the halo contains the circumcircles of all triangles near tile borders,
+/// which can be violated by thin triangles along the convex hull of the cloud
+MRMESH_API VoidOrErrStr terrainTriangulationTiles( const std::vector<PointCloudTile>& tiles,
+    const TerrainTileReceiver& receiver, const ProgressCallback& cb = {} );
+
+/// \}
+
+} // namespace MR
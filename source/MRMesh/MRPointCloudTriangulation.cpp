@@ -19,7 +19,10 @@
 #include "MRLocalTriangulations.h"
 #include "MRMeshFixer.h"
 #include "MREdgePaths.h"
+#include "MRMakeSphereMesh.h"
+#include "MRGTest.h"
 #include <parallel_hashmap/phmap.h>
+#include <numeric>
 
 namespace MR
 {
@@ -32,6 +35,9 @@ public:
     std::optional<Mesh> triangulate( ProgressCallback progressCb );
 
 private:
+    /// finds repeated triangles tile by tile, see TriangulationParameters::tileSize
+    bool findTrianglesByTiles_( Triangulation & t3, Triangulation & t2, ProgressCallback progressCb );
+
     /// constructs mesh from given triangles
     std::optional<Mesh> makeMesh_( Triangulation && t3, Triangulation && t2, ProgressCallback progressCb );
 
@@ -51,6 +57,14 @@ std::optional<Mesh> PointCloudTriangulator::triangulate( ProgressCallback progre
     assert( ( params_.numNeighbours <= 0 && params_.radius > 0 )
          || ( params_.numNeighbours > 0 && params_.radius <= 0 ) );
 
+    if ( params_.tileSize > 0 && pointCloud_.hasNormals() )
+    {
+        Triangulation t3, t2;
+        if ( !findTrianglesByTiles_( t3, t2, subprogress( progressCb, 0.0f, 0.5f ) ) )
+            return {};
+        return makeMesh_( std::move( t3 ), std::move( t2 ), subprogress( progressCb, 0.5f, 1.0f ) );
+    }
+
     auto optLocalTriangulations = TriangulationHelpers::buildUnitedLocalTriangulations( pointCloud_,
         {
             .radius = params_.radius,
@@ -74,6 +88,146 @@ std::optional<Mesh> PointCloudTriangulator::triangulate( ProgressCallback progre
     return makeMesh_( std::move( t3 ), std::move( t2 ), subprogress( progressCb, 0.5f, 1.0f ) );
 }
 
+bool PointCloudTriangulator::findTrianglesByTiles_( Triangulation & t3, Triangulation & t2, ProgressCallback progressCb )
+{
+    MR_TIMER
+    const auto box = pointCloud_.computeBoundingBox();
+    if ( !box.valid() )
+        return true;
+    const float tileSize = params_.tileSize;
+    // by default the halo is twice the radius of points' neighborhoods (or its average value if the neighborhoods are given by the number of points)
+    const float halo = params_.tileHalo > 0 ? params_.tileHalo
+        : 2 * ( params_.radius > 0 ? params_.radius : findAvgPointsRadius( pointCloud_, params_.numNeighbours ) );
+    const auto boxSize = box.size();
+    const Vector3i dims(
+        std::max( 1, (int)std::ceil( boxSize.x / tileSize ) ),
+        std::max( 1, (int)std::ceil( boxSize.y / tileSize ) ),
+        std::max( 1, (int)std::ceil( boxSize.z / tileSize ) ) );
+    auto tileOf = [&] ( const Vector3f & p )
+    {
+        const auto d = ( p - box.min ) / tileSize;
+        return Vector3i(
+            std::clamp( (int)std::floor( d.x ), 0, dims.x - 1 ),
+            std::clamp( (int)std::floor( d.y ), 0, dims.y - 1 ),
+            std::clamp( (int)std::floor( d.z ), 0, dims.z - 1 ) );
+    };
+    auto tileIndex = [&] ( const Vector3i & t )
+    {
+        return ( size_t( t.z ) * dims.y + t.y ) * dims.x + t.x;
+    };
+    const size_t numTiles = size_t( dims.x ) * dims.y * dims.z;
+
+    // calls given function for the tile owning the point and for every other tile with the point in its halo
+    auto forEachTile = [&] ( const Vector3f & p, auto && f )
+    {
+        const auto own = tileOf( p );
+        const auto lo = tileOf( p - Vector3f::diagonal( halo ) );
+        const auto hi = tileOf( p + Vector3f::diagonal( halo ) );
+        for ( int z = lo.z; z <= hi.z; ++z )
+            for ( int y = lo.y; y <= hi.y; ++y )
+                for ( int x = lo.x; x <= hi.x; ++x )
+                    f( tileIndex( { x, y, z } ), Vector3i( x, y, z ) == own );
+    };
+
+    // distribute point ids among tiles: the owned points of each tile go first, then the points of its halo
+    std::vector<size_t> firstPoint( numTiles + 1, 0 );
+    std::vector<size_t> numOwned( numTiles, 0 );
+    for ( auto v : pointCloud_.validPoints )
+        forEachTile( pointCloud_.points[v], [&] ( size_t t, bool own )
+        {
+            ++firstPoint[t + 1];
+            if ( own )
+                ++numOwned[t];
+        } );
+    std::partial_sum( firstPoint.begin(), firstPoint.end(), firstPoint.begin() );
+    std::vector<VertId> tilePoints( firstPoint.back() );
+    std::vector<size_t> nextOwned( firstPoint.begin(), firstPoint.end() - 1 );
+    std::vector<size_t> nextHalo( numTiles );
+    for ( size_t t = 0; t < numTiles; ++t )
+        nextHalo[t] = firstPoint[t] + numOwned[t];
+    for ( auto v : pointCloud_.validPoints )
+        forEachTile( pointCloud_.points[v], [&] ( size_t t, bool own )
+        {
+            tilePoints[own ? nextOwned[t]++ : nextHalo[t]++] = v;
+        } );
+    if ( !reportProgress( progressCb, 0.1f ) )
+        return false;
+
+    std::vector<size_t> nonEmptyTiles;
+    for ( size_t t = 0; t < numTiles; ++t )
+        if ( numOwned[t] > 0 )
+            nonEmptyTiles.push_back( t );
+
+    // triangulate the tiles independently, each tile keeps only the triangles with the smallest vertex id owned by it,
+    // so every triangle is found exactly once
+    std::vector<Triangulation> tileT3( nonEmptyTiles.size() ), tileT2( nonEmptyTiles.size() );
+    if ( !ParallelFor( size_t( 0 ), nonEmptyTiles.size(), [&] ( size_t i )
+    {
+        const auto t = nonEmptyTiles[i];
+        const auto begin = tilePoints.begin() + firstPoint[t];
+        const auto end = tilePoints.begin() + firstPoint[t + 1];
+        const auto numPoints = size_t( end - begin );
+
+        PointCloud tile;
+        tile.points.reserve( numPoints );
+        tile.normals.reserve( numPoints );
+        for ( auto it = begin; it != end; ++it )
+        {
+            tile.points.push_back( pointCloud_.points[*it] );
+            tile.normals.push_back( pointCloud_.normals[*it] );
+        }
+        tile.validPoints.resize( numPoints, true );
+
+        auto localTriangulations = TriangulationHelpers::buildUnitedLocalTriangulations( tile,
+            {
+                .radius = params_.radius,
+                .numNeis = params_.numNeighbours,
+                .critAngle = params_.critAngle,
+                .boundaryAngle = params_.boundaryAngle,
+                .trustedNormals = &tile.normals,
+                .automaticRadiusIncrease = params_.automaticRadiusIncrease
+            } );
+        if ( !localTriangulations )
+            return;
+        Triangulation local3, local2;
+        findRepeatedOrientedTriangles( *localTriangulations, &local3, &local2 );
+        localTriangulations.reset();
+
+        auto keepOwned = [&] ( const Triangulation & local, Triangulation & res )
+        {
+            for ( const auto & tri : local )
+            {
+                int minI = 0;
+                for ( int j = 1; j < 3; ++j )
+                    if ( begin[size_t( tri[j] )] < begin[size_t( tri[minI] )] )
+                        minI = j;
+                if ( size_t( tri[minI] ) >= numOwned[t] )
+                    continue;
+                res.push_back( { begin[size_t( tri[0] )], begin[size_t( tri[1] )], begin[size_t( tri[2] )] } );
+            }
+        };
+        keepOwned( local3, tileT3[i] );
+        keepOwned( local2, tileT2[i] );
+    }, subprogress( progressCb, 0.1f, 0.9f ) ) )
+        return false;
+
+    auto join = [] ( std::vector<Triangulation> & parts, Triangulation & res )
+    {
+        size_t total = 0;
+        for ( const auto & part : parts )
+            total += part.size();
+        res.reserve( total );
+        for ( auto & part : parts )
+        {
+            res.vec_.insert( res.vec_.end(), part.vec_.begin(), part.vec_.end() );
+            part = {};
+        }
+    };
+    join( tileT3, t3 );
+    join( tileT2, t2 );
+    return reportProgress( progressCb, 1.0f );
+}
+
 std::optional<Mesh> PointCloudTriangulator::makeMesh_( Triangulation && t3, Triangulation && t2, ProgressCallback progressCb )
 {
     MR_TIMER
@@ -147,4 +301,35 @@ std::optional<Mesh> triangulatePointCloud( const PointCloud& pointCloud, const T
     return triangulator.triangulate( progressCb );
 }
 
+TEST( MRMesh, TriangulatePointCloudTiles )
+{
+    const auto sphere = makeSphere( { .radius = 1.0f, .numMeshVertices = 3000 } );
+    PointCloud cloud;
+    cloud.points = sphere.points;
+    cloud.validPoints = sphere.topology.getValidVerts();
+    cloud.normals.resize( cloud.points.size() );
+    for ( auto v : cloud.validPoints )
+        cloud.normals[v] = cloud.points[v].normalized();
+
+    TriangulationParameters params;
+    params.critHoleLength = 0;
+    const auto whole = triangulatePointCloud( cloud, params );
+    ASSERT_TRUE( whole.has_value() );
+
+    params.tileSize = 0.7f;
+    params.tileHalo = 0.3f;
+    const auto tiled = triangulatePointCloud( cloud, params );
+    ASSERT_TRUE( tiled.has_value() );
+
+    // with wide enough halo the tiles give exactly the same triangles
+    EXPECT_EQ( tiled->topology.numValidFaces(), whole->topology.numValidFaces() );
+    EXPECT_EQ( tiled->topology.getAllTriVerts(), whole->topology.getAllTriVerts() );
+
+    // the default halo is derived from the size of points' neighborhoods
+    params.tileHalo = 0;
+    const auto tiledDefaultHalo = triangulatePointCloud( cloud, params );
+    ASSERT_TRUE( tiledDefaultHalo.has_value() );
+    EXPECT_EQ( tiledDefaultHalo->topology.getAllTriVerts(), whole->topology.getAllTriVerts() );
+}
+
 } //namespace MR
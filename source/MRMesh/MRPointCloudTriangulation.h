@@ -67,8 +67,19 @@ struct TriangulationParameters
     /// automatic increase of the radius if points outside can make triangles from original radius not-Delone
     bool automaticRadiusIncrease = true;
 
-    /// optional: if provided this cloud will be used for searching of neighbors (so it must have same validPoints)
+    /// optional: if provided this cloud will be used for searching of neighbors (so it must have same validPoints);
+    /// it is ignored if the cloud is triangulated by tiles
     const PointCloud * searchNeighbors = nullptr;
+
+    /// if positive and the cloud has normals then the cloud is subdivided on cubic tiles of this size,
+    /// which are triangulated independently in parallel and only the triangles owned by each tile are kept,
+    /// so the local triangulations of all points are never stored in memory at once
+    float tileSize = 0;
+
+    /// each tile is triangulated together with the points located not further than this distance from it;
+    /// for the result to be the same as without tiling it shall be at least twice the radius of points' neighborhoods;
+    /// if not positive then twice the radius is used, or twice the average radius of numNeighbours points if the radius is not set
+    float tileHalo = 0;
 };
 
 /**
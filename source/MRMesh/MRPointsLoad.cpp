@@ -11,7 +11,10 @@
 #include "MRComputeBoundingBox.h"
 #include "MRPointsLoadE57.h"
 #include "MRBitSetParallelFor.h"
+#include "MRFile.h"
+#include "MRGTest.h"
 
+#include <charconv>
 #include <fstream>
 
 #ifndef MRMESH_NO_OPENCTM
@@ -46,27 +49,18 @@ const IOFilters Filters =
 #endif
 };
 
-Expected<PointCloud> fromText( const std::filesystem::path& file, const PointsLoadSettings& settings )
+namespace
 {
-    std::ifstream in( file, std::ifstream::binary );
-    if ( !in )
-        return unexpected( std::string( "Cannot open file for reading " ) + utf8string( file ) );
 
-    return addFileNameInError( fromText( in, settings ), file );
-}
-
-Expected<PointCloud> fromText( std::istream& in, const PointsLoadSettings& settings )
+// parses points of text file given by the content of whole file
+Expected<PointCloud> parseText( const char* data, size_t size, const PointsLoadSettings& settings )
 {
     MR_TIMER
 
-    auto buf = readCharBuffer( in );
-    if ( !buf )
-        return unexpected( std::move( buf.error() ) );
-
     if ( !reportProgress( settings.callback, 0.50f ) )
         return unexpectedOperationCanceled();
 
-    const auto newlines = splitByLines( buf->data(), buf->size() );
+    const auto newlines = splitByLines( data, size );
     const auto lineCount = newlines.size() - 1;
 
     if ( !reportProgress( settings.callback, 0.60f ) )
@@ -84,7 +78,7 @@ Expected<PointCloud> fromText( std::istream& in, const PointsLoadSettings& setti
     auto hasColors = false;
     for ( auto i = 0; i < lineCount; ++i )
     {
-        const std::string_view line( buf->data() + newlines[i], newlines[i + 1] - newlines[i + 0] );
+        const std::string_view line( data + newlines[i], newlines[i + 1] - newlines[i + 0] );
         if ( line.empty() || line.starts_with( '#' ) || line.starts_with( ';' ) )
             continue;
 
@@ -115,7 +109,7 @@ Expected<PointCloud> fromText( std::istream& in, const PointsLoadSettings& setti
     tbb::task_group_context ctx;
     const auto keepGoing = BitSetParallelForAll( cloud.validPoints, [&] ( VertId v )
     {
-        const std::string_view line( buf->data() + newlines[v], newlines[v + 1] - newlines[v + 0] );
+        const std::string_view line( data + newlines[v], newlines[v + 1] - newlines[v + 0] );
         if ( line.empty() || line.starts_with( '#' ) || line.starts_with( ';' ) )
             return;
 
@@ -146,57 +140,31 @@ Expected<PointCloud> fromText( std::istream& in, const PointsLoadSettings& setti
     return cloud;
 }
 
-Expected<MR::PointCloud> fromText( const std::filesystem::path& file, AffineXf3f* outXf, ProgressCallback callback /*= {} */ )
-{
-    return fromText( file, {
-        .outXf = outXf,
-        .callback = std::move( callback ),
-    } );
-}
-
-Expected<MR::PointCloud> fromText( std::istream& in, AffineXf3f* outXf, ProgressCallback callback /*= {} */ )
+// parses points of .pts file given by the content of whole file including the header line with the number of points
+Expected<PointCloud> parsePts( const char* data, size_t size, VertColors* colors, AffineXf3f* outXf, ProgressCallback callback )
 {
-    return fromText( in, {
-        .outXf = outXf,
-        .callback = std::move( callback ),
-    } );
-}
-
-Expected<MR::PointCloud> fromPts( const std::filesystem::path& file, VertColors* colors /*= nullptr*/, 
-    AffineXf3f* outXf /*= nullptr*/, ProgressCallback callback /*= {} */ )
-{
-    std::ifstream in( file, std::ifstream::binary );
-    if ( !in )
-        return unexpected( std::string( "Cannot open file for reading " ) + utf8string( file ) );
-
-    return addFileNameInError( fromPts( in, colors, outXf, callback ), file );
-}
-
-Expected<MR::PointCloud> fromPts( std::istream& in, VertColors* colors /*= nullptr*/, 
-    AffineXf3f* outXf /*= nullptr*/, ProgressCallback callback /*= {} */ )
-{
-    MR_TIMER;
-    std::string numPointsLine;
-    if ( !std::getline( in, numPointsLine ) )
+    MR_TIMER
+    const auto lineOffsets = splitByLines( data, size );
+    if ( lineOffsets.size() < 2 )
         return unexpected( "Cannot read header line" );
-    auto numPoints = std::atoll( numPointsLine.c_str() );
+    std::string_view numPointsLine( data, lineOffsets[1] - lineOffsets[0] );
+    // std::from_chars does not skip leading whitespaces in contrast to std::atoll
+    numPointsLine.remove_prefix( std::min( numPointsLine.find_first_not_of( " \t" ), numPointsLine.size() ) );
+    long long numPoints = 0;
+    if ( std::from_chars( numPointsLine.data(), numPointsLine.data() + numPointsLine.size(), numPoints ).ec != std::errc() )
+        return unexpected( "Cannot parse the number of points in header line" );
     if ( numPoints == 0 )
         return unexpected( "Empty pts file" );
 
-    auto dataExp = readCharBuffer( in );
-    if ( !dataExp.has_value() )
-        return unexpected( dataExp.error() );
-
     if ( callback && !callback( 0.25f ) )
         return unexpected( "Loading canceled" );
 
-    const auto& data = *dataExp;
-    auto lineOffsets = splitByLines( data.data(), data.size() );
-
-    int firstLine = 1;
+    const int firstLine = 1;
+    if ( lineOffsets.size() < firstLine + 2 )
+        return unexpected( "Empty pts file" );
     Vector3d firstLineCoord;
     Color firstLineColor;
-    std::string_view shitLine( data.data() + lineOffsets[firstLine], lineOffsets[firstLine + 1] - lineOffsets[firstLine] );
+    std::string_view shitLine( data + lineOffsets[firstLine], lineOffsets[firstLine + 1] - lineOffsets[firstLine] );
     auto shiftLineRes = parsePtsCoordinate( shitLine, firstLineCoord, firstLineColor );
     if ( !shiftLineRes.has_value() )
         return unexpected( shiftLineRes.error() );
@@ -205,16 +173,16 @@ Expected<MR::PointCloud> fromPts( std::istream& in, VertColors* colors /*= nullp
         *outXf = AffineXf3f::translation( Vector3f( firstLineCoord ) );
 
     if ( colors )
-        colors->resize( lineOffsets.size() - firstLine - 1 );
+        colors->resizeNoInit( lineOffsets.size() - firstLine - 1 );
 
     PointCloud pc;
-    pc.points.resize( lineOffsets.size() - firstLine - 1 );
+    pc.points.resizeNoInit( lineOffsets.size() - firstLine - 1 );
 
     std::string parseError;
     tbb::task_group_context ctx;
     auto keepGoing = ParallelFor( pc.points, [&] ( size_t i )
     {
-        std::string_view line( data.data() + lineOffsets[firstLine + i], lineOffsets[firstLine + i + 1] - lineOffsets[firstLine + i] );
+        std::string_view line( data + lineOffsets[firstLine + i], lineOffsets[firstLine + i + 1] - lineOffsets[firstLine + i] );
         Vector3d tempDoubleCoord;
         Color tempColor;
         auto parseRes = parsePtsCoordinate( line, tempDoubleCoord, tempColor );
@@ -236,6 +204,65 @@ Expected<MR::PointCloud> fromPts( std::istream& in, VertColors* colors /*= nullp
     return pc;
 }
 
+} // anonymous namespace
+
+Expected<PointCloud> fromText( const std::filesystem::path& file, const PointsLoadSettings& settings )
+{
+    // the file is parsed directly in mapped memory without copying it in a buffer
+    MappedFile mapped;
+    if ( !mapped.open( file ) )
+        return unexpected( std::string( "Cannot open file for reading " ) + utf8string( file ) );
+
+    return addFileNameInError( parseText( mapped.data(), mapped.size(), settings ), file );
+}
+
+Expected<PointCloud> fromText( std::istream& in, const PointsLoadSettings& settings )
+{
+    MR_TIMER
+
+    auto buf = readCharBuffer( in );
+    if ( !buf )
+        return unexpected( std::move( buf.error() ) );
+
+    return parseText( buf->data(), buf->size(), settings );
+}
+
+Expected<MR::PointCloud> fromText( const std::filesystem::path& file, AffineXf3f* outXf, ProgressCallback callback /*= {} */ )
+{
+    return fromText( file, {
+        .outXf = outXf,
+        .callback = std::move( callback ),
+    } );
+}
+
+Expected<MR::PointCloud> fromText( std::istream& in, AffineXf3f* outXf, ProgressCallback callback /*= {} */ )
+{
+    return fromText( in, {
+        .outXf = outXf,
+        .callback = std::move( callback ),
+    } );
+}
+
+Expected<MR::PointCloud> fromPts( const std::filesystem::path& file, VertColors* colors /*= nullptr*/, 
+    AffineXf3f* outXf /*= nullptr*/, ProgressCallback callback /*= {} */ )
+{
+    MappedFile mapped;
+    if ( !mapped.open( file ) )
+        return unexpected( std::string( "Cannot open file for reading " ) + utf8string( file ) );
+
+    return addFileNameInError( parsePts( mapped.data(), mapped.size(), colors, outXf, std::move( callback ) ), file );
+}
+
+Expected<MR::PointCloud> fromPts( std::istream& in, VertColors* colors /*= nullptr*/, 
+    AffineXf3f* outXf /*= nullptr*/, ProgressCallback callback /*= {} */ )
+{
+    auto dataExp = readCharBuffer( in );
+    if ( !dataExp.has_value() )
+        return unexpected( dataExp.error() );
+
+    return parsePts( dataExp->data(), dataExp->size(), colors, outXf, std::move( callback ) );
+}
+
 #ifndef MRMESH_NO_OPENCTM
 
 Expected<MR::PointCloud> fromCtm( const std::filesystem::path& file, VertColors* colors /*= nullptr */, ProgressCallback callback )
@@ -636,5 +663,55 @@ Expected<PointCloud> fromAnySupportedFormat( std::istream& in, const std::string
     return res;
 }
 
+TEST( MRMesh, PointsLoadMappedText )
+{
+    const auto dir = std::filesystem::temp_directory_path() / "MeshLib_PointsLoadMappedText";
+    std::error_code ec;
+    std::filesystem::create_directories( dir, ec );
+
+    const auto ptsFile = dir / "points.pts";
+    {
+        std::ofstream out( ptsFile, std::ofstream::binary );
+        out << "3\n10 20 30 0 255 0 0\n11 20 30 0 0 255 0\n12 20 30 0 0 0 255\n";
+    }
+    VertColors colors;
+    AffineXf3f xf;
+    auto pts = fromPts( ptsFile, &colors, &xf );
+    ASSERT_TRUE( pts.has_value() );
+    ASSERT_EQ( pts->points.size(), 3 );
+    ASSERT_EQ( colors.size(), 3 );
+    EXPECT_EQ( xf( pts->points[0_v] ), Vector3f( 10, 20, 30 ) );
+    EXPECT_EQ( xf( pts->points[2_v] ), Vector3f( 12, 20, 30 ) );
+    EXPECT_EQ( colors[1_v], Color( 0, 255, 0 ) );
+
+    // the number of points can be preceded by whitespaces
+    {
+        std::ofstream out( ptsFile, std::ofstream::binary );
+        out << " \t2\r\n1 2 3 0 10 20 30\r\n4 5 6 0 40 50 60\r\n";
+    }
+    pts = fromPts( ptsFile, nullptr, &xf );
+    ASSERT_TRUE( pts.has_value() );
+    ASSERT_EQ( pts->points.size(), 2 );
+    EXPECT_EQ( xf( pts->points[1_v] ), Vector3f( 4, 5, 6 ) );
+
+    {
+        std::ofstream out( ptsFile, std::ofstream::binary );
+        out << "points\n1 2 3 0 10 20 30\n";
+    }
+    EXPECT_FALSE( fromPts( ptsFile ).has_value() );
+
+    const auto xyzFile = dir / "points.xyz";
+    {
+        std::ofstream out( xyzFile, std::ofstream::binary );
+        out << "# comment\n1 2 3\n4 5 6\n";
+    }
+    auto xyz = fromText( xyzFile, PointsLoadSettings{} );
+    ASSERT_TRUE( xyz.has_value() );
+    EXPECT_EQ( xyz->validPoints.count(), 2 );
+    EXPECT_EQ( xyz->points[2_v], Vector3f( 4, 5, 6 ) );
+
+    std::filesystem::remove_all( dir, ec );
+}
+
 }
 }
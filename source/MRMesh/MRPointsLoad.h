@@ -67,11 +67,24 @@ MRMESH_API Expected<PointCloud> fromE57( const std::filesystem::path& file, Vert
 #endif
 
 #if !defined( MRMESH_NO_LAS )
+/// loads from .las or .laz file; the chunks of compressed points listed in the chunk table of .laz file are decompressed in parallel
+/// \param box if given then only the points inside it (in the coordinates of the file, before applying outXf) are loaded;
+///            since .laz chunks have no bounds, the filter is applied to each decompressed point
+MRMESH_API Expected<PointCloud> fromLas( const std::filesystem::path& file, const PointsLoadSettings& settings, const Box3d* box = nullptr );
 /// loads from .las file
 MRMESH_API Expected<PointCloud> fromLas( const std::filesystem::path& file, VertColors* colors = nullptr,
                                                       AffineXf3f* outXf = nullptr, ProgressCallback callback = {} );
 MRMESH_API Expected<PointCloud> fromLas( std::istream& in, VertColors* colors = nullptr,
                                                       AffineXf3f* outXf = nullptr, ProgressCallback callback = {} );
+
+/// receives next chunk of loaded points and their colors (empty if not requested)
+using PointsChunkCallback = std::function<VoidOrErrStr( PointCloud&& chunk, VertColors&& colors )>;
+
+/// loads .las file by chunks of given number of points without keeping all points in memory,
+/// e.g. to write them in spatial tiles by PointCloudTilesWriter;
+/// \param outXf receives the transformation of all chunks before the first chunk is loaded
+MRMESH_API VoidOrErrStr fromLasByChunks( const std::filesystem::path& file, size_t chunkSize, const PointsChunkCallback& onChunk,
+                                         bool withColors = false, AffineXf3f* outXf = nullptr, ProgressCallback callback = {} );
 #endif
 
 MRMESH_API Expected<PointCloud> fromDxf( const std::filesystem::path& file, ProgressCallback callback = {} );
@@ -5,12 +5,19 @@
 #include "MRStringConvert.h"
 #include "MRQuaternion.h"
 #include "MRTimer.h"
+#include "MRGTest.h"
+#include "MRParallelFor.h"
 #include <MRPch/MRFmt.h>
+#include <MRPch/MRTBB.h>
+#include <atomic>
+#include <memory>
+#include <thread>
 
 #pragma warning(push)
 #pragma warning(disable: 4251) // class needs to have dll-interface to be used by clients of another class
 #pragma warning(disable: 4275) // vcpkg `2022.11.14`: non dll-interface class 'std::exception' used as base for dll-interface class 'e57::E57Exception'
 #include <E57Format/E57SimpleReader.h>
+#include <E57Format/E57SimpleWriter.h>
 #if !__has_include(<E57Format/E57Version.h>)
 #define  MR_OLD_E57
 #endif
@@ -23,6 +30,124 @@ namespace MR
 namespace PointsLoad
 {
 
+namespace
+{
+
+std::unique_ptr<e57::Reader> openE57Reader( const std::filesystem::path& file )
+{
+#ifdef MR_OLD_E57
+    return std::make_unique<e57::Reader>( utf8string( file ) );
+#else
+    return std::make_unique<e57::Reader>( utf8string( file ), e57::ReaderOptions{} );
+#endif
+}
+
+// reads only the first point of the scan
+std::optional<Vector3d> readFirstE57Point( e57::Reader& eReader, int scanIndex )
+{
+#ifdef MR_OLD_E57
+    e57::Data3DPointsData_d buffers;
+#else
+    e57::Data3DPointsDouble buffers;
+#endif
+    Vector3d p;
+    buffers.cartesianX = &p.x;
+    buffers.cartesianY = &p.y;
+    buffers.cartesianZ = &p.z;
+    e57::CompressedVectorReader dataReader = eReader.SetUpData3DPointsData( scanIndex, 1, buffers );
+    const auto size = dataReader.read();
+    dataReader.close();
+    if ( size == 0 )
+        return {};
+    return p;
+}
+
+// the information about one scan found before loading its points
+struct E57ScanInfo
+{
+    AffineXf3d e57Xf;
+    std::optional<AffineXf3d> aXf; // will be applied to all points
+    int64_t numPoints = 0;
+};
+
+// reads the points of one scan, different scans can be read in parallel by different readers;
+// onRead is called after each portion of points with their number, and the reading stops if it returns false
+// \return false if the reading was stopped
+bool loadE57Scan( e57::Reader& eReader, int scanIndex, const E57ScanInfo& info, NamedCloud& nc, const std::function<bool( size_t )>& onRead )
+{
+    // how many points to read in a time
+    const int64_t nSize = std::min( info.numPoints, int64_t( 1024 ) * 128 );
+    if ( nSize <= 0 )
+        return true;
+
+#ifdef MR_OLD_E57
+    e57::Data3DPointsData_d buffers;
+#else
+    e57::Data3DPointsDouble buffers;
+#endif
+    std::vector<double> xs( nSize ), ys( nSize ), zs( nSize );
+    buffers.cartesianX = xs.data();
+    buffers.cartesianY = ys.data();
+    buffers.cartesianZ = zs.data();
+#ifdef MR_OLD_E57
+    std::vector<uint8_t> rs, gs, bs;
+#else
+    std::vector<uint16_t> rs, gs, bs;
+#endif
+    std::vector<int8_t> invalidColors;
+    rs.resize( nSize );
+    gs.resize( nSize );
+    bs.resize( nSize );
+    buffers.colorRed = rs.data();
+    buffers.colorGreen = gs.data();
+    buffers.colorBlue = bs.data();
+    invalidColors.resize( nSize );
+    buffers.isColorInvalid = invalidColors.data();
+
+    e57::CompressedVectorReader dataReader = eReader.SetUpData3DPointsData( scanIndex, nSize, buffers );
+
+    auto & cloud = nc.cloud;
+    auto & colors = nc.colors;
+    cloud.points.reserve( info.numPoints );
+    unsigned long size = 0;
+    bool hasInputColors = false;
+    const auto aXf = info.aXf.value_or( AffineXf3d() );
+    while ( ( size = dataReader.read() ) > 0 )
+    {
+        if ( cloud.points.empty() )
+        {
+            hasInputColors = invalidColors.front() == 0;
+            if ( hasInputColors )
+                colors.reserve( info.numPoints );
+        }
+        for ( unsigned long i = 0; i < size; ++i )
+        {
+            const auto p = Vector3d( buffers.cartesianX[i], buffers.cartesianY[i], buffers.cartesianZ[i] );
+            cloud.points.emplace_back( Vector3f( aXf( p ) ) );
+            if ( hasInputColors )
+            {
+                colors.emplace_back(
+                    buffers.colorRed[i],
+                    buffers.colorGreen[i],
+                    buffers.colorBlue[i]
+                );
+            }
+        }
+        if ( !onRead( size ) )
+        {
+            dataReader.close();
+            return false;
+        }
+    }
+
+    assert( cloud.points.size() == (size_t)info.numPoints );
+    cloud.validPoints.resize( cloud.points.size(), true );
+    dataReader.close();
+    return true;
+}
+
+} // anonymous namespace
+
 Expected<std::vector<NamedCloud>> fromSceneE57File( const std::filesystem::path& file, const E57LoadSettings & settings )
 {
     MR_TIMER
@@ -33,30 +158,36 @@ Expected<std::vector<NamedCloud>> fromSceneE57File( const std::filesystem::path&
 
     try
     {
-#ifdef MR_OLD_E57
-        e57::Reader eReader( utf8string( file ) );
-#else
-        e57::Reader eReader( utf8string( file ), {} );
-#endif
-        const auto numScans = eReader.GetData3DCount();
+        // find the transformations of all scans first, since the transformation of a scan can depend on previous scans
+        auto eReader = openE57Reader( file );
+        const auto numScans = eReader->GetData3DCount();
         res.resize( numScans );
+        std::vector<E57ScanInfo> infos( numScans );
         for ( int scanIndex = 0; scanIndex < numScans; ++scanIndex )
         {
-            auto sp = subprogress( settings.progress, float( scanIndex ) / numScans, float( scanIndex + 1 ) / numScans );
             auto & nc = res[scanIndex];
+            auto & info = infos[scanIndex];
             e57::Data3D scanHeader;
-            eReader.ReadData3D( scanIndex, scanHeader );
+            eReader->ReadData3D( scanIndex, scanHeader );
             nc.name = scanHeader.name;
-            const AffineXf3d e57Xf(
+            info.e57Xf = AffineXf3d(
                 Quaterniond( scanHeader.pose.rotation.w, scanHeader.pose.rotation.x, scanHeader.pose.rotation.y, scanHeader.pose.rotation.z ),
                 Vector3d( scanHeader.pose.translation.x, scanHeader.pose.translation.y, scanHeader.pose.translation.z )
             );
 
-            std::optional<AffineXf3d> aXf; // will be applied to all points
+            int64_t nColumn = 0;
+            int64_t nRow = 0;
+            int64_t nGroupsSize = 0;
+            int64_t nCountSize = 0;
+            bool bColumnIndex = false;
+            if ( !eReader->GetData3DSizes( scanIndex, nRow, nColumn, info.numPoints, nGroupsSize, nCountSize, bColumnIndex) )
+                return MR::unexpected( std::string( "GetData3DSizes failed during reading of " + utf8string( file ) ) );
+
+            auto & aXf = info.aXf;
             if ( settings.identityXf )
-                aXf = e57Xf;
+                aXf = info.e57Xf;
             else if ( settings.combineAllObjects && xf0 )
-                aXf = xf0->inverse() * e57Xf;
+                aXf = xf0->inverse() * info.e57Xf;
 
             if ( !aXf )
             {
@@ -68,93 +199,58 @@ Expected<std::vector<NamedCloud>> fromSceneE57File( const std::filesystem::path&
                 if ( box.valid() )
                     aXf = AffineXf3d::translation( -box.center() );
             }
-
-            int64_t nColumn = 0;
-            int64_t nRow = 0;
-            int64_t nPointsSize = 0;
-            int64_t nGroupsSize = 0;
-            int64_t nCountSize = 0;
-            bool bColumnIndex = false;
-
-            if ( !eReader.GetData3DSizes( scanIndex, nRow, nColumn, nPointsSize, nGroupsSize, nCountSize, bColumnIndex) )
-                return MR::unexpected( std::string( "GetData3DSizes failed during reading of " + utf8string( file ) ) );
-
-            // how many points to read in a time
-            const int64_t nSize = std::min( nPointsSize, int64_t( 1024 ) * 128 );
-
-    #ifdef MR_OLD_E57
-            e57::Data3DPointsData_d buffers;
-    #else
-            e57::Data3DPointsDouble buffers;
-    #endif
-            std::vector<double> xs( nSize ), ys( nSize ), zs( nSize );
-            buffers.cartesianX = xs.data();
-            buffers.cartesianY = ys.data();
-            buffers.cartesianZ = zs.data();
-    #ifdef MR_OLD_E57
-            std::vector<uint8_t> rs, gs, bs;
-    #else
-            std::vector<uint16_t> rs, gs, bs;
-    #endif
-            std::vector<int8_t> invalidColors;
-            rs.resize( nSize );
-            gs.resize( nSize );
-            bs.resize( nSize );
-            buffers.colorRed = rs.data();
-            buffers.colorGreen = gs.data();
-            buffers.colorBlue = bs.data();
-            invalidColors.resize( nSize );
-            buffers.isColorInvalid = invalidColors.data();
-
-            e57::CompressedVectorReader dataReader = eReader.SetUpData3DPointsData( scanIndex, nSize, buffers );
-
-            auto & cloud = nc.cloud;
-            auto & colors = nc.colors;
-            cloud.points.reserve( nPointsSize );
-            unsigned long size = 0;
-            bool hasInputColors = false;
-            while ( ( size = dataReader.read() ) > 0 )
+            if ( !aXf && info.numPoints > 0 )
             {
-                reportProgress( sp, float( cloud.points.size() ) / nPointsSize );
-                if ( cloud.points.empty() )
-                {
-                    hasInputColors = invalidColors.front() == 0;
-                    if ( hasInputColors )
-                        colors.reserve( nPointsSize );
-                }
-                if ( !aXf )
-                {
-                    aXf = AffineXf3d::translation(
-                    {
-                        -buffers.cartesianX[0],
-                        -buffers.cartesianY[0],
-                        -buffers.cartesianZ[0],
-                    } );
-                }
-                for ( unsigned long i = 0; i < size; ++i )
-                {
-                    const auto p = Vector3d( buffers.cartesianX[i], buffers.cartesianY[i], buffers.cartesianZ[i] );
-                    cloud.points.emplace_back( Vector3f( (*aXf)( p ) ) );
-                    if ( hasInputColors )
-                    {
-                        colors.emplace_back(
-                            buffers.colorRed[i],
-                            buffers.colorGreen[i],
-                            buffers.colorBlue[i]
-                        );
-                    }
-                }
+                if ( auto p = readFirstE57Point( *eReader, scanIndex ) )
+                    aXf = AffineXf3d::translation( -*p );
             }
 
-            assert( cloud.points.size() == (size_t)nPointsSize );
-            cloud.validPoints.resize( cloud.points.size(), true );
-
-            dataReader.close();
             nc.xf = ( settings.identityXf || !aXf ) ? AffineXf3f() :
-                AffineXf3f( e57Xf * aXf->inverse() );
+                AffineXf3f( info.e57Xf * aXf->inverse() );
             if ( !xf0 && aXf )
-                xf0 = e57Xf * aXf->inverse();
+                xf0 = info.e57Xf * aXf->inverse();
         }
+
+        // the progress is measured in points, since the scans can be of very different size
+        int64_t totalPoints = 0;
+        for ( const auto& info : infos )
+            totalPoints += info.numPoints;
+        std::atomic<int64_t> pointsRead{ 0 };
+        std::atomic<bool> canceled{ false };
+        const auto callingThreadId = std::this_thread::get_id();
+        auto onRead = [&] ( size_t numRead )
+        {
+            const auto done = pointsRead += int64_t( numRead );
+            if ( canceled )
+                return false;
+            // only the calling thread reports progress
+            if ( std::this_thread::get_id() == callingThreadId && totalPoints > 0
+                && !reportProgress( settings.progress, float( done ) / float( totalPoints ) ) )
+                canceled = true;
+            return !canceled;
+        };
+
+        if ( numScans == 1 )
+        {
+            // single scan is read by the reader already opened
+            loadE57Scan( *eReader, 0, infos[0], res[0], onRead );
+        }
+        else
+        {
+            eReader.reset();
+            // the scans are read in parallel, each thread opens its own reader once and uses it for all its scans
+            tbb::enumerable_thread_specific<std::unique_ptr<e57::Reader>> scanReaders;
+            ParallelFor( 0, int( numScans ), scanReaders, [&] ( int scanIndex, std::unique_ptr<e57::Reader>& scanReader )
+            {
+                if ( canceled )
+                    return;
+                if ( !scanReader )
+                    scanReader = openE57Reader( file );
+                loadE57Scan( *scanReader, scanIndex, infos[scanIndex], res[scanIndex], onRead );
+            } );
+        }
+        if ( canceled )
+            return unexpectedOperationCanceled();
     }
     catch( const e57::E57Exception & e )
     {
@@ -197,6 +293,109 @@ Expected<std::vector<NamedCloud>> fromSceneE57File( const std::filesystem::path&
     return res;
 }
 
+#ifndef MR_OLD_E57
+TEST( MRMesh, PointsLoadE57Scans )
+{
+    const auto dir = std::filesystem::temp_directory_path() / "MeshLib_PointsLoadE57Scans";
+    std::error_code ec;
+    std::filesystem::create_directories( dir, ec );
+    const auto file = dir / "scans.e57";
+
+    // the second scan is larger than one portion of reading, and it is rotated around Z-axis by 90 degrees
+    const std::array<int64_t, 3> numPoints = { 1000, 200000, 50 };
+    auto localPoint = [] ( int s, int64_t i )
+    {
+        return Vector3d( 0.25 * ( i % 100 ), 0.25 * ( i / 100 % 100 ), 0.5 * s );
+    };
+    auto pointColor = [] ( int s, int64_t i )
+    {
+        return Color( int( i % 256 ), s, 7 );
+    };
+    std::vector<AffineXf3d> poses;
+    {
+        e57::WriterOptions options;
+        options.guid = "MeshLib_PointsLoadE57Scans";
+        e57::Writer writer( utf8string( file ), options );
+        for ( int s = 0; s < (int)numPoints.size(); ++s )
+        {
+            e57::Data3D header;
+            header.guid = fmt::format( "scan{}", s );
+            header.name = fmt::format( "Scan {}", s );
+            header.pointCount = numPoints[s];
+            header.pointFields.cartesianXField = header.pointFields.cartesianYField = header.pointFields.cartesianZField = true;
+            header.pointFields.colorRedField = header.pointFields.colorGreenField = header.pointFields.colorBlueField = true;
+            header.colorLimits.colorRedMaximum = header.colorLimits.colorGreenMaximum = header.colorLimits.colorBlueMaximum = 255;
+            header.pose.rotation.w = s == 1 ? std::sqrt( 0.5 ) : 1.0;
+            header.pose.rotation.z = s == 1 ? std::sqrt( 0.5 ) : 0.0;
+            header.pose.translation.x = 10.0 * s;
+            Box3d box;
+            for ( int64_t i = 0; i < numPoints[s]; ++i )
+                box.include( localPoint( s, i ) );
+            header.cartesianBounds.xMinimum = box.min.x;
+            header.cartesianBounds.xMaximum = box.max.x;
+            header.cartesianBounds.yMinimum = box.min.y;
+            header.cartesianBounds.yMaximum = box.max.y;
+            header.cartesianBounds.zMinimum = box.min.z;
+            header.cartesianBounds.zMaximum = box.max.z;
+            poses.push_back( AffineXf3d( Quaterniond( header.pose.rotation.w, 0, 0, header.pose.rotation.z ), Vector3d( 10.0 * s, 0, 0 ) ) );
+
+            e57::Data3DPointsDouble buffers( header );
+            for ( int64_t i = 0; i < numPoints[s]; ++i )
+            {
+                const auto p = localPoint( s, i );
+                buffers.cartesianX[i] = p.x;
+                buffers.cartesianY[i] = p.y;
+                buffers.cartesianZ[i] = p.z;
+                const auto c = pointColor( s, i );
+                buffers.colorRed[i] = c.r;
+                buffers.colorGreen[i] = c.g;
+                buffers.colorBlue[i] = c.b;
+            }
+            writer.WriteData3DData( header, buffers );
+        }
+        writer.Close();
+    }
+
+    // the scans are loaded in parallel with their own transformations applied to the points
+    auto scans = fromSceneE57File( file, { .identityXf = true } );
+    ASSERT_TRUE( scans.has_value() );
+    ASSERT_EQ( scans->size(), numPoints.size() );
+    for ( int s = 0; s < (int)numPoints.size(); ++s )
+    {
+        const auto & scan = ( *scans )[s];
+        EXPECT_EQ( scan.name, fmt::format( "Scan {}", s ) );
+        EXPECT_EQ( scan.xf, AffineXf3f() );
+        ASSERT_EQ( scan.cloud.points.size(), numPoints[s] );
+        ASSERT_EQ( scan.colors.size(), numPoints[s] );
+        EXPECT_EQ( scan.cloud.validPoints.count(), numPoints[s] );
+        for ( int64_t i = 0; i < numPoints[s]; ++i )
+        {
+            const auto v = VertId( size_t( i ) );
+            EXPECT_LT( ( Vector3d( scan.cloud.points[v] ) - poses[s]( localPoint( s, i ) ) ).length(), 1e-5 );
+            EXPECT_EQ( scan.colors[v], pointColor( s, i ) );
+        }
+    }
+
+    // all scans in one cloud with common transformation
+    auto combined = fromSceneE57File( file, { .combineAllObjects = true } );
+    ASSERT_TRUE( combined.has_value() );
+    ASSERT_EQ( combined->size(), 1 );
+    const auto & all = combined->front();
+    ASSERT_EQ( all.cloud.points.size(), numPoints[0] + numPoints[1] + numPoints[2] );
+    EXPECT_EQ( all.colors.size(), all.cloud.points.size() );
+    auto v = 0_v;
+    for ( int s = 0; s < (int)numPoints.size(); ++s )
+        for ( int64_t i = 0; i < numPoints[s]; ++i, ++v )
+            EXPECT_LT( ( Vector3d( all.xf( all.cloud.points[v] ) ) - poses[s]( localPoint( s, i ) ) ).length(), 1e-4 );
+
+    // cancellation
+    auto canceled = fromSceneE57File( file, { .progress = [] ( float p ) { return p < 0.5f; } } );
+    EXPECT_FALSE( canceled.has_value() );
+
+    std::filesystem::remove_all( dir, ec );
+}
+#endif // MR_OLD_E57
+
 } //namespace PointsLoad
 
 } //namespace MR
@@ -3,9 +3,18 @@
 #include "MRAffineXf3.h"
 #include "MRBox.h"
 #include "MRColor.h"
+#include "MRGTest.h"
+#include "MRParallelFor.h"
 #include "MRPointCloud.h"
+#include "MRPointCloudTiles.h"
 #include "MRStringConvert.h"
+#include "MRTimer.h"
 #include "MRPch/MRFmt.h"
+#include "MRPch/MRTBB.h"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
 
 #if _MSC_VER >= 1937 // Visual Studio 2022 version 17.7
 #pragma warning( push )
@@ -13,6 +22,7 @@
 #endif
 #include <lazperf/lazperf.hpp>
 #include <lazperf/readers.hpp>
+#include <lazperf/writers.hpp>
 #if _MSC_VER >= 1937 // Visual Studio 2022 version 17.7
 #pragma warning( pop )
 #endif
@@ -223,73 +233,352 @@ Color getColor( uint8_t classification )
         return Color::black();
 }
 
-Expected<PointCloud> process( lazperf::reader::basic_file& reader, VertColors* colors, AffineXf3f* outXf, ProgressCallback callback )
+// converts point records of the file into the coordinates and colors of the result
+class PointDecoder
+{
+public:
+    PointDecoder( const lazperf::header14& header, const Box3d* box, AffineXf3f* outXf )
+        : format_( header.pointFormat() )
+        , scale_( header.scale.x, header.scale.y, header.scale.z )
+        , offset_( header.offset.x, header.offset.y, header.offset.z )
+    {
+        if ( outXf )
+        {
+            const Box3d fileBox {
+                { header.minx, header.miny, header.minz },
+                { header.maxx, header.maxy, header.maxz },
+            };
+            center_ = fileBox.center();
+            *outXf = AffineXf3f::translation( Vector3f( center_ ) );
+            offset_ -= center_;
+        }
+        if ( box )
+            box_ = Box3d( box->min - center_, box->max - center_ );
+    }
+
+    int format() const { return format_; }
+
+    /// returns false if the point is filtered out by the box
+    bool decode( const char* buf, Vector3f& pos, Color* color ) const
+    {
+        const auto point = getPoint( buf, format_ );
+        const Vector3d posd {
+            point.x * scale_.x + offset_.x,
+            point.y * scale_.y + offset_.y,
+            point.z * scale_.z + offset_.z,
+        };
+        if ( box_ && !box_->contains( posd ) )
+            return false;
+        pos = Vector3f( posd );
+
+        if ( color )
+        {
+            if ( hasColorChannels( format_ ) )
+            {
+                const auto colorChannels = *getColorChannels( buf, format_ );
+                *color = Color( colorChannels.red, colorChannels.green, colorChannels.blue );
+            }
+            else
+            {
+                *color = getColor( getClassification( buf, format_ ) );
+            }
+        }
+        return true;
+    }
+
+private:
+    int format_ = 0;
+    Vector3d scale_;
+    Vector3d offset_;
+    Vector3d center_;
+    std::optional<Box3d> box_;
+};
+
+VoidOrErrStr processByChunks( lazperf::reader::basic_file& reader, size_t chunkSize, bool withColors, const Box3d* box,
+    const PointsLoad::PointsChunkCallback& onChunk, AffineXf3f* outXf, ProgressCallback callback )
 {
     const auto pointCount = reader.pointCount();
 
     const auto& header = reader.header();
-    const auto pointFormat = header.pointFormat();
 
     constexpr size_t maxPointRecordLength = sizeof( LasPoint10 );
     std::array<char, maxPointRecordLength> buf { '\0' };
     if ( buf.size() < header.point_record_length )
         return unexpected( fmt::format( "Unsupported LAS format version: {}.{}", header.version.major, header.version.minor ) );
 
-    PointCloud result;
-    result.points.reserve( pointCount );
-    if ( colors )
-        colors->reserve( pointCount );
+    const PointDecoder decoder( header, box, outXf );
 
-    Vector3d offset {
-        header.offset.x,
-        header.offset.y,
-        header.offset.z,
+    chunkSize = std::max( chunkSize, size_t( 1 ) );
+    PointCloud chunk;
+    VertColors colors;
+    auto startChunk = [&] ( size_t firstPoint )
+    {
+        const auto size = std::min( chunkSize, size_t( pointCount ) - firstPoint );
+        chunk.points.reserve( size );
+        if ( withColors )
+            colors.reserve( size );
     };
-    if ( outXf )
+    auto finishChunk = [&]
     {
-        const Box3d box {
-            { header.minx, header.miny, header.minz },
-            { header.maxx, header.maxy, header.maxz },
-        };
-        const auto center = box.center();
-        *outXf = AffineXf3f::translation( Vector3f( center ) );
-        offset -= center;
-    }
+        chunk.validPoints.resize( chunk.points.size(), true );
+        auto res = onChunk( std::move( chunk ), std::move( colors ) );
+        chunk = {};
+        colors = {};
+        return res;
+    };
 
-    for ( auto i = 0; i < pointCount; ++i )
+    startChunk( 0 );
+    Vector3f pos;
+    Color color;
+    for ( size_t i = 0; i < pointCount; ++i )
     {
-        if ( i % 4096 == 0 )
-            reportProgress( callback, (float)i / (float)pointCount );
+        if ( i % 4096 == 0 && !reportProgress( callback, (float)i / (float)pointCount ) )
+            return unexpectedOperationCanceled();
 
         reader.readPoint( buf.data() );
-        const auto point = getPoint( buf.data(), pointFormat );
-        const Vector3d pos {
-            point.x * header.scale.x + offset.x,
-            point.y * header.scale.y + offset.y,
-            point.z * header.scale.z + offset.z,
-        };
-        result.points.emplace_back( pos );
+        if ( !decoder.decode( buf.data(), pos, withColors ? &color : nullptr ) )
+            continue;
+        chunk.points.push_back( pos );
+        if ( withColors )
+            colors.push_back( color );
 
+        if ( chunk.points.size() == chunkSize )
+        {
+            if ( auto res = finishChunk(); !res )
+                return res;
+            startChunk( i + 1 );
+        }
+    }
+    if ( !chunk.points.empty() )
+        return finishChunk();
+    return {};
+}
+
+Expected<PointCloud> process( lazperf::reader::basic_file& reader, VertColors* colors, const Box3d* box, AffineXf3f* outXf, ProgressCallback callback )
+{
+    // all points in one chunk
+    PointCloud result;
+    auto res = processByChunks( reader, reader.pointCount(), colors != nullptr, box, [&] ( PointCloud&& chunk, VertColors&& chunkColors ) -> VoidOrErrStr
+    {
+        result = std::move( chunk );
         if ( colors )
+            *colors = std::move( chunkColors );
+        return {};
+    }, outXf, std::move( callback ) );
+    if ( !res )
+        return unexpected( std::move( res.error() ) );
+    return result;
+}
+
+template <typename T>
+bool readAt( std::istream& in, uint64_t pos, T& value )
+{
+    in.seekg( pos );
+    in.read( (char*)&value, sizeof( T ) );
+    return bool( in );
+}
+
+// the location of independently compressed chunks of points in .laz file
+struct LazChunkTable
+{
+    int format = 0;
+    int ebCount = 0;
+    uint16_t pointRecordLength = 0;
+    /// the number of points and the absolute offset of each chunk in the file
+    std::vector<lazperf::chunk> chunks;
+    /// the offset right after the last chunk
+    uint64_t end = 0;
+};
+
+// returns the size of the point record of given format without extra bytes
+int baseRecordLength( int format )
+{
+    constexpr std::array<int, 11> sizes = {
+        sizeof( LasPoint0 ), sizeof( LasPoint1 ), sizeof( LasPoint2 ), sizeof( LasPoint3 ), sizeof( LasPoint4 ), sizeof( LasPoint5 ),
+        sizeof( LasPoint6 ), sizeof( LasPoint7 ), sizeof( LasPoint8 ), sizeof( LasPoint9 ), sizeof( LasPoint10 ),
+    };
+    return 0 <= format && format < (int)sizes.size() ? sizes[format] : 0;
+}
+
+// reads the chunk table of .laz file (the header fields are read from the file directly following LAS specification);
+// returns std::nullopt if the file is not compressed or its chunk table cannot be used
+std::optional<LazChunkTable> readLazChunkTable( std::istream& in, uint64_t pointCount )
+{
+    uint16_t headerSize = 0;
+    uint32_t pointOffset = 0;
+    uint32_t vlrCount = 0;
+    uint8_t pointFormatId = 0;
+    uint16_t pointRecordLength = 0;
+    if ( !readAt( in, 94, headerSize ) || !readAt( in, 96, pointOffset ) || !readAt( in, 100, vlrCount )
+        || !readAt( in, 104, pointFormatId ) || !readAt( in, 105, pointRecordLength ) )
+        return {};
+    if ( ( pointFormatId & 0x80 ) == 0 )
+        return {}; // not compressed
+
+    LazChunkTable res;
+    res.format = pointFormatId & 0x3F;
+    res.pointRecordLength = pointRecordLength;
+    res.ebCount = int( pointRecordLength ) - baseRecordLength( res.format );
+    if ( baseRecordLength( res.format ) == 0 || res.ebCount < 0 )
+        return {};
+
+    // find LASzip VLR with the size of chunks
+    constexpr uint32_t variableChunkSize = 0xFFFFFFFF;
+    std::optional<uint32_t> chunkSize;
+    uint64_t vlrPos = headerSize;
+    for ( uint32_t i = 0; i < vlrCount && !chunkSize; ++i )
+    {
+        std::array<char, 16> userId;
+        uint16_t recordId = 0;
+        uint16_t recordLength = 0;
+        if ( !readAt( in, vlrPos + 2, userId ) || !readAt( in, vlrPos + 18, recordId ) || !readAt( in, vlrPos + 20, recordLength ) )
+            return {};
+        constexpr uint64_t vlrHeaderSize = 54;
+        if ( std::string_view( userId.data(), strnlen( userId.data(), userId.size() ) ) == "laszip encoded" && recordId == 22204 )
         {
-            if ( hasColorChannels( pointFormat ) )
-            {
-                const auto colorChannels = *getColorChannels( buf.data(), pointFormat );
-                colors->emplace_back(
-                    colorChannels.red,
-                    colorChannels.green,
-                    colorChannels.blue
-                );
-            }
-            else
+            uint32_t size = 0;
+            if ( !readAt( in, vlrPos + vlrHeaderSize + 12, size ) )
+                return {};
+            chunkSize = size;
+        }
+        vlrPos += vlrHeaderSize + recordLength;
+    }
+    if ( !chunkSize || *chunkSize == 0 )
+        return {};
+
+    int64_t tableOffset = 0;
+    if ( !readAt( in, pointOffset, tableOffset ) )
+        return {};
+    if ( tableOffset == -1 )
+    {
+        // the offset was not known at the moment of writing point data, so it is stored at the end of the file
+        in.seekg( -8, std::ios::end );
+        in.read( (char*)&tableOffset, sizeof( tableOffset ) );
+        if ( !in )
+            return {};
+    }
+    uint32_t tableVersion = 0;
+    uint32_t numChunks = 0;
+    if ( tableOffset <= pointOffset || !readAt( in, tableOffset, tableVersion ) || !readAt( in, tableOffset + 4, numChunks ) || numChunks == 0 )
+        return {};
+
+    // the table contains the compressed sizes of chunks (and the numbers of points for variable chunks)
+    in.seekg( tableOffset + 8 );
+    const bool variable = *chunkSize == variableChunkSize;
+    try
+    {
+        res.chunks = lazperf::decompress_chunk_table( [&in] ( unsigned char* buf, size_t len )
+        {
+            in.read( (char*)buf, len );
+            if ( !in )
+                throw std::runtime_error( "Failed to read chunk table" );
+        }, numChunks, variable );
+    }
+    catch ( const std::exception& )
+    {
+        // truncated or corrupted table, the points are decoded sequentially then
+        return {};
+    }
+    if ( res.chunks.size() != numChunks )
+        return {};
+
+    uint64_t offset = uint64_t( pointOffset ) + sizeof( int64_t );
+    uint64_t numPoints = 0;
+    for ( auto& chunk : res.chunks )
+    {
+        if ( !variable )
+            chunk.count = std::min( uint64_t( *chunkSize ), pointCount - numPoints );
+        numPoints += chunk.count;
+        const auto size = chunk.offset;
+        chunk.offset = offset;
+        offset += size;
+    }
+    res.end = offset;
+    if ( numPoints != pointCount || res.end > uint64_t( tableOffset ) )
+        return {};
+    return res;
+}
+
+// decompresses all chunks of .laz file in parallel directly into their ranges of the result
+Expected<PointCloud> processLazParallel( const std::filesystem::path& file, const LazChunkTable& table, const PointDecoder& decoder,
+    VertColors* colors, const Box3d* box, ProgressCallback callback )
+{
+    MR_TIMER
+    const auto numChunks = table.chunks.size();
+    std::vector<size_t> firstPoint( numChunks + 1, 0 );
+    for ( size_t i = 0; i < numChunks; ++i )
+        firstPoint[i + 1] = firstPoint[i] + table.chunks[i].count;
+
+    PointCloud result;
+    result.points.resizeNoInit( firstPoint.back() );
+    if ( colors )
+        colors->resizeNoInit( firstPoint.back() );
+
+    struct ChunkReader
+    {
+        std::ifstream in;
+        std::vector<char> compressed;
+        std::vector<char> record;
+    };
+    tbb::enumerable_thread_specific<ChunkReader> readers;
+    std::vector<size_t> numLoaded( numChunks, 0 );
+    std::atomic<bool> readFailed{ false };
+    const bool keepGoing = ParallelFor( size_t( 0 ), numChunks, readers, [&] ( size_t i, ChunkReader& reader )
+    {
+        if ( readFailed )
+            return;
+        if ( !reader.in.is_open() )
+        {
+            reader.in.open( file, std::ifstream::binary );
+            reader.record.resize( table.pointRecordLength );
+        }
+        const auto& chunk = table.chunks[i];
+        const auto chunkEnd = i + 1 < numChunks ? table.chunks[i + 1].offset : table.end;
+        reader.compressed.resize( chunkEnd - chunk.offset );
+        reader.in.seekg( chunk.offset );
+        reader.in.read( reader.compressed.data(), reader.compressed.size() );
+        if ( !reader.in )
+        {
+            readFailed = true;
+            return;
+        }
+
+        lazperf::reader::chunk_decompressor decompressor( table.format, table.ebCount, reader.compressed.data() );
+        auto v = VertId( firstPoint[i] );
+        for ( uint64_t k = 0; k < chunk.count; ++k )
+        {
+            decompressor.decompress( reader.record.data() );
+            if ( decoder.decode( reader.record.data(), result.points[v], colors ? &( *colors )[v] : nullptr ) )
+                ++v;
+        }
+        numLoaded[i] = size_t( v ) - firstPoint[i];
+    }, callback );
+
+    if ( !keepGoing )
+        return unexpectedOperationCanceled();
+    if ( readFailed )
+        return unexpected( "Failed to read compressed points from " + utf8string( file ) );
+
+    if ( box )
+    {
+        // move the points passed the filter from the ranges of their chunks together
+        size_t numPoints = 0;
+        for ( size_t i = 0; i < numChunks; ++i )
+        {
+            const auto begin = result.points.vec_.begin() + firstPoint[i];
+            std::copy( begin, begin + numLoaded[i], result.points.vec_.begin() + numPoints );
+            if ( colors )
             {
-                colors->emplace_back( getColor( getClassification( buf.data(), pointFormat ) ) );
+                const auto colorsBegin = colors->vec_.begin() + firstPoint[i];
+                std::copy( colorsBegin, colorsBegin + numLoaded[i], colors->vec_.begin() + numPoints );
             }
+            numPoints += numLoaded[i];
         }
+        result.points.resize( numPoints );
+        if ( colors )
+            colors->resize( numPoints );
     }
-
     result.validPoints.resize( result.points.size(), true );
-
     return result;
 }
 
@@ -298,12 +587,25 @@ Expected<PointCloud> process( lazperf::reader::basic_file& reader, VertColors* c
 namespace MR::PointsLoad
 {
 
-Expected<PointCloud> fromLas( const std::filesystem::path& file, VertColors* colors, AffineXf3f* outXf, ProgressCallback callback )
+Expected<PointCloud> fromLas( const std::filesystem::path& file, const PointsLoadSettings& settings, const Box3d* box )
 {
+    MR_TIMER
     try
     {
         lazperf::reader::named_file reader( utf8string( file ) );
-        return process( reader, colors, outXf, std::move( callback ) );
+
+        std::optional<LazChunkTable> table;
+        {
+            std::ifstream in( file, std::ifstream::binary );
+            if ( in )
+                table = readLazChunkTable( in, reader.pointCount() );
+        }
+        // the files with single chunk or with unusual layout are decoded sequentially
+        if ( !table || table->chunks.size() < 2 )
+            return process( reader, settings.colors, box, settings.outXf, settings.callback );
+
+        const PointDecoder decoder( reader.header(), box, settings.outXf );
+        return processLazParallel( file, *table, decoder, settings.colors, box, settings.callback );
     }
     catch ( const std::exception& exc )
     {
@@ -311,12 +613,17 @@ Expected<PointCloud> fromLas( const std::filesystem::path& file, VertColors* col
     }
 }
 
+Expected<PointCloud> fromLas( const std::filesystem::path& file, VertColors* colors, AffineXf3f* outXf, ProgressCallback callback )
+{
+    return fromLas( file, { .colors = colors, .outXf = outXf, .callback = std::move( callback ) } );
+}
+
 Expected<PointCloud> fromLas( std::istream& in, VertColors* colors, AffineXf3f* outXf, ProgressCallback callback )
 {
     try
     {
         lazperf::reader::generic_file reader( in );
-        return process( reader, colors, outXf, std::move( callback ) );
+        return process( reader, colors, nullptr, outXf, std::move( callback ) );
     }
     catch ( const std::exception& exc )
     {
@@ -324,6 +631,167 @@ Expected<PointCloud> fromLas( std::istream& in, VertColors* colors, AffineXf3f*
     }
 }
 
+VoidOrErrStr fromLasByChunks( const std::filesystem::path& file, size_t chunkSize, const PointsChunkCallback& onChunk,
+    bool withColors, AffineXf3f* outXf, ProgressCallback callback )
+{
+    try
+    {
+        lazperf::reader::named_file reader( utf8string( file ) );
+        return processByChunks( reader, chunkSize, withColors, nullptr, onChunk, outXf, std::move( callback ) );
+    }
+    catch ( const std::exception& exc )
+    {
+        return unexpected( fmt::format( "Failed to read file: {}", exc.what() ) );
+    }
+}
+
+// writes test .laz file with the points (0.01 * i, 0.02 * i, 0.01 * (i % 7)) of classes i % 3
+static void writeTestLaz( const std::filesystem::path& file, int numPoints, unsigned chunkSize )
+{
+    lazperf::writer::named_file writer( utf8string( file ),
+        lazperf::writer::named_file::config( { 0.01, 0.01, 0.01 }, { 0, 0, 0 }, chunkSize ) );
+    for ( int i = 0; i < numPoints; ++i )
+    {
+        LasPoint0 p{};
+        p.x = i;
+        p.y = 2 * i;
+        p.z = i % 7;
+        p.classification = uint8_t( i % 3 );
+        writer.writePoint( (const char*)&p );
+    }
+    writer.close();
+}
+
+TEST( MRMesh, PointsLoadLazParallel )
+{
+    const auto dir = std::filesystem::temp_directory_path() / "MeshLib_PointsLoadLazParallel";
+    std::error_code ec;
+    std::filesystem::create_directories( dir, ec );
+
+    // small chunks to have several of them in the file
+    constexpr int numPoints = 1050;
+    constexpr unsigned chunkSize = 100;
+    const auto lazFile = dir / "points.laz";
+    writeTestLaz( lazFile, numPoints, chunkSize );
+
+    std::optional<LazChunkTable> table;
+    {
+        std::ifstream in( lazFile, std::ifstream::binary );
+        table = readLazChunkTable( in, numPoints );
+    }
+    ASSERT_TRUE( table.has_value() );
+    EXPECT_EQ( table->chunks.size(), ( numPoints + chunkSize - 1 ) / chunkSize );
+
+    VertColors parColors;
+    auto par = fromLas( lazFile, PointsLoadSettings{ .colors = &parColors } );
+    ASSERT_TRUE( par.has_value() );
+
+    VertColors seqColors;
+    lazperf::reader::named_file reader( utf8string( lazFile ) );
+    auto seq = process( reader, &seqColors, nullptr, nullptr, {} );
+    ASSERT_TRUE( seq.has_value() );
+
+    ASSERT_EQ( par->points.size(), numPoints );
+    EXPECT_EQ( par->points.vec_, seq->points.vec_ );
+    EXPECT_EQ( parColors.vec_, seqColors.vec_ );
+
+    // the box filter keeps the same points in both ways of decoding, and the points of each chunk are moved together
+    const Box3d box( { 2.0, 0.0, 0.0 }, { 5.0, 100.0, 0.045 } );
+    VertColors parBoxColors;
+    auto parBox = fromLas( lazFile, PointsLoadSettings{ .colors = &parBoxColors }, &box );
+    ASSERT_TRUE( parBox.has_value() );
+    VertColors seqBoxColors;
+    lazperf::reader::named_file boxReader( utf8string( lazFile ) );
+    auto seqBox = process( boxReader, &seqBoxColors, &box, nullptr, {} );
+    ASSERT_TRUE( seqBox.has_value() );
+    EXPECT_GT( parBox->points.size(), 0 );
+    EXPECT_LT( parBox->points.size(), numPoints / 4 );
+    EXPECT_EQ( parBox->validPoints.count(), parBox->points.size() );
+    EXPECT_EQ( parBox->points.vec_, seqBox->points.vec_ );
+    EXPECT_EQ( parBoxColors.vec_, seqBoxColors.vec_ );
+    for ( const auto & p : parBox->points )
+        EXPECT_TRUE( box.contains( Vector3d( p ) ) );
+
+    // the file with truncated chunk table is still loaded, sequentially
+    const auto truncFile = dir / "truncated.laz";
+    std::filesystem::copy_file( lazFile, truncFile, std::filesystem::copy_options::overwrite_existing, ec );
+    std::filesystem::resize_file( truncFile, std::filesystem::file_size( truncFile, ec ) - 4, ec );
+    {
+        std::ifstream in( truncFile, std::ifstream::binary );
+        EXPECT_FALSE( readLazChunkTable( in, numPoints ).has_value() );
+    }
+    auto trunc = fromLas( truncFile, PointsLoadSettings{} );
+    ASSERT_TRUE( trunc.has_value() );
+    EXPECT_EQ( trunc->points.vec_, seq->points.vec_ );
+
+    std::filesystem::remove_all( dir, ec );
+}
+
+TEST( MRMesh, PointsLoadLasByChunks )
+{
+    const auto dir = std::filesystem::temp_directory_path() / "MeshLib_PointsLoadLasByChunks";
+    std::error_code ec;
+    std::filesystem::remove_all( dir, ec );
+    std::filesystem::create_directories( dir, ec );
+
+    constexpr int numPoints = 1050;
+    const auto lazFile = dir / "points.laz";
+    writeTestLaz( lazFile, numPoints, 100 );
+
+    VertColors allColors;
+    AffineXf3f allXf;
+    auto all = fromLas( lazFile, PointsLoadSettings{ .colors = &allColors, .outXf = &allXf } );
+    ASSERT_TRUE( all.has_value() );
+
+    // the chunks have requested size except for the last one, and together they give all points
+    constexpr size_t chunkSize = 128;
+    std::vector<size_t> chunkSizes;
+    PointCloud joined;
+    VertColors joinedColors;
+    AffineXf3f xf;
+    PointCloudTilesWriter writer( { .tileSize = 4, .haloWidth = 0.5f, .dir = dir } );
+    auto res = fromLasByChunks( lazFile, chunkSize, [&] ( PointCloud&& chunk, VertColors&& colors ) -> VoidOrErrStr
+    {
+        EXPECT_EQ( chunk.validPoints.count(), chunk.points.size() );
+        EXPECT_EQ( colors.size(), chunk.points.size() );
+        chunkSizes.push_back( chunk.points.size() );
+        joined.points.vec_.insert( joined.points.vec_.end(), chunk.points.vec_.begin(), chunk.points.vec_.end() );
+        joinedColors.vec_.insert( joinedColors.vec_.end(), colors.vec_.begin(), colors.vec_.end() );
+        return writer.addPoints( chunk, &colors );
+    }, true, &xf );
+    ASSERT_TRUE( res.has_value() );
+    ASSERT_EQ( chunkSizes.size(), ( numPoints + chunkSize - 1 ) / chunkSize );
+    for ( size_t i = 0; i + 1 < chunkSizes.size(); ++i )
+        EXPECT_EQ( chunkSizes[i], chunkSize );
+    EXPECT_EQ( chunkSizes.back(), numPoints % chunkSize );
+    EXPECT_EQ( xf, allXf );
+    EXPECT_EQ( joined.points.vec_, all->points.vec_ );
+    EXPECT_EQ( joinedColors.vec_, allColors.vec_ );
+
+    // the streamed points are distributed among the tiles
+    auto tiles = writer.finish();
+    ASSERT_TRUE( tiles.has_value() );
+    EXPECT_GT( tiles->size(), 1 );
+    size_t numCore = 0;
+    for ( const auto& tile : *tiles )
+        numCore += tile.numCorePoints;
+    EXPECT_EQ( numCore, numPoints );
+
+    // the error of chunk processing stops loading
+    int numCalls = 0;
+    auto stopped = fromLasByChunks( lazFile, chunkSize, [&] ( PointCloud&&, VertColors&& ) -> VoidOrErrStr
+    {
+        if ( ++numCalls == 2 )
+            return unexpected( std::string( "stop" ) );
+        return {};
+    } );
+    ASSERT_FALSE( stopped.has_value() );
+    EXPECT_EQ( stopped.error(), "stop" );
+    EXPECT_EQ( numCalls, 2 );
+
+    std::filesystem::remove_all( dir, ec );
+}
+
 } // namespace MR::PointsLoad
 
-#endif // !defined( MRMESH_NO_LAS )
\ No newline at end of file
+#endif // !defined( MRMESH_NO_LAS )
@@ -4,7 +4,9 @@
 #include "MRFewSmallest.h"
 #include "MRBuffer.h"
 #include "MRBitSetParallelFor.h"
+#include "MRParallelFor.h"
 #include "MRTimer.h"
+#include "MRGTest.h"
 #include "MRPch/MRTBB.h"
 
 namespace MR
@@ -21,6 +23,109 @@ struct SubTask
     {}
 };
 
+/// coordinates of the points in the order of AABBTreePoints stored in separate arrays (structure of arrays),
+/// which allows the compiler to vectorize the computation of distances to all points of a leaf
+class OrderedPointsSoA
+{
+public:
+    explicit OrderedPointsSoA( const std::vector<AABBTreePoints::Point>& orderedPoints )
+        : x_( orderedPoints.size() ), y_( orderedPoints.size() ), z_( orderedPoints.size() )
+    {
+        MR_TIMER
+        ParallelFor( orderedPoints, [&] ( size_t i )
+        {
+            x_[i] = orderedPoints[i].coord.x;
+            y_[i] = orderedPoints[i].coord.y;
+            z_[i] = orderedPoints[i].coord.z;
+        } );
+    }
+
+    /// computes squared distances from pt to the points [first, last) and stores them in res
+    void distancesSq( const Vector3f& pt, int first, int last, float* res ) const
+    {
+        const float* x = x_.data() + first;
+        const float* y = y_.data() + first;
+        const float* z = z_.data() + first;
+        const int num = last - first;
+        for ( int i = 0; i < num; ++i )
+        {
+            const float dx = x[i] - pt.x;
+            const float dy = y[i] - pt.y;
+            const float dz = z[i] - pt.z;
+            res[i] = dx * dx + dy * dy + dz * dz;
+        }
+    }
+
+private:
+    std::vector<float> x_, y_, z_;
+};
+
+/// the same as findFewClosestPoints without distance limits and transformation, but scanning the leaves in given SoA
+void findFewClosestPoints( const Vector3f& pt, const AABBTreePoints& tree, const OrderedPointsSoA& soa, FewSmallest<PointsProjectionResult>& res )
+{
+    res.clear();
+    if ( tree.nodes().empty() )
+        return;
+    const auto& orderedPoints = tree.orderedPoints();
+
+    constexpr int MaxStackSize = 32; // to avoid allocations
+    SubTask subtasks[MaxStackSize];
+    int stackSize = 0;
+
+    auto topDistSq = [&]
+    {
+        return !res.full() ? FLT_MAX : res.top().distSq;
+    };
+
+    auto addSubTask = [&] ( const SubTask& s )
+    {
+        if ( s.distSq < topDistSq() )
+        {
+            assert( stackSize < MaxStackSize );
+            subtasks[stackSize++] = s;
+        }
+    };
+
+    auto getSubTask = [&] ( NodeId n )
+    {
+        float distSq = ( tree.nodes()[n].box.getBoxClosestPointTo( pt ) - pt ).lengthSq();
+        return SubTask( n, distSq );
+    };
+
+    addSubTask( getSubTask( tree.rootNodeId() ) );
+
+    float leafDistSq[AABBTreePoints::MaxNumPointsInLeaf];
+    while ( stackSize > 0 )
+    {
+        const auto s = subtasks[--stackSize];
+        const auto& node = tree[s.n];
+        if ( s.distSq >= topDistSq() )
+            continue;
+
+        if ( node.leaf() )
+        {
+            auto [first, last] = node.getLeafPointRange();
+            assert( last - first <= AABBTreePoints::MaxNumPointsInLeaf );
+            soa.distancesSq( pt, first, last, leafDistSq );
+            for ( int i = first; i < last; ++i )
+            {
+                const float distSq = leafDistSq[i - first];
+                if ( distSq < topDistSq() )
+                    res.push( { .distSq = distSq, .vId = orderedPoints[i].id } );
+            }
+            continue;
+        }
+
+        auto s1 = getSubTask( node.leftOrFirst );
+        auto s2 = getSubTask( node.rightOrLast );
+        if ( s1.distSq < s2.distSq )
+            std::swap( s1, s2 );
+        assert( s1.distSq >= s2.distSq );
+        addSubTask( s1 ); // larger distance to look later
+        addSubTask( s2 ); // smaller distance to look first
+    }
+}
+
 } //anonymous namespace
 
 PointsProjectionResult findProjectionOnPoints( const Vector3f& pt, const PointCloud& pc,
@@ -186,15 +291,18 @@ Buffer<VertId> findNClosestPointsPerPoint( const PointCloud& pc, int numNei, con
 
     tbb::enumerable_thread_specific<FewSmallest<PointsProjectionResult>> perThreadNeis( numNei + 1 );
 
-    pc.getAABBTree(); // to avoid multiple calls to tree construction from parallel region,
-                      // which can result that two different vertices will start being processed by one thread
+    const auto& tree = pc.getAABBTree(); // to avoid multiple calls to tree construction from parallel region,
+                                         // which can result that two different vertices will start being processed by one thread
+    const auto& orderedPoints = tree.orderedPoints();
+    const OrderedPointsSoA soa( orderedPoints );
 
-    if ( !BitSetParallelFor( pc.validPoints, [&]( VertId v )
+    // the queries are processed in the order of the points in the tree (close points are processed one after another by the same thread),
+    // so the visited nodes and leaves of the tree are mostly in cache
+    if ( !ParallelFor( size_t( 0 ), orderedPoints.size(), perThreadNeis, [&]( size_t i, FewSmallest<PointsProjectionResult> & neis )
     {
-        auto & neis = perThreadNeis.local();
-        neis.clear();
+        const auto v = orderedPoints[i].id;
         assert( neis.maxElms() == numNei + 1 );
-        findFewClosestPoints( pc.points[v], pc, neis );
+        findFewClosestPoints( orderedPoints[i].coord, tree, soa, neis );
         VertId * p = res.data() + ( (size_t)v * numNei );
         const VertId * pEnd = p + numNei;
         for ( const auto & n : neis.get() )
@@ -241,4 +349,43 @@ VertPair findTwoClosestPoints( const PointCloud& pc, const ProgressCallback & pr
     return res;
 }
 
+TEST( MRMesh, FindNClosestPointsPerPoint )
+{
+    PointCloud pc;
+    for ( int i = 0; i < 500; ++i )
+    {
+        // deterministic pseudo-random points in a unit cube
+        const auto h = [i] ( int k ) { return float( ( ( i + 1 ) * ( 7919 + 104729 * k ) ) % 1009 ) / 1009.0f; };
+        pc.points.push_back( { h( 0 ), h( 1 ), h( 2 ) } );
+    }
+    pc.validPoints.resize( pc.points.size(), true );
+    pc.validPoints.reset( 17_v );
+
+    constexpr int numNei = 6;
+    const auto neis = findNClosestPointsPerPoint( pc, numNei );
+    ASSERT_EQ( neis.size(), pc.points.size() * numNei );
+    for ( auto v : pc.validPoints )
+    {
+        // brute force distances to all other valid points
+        std::vector<float> distSq;
+        for ( auto u : pc.validPoints )
+            if ( u != v )
+                distSq.push_back( ( pc.points[u] - pc.points[v] ).lengthSq() );
+        std::sort( distSq.begin(), distSq.end() );
+
+        std::vector<float> found;
+        for ( int j = 0; j < numNei; ++j )
+        {
+            const auto u = neis[v * numNei + j];
+            ASSERT_TRUE( u.valid() );
+            EXPECT_NE( u, v );
+            EXPECT_TRUE( pc.validPoints.test( u ) );
+            found.push_back( ( pc.points[u] - pc.points[v] ).lengthSq() );
+        }
+        std::sort( found.begin(), found.end() );
+        for ( int j = 0; j < numNei; ++j )
+            EXPECT_EQ( found[j], distSq[j] );
+    }
+}
+
 } //namespace MR
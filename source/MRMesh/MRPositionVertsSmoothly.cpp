@@ -8,6 +8,7 @@
 #include "MRTriMath.h"
 #include "MRMeshRelax.h"
 #include "MRLaplacian.h"
+#include "MRMultigridSolver.h"
 #include "MRTimer.h"
 #include <Eigen/SparseCholesky>
 
@@ -16,11 +17,13 @@ namespace MR
 
 void positionVertsSmoothly( Mesh& mesh, const VertBitSet& verts,
     EdgeWeights edgeWeightsType,
-    const VertBitSet * fixedSharpVertices )
+    const VertBitSet * fixedSharpVertices, const MultigridSettings * multigrid )
 {
     MR_TIMER
 
     Laplacian laplacian( mesh );
+    if ( multigrid )
+        laplacian.setMultigrid( *multigrid );
     laplacian.init( verts, edgeWeightsType, Laplacian::RememberShape::No );
     if ( fixedSharpVertices )
         for ( auto v : *fixedSharpVertices )
@@ -29,7 +32,7 @@ void positionVertsSmoothly( Mesh& mesh, const VertBitSet& verts,
 }
 
 void positionVertsSmoothlySharpBd( Mesh& mesh, const VertBitSet& verts,
-    const Vector<Vector3f, VertId>* vertShifts, const VertScalars* vertStabilizers )
+    const Vector<Vector3f, VertId>* vertShifts, const VertScalars* vertStabilizers, const MultigridSettings * multigrid )
 {
     MR_TIMER
     assert( vertStabilizers || !MeshComponents::hasFullySelectedComponent( mesh, verts ) );
@@ -85,14 +88,44 @@ void positionVertsSmoothlySharpBd( Mesh& mesh, const VertBitSet& verts,
     SparseMatrix A;
     A.resize( sz, sz );
     A.setFromTriplets( mTriplets.begin(), mTriplets.end() );
-    Eigen::SimplicialLDLT<SparseMatrix> solver;
-    solver.compute( A );
 
     Eigen::VectorXd sol[3];
-    ParallelFor( 0, 3, [&]( int i )
+    bool solved = false;
+    if ( multigrid )
     {
-        sol[i] = solver.solve( rhs[i] );
-    } );
+        // multigrid solver needs both parts of symmetric matrix, and current positions are good initial guess
+        MultigridSolver solver( *multigrid );
+        solver.compute( Eigen::SparseMatrix<double>( A.selfadjointView<Eigen::Lower>() ) );
+        if ( solver.valid() )
+        {
+            Eigen::VectorXd guess[3];
+            for ( int i = 0; i < 3; ++i )
+                guess[i].resize( sz );
+            n = 0;
+            for ( auto v : verts )
+            {
+                for ( int i = 0; i < 3; ++i )
+                    guess[i][n] = mesh.points[v][i];
+                ++n;
+            }
+            MultigridStats stats[3];
+            ParallelFor( 0, 3, [&]( int i )
+            {
+                sol[i] = solver.solve( rhs[i], &guess[i], &stats[i] );
+            } );
+            solved = stats[0].converged && stats[1].converged && stats[2].converged;
+        }
+        // otherwise the system is solved by direct factorization
+    }
+    if ( !solved )
+    {
+        Eigen::SimplicialLDLT<SparseMatrix> solver;
+        solver.compute( A );
+        ParallelFor( 0, 3, [&]( int i )
+        {
+            sol[i] = solver.solve( rhs[i] );
+        } );
+    }
 
     // copy solution back into mesh points
     n = 0;
@@ -287,7 +320,7 @@ void inflate( Mesh& mesh, const VertBitSet& verts, const InflateSettings & setti
     if ( !verts.any() )
         return;
     if ( settings.preSmooth )
-        positionVertsSmoothlySharpBd( mesh, verts );
+        positionVertsSmoothlySharpBd( mesh, verts, nullptr, nullptr, settings.multigrid );
     if ( settings.iterations <= 0 || settings.pressure == 0 )
         return;
 
@@ -317,7 +350,7 @@ void inflate( Mesh& mesh, const VertBitSet& verts, const InflateSettings & setti
         {
             vertShifts[v] = currPressure * a[v] * mesh.normal( v );
         } );
-        positionVertsSmoothlySharpBd( mesh, verts, &vertShifts );
+        positionVertsSmoothlySharpBd( mesh, verts, &vertShifts, nullptr, settings.multigrid );
     }
 }
 
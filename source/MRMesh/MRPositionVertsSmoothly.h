@@ -9,17 +9,23 @@ namespace MR
 /// Puts given vertices in such positions to make smooth surface both inside verts-region and on its boundary;
 /// \param verts must not include all vertices of a mesh connected component
 /// \param fixedSharpVertices in these vertices the surface can be not-smooth
+/// \param multigrid if given then the system is solved by iterative multigrid solver instead of direct factorization,
+///                  which is recommended for very large regions; the direct solver is still used if multigrid one fails or does not converge
 MRMESH_API void positionVertsSmoothly( Mesh& mesh, const VertBitSet& verts,
     EdgeWeights edgeWeightsType = EdgeWeights::Cotan,
-    const VertBitSet * fixedSharpVertices = nullptr );
+    const VertBitSet * fixedSharpVertices = nullptr,
+    const MultigridSettings * multigrid = nullptr );
 
 /// Puts given vertices in such positions to make smooth surface inside verts-region, but sharp on its boundary;
 /// \param verts must not include all vertices of a mesh connected component unless vertStabilizers are given
 /// \param vertShifts optional additional shifts of each vertex relative to smooth position
 /// \param vertStabilizers optional per-vertex stabilizers: the more the value, the bigger vertex attraction to its original position
+/// \param multigrid if given then the system is solved by iterative multigrid solver instead of direct factorization,
+///                  the direct solver is still used if multigrid one fails or does not converge
 MRMESH_API void positionVertsSmoothlySharpBd( Mesh& mesh, const VertBitSet& verts,
     const Vector<Vector3f, VertId>* vertShifts = nullptr,
-    const VertScalars* vertStabilizers = nullptr );
+    const VertScalars* vertStabilizers = nullptr,
+    const MultigridSettings * multigrid = nullptr );
 
 struct SpacingSettings
 {
@@ -59,6 +65,9 @@ struct InflateSettings
     bool preSmooth = true;
     /// whether to increase the pressure gradually during the iterations (recommended for best quality)
     bool gradualPressureGrowth = true;
+    /// if given then the systems are solved by iterative multigrid solver instead of direct factorization,
+    /// which is recommended for very large regions
+    const MultigridSettings * multigrid = nullptr;
 };
 
 /// Inflates (in one of two sides) given mesh region,
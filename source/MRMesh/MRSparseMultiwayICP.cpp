@@ -0,0 +1,415 @@
+#include "MRSparseMultiwayICP.h"
+#include "MRAABBTreeObjects.h"
+#include "MRUnionFind.h"
+#include "MRParallelFor.h"
+#include "MRBitSet.h"
+#include "MRPointCloud.h"
+#include "MRTimer.h"
+#include "MRGTest.h"
+#include <Eigen/SparseCholesky>
+
+namespace MR
+{
+
+namespace
+{
+
+/// the pose graph edge prepared for optimization
+struct PoseGraphConstraint
+{
+    ObjId a, b;
+    AffineXf3d aToB;
+    /// the points in local space of object a, which shall coincide in world space after the transformations of a and b (via aToB)
+    std::array<Vector3d, 8> pts;
+    double weight = 0;
+};
+
+using Matrix36d = Eigen::Matrix<double, 3, 6>;
+
+/// the derivative of the point u + c after small motion (rotation omega around c and translation t) by ( omega, t )
+Matrix36d motionJacobian( const Vector3d& u )
+{
+    Matrix36d j;
+    j << 0,    u.z, -u.y, 1, 0, 0,
+        -u.z,  0,    u.x, 0, 1, 0,
+         u.y, -u.x,  0,   0, 0, 1;
+    return j;
+}
+
+/// finds the pairs of objects ( i < j ) with intersecting world bounding boxes expanded by given margin
+std::vector<std::pair<ObjId, ObjId>> findOverlappingPairs( const ICPObjects& objects, const Vector<Box3f, ObjId>& worldBoxes, float margin )
+{
+    MR_TIMER
+    const AABBTreeObjects tree( objects );
+    Vector<std::vector<ObjId>, ObjId> neighbors( objects.size() );
+    ParallelFor( neighbors, [&] ( ObjId i )
+    {
+        auto box = worldBoxes[i];
+        if ( !box.valid() )
+            return;
+        box.min -= Vector3f::diagonal( margin );
+        box.max += Vector3f::diagonal( margin );
+
+        std::vector<NodeId> stack{ tree.rootNodeId() };
+        while ( !stack.empty() )
+        {
+            const auto& node = tree[stack.back()];
+            stack.pop_back();
+            if ( !node.box.intersects( box ) )
+                continue;
+            if ( node.leaf() )
+            {
+                if ( node.leafId() > i )
+                    neighbors[i].push_back( node.leafId() );
+                continue;
+            }
+            stack.push_back( node.l );
+            stack.push_back( node.r );
+        }
+        std::sort( neighbors[i].begin(), neighbors[i].end() );
+    } );
+
+    std::vector<std::pair<ObjId, ObjId>> res;
+    for ( ObjId i( 0 ); i < neighbors.size(); ++i )
+        for ( auto j : neighbors[i] )
+            res.emplace_back( i, j );
+    return res;
+}
+
+} // anonymous namespace
+
+Expected<Vector<AffineXf3f, ObjId>> sparseMultiwayICP( const ICPObjects& objects,
+    const ICPProperties& props, const SparseMultiwayICPParams& params, std::vector<ICPPoseGraphEdge>* outEdges )
+{
+    MR_TIMER
+    const auto numObjs = objects.size();
+    Vector<AffineXf3f, ObjId> res( numObjs );
+    for ( ObjId i( 0 ); i < numObjs; ++i )
+        res[i] = objects[i].xf;
+    if ( outEdges )
+        outEdges->clear();
+    if ( numObjs < 2 )
+        return res;
+
+    // sample all objects once and prepare their search trees to avoid building them in many threads simultaneously
+    Vector<VertBitSet, ObjId> samples( numObjs );
+    Vector<Box3f, ObjId> worldBoxes( numObjs );
+    if ( !ParallelFor( objects, [&] ( ObjId i )
+    {
+        const auto& obj = objects[i].obj;
+        obj.cacheAABBTree();
+        if ( auto s = obj.pointsGridSampling( params.samplingVoxelSize ) )
+            samples[i] = std::move( *s );
+        worldBoxes[i] = transformed( obj.getObjBoundingBox(), objects[i].xf );
+    }, subprogress( params.cb, 0.0f, 0.2f ) ) )
+        return unexpectedOperationCanceled();
+
+    const auto candidates = findOverlappingPairs( objects, worldBoxes, params.overlapMargin );
+
+    // align each pair of overlapping objects independently
+    std::vector<std::optional<ICPPoseGraphEdge>> pairResults( candidates.size() );
+    if ( !ParallelFor( size_t( 0 ), candidates.size(), [&] ( size_t k )
+    {
+        const auto [a, b] = candidates[k];
+        const auto overlap = worldBoxes[a].intersection( worldBoxes[b] );
+        if ( !overlap.valid() )
+            return;
+        // the samples outside of the common region have no counterparts on the other object and only spoil the alignment
+        auto overlapSamples = [&] ( ObjId i )
+        {
+            auto res = samples[i];
+            const auto& points = objects[i].obj.points();
+            for ( auto v : samples[i] )
+                if ( !overlap.contains( objects[i].xf( points[v] ) ) )
+                    res.reset( v );
+            return res;
+        };
+        const auto aSamples = overlapSamples( a );
+        const auto bSamples = overlapSamples( b );
+        const auto minSamples = std::min( aSamples.count(), bSamples.count() );
+        if ( minSamples == 0 )
+            return;
+        ICP icp( objects[a], objects[b], aSamples, bSamples );
+        icp.setParams( props );
+        const auto aXf = icp.calculateTransformation();
+        const auto numActive = icp.getNumActivePairs();
+        if ( numActive == 0 || numActive < params.minActivePairsRatio * minSamples )
+            return;
+        pairResults[k] = ICPPoseGraphEdge{ a, b, objects[b].xf.inverse() * aXf, numActive };
+    }, subprogress( params.cb, 0.2f, 0.9f ) ) )
+        return unexpectedOperationCanceled();
+
+    std::vector<ICPPoseGraphEdge> edges;
+    for ( auto& e : pairResults )
+        if ( e )
+            edges.push_back( *e );
+    if ( outEdges )
+        *outEdges = edges;
+
+    // the object with the smallest id in each connected component is fixed, all others are variables
+    UnionFind<ObjId> unionFind( numObjs );
+    for ( const auto& e : edges )
+        unionFind.unite( e.a, e.b );
+    Vector<int, ObjId> varIndex( numObjs, -1 );
+    ObjBitSet anchorRoots( numObjs );
+    int numVars = 0;
+    for ( ObjId i( 0 ); i < numObjs; ++i )
+    {
+        const auto root = unionFind.find( i );
+        if ( anchorRoots.test( root ) )
+            varIndex[i] = numVars++;
+        else
+            anchorRoots.set( root );
+    }
+    if ( numVars == 0 )
+        return res;
+
+    // each edge is represented by the corners of the intersection of world boxes of its objects,
+    // which must coincide in world space after transformation by both objects
+    Vector<AffineXf3d, ObjId> xfs( numObjs );
+    Vector<Vector3d, ObjId> pivots( numObjs );
+    for ( ObjId i( 0 ); i < numObjs; ++i )
+    {
+        xfs[i] = AffineXf3d( objects[i].xf );
+        pivots[i] = worldBoxes[i].valid() ? Vector3d( worldBoxes[i].center() ) : xfs[i].b;
+    }
+    std::vector<PoseGraphConstraint> constraints( edges.size() );
+    ParallelFor( constraints, [&] ( size_t k )
+    {
+        const auto& e = edges[k];
+        auto& c = constraints[k];
+        c.a = e.a;
+        c.b = e.b;
+        c.aToB = AffineXf3d( e.aToB );
+        c.weight = double( e.numActivePairs ) / c.pts.size();
+        auto box = worldBoxes[e.a].intersection( worldBoxes[e.b] );
+        if ( !box.valid() )
+        {
+            // the boxes only touch within overlapMargin
+            auto both = worldBoxes[e.a];
+            both.include( worldBoxes[e.b] );
+            box = Box3f( both.center(), both.center() );
+        }
+        const auto toLocalA = xfs[e.a].inverse();
+        const auto corners = getCorners( box );
+        for ( int q = 0; q < c.pts.size(); ++q )
+            c.pts[q] = toLocalA( Vector3d( corners[q] ) );
+    } );
+
+    // Gauss-Newton iterations of minimizing the weighted sum of squared distances between constraint points,
+    // the motion of each variable object is linearized around its pivot
+    for ( int iter = 0; iter < params.poseGraphIterations; ++iter )
+    {
+        std::vector<Eigen::Triplet<double>> triplets;
+        triplets.reserve( 6 * 6 * ( numVars + 2 * constraints.size() ) );
+        Eigen::VectorXd rhs = Eigen::VectorXd::Zero( 6 * numVars );
+        double maxRes = 0;
+        auto addBlock = [&] ( int row, int col, const Eigen::Matrix<double, 6, 6>& m )
+        {
+            for ( int r = 0; r < 6; ++r )
+                for ( int c = 0; c < 6; ++c )
+                    triplets.emplace_back( 6 * row + r, 6 * col + c, m( r, c ) );
+        };
+        for ( const auto& c : constraints )
+        {
+            const int va = varIndex[c.a];
+            const int vb = varIndex[c.b];
+            if ( va < 0 && vb < 0 )
+                continue;
+            Eigen::Matrix<double, 6, 6> haa = Eigen::Matrix<double, 6, 6>::Zero(), hbb = haa, hab = haa;
+            Eigen::Matrix<double, 6, 1> ga = Eigen::Matrix<double, 6, 1>::Zero(), gb = ga;
+            for ( const auto& p : c.pts )
+            {
+                const auto pa = xfs[c.a]( p );
+                const auto pb = xfs[c.b]( c.aToB( p ) );
+                const auto d = pa - pb;
+                maxRes = std::max( maxRes, d.lengthSq() );
+                const Eigen::Vector3d r( d.x, d.y, d.z );
+                const auto ja = motionJacobian( pa - pivots[c.a] );
+                const auto jb = motionJacobian( pb - pivots[c.b] );
+                haa += c.weight * ja.transpose() * ja;
+                hbb += c.weight * jb.transpose() * jb;
+                hab -= c.weight * ja.transpose() * jb;
+                ga -= c.weight * ja.transpose() * r;
+                gb += c.weight * jb.transpose() * r;
+            }
+            if ( va >= 0 )
+            {
+                addBlock( va, va, haa );
+                rhs.segment<6>( 6 * va ) += ga;
+            }
+            if ( vb >= 0 )
+            {
+                addBlock( vb, vb, hbb );
+                rhs.segment<6>( 6 * vb ) += gb;
+            }
+            if ( va >= 0 && vb >= 0 )
+            {
+                addBlock( va, vb, hab );
+                addBlock( vb, va, hab.transpose() );
+            }
+        }
+        if ( maxRes == 0 )
+            break;
+        // tiny regularization keeps the system solvable if some object is constrained only partially
+        for ( int v = 0; v < 6 * numVars; ++v )
+            triplets.emplace_back( v, v, 1e-9 );
+
+        Eigen::SparseMatrix<double> mat( 6 * numVars, 6 * numVars );
+        mat.setFromTriplets( triplets.begin(), triplets.end() );
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver;
+        solver.compute( mat );
+        if ( solver.info() != Eigen::Success )
+            break;
+        const Eigen::VectorXd delta = solver.solve( rhs );
+
+        ParallelFor( xfs, [&] ( ObjId i )
+        {
+            const int v = varIndex[i];
+            if ( v < 0 )
+                return;
+            const Vector3d omega( delta[6 * v], delta[6 * v + 1], delta[6 * v + 2] );
+            const Vector3d t( delta[6 * v + 3], delta[6 * v + 4], delta[6 * v + 5] );
+            const auto angle = omega.length();
+            const auto rot = angle > 0 ? Matrix3d::rotation( omega / angle, angle ) : Matrix3d();
+            const auto& c = pivots[i];
+            xfs[i] = AffineXf3d::translation( c + t ) * AffineXf3d::linear( rot ) * AffineXf3d::translation( -c ) * xfs[i];
+        } );
+
+        if ( !reportProgress( params.cb, 0.9f + 0.1f * float( iter + 1 ) / params.poseGraphIterations ) )
+            return unexpectedOperationCanceled();
+    }
+
+    for ( ObjId i( 0 ); i < numObjs; ++i )
+        res[i] = AffineXf3f( xfs[i] );
+    return res;
+}
+
+namespace
+{
+
+/// numPatches x numPatches overlapping patches of a wavy surface with given distance between points;
+/// the first patch is in its true position, all others are slightly perturbed
+struct WavyPatches
+{
+    std::vector<PointCloud> clouds;
+    ICPObjects objects;
+};
+
+WavyPatches makeWavyPatches( int numPatches, float spacing )
+{
+    constexpr float patchStep = 1.5f;
+    constexpr float patchSize = 2.0f;
+    auto surface = [] ( float x, float y )
+    {
+        return Vector3f( x, y, 0.3f * std::sin( 2 * x ) * std::cos( 1.7f * y ) );
+    };
+    auto normal = [] ( float x, float y )
+    {
+        return Vector3f( -0.6f * std::cos( 2 * x ) * std::cos( 1.7f * y ), 0.51f * std::sin( 2 * x ) * std::sin( 1.7f * y ), 1.0f ).normalized();
+    };
+
+    WavyPatches res;
+    res.clouds.resize( numPatches * numPatches );
+    for ( int py = 0; py < numPatches; ++py )
+    {
+        for ( int px = 0; px < numPatches; ++px )
+        {
+            auto& cloud = res.clouds[py * numPatches + px];
+            for ( float y = py * patchStep; y <= py * patchStep + patchSize; y += spacing )
+            {
+                for ( float x = px * patchStep; x <= px * patchStep + patchSize; x += spacing )
+                {
+                    cloud.points.push_back( surface( x, y ) );
+                    cloud.normals.push_back( normal( x, y ) );
+                }
+            }
+            cloud.validPoints.resize( cloud.points.size(), true );
+        }
+    }
+    for ( int i = 0; i < res.clouds.size(); ++i )
+    {
+        AffineXf3f xf;
+        if ( i > 0 )
+        {
+            // the rotation is around the center of the patch, so that far patches are not displaced much
+            const Vector3f axis( std::sin( float( i ) ), std::cos( 2.0f * i ), 1.0f );
+            const auto center = Vector3f( ( i % numPatches ) * patchStep, ( i / numPatches ) * patchStep, 0.0f ) + Vector3f( 0.5f, 0.5f, 0.0f ) * patchSize;
+            xf = AffineXf3f::translation( 0.03f * Vector3f( std::cos( 3.0f * i ), std::sin( 5.0f * i ), std::sin( 1.0f * i ) ) )
+                * AffineXf3f::xfAround( Matrix3f::rotation( axis.normalized(), 0.02f ), center );
+        }
+        res.objects.push_back( { MeshOrPoints( res.clouds[i] ), xf } );
+    }
+    return res;
+}
+
+} //anonymous namespace
+
+TEST( MRMesh, SparseMultiwayICP )
+{
+    // 4x4 overlapping patches
+    constexpr int numPatches = 4;
+    const auto patches = makeWavyPatches( numPatches, 0.04f );
+
+    ICPProperties props;
+    props.iterLimit = 20;
+    props.distThresholdSq = sqr( 0.3f );
+    SparseMultiwayICPParams params;
+    params.samplingVoxelSize = 0.1f;
+    params.overlapMargin = 0.1f;
+    std::vector<ICPPoseGraphEdge> edges;
+    auto res = sparseMultiwayICP( patches.objects, props, params, &edges );
+    ASSERT_TRUE( res.has_value() );
+
+    // only neighbor patches (including diagonal ones) overlap
+    EXPECT_EQ( edges.size(), 2 * numPatches * ( numPatches - 1 ) + 2 * ( numPatches - 1 ) * ( numPatches - 1 ) );
+    EXPECT_EQ( ( *res )[ObjId( 0 )], AffineXf3f() );
+    for ( ObjId i( 0 ); i < res->size(); ++i )
+    {
+        const auto& xf = ( *res )[i];
+        EXPECT_LT( ( xf.A - Matrix3f() ).norm(), 3e-3f );
+        EXPECT_LT( xf.b.length(), 1e-2f );
+    }
+}
+
+TEST( MRMesh, SparseMultiwayICPManyObjects )
+{
+    // 16x16 = 256 overlapping patches, each overlaps at most 8 others
+    constexpr int numPatches = 16;
+    const auto patches = makeWavyPatches( numPatches, 0.04f );
+
+    ICPProperties props;
+    props.iterLimit = 20;
+    props.distThresholdSq = sqr( 0.3f );
+    SparseMultiwayICPParams params;
+    params.samplingVoxelSize = 0.1f;
+    params.overlapMargin = 0.1f;
+    std::vector<ICPPoseGraphEdge> edges;
+    auto res = sparseMultiwayICP( patches.objects, props, params, &edges );
+    ASSERT_TRUE( res.has_value() );
+    ASSERT_EQ( res->size(), numPatches * numPatches );
+
+    EXPECT_EQ( edges.size(), 2 * numPatches * ( numPatches - 1 ) + 2 * ( numPatches - 1 ) * ( numPatches - 1 ) );
+    EXPECT_EQ( ( *res )[ObjId( 0 )], AffineXf3f() );
+    // the patches are far from the origin, so check the displacement of the patch points instead of xf.b
+    auto maxShift = [&] ( ObjId i, const AffineXf3f& xf )
+    {
+        const auto box = patches.clouds[i].computeBoundingBox();
+        return std::max( ( xf( box.min ) - box.min ).length(), ( xf( box.max ) - box.max ).length() );
+    };
+    float maxInitialShift = 0, maxShiftAfter = 0;
+    for ( ObjId i( 0 ); i < res->size(); ++i )
+    {
+        maxInitialShift = std::max( maxInitialShift, maxShift( i, patches.objects[i].xf ) );
+        maxShiftAfter = std::max( maxShiftAfter, maxShift( i, ( *res )[i] ) );
+    }
+    // the errors of pairwise alignments accumulate along the chains of 16 patches
+    EXPECT_GT( maxInitialShift, 0.05f );
+    EXPECT_LT( maxShiftAfter, 0.03f );
+
+    // but neighbor patches are aligned with one another precisely
+    for ( const auto& e : edges )
+        EXPECT_LT( maxShift( e.a, ( *res )[e.b].inverse() * ( *res )[e.a] ), 1e-2f );
+}
+
+} //namespace MR
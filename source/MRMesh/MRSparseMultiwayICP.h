@@ -0,0 +1,53 @@
+#pragma once
+
+#include "MRMultiwayICP.h"
+#include "MRExpected.h"
+
+namespace MR
+{
+
+/// parameters of registration of many objects via pairwise alignments and pose graph optimization
+struct SparseMultiwayICPParams
+{
+    /// approximate distance between samples on each object
+    float samplingVoxelSize = 0;
+
+    /// two objects are aligned with one another only if their world bounding boxes expanded by this distance intersect
+    float overlapMargin = 0;
+
+    /// the alignment of two objects is used only if the number of active point pairs after it is at least this fraction
+    /// of the number of samples in the intersection of world bounding boxes on the object having less of them
+    float minActivePairsRatio = 0.05f;
+
+    /// the number of Gauss-Newton iterations of pose graph optimization
+    int poseGraphIterations = 5;
+
+    /// callback for progress reports
+    ProgressCallback cb;
+};
+
+/// the result of pairwise alignment of two overlapping objects, an edge of pose graph
+struct ICPPoseGraphEdge
+{
+    ObjId a, b;
+
+    /// the transformation from local space of object a into local space of object b found by ICP
+    AffineXf3f aToB;
+
+    /// the number of active point pairs after ICP, used as the weight of the edge
+    size_t numActivePairs = 0;
+};
+
+/// registers many objects (e.g. hundreds of scans) having known approximate transformations:
+/// 1. finds the pairs of objects with overlapping world bounding boxes using AABB tree of objects;
+/// 2. aligns each pair independently with ICP in parallel using only the samples within the intersection of their world bounding boxes;
+/// 3. finds the transformations of all objects best satisfying all pairwise alignments by pose graph optimization with sparse solver;
+/// unlike MultiwayICP the cost grows linearly with the number of objects if each object overlaps a bounded number of others;
+/// the object with the smallest id in each connected component of the pose graph keeps its transformation;
+/// \param props parameters of pairwise ICP
+/// \param outEdges optional output of all accepted pairwise alignments
+/// \return adjusted transformations of all objects or error if the operation was canceled
+[[nodiscard]] MRMESH_API Expected<Vector<AffineXf3f, ObjId>> sparseMultiwayICP( const ICPObjects& objects,
+    const ICPProperties& props, const SparseMultiwayICPParams& params, std::vector<ICPPoseGraphEdge>* outEdges = nullptr );
+
+} //namespace MR
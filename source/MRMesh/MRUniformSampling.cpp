@@ -5,11 +5,134 @@
 #include "MRTimer.h"
 #include "MRPointsInBall.h"
 #include "MRBox.h"
+#include "MRParallelFor.h"
+#include "MRGTest.h"
+#include <tbb/parallel_sort.h>
+#include <atomic>
 #include <cfloat>
 
 namespace MR
 {
 
+namespace
+{
+
+std::optional<VertBitSet> pointUniformSamplingParallel( const PointCloud& pointCloud, const UniformSamplingSettings & settings,
+    const VertNormals * pNormals )
+{
+    MR_TIMER
+    const auto box = pointCloud.computeBoundingBox();
+    if ( !box.valid() )
+        return VertBitSet( pointCloud.validPoints.size() );
+
+    // the cells are not smaller than the distance, so two cells of one phase separated by another cell do not influence one another
+    constexpr int bitsPerCoord = 20;
+    constexpr int maxCoord = ( 1 << bitsPerCoord ) - 1;
+    const auto boxSize = box.size();
+    const float cellSize = std::max( settings.distance, std::max( { boxSize.x, boxSize.y, boxSize.z } ) / maxCoord );
+    if ( !( cellSize > 0 ) )
+        return pointCloud.validPoints;
+
+    // the key of a point is its phase (3 bits), then the coordinates of its cell
+    struct KeyedPoint
+    {
+        std::uint64_t key = 0;
+        VertId v;
+    };
+    std::vector<KeyedPoint> keyed;
+    keyed.reserve( pointCloud.validPoints.count() );
+    for ( auto v : pointCloud.validPoints )
+        keyed.push_back( { 0, v } );
+    ParallelFor( keyed, [&]( size_t i )
+    {
+        const auto d = ( pointCloud.points[keyed[i].v] - box.min ) / cellSize;
+        const auto x = std::uint64_t( std::clamp( int( d.x ), 0, maxCoord ) );
+        const auto y = std::uint64_t( std::clamp( int( d.y ), 0, maxCoord ) );
+        const auto z = std::uint64_t( std::clamp( int( d.z ), 0, maxCoord ) );
+        const auto phase = ( x & 1 ) | ( ( y & 1 ) << 1 ) | ( ( z & 1 ) << 2 );
+        keyed[i].key = ( phase << ( 3 * bitsPerCoord ) ) | ( x << ( 2 * bitsPerCoord ) ) | ( y << bitsPerCoord ) | z;
+    } );
+    // the points inside one cell are ordered as in sequential sampling
+    tbb::parallel_sort( keyed.begin(), keyed.end(), [&]( const KeyedPoint & a, const KeyedPoint & b )
+    {
+        if ( a.key != b.key )
+            return a.key < b.key;
+        if ( settings.lexicographicalOrder )
+        {
+            const auto & pa = pointCloud.points[a.v];
+            const auto & pb = pointCloud.points[b.v];
+            if ( std::tie( pa.x, pa.y, pa.z ) != std::tie( pb.x, pb.y, pb.z ) )
+                return std::tie( pa.x, pa.y, pa.z ) < std::tie( pb.x, pb.y, pb.z );
+        }
+        return a.v < b.v;
+    } );
+    if ( !reportProgress( settings.progress, 0.2f ) )
+        return {};
+
+    std::vector<size_t> cellStarts;
+    for ( size_t i = 0; i < keyed.size(); ++i )
+        if ( i == 0 || keyed[i].key != keyed[i - 1].key )
+            cellStarts.push_back( i );
+    const auto numCells = cellStarts.size();
+    cellStarts.push_back( keyed.size() );
+    auto cellPhase = [&]( size_t c ) { return int( keyed[cellStarts[c]].key >> ( 3 * bitsPerCoord ) ); };
+
+    // points of other cells can be marked concurrently from two cells of one phase
+    std::vector<std::atomic<bool>> visited( pointCloud.points.size() );
+    std::vector<char> sampled( keyed.size(), 0 );
+
+    auto processCell = [&]( size_t c )
+    {
+        std::vector<std::pair<VertId, float>> nearVerts;
+        for ( auto i = cellStarts[c]; i < cellStarts[c + 1]; ++i )
+        {
+            const auto v = keyed[i].v;
+            if ( visited[v].load( std::memory_order_relaxed ) )
+                continue;
+            sampled[i] = 1;
+            const auto p = pointCloud.points[v];
+            float localMaxDistSq = sqr( settings.distance );
+            findPointsInBall( pointCloud, p, settings.distance, [&] ( VertId u, const Vector3f& pu )
+            {
+                const auto distSq = ( p - pu ).lengthSq();
+                if ( pNormals && std::abs( dot( (*pNormals)[v], (*pNormals)[u] ) ) < settings.minNormalDot )
+                {
+                    localMaxDistSq = std::min( localMaxDistSq, distSq );
+                    return;
+                }
+                nearVerts.emplace_back( u, distSq );
+            } );
+            for ( const auto & [u, distSq] : nearVerts )
+                if ( distSq < localMaxDistSq )
+                    visited[u].store( true, std::memory_order_relaxed );
+            nearVerts.clear();
+        }
+    };
+
+    size_t phaseBegin = 0;
+    for ( int phase = 0; phase < 8; ++phase )
+    {
+        size_t phaseEnd = phaseBegin;
+        while ( phaseEnd < numCells && cellPhase( phaseEnd ) == phase )
+            ++phaseEnd;
+        if ( !ParallelFor( phaseBegin, phaseEnd, processCell,
+            subprogress( settings.progress, 0.2f + 0.1f * phase, 0.3f + 0.1f * phase ) ) )
+            return {};
+        phaseBegin = phaseEnd;
+    }
+    assert( phaseBegin == numCells );
+
+    VertBitSet res( pointCloud.validPoints.size() );
+    for ( size_t i = 0; i < keyed.size(); ++i )
+        if ( sampled[i] )
+            res.set( keyed[i].v );
+    if ( !reportProgress( settings.progress, 1.0f ) )
+        return {};
+    return res;
+}
+
+} // anonymous namespace
+
 std::optional<VertBitSet> pointUniformSampling( const PointCloud& pointCloud, const UniformSamplingSettings & settings )
 {
     MR_TIMER
@@ -20,6 +143,9 @@ std::optional<VertBitSet> pointUniformSampling( const PointCloud& pointCloud, co
     if ( !pNormals && pointCloud.hasNormals() )
         pNormals = &pointCloud.normals;
 
+    if ( settings.parallel )
+        return pointUniformSamplingParallel( pointCloud, settings, pNormals );
+
     VertBitSet visited( pointCloud.validPoints.size() );
     VertBitSet sampled( pointCloud.validPoints.size() );
 
@@ -104,4 +230,43 @@ std::optional<PointCloud> makeUniformSampledCloud( const PointCloud& pointCloud,
     return res;
 }
 
+TEST( MRMesh, PointUniformSamplingParallel )
+{
+    PointCloud cloud;
+    for ( int i = 0; i < 20000; ++i )
+    {
+        // pseudo-random points in the unit cube
+        const auto h = [i] ( int k ) { return float( ( ( i + 1 ) * 2654435761u * ( 2 * k + 1 ) ) % 10007u ) / 10007.0f; };
+        cloud.points.emplace_back( h( 0 ), h( 1 ), h( 2 ) );
+    }
+    cloud.validPoints.resize( cloud.points.size(), true );
+
+    UniformSamplingSettings settings;
+    settings.distance = 0.1f;
+    settings.parallel = true;
+    const auto samples = pointUniformSampling( cloud, settings );
+    ASSERT_TRUE( samples.has_value() );
+    EXPECT_GT( samples->count(), 100 );
+
+    // samples are not closer than the distance, and every point is close to some sample
+    for ( auto v : cloud.validPoints )
+    {
+        float minDistSq = FLT_MAX;
+        for ( auto s : *samples )
+            if ( s != v )
+                minDistSq = std::min( minDistSq, ( cloud.points[s] - cloud.points[v] ).lengthSq() );
+        if ( samples->test( v ) )
+            EXPECT_GE( minDistSq, sqr( settings.distance ) );
+        else
+            EXPECT_LT( minDistSq, sqr( settings.distance ) );
+    }
+
+    // the same samples with a single thread
+    std::optional<VertBitSet> samples1;
+    tbb::task_arena arena( 1 );
+    arena.execute( [&] { samples1 = pointUniformSampling( cloud, settings ); } );
+    ASSERT_TRUE( samples1.has_value() );
+    EXPECT_EQ( *samples, *samples1 );
+}
+
 } //namespace MR
@@ -20,6 +20,10 @@ struct UniformSamplingSettings
     /// if true process the points in lexicographical order, which gives tighter and more uniform samples;
     /// if false process the points according to their ids, which is faster
     bool lexicographicalOrder = true;
+    /// if true then the points are distributed among the cells of a grid with the size of cell not less than distance,
+    /// and the cells are processed in 8 phases, where the cells of one phase are not adjacent and processed in parallel;
+    /// the samples are slightly different from sequential sampling, but they do not depend on the number of threads
+    bool parallel = false;
     /// if not nullptr then these normals will be used during sampling instead of normals in the cloud itself
     const VertNormals * pNormals = nullptr;
     /// to report progress and cancel processing
@@ -3,6 +3,7 @@
 #include "MRAABBTreePolyline.h"
 #include "MRAABBTreePoints.h"
 #include "MRDipole.h"
+#include "MRMeshAdjacency.h"
 #include "MRHeapBytes.h"
 #include "MRPch/MRTBB.h"
 #include <cassert>
@@ -140,5 +141,6 @@ template class UniqueThreadSafeOwner<AABBTreePolyline2>;
 template class UniqueThreadSafeOwner<AABBTreePolyline3>;
 template class UniqueThreadSafeOwner<AABBTreePoints>;
 template class UniqueThreadSafeOwner<Dipoles>;
+template class UniqueThreadSafeOwner<MeshAdjacency>;
 
 } //namespace MR
@@ -256,22 +256,28 @@ VdbVolume floatGridToVdbVolume( const FloatGrid& grid )
 
 FloatGrid simpleVolumeToDenseGrid( const SimpleVolume& simpleVolume,
                                    ProgressCallback cb )
+{
+    MR_TIMER;
+    auto grid = MakeFloatGrid( std::make_shared<openvdb::FloatGrid>( FLT_MAX ) );
+    putSimpleVolumeInDenseGrid( grid, {}, simpleVolume, cb );
+    openvdb::tools::changeBackground( grid->tree(), 0.f );
+    return grid;
+}
+
+void putSimpleVolumeInDenseGrid( FloatGrid& grid, const Vector3i& minCoord, const SimpleVolume& simpleVolume, ProgressCallback cb )
 {
     MR_TIMER;
     if ( cb )
         cb( 0.0f );
-    openvdb::math::Coord minCoord( 0, 0, 0 );
+    openvdb::math::Coord minCoordVdb( minCoord.x, minCoord.y, minCoord.z );
     openvdb::math::Coord dimsCoord( simpleVolume.dims.x, simpleVolume.dims.y, simpleVolume.dims.z );
-    openvdb::math::CoordBBox denseBBox( minCoord, minCoord + dimsCoord.offsetBy( -1 ) );
+    openvdb::math::CoordBBox denseBBox( minCoordVdb, minCoordVdb + dimsCoord.offsetBy( -1 ) );
     openvdb::tools::Dense<float, openvdb::tools::LayoutXYZ> dense( denseBBox, const_cast< float* >( simpleVolume.data.data() ) );
     if ( cb )
         cb( 0.5f );
-    std::shared_ptr<openvdb::FloatGrid> grid = std::make_shared<openvdb::FloatGrid>( FLT_MAX );
-    openvdb::tools::copyFromDense( dense, *grid, denseVolumeToGridTolerance );
-    openvdb::tools::changeBackground( grid->tree(), 0.f );
+    openvdb::tools::copyFromDense( dense, ovdb( *grid ), denseVolumeToGridTolerance );
     if ( cb )
         cb( 1.0f );
-    return MakeFloatGrid( std::move( grid ) );
 }
 
 VdbVolume simpleVolumeToVdbVolume( const SimpleVolume& simpleVolume, ProgressCallback cb /*= {} */ )
@@ -56,6 +56,10 @@ MRMESH_API VdbVolume floatGridToVdbVolume( const FloatGrid& grid );
 // make copy of data
 // grid can be used to make iso-surface later with gridToMesh function
 MRMESH_API FloatGrid simpleVolumeToDenseGrid( const SimpleVolume& simpleVolume, ProgressCallback cb = {} );
+// copies the values of SimpleVolume in the region of the grid starting from minCoord,
+// the values equal to grid's background are not stored;
+// allows one to make FloatGrid from a volume by parts without keeping the whole volume in memory
+MRMESH_API void putSimpleVolumeInDenseGrid( FloatGrid& grid, const Vector3i& minCoord, const SimpleVolume& simpleVolume, ProgressCallback cb = {} );
 MRMESH_API VdbVolume simpleVolumeToVdbVolume( const SimpleVolume& simpleVolume, ProgressCallback cb = {} );
 
 // make SimpleVolume from VdbVolume
@@ -1,10 +1,49 @@
 #pragma once
 
 #include "MRVoxelsVolumeAccess.h"
+#include <optional>
+#include <span>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <xmmintrin.h> //SSE instructions
+#endif
 
 namespace MR
 {
 
+/// blends the values in 8 corners of a voxel cell with trilinear weights;
+/// the corners are ordered as (x,y,z): 000, 100, 010, 110, 001, 101, 011, 111;
+/// \param frac [0;1) position of a point in the cell
+template <typename T>
+inline T interpolateTrilinear( const T* corners, const Vector3f& frac )
+{
+    T value{};
+    float cx[2] = { 1.0f - frac.x, frac.x };
+    float cy[2] = { 1.0f - frac.y, frac.y };
+    float cz[2] = { 1.0f - frac.z, frac.z };
+    for ( int i = 0; i < 8; i++ )
+        value += corners[i] * ( cx[i & 1] * cy[( i >> 1 ) & 1] * cz[i >> 2] );
+    return value;
+}
+
+/* CPU(X86_64) - AMD64 / Intel64 / x86_64 64-bit */
+#if defined(__x86_64__) || defined(_M_X64)
+template <>
+inline float interpolateTrilinear<float>( const float* corners, const Vector3f& frac )
+{
+    // interpolate along z both xy-layers of the cell at once, then blend 4 values with xy-weights
+    const __m128 z0 = _mm_loadu_ps( corners );
+    const __m128 z1 = _mm_loadu_ps( corners + 4 );
+    const __m128 xy = _mm_add_ps( z0, _mm_mul_ps( _mm_sub_ps( z1, z0 ), _mm_set1_ps( frac.z ) ) );
+    const __m128 wxy = _mm_mul_ps(
+        _mm_set_ps( frac.x, 1.0f - frac.x, frac.x, 1.0f - frac.x ),
+        _mm_set_ps( frac.y, frac.y, 1.0f - frac.y, 1.0f - frac.y ) );
+    __m128 v = _mm_mul_ps( xy, wxy );
+    v = _mm_add_ps( v, _mm_movehl_ps( v, v ) );
+    v = _mm_add_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+    return _mm_cvtss_f32( v );
+}
+#endif
+
 /// helper class for generalized access to voxel volume data with trilinear interpolation
 /// coordinate: 0       voxelSize
 ///             |       |
@@ -49,16 +88,29 @@ public:
     ValueType get( const Vector3f& pos ) const
     {
         IndexAndPos index = getIndexAndPos(pos);
-        ValueType value{};
-        float cx[2] = { 1.0f - index.pos.x, index.pos.x };
-        float cy[2] = { 1.0f - index.pos.y, index.pos.y };
-        float cz[2] = { 1.0f - index.pos.z, index.pos.z };
-        for ( int i = 0; i < 8; i++ )
+        ValueType corners[8];
+        getCorners_( index.index, corners );
+        return interpolateTrilinear( corners, index.pos );
+    }
+
+    /// get values at several positions at once, values.size() must be equal to positions.size();
+    /// the values in the corners of a cell are read only once for a run of consecutive positions inside it,
+    /// so spatially ordered positions (e.g. dense samples along a segment) are processed faster than by separate calls
+    void get( std::span<const Vector3f> positions, std::span<ValueType> values ) const
+    {
+        assert( positions.size() == values.size() );
+        ValueType corners[8];
+        std::optional<Vector3i> cornersCell;
+        for ( size_t i = 0; i < positions.size(); ++i )
         {
-            Vector3i d{ i & 1, ( i >> 1 ) & 1, i >> 2 };
-            value += accessor_.safeGet( index.index + d ) * ( cx[d.x] * cy[d.y] * cz[d.z] );
+            const auto index = getIndexAndPos( positions[i] );
+            if ( cornersCell != index.index )
+            {
+                getCorners_( index.index, corners );
+                cornersCell = index.index;
+            }
+            values[i] = interpolateTrilinear( corners, index.pos );
         }
-        return value;
     }
 
 private:
@@ -68,6 +120,12 @@ private:
     Vector3i minCoord_{};
 #endif
 
+    void getCorners_( const Vector3i& index, ValueType* corners ) const
+    {
+        for ( int i = 0; i < 8; i++ )
+            corners[i] = accessor_.safeGet( index + Vector3i{ i & 1, ( i >> 1 ) & 1, i >> 2 } );
+    }
+
     struct IndexAndPos
     {
         Vector3i index; // Zero-based voxel index in the volume
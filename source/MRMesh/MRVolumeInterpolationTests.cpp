@@ -0,0 +1,47 @@
+#include "MRVolumeInterpolation.h"
+#include "MRGTest.h"
+
+namespace MR
+{
+
+TEST( MRMesh, VolumeInterpolationBatch )
+{
+    SimpleVolume volume;
+    volume.dims = { 5, 4, 3 };
+    volume.voxelSize = { 0.5f, 1.0f, 2.0f };
+    volume.data.resize( size_t( volume.dims.x ) * volume.dims.y * volume.dims.z );
+    for ( size_t i = 0; i < volume.data.size(); ++i )
+        volume.data[i] = float( ( i * 7919 ) % 23 ) - 11.0f;
+
+    VoxelsVolumeAccessor<SimpleVolume> accessor( volume );
+    VoxelsVolumeInterpolatedAccessor<VoxelsVolumeAccessor<SimpleVolume>> interpolator( volume, accessor );
+
+    // exact values in voxel origins
+    EXPECT_NEAR( interpolator.get( Vector3f( 1.0f, 2.0f, 2.0f ) ), volume.data[VolumeIndexer( volume.dims ).toVoxelId( { 2, 2, 1 } )], 1e-6f );
+
+    // dense samples along a segment crossing the volume and leaving it
+    std::vector<Vector3f> positions;
+    for ( int i = 0; i < 100; ++i )
+        positions.push_back( Vector3f( -0.3f, 0.1f, 0.2f ) + Vector3f( 0.031f, 0.043f, 0.067f ) * float( i ) );
+    std::vector<float> values( positions.size() );
+    interpolator.get( positions, values );
+    for ( size_t i = 0; i < positions.size(); ++i )
+    {
+        // reference trilinear interpolation
+        const auto& p = positions[i];
+        const Vector3f rel( p.x / volume.voxelSize.x, p.y / volume.voxelSize.y, p.z / volume.voxelSize.z );
+        const Vector3i base( int( std::floor( rel.x ) ), int( std::floor( rel.y ) ), int( std::floor( rel.z ) ) );
+        const Vector3f frac = rel - Vector3f( base );
+        float expected = 0;
+        for ( int c = 0; c < 8; ++c )
+        {
+            const Vector3i d{ c & 1, ( c >> 1 ) & 1, c >> 2 };
+            const float w = ( d.x ? frac.x : 1 - frac.x ) * ( d.y ? frac.y : 1 - frac.y ) * ( d.z ? frac.z : 1 - frac.z );
+            expected += accessor.safeGet( base + d ) * w;
+        }
+        EXPECT_NEAR( values[i], expected, 1e-5f );
+        EXPECT_NEAR( values[i], interpolator.get( p ), 1e-5f );
+    }
+}
+
+} //namespace MR
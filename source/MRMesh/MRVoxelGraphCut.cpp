@@ -5,9 +5,11 @@
 #include "MRVoxelsVolume.h"
 #include "MRVolumeIndexer.h"
 #include "MRBitSetParallelFor.h"
+#include "MRParallelFor.h"
 #include "MRHash.h"
 #include "MRExpected.h"
 #include "MRBox.h"
+#include "MRGTest.h"
 #include "MRPch/MRSpdlog.h"
 #include "MRPch/MRTBB.h"
 #include <parallel_hashmap/phmap.h>
@@ -392,10 +394,13 @@ void VoxelGraphCut::makeSubtasks_()
 void VoxelGraphCut::makeSubtasks_( const SeqVoxelSpan & span, Subtask * st, size_t stSize )
 {
     assert( stSize >= 1 );
-    if ( stSize == 1 )
+    // small spans (e.g. in narrow bands of multi-resolution segmentation) cannot be split on whole blocks of bits
+    if ( stSize == 1 || span.size() < 2 * BitSet::bits_per_block )
     {
         std::sort( seq2voxel_.data() + span.begin, seq2voxel_.data() + span.end );
         st[0].span = span;
+        for ( size_t i = 1; i < stSize; ++i )
+            st[i].span = { span.end, span.end };
         return;
     }
 
@@ -1198,4 +1203,152 @@ Expected<VoxelBitSet> segmentVolumeByGraphCut( const SimpleVolume & densityVolum
     return vgc.getResult( sourceSeeds );
 }
 
+namespace
+{
+
+/// the volume and the seeds with halved resolution in each dimension
+struct CoarseLevel
+{
+    SimpleVolume densityVolume;
+    VoxelBitSet sourceSeeds;
+    VoxelBitSet sinkSeeds;
+};
+
+/// returns the coarse level with the density averaged over 2x2x2 fine voxels;
+/// a coarse voxel is a seed if it covers only seeds of one kind
+CoarseLevel downsample( const SimpleVolume & densityVolume, const VoxelBitSet & sourceSeeds, const VoxelBitSet & sinkSeeds )
+{
+    MR_TIMER
+    const VolumeIndexer fineIndexer( densityVolume.dims );
+    CoarseLevel res;
+    res.densityVolume.dims = ( densityVolume.dims + Vector3i::diagonal( 1 ) ) / 2;
+    res.densityVolume.voxelSize = densityVolume.voxelSize * 2.0f;
+    res.densityVolume.min = densityVolume.min;
+    res.densityVolume.max = densityVolume.max;
+    const VolumeIndexer indexer( res.densityVolume.dims );
+    res.densityVolume.data.resize( indexer.size() );
+    res.sourceSeeds.resize( indexer.size() );
+    res.sinkSeeds.resize( indexer.size() );
+
+    // every block of bits in both seeds is processed by one thread only
+    BitSetParallelForAll( res.sourceSeeds, [&] ( VoxelId cv )
+    {
+        const auto cpos = indexer.toPos( cv );
+        float sum = 0;
+        int num = 0;
+        bool hasSource = false, hasSink = false;
+        for ( int z = 2 * cpos.z; z < std::min( 2 * cpos.z + 2, densityVolume.dims.z ); ++z )
+            for ( int y = 2 * cpos.y; y < std::min( 2 * cpos.y + 2, densityVolume.dims.y ); ++y )
+                for ( int x = 2 * cpos.x; x < std::min( 2 * cpos.x + 2, densityVolume.dims.x ); ++x )
+                {
+                    const auto v = fineIndexer.toVoxelId( { x, y, z } );
+                    sum += densityVolume.data[v];
+                    ++num;
+                    hasSource = hasSource || sourceSeeds.test( v );
+                    hasSink = hasSink || sinkSeeds.test( v );
+                }
+        res.densityVolume.data[cv] = sum / num;
+        if ( hasSource != hasSink )
+        {
+            if ( hasSource )
+                res.sourceSeeds.set( cv );
+            else
+                res.sinkSeeds.set( cv );
+        }
+    } );
+    return res;
+}
+
+/// returns fine voxels, which coarse voxels are in given set
+VoxelBitSet upsample( const VoxelBitSet & coarse, const Vector3i & coarseDims, const Vector3i & fineDims )
+{
+    MR_TIMER
+    const VolumeIndexer indexer( coarseDims );
+    const VolumeIndexer fineIndexer( fineDims );
+    VoxelBitSet res( fineIndexer.size() );
+    BitSetParallelForAll( res, [&] ( VoxelId v )
+    {
+        if ( coarse.test( indexer.toVoxelId( fineIndexer.toPos( v ) / 2 ) ) )
+            res.set( v );
+    } );
+    return res;
+}
+
+} // anonymous namespace
+
+Expected<VoxelBitSet> segmentVolumeByMultiResGraphCut( const SimpleVolume & densityVolume, float k, const VoxelBitSet & sourceSeeds, const VoxelBitSet & sinkSeeds,
+    const MultiResGraphCutSettings & settings, ProgressCallback cb )
+{
+    MR_TIMER
+    const auto & dims = densityVolume.dims;
+    const auto coarseDims = ( dims + Vector3i::diagonal( 1 ) ) / 2;
+    if ( settings.maxLevels <= 0 || std::min( { coarseDims.x, coarseDims.y, coarseDims.z } ) < settings.minLevelDim )
+        return segmentVolumeByGraphCut( densityVolume, k, sourceSeeds, sinkSeeds, cb );
+
+    auto coarse = downsample( densityVolume, sourceSeeds, sinkSeeds );
+    if ( coarse.sourceSeeds.none() || coarse.sinkSeeds.none() )
+        return segmentVolumeByGraphCut( densityVolume, k, sourceSeeds, sinkSeeds, cb ); // seeds of different kinds are too close to each other
+    if ( !reportProgress( cb, 0.05f ) )
+        return unexpectedOperationCanceled();
+
+    auto coarseSettings = settings;
+    --coarseSettings.maxLevels;
+    auto coarseRes = segmentVolumeByMultiResGraphCut( coarse.densityVolume, k, coarse.sourceSeeds, coarse.sinkSeeds, coarseSettings, subprogress( cb, 0.05f, 0.25f ) );
+    if ( !coarseRes )
+        return unexpected( std::move( coarseRes.error() ) );
+
+    const VolumeIndexer indexer( dims );
+    auto innerSource = upsample( *coarseRes, coarse.densityVolume.dims, dims );
+    auto outerSource = innerSource;
+    if ( settings.bandWidth > 0 )
+    {
+        shrinkVoxelsMask( innerSource, indexer, settings.bandWidth );
+        expandVoxelsMask( outerSource, indexer, settings.bandWidth );
+    }
+    if ( !reportProgress( cb, 0.3f ) )
+        return unexpectedOperationCanceled();
+
+    // all voxels outside the band become seeds, and the original seeds are preserved in any case
+    VoxelBitSet bandSourceSeeds = ( innerSource - sinkSeeds ) | sourceSeeds;
+    outerSource.flip();
+    VoxelBitSet bandSinkSeeds = ( outerSource - sourceSeeds ) | sinkSeeds;
+    return segmentVolumeByGraphCut( densityVolume, k, bandSourceSeeds, bandSinkSeeds, subprogress( cb, 0.3f, 1.0f ) );
+}
+
+TEST( MRMesh, MultiResGraphCut )
+{
+    // the density is high inside a sphere and smoothly decreases outside
+    const Vector3i dims = Vector3i::diagonal( 48 );
+    const Vector3f center = Vector3f::diagonal( 23.5f );
+    const float radius = 15.3f;
+    const VolumeIndexer indexer( dims );
+    SimpleVolume volume;
+    volume.dims = dims;
+    volume.min = 0;
+    volume.max = 1;
+    volume.data.resize( indexer.size() );
+    VoxelBitSet sourceSeeds( indexer.size() ), sinkSeeds( indexer.size() );
+    for ( VoxelId v( size_t( 0 ) ); v < indexer.size(); ++v )
+    {
+        const auto pos = indexer.toPos( v );
+        const auto dist = ( Vector3f( pos ) - center ).length();
+        volume.data[v] = 1 / ( 1 + std::exp( 2 * ( dist - radius ) ) );
+        if ( dist < 3 )
+            sourceSeeds.set( v );
+        else if ( indexer.isBdVoxel( pos ) )
+            sinkSeeds.set( v );
+    }
+
+    auto fullRes = segmentVolumeByGraphCut( volume, 20.0f, sourceSeeds, sinkSeeds );
+    ASSERT_TRUE( fullRes.has_value() );
+    auto multiRes = segmentVolumeByMultiResGraphCut( volume, 20.0f, sourceSeeds, sinkSeeds, { .maxLevels = 2, .minLevelDim = 8 } );
+    ASSERT_TRUE( multiRes.has_value() );
+
+    // the accuracy: the number of voxels classified differently relative to the size of full resolution segment
+    const auto fullCount = fullRes->count();
+    const auto diffCount = ( *fullRes ^ *multiRes ).count();
+    EXPECT_GT( fullCount, 0 );
+    EXPECT_LE( diffCount, fullCount / 100 );
+}
+
 } // namespace MR
@@ -19,4 +19,28 @@ namespace MR
  */
 MRMESH_API Expected<VoxelBitSet> segmentVolumeByGraphCut( const SimpleVolume& densityVolume, float k, const VoxelBitSet& sourceSeeds, const VoxelBitSet& sinkSeeds, ProgressCallback cb = {} );
 
+/// \ingroup VoxelGroup
+struct MultiResGraphCutSettings
+{
+    /// the maximal number of coarser levels, each next level halves the resolution in every dimension;
+    /// 0 means that the segmentation is done on full resolution only (same as segmentVolumeByGraphCut)
+    int maxLevels = 2;
+    /// a level is not created if any of its dimensions becomes smaller than this value
+    int minLevelDim = 16;
+    /// the half-width in voxels of the band around the cut from coarser level, where the cut is refined on finer level;
+    /// the voxels outside the band keep the side found on coarser level
+    int bandWidth = 2;
+};
+
+/**
+ * \brief Segment voxels of given volume on two sets using coarse-to-fine graph-cut, returning source set
+ * \ingroup VoxelGroup
+ * \details The cut is first found in the volume downsampled several times, then on each finer level
+ * it is refined only in a narrow band around upsampled coarse cut. So time and memory are proportional to the number of voxels near the cut,
+ * while the result can slightly differ from the one of segmentVolumeByGraphCut if the optimal cut is not visible on coarse levels
+ * \param k, sourceSeeds, sinkSeeds - same as in segmentVolumeByGraphCut
+ */
+MRMESH_API Expected<VoxelBitSet> segmentVolumeByMultiResGraphCut( const SimpleVolume& densityVolume, float k, const VoxelBitSet& sourceSeeds, const VoxelBitSet& sinkSeeds,
+    const MultiResGraphCutSettings& settings = {}, ProgressCallback cb = {} );
+
 } // namespace MR
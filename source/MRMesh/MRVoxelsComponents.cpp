@@ -0,0 +1,231 @@
+#include "MRVoxelsComponents.h"
+#include "MRUnionFind.h"
+#include "MRBitSet.h"
+#include "MRParallelFor.h"
+#include "MRProgressCallback.h"
+#include "MRphmap.h"
+#include "MRTimer.h"
+#include "MRGTest.h"
+#include <numeric>
+
+namespace MR
+{
+
+namespace VoxelsComponents
+{
+
+Expected<LabeledVoxels> labelComponents( const VoxelBitSet& voxels, const VolumeIndexer& indexer, bool labelComplement, const ProgressCallback& cb )
+{
+    MR_TIMER
+    LabeledVoxels res;
+    if ( indexer.size() == 0 )
+        return res;
+
+    const auto& dims = indexer.dims();
+    const auto sizeX = size_t( dims.x );
+    const auto sizeXY = indexer.sizeXY();
+
+    // the volume is subdivided on blocks of consecutive z-planes depending only on volume dimensions (not on the number of threads),
+    // so the union-find structure and the numbering of components are always the same
+    constexpr size_t minBlockVoxels = size_t( 1 ) << 16;
+    const int blockDepth = int( std::min( ( minBlockVoxels + sizeXY - 1 ) / sizeXY, size_t( dims.z ) ) );
+    const int numBlocks = ( dims.z + blockDepth - 1 ) / blockDepth;
+    auto blockZEnd = [&] ( int b ) { return std::min( ( b + 1 ) * blockDepth, dims.z ); };
+    auto blockBegin = [&] ( int b ) { return VoxelId( size_t( b ) * blockDepth * sizeXY ); };
+    auto blockEnd = [&] ( int b ) { return VoxelId( blockZEnd( b ) * sizeXY ); };
+
+    // whether the voxel belongs to some component
+    auto labeled = [&] ( VoxelId v )
+    {
+        return labelComplement || voxels.test( v );
+    };
+    // whether two neighbor voxels belong to the same component, given that the first one is labeled
+    auto connected = [&] ( VoxelId v, VoxelId n )
+    {
+        return voxels.test( v ) == voxels.test( n );
+    };
+
+    UnionFind<VoxelId> unionFind( indexer.size() );
+
+    // unite neighbor voxels within each block, each thread modifies only the part of union-find structure related to its block
+    if ( !ParallelFor( 0, numBlocks, [&] ( int b )
+    {
+        const int zEnd = blockZEnd( b );
+        for ( int z = b * blockDepth; z < zEnd; ++z )
+        {
+            for ( int y = 0; y < dims.y; ++y )
+            {
+                auto v = indexer.toVoxelId( { 0, y, z } );
+                for ( int x = 0; x < dims.x; ++x, ++v )
+                {
+                    if ( !labeled( v ) )
+                        continue;
+                    if ( x + 1 < dims.x && connected( v, v + size_t( 1 ) ) )
+                        unionFind.unite( v, v + size_t( 1 ) );
+                    if ( y + 1 < dims.y && connected( v, v + sizeX ) )
+                        unionFind.unite( v, v + sizeX );
+                    if ( z + 1 < zEnd && connected( v, v + sizeXY ) )
+                        unionFind.unite( v, v + sizeXY );
+                }
+            }
+        }
+    }, subprogress( cb, 0.0f, 0.5f ), 1 ) )
+        return unexpectedOperationCanceled();
+
+    // merge the groups of blocks pairwise along their common plane, doubling the size of groups on each level;
+    // the merged groups on one level do not intersect, so they are processed in parallel
+    const auto mergeCb = subprogress( cb, 0.5f, 0.6f );
+    for ( int step = 1; step < numBlocks; step *= 2 )
+    {
+        const int numPairs = ( numBlocks + 2 * step - 1 ) / ( 2 * step );
+        ParallelFor( 0, numPairs, [&] ( int p )
+        {
+            const int rightGroup = ( 2 * p + 1 ) * step;
+            if ( rightGroup >= numBlocks )
+                return;
+            const auto planeEnd = blockBegin( rightGroup );
+            for ( auto v = planeEnd - sizeXY; v < planeEnd; ++v )
+                if ( labeled( v ) && connected( v, v + sizeXY ) )
+                    unionFind.unite( v, v + sizeXY );
+        } );
+        if ( !reportProgress( mergeCb, float( step ) / numBlocks ) )
+            return unexpectedOperationCanceled();
+    }
+
+    // point every voxel directly on its root and count the roots in each block
+    std::vector<int> firstLabel( numBlocks + 1, 0 );
+    if ( !ParallelFor( 0, numBlocks, [&] ( int b )
+    {
+        const auto begin = blockBegin( b );
+        const auto end = blockEnd( b );
+        int numRoots = 0;
+        for ( auto v = begin; v < end; ++v )
+            if ( labeled( v ) && unionFind.findUpdateRange( v, begin, end ) == v )
+                ++numRoots;
+        firstLabel[b + 1] = numRoots;
+    }, subprogress( cb, 0.6f, 0.7f ), 1 ) )
+        return unexpectedOperationCanceled();
+
+    std::partial_sum( firstLabel.begin(), firstLabel.end(), firstLabel.begin() );
+    const int numComponents = firstLabel.back();
+
+    // number the roots in the order of blocks, and the roots inside one block in the order of voxel ids
+    res.labels.resize( indexer.size() );
+    res.voxelCounts.resize( numComponents, 0 );
+    res.boxes.resize( numComponents );
+    const auto& parents = unionFind.parents();
+    if ( !ParallelFor( 0, numBlocks, [&] ( int b )
+    {
+        RegionId l( firstLabel[b] );
+        for ( auto v = blockBegin( b ); v < blockEnd( b ); ++v )
+        {
+            if ( !labeled( v ) || parents[v] != v )
+                continue;
+            res.voxelCounts[l] = unionFind.sizeOfComp( v );
+            res.labels[v] = l++;
+        }
+        assert( l == firstLabel[b + 1] );
+    }, subprogress( cb, 0.7f, 0.8f ), 1 ) )
+        return unexpectedOperationCanceled();
+
+    // propagate the labels from the roots and compute the boxes of the components:
+    // the boxes of components with the roots in this block are updated directly, other boxes are accumulated locally and merged later
+    std::vector<HashMap<RegionId, Box3i>> foreignBoxes( numBlocks );
+    if ( !ParallelFor( 0, numBlocks, [&] ( int b )
+    {
+        const RegionId myFirst( firstLabel[b] );
+        const RegionId myEnd( firstLabel[b + 1] );
+        auto& myForeignBoxes = foreignBoxes[b];
+        auto addRun = [&] ( RegionId l, const Vector3i& first, const Vector3i& last )
+        {
+            auto& box = ( l >= myFirst && l < myEnd ) ? res.boxes[l] : myForeignBoxes[l];
+            box.include( first );
+            box.include( last );
+        };
+
+        const int zEnd = blockZEnd( b );
+        for ( int z = b * blockDepth; z < zEnd; ++z )
+        {
+            for ( int y = 0; y < dims.y; ++y )
+            {
+                auto v = indexer.toVoxelId( { 0, y, z } );
+                RegionId runLabel;
+                int runStart = 0;
+                for ( int x = 0; x < dims.x; ++x, ++v )
+                {
+                    RegionId l;
+                    if ( labeled( v ) )
+                    {
+                        const auto root = parents[v];
+                        l = root == v ? res.labels[v] : ( res.labels[v] = res.labels[root] );
+                    }
+                    if ( l == runLabel )
+                        continue;
+                    if ( runLabel )
+                        addRun( runLabel, { runStart, y, z }, { x - 1, y, z } );
+                    runLabel = l;
+                    runStart = x;
+                }
+                if ( runLabel )
+                    addRun( runLabel, { runStart, y, z }, { dims.x - 1, y, z } );
+            }
+        }
+    }, subprogress( cb, 0.8f, 1.0f ), 1 ) )
+        return unexpectedOperationCanceled();
+
+    for ( const auto& blockBoxes : foreignBoxes )
+        for ( const auto& [l, box] : blockBoxes )
+            res.boxes[l].include( box );
+
+    return res;
+}
+
+TEST( MRMesh, LabelVoxelsComponents )
+{
+    // large xy-plane makes every z-plane a separate block
+    VolumeIndexer indexer( { 256, 256, 4 } );
+    VoxelBitSet voxels( indexer.size() );
+    // vertical column through all blocks
+    for ( int z = 0; z < 4; ++z )
+        voxels.set( indexer.toVoxelId( { 1, 1, z } ) );
+    // two columns connected only in the last block
+    for ( int z = 0; z < 4; ++z )
+    {
+        voxels.set( indexer.toVoxelId( { 10, 10, z } ) );
+        voxels.set( indexer.toVoxelId( { 12, 10, z } ) );
+    }
+    voxels.set( indexer.toVoxelId( { 11, 10, 3 } ) );
+    // isolated voxel
+    voxels.set( indexer.toVoxelId( { 100, 200, 2 } ) );
+
+    auto labeled = labelComponents( voxels, indexer );
+    ASSERT_TRUE( labeled.has_value() );
+    ASSERT_EQ( labeled->numComponents(), 3 );
+    EXPECT_FALSE( labeled->labels[indexer.toVoxelId( { 0, 0, 0 } )].valid() );
+
+    const auto column = labeled->labels[indexer.toVoxelId( { 1, 1, 0 } )];
+    EXPECT_EQ( labeled->voxelCounts[column], 4 );
+    EXPECT_EQ( labeled->boxes[column], Box3i( { 1, 1, 0 }, { 1, 1, 3 } ) );
+
+    const auto arch = labeled->labels[indexer.toVoxelId( { 10, 10, 0 } )];
+    EXPECT_EQ( labeled->labels[indexer.toVoxelId( { 12, 10, 0 } )], arch );
+    EXPECT_EQ( labeled->voxelCounts[arch], 9 );
+    EXPECT_EQ( labeled->boxes[arch], Box3i( { 10, 10, 0 }, { 12, 10, 3 } ) );
+
+    const auto single = labeled->labels[indexer.toVoxelId( { 100, 200, 2 } )];
+    EXPECT_EQ( labeled->voxelCounts[single], 1 );
+    EXPECT_NE( single, column );
+    EXPECT_NE( single, arch );
+
+    // the complement is connected, and the hole inside the arch is a part of it
+    auto labeledBoth = labelComponents( voxels, indexer, true );
+    ASSERT_TRUE( labeledBoth.has_value() );
+    ASSERT_EQ( labeledBoth->numComponents(), 4 );
+    const auto outside = labeledBoth->labels[indexer.toVoxelId( { 0, 0, 0 } )];
+    EXPECT_EQ( labeledBoth->voxelCounts[outside], indexer.size() - 14 );
+    EXPECT_EQ( labeledBoth->boxes[outside], Box3i( { 0, 0, 0 }, { 255, 255, 3 } ) );
+}
+
+} // namespace VoxelsComponents
+
+} // namespace MR
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "MRVolumeIndexer.h"
+#include "MRVector.h"
+#include "MRBox.h"
+#include "MRExpected.h"
+
+namespace MR
+{
+
+namespace VoxelsComponents
+{
+
+/// \defgroup VoxelsComponentsGroup VoxelsComponents
+/// \ingroup ComponentsGroup
+/// \{
+
+/// the result of connected components labeling of a dense voxel volume
+struct LabeledVoxels
+{
+    /// component id of each voxel in the volume, invalid id for the voxels not belonging to any component
+    Voxel2RegionMap labels;
+
+    /// the number of voxels in each component
+    Vector<size_t, RegionId> voxelCounts;
+
+    /// the bounding box of each component in voxel coordinates of the volume (including max voxel)
+    Vector<Box3i, RegionId> boxes;
+
+    /// returns the number of found components
+    [[nodiscard]] int numComponents() const { return (int)voxelCounts.size(); }
+};
+
+/// finds 6-connected components of given voxels in parallel:
+/// the volume is split on z-slabs labeled independently by different threads, then the slabs are merged pairwise along their common planes;
+/// the numbering of components does not depend on the number of threads;
+/// \param voxels the set of voxels in the volume with dimensions \param indexer to find components of
+/// \param labelComplement if true then the voxels outside of \param voxels are split on components as well (and labeled),
+///                        otherwise they get invalid label
+/// \return error only if the operation was canceled by the callback
+[[nodiscard]] MRMESH_API Expected<LabeledVoxels> labelComponents( const VoxelBitSet& voxels, const VolumeIndexer& indexer,
+    bool labelComplement = false, const ProgressCallback& cb = {} );
+
+/// \}
+
+} // namespace VoxelsComponents
+
+} // namespace MR
@@ -10,6 +10,9 @@
 #include "MROpenVDBHelper.h"
 #include "MRTiffIO.h"
 #include "MRParallelFor.h"
+#include "MRMarchingCubes.h"
+#include "MRMesh.h"
+#include "MRVector2.h"
 #include <MRPch/MROpenvdb.h>
 #include "MRPch/MRSpdlog.h"
 #include "MRPch/MRTBB.h"
@@ -87,6 +90,7 @@ struct SliceInfo : SliceInfoBase
 {
     // these fields will be ignored in sorting
     Vector3d imagePos;
+    Vector2i dims; // columns and rows
 };
 
 void sortByOrder( std::vector<std::filesystem::path>& scans, std::vector<SliceInfo>& zOrder )
@@ -289,9 +293,15 @@ struct DCMFileLoadResult
     float max = -FLT_MAX;
     std::string seriesDescription;
     AffineXf3f xf;
+    Vector3f voxelSize;
 };
 
-DCMFileLoadResult loadSingleFile( const std::filesystem::path& path, SimpleVolume& data, size_t offset )
+/// decodes the pixels of given file directly in data.data starting from given offset;
+/// if data.dims.x or data.dims.y is zero, then the dimensions are taken from the file and data.data is allocated,
+/// otherwise data.data must be already allocated, and only pixel values are written there,
+/// so the function can be called in parallel for all slices of one volume;
+/// \param cacheBuffer is reused between the calls to avoid allocations
+DCMFileLoadResult loadSingleFile( const std::filesystem::path& path, SimpleVolume& data, size_t offset, std::vector<char>& cacheBuffer )
 {
     MR_TIMER;
     DCMFileLoadResult res;
@@ -348,62 +358,58 @@ DCMFileLoadResult loadSingleFile( const std::filesystem::path& path, SimpleVolum
     const unsigned* dims = gimage.GetDimensions();
     bool needInvertZ = false;
 
-    if ( data.dims.x == 0 || data.dims.y == 0 )
+    const double* spacing = gimage.GetSpacing();
+    if ( spacing[0] == 1 && spacing[1] == 1 && spacing[2] == 1 )
     {
-        data.dims.x = dims[0];
-        data.dims.y = dims[1];
+        // gdcm was unable to find the spacing, so find it by ourselves
+        if( ds.FindDataElement( gdcm::Keywords::PixelSpacing::GetTag() ) )
+        {
+            const gdcm::DataElement& de = ds.GetDataElement( gdcm::Keywords::PixelSpacing::GetTag() );
+            gdcm::Keywords::PixelSpacing desc;
+            desc.SetFromDataElement( de );
+            res.voxelSize.x = float( desc.GetValue(0) / 1000 );
+            res.voxelSize.y = float( desc.GetValue(1) / 1000 );
+        }
     }
-    if ( dimsNum == 3 )
+    else 
     {
-        data.dims.z = dims[2];
+        res.voxelSize.x = float( spacing[0] / 1000 );
+        res.voxelSize.y = float( spacing[1] / 1000 );
     }
-    if ( data.voxelSize[0] == 0.0f )
+    if ( dimsNum == 3 )
     {
-        const double* spacing = gimage.GetSpacing();
-        if ( spacing[0] == 1 && spacing[1] == 1 && spacing[2] == 1 )
-        {
-            // gdcm was unable to find the spacing, so find it by ourselves
-            if( ds.FindDataElement( gdcm::Keywords::PixelSpacing::GetTag() ) )
-            {
-                const gdcm::DataElement& de = ds.GetDataElement( gdcm::Keywords::PixelSpacing::GetTag() );
-                gdcm::Keywords::PixelSpacing desc;
-                desc.SetFromDataElement( de );
-                data.voxelSize.x = float( desc.GetValue(0) / 1000 );
-                data.voxelSize.y = float( desc.GetValue(1) / 1000 );
-            }
-        }
-        else 
+        float spacingZ = 0.0f;
+        if ( ds.FindDataElement( gdcm::Keywords::SpacingBetweenSlices::GetTag() ) )
         {
-            data.voxelSize.x = float( spacing[0] / 1000 );
-            data.voxelSize.y = float( spacing[1] / 1000 );
+            const gdcm::DataElement& de = ds.GetDataElement( gdcm::Keywords::SpacingBetweenSlices::GetTag() );
+            gdcm::Keywords::SpacingBetweenSlices desc;
+            desc.SetFromDataElement( de );
+            spacingZ = float( desc.GetValue() );
+            // looks like if this tag is set image stored inverted by Z
+            // no other tags was found to determine orientation (compared with cases without this tag)
+            needInvertZ = spacingZ > 0.0f;
         }
-        if ( data.voxelSize.z == 0.0f )
+        else
         {
-            if ( dimsNum == 3 )
-            {
-                float spacingZ = 0.0f;
-                if ( ds.FindDataElement( gdcm::Keywords::SpacingBetweenSlices::GetTag() ) )
-                {
-                    const gdcm::DataElement& de = ds.GetDataElement( gdcm::Keywords::SpacingBetweenSlices::GetTag() );
-                    gdcm::Keywords::SpacingBetweenSlices desc;
-                    desc.SetFromDataElement( de );
-                    spacingZ = float( desc.GetValue() );
-                    // looks like if this tag is set image stored inverted by Z
-                    // no other tags was found to determine orientation (compared with cases without this tag)
-                    needInvertZ = spacingZ > 0.0f;
-                }
-                else
-                {
-                    spacingZ = float( spacing[2] );
-                    needInvertZ = spacingZ < 0.0f;
-                }
-                data.voxelSize.z = std::abs( spacingZ ) * 1e-3f;
-            }
-            else
-                data.voxelSize.z = data.voxelSize.x;
+            spacingZ = float( spacing[2] );
+            needInvertZ = spacingZ < 0.0f;
         }
+        res.voxelSize.z = std::abs( spacingZ ) * 1e-3f;
     }
-    else if ( data.dims.x != (int) dims[0] || data.dims.y != (int) dims[1] )
+    else
+        res.voxelSize.z = res.voxelSize.x;
+
+    auto dimZ = dimsNum == 3 ? dims[2] : 1;
+    auto dimXY = dims[0] * dims[1];
+    if ( data.dims.x == 0 || data.dims.y == 0 )
+    {
+        data.dims.x = dims[0];
+        data.dims.y = dims[1];
+        if ( dimsNum == 3 )
+            data.dims.z = dims[2];
+        data.data.resize( size_t( data.dims.x ) * data.dims.y * data.dims.z );
+    }
+    else if ( data.dims.x != (int) dims[0] || data.dims.y != (int) dims[1] || offset + size_t( dimZ ) * dimXY > data.data.size() )
     {
         spdlog::error( "loadSingle: dimensions are inconsistent with other files, file: {}", utf8string( path ) );
         return res;
@@ -426,18 +432,13 @@ DCMFileLoadResult loadSingleFile( const std::filesystem::path& path, SimpleVolum
         spdlog::error( "Type: {}", (int)gimage.GetPixelFormat() );
         return res;
     }
-    std::vector<char> cacheBuffer( gimage.GetBufferLength() );
+    cacheBuffer.resize( gimage.GetBufferLength() );
     if ( !gimage.GetBuffer( cacheBuffer.data() ) )
     {
         spdlog::error( "loadSingle: cannot load data from file: {}", utf8string( path ) );
         return res;
     }
-    size_t fulSize = size_t( data.dims.x )*data.dims.y*data.dims.z;
-    if ( data.data.size() != fulSize )
-        data.data.resize( fulSize );
 
-    auto dimZ = dimsNum == 3 ? dims[2] : 1;
-    auto dimXY = dims[0] * dims[1];
     auto dimXYZinv = dimZ * dimXY - dimXY;
     for ( unsigned z = 0; z < dimZ; ++z )
     {
@@ -461,10 +462,12 @@ struct SeriesInfo
     float sliceSize{ 0.0f };
     int numSlices{ 0 };
     BitSet missedSlices;
+    Vector2i sliceDims; // columns and rows of the first slice
 };
 
 SeriesInfo sortDICOMFiles( std::vector<std::filesystem::path>& files, unsigned maxNumThreads )
 {
+    MR_TIMER
     SeriesInfo res;
 
     if ( files.empty() )
@@ -487,7 +490,9 @@ SeriesInfo sortDICOMFiles( std::vector<std::filesystem::path>& files, unsigned m
                     gdcm::Tag( 0x0002, 0x0002 ),
                     gdcm::Tag( 0x0008, 0x0016 ),
                     gdcm::Keywords::InstanceNumber::GetTag(),
-                    gdcm::Keywords::ImagePositionPatient::GetTag() } );
+                    gdcm::Keywords::ImagePositionPatient::GetTag(),
+                    gdcm::Keywords::Rows::GetTag(),
+                    gdcm::Keywords::Columns::GetTag() } );
 
                 SliceInfo sl;
                 sl.fileNum = i;
@@ -504,6 +509,15 @@ SeriesInfo sortDICOMFiles( std::vector<std::filesystem::path>& files, unsigned m
                     at.SetFromDataElement( de );
                     sl.instanceNum = at.GetValue();
                 }
+                // slice dimensions are necessary to allocate the volume before decoding of pixels
+                if( ds.FindDataElement( gdcm::Keywords::Columns::GetTag() ) && ds.FindDataElement( gdcm::Keywords::Rows::GetTag() ) )
+                {
+                    gdcm::Keywords::Columns columns;
+                    columns.SetFromDataElement( ds.GetDataElement( gdcm::Keywords::Columns::GetTag() ) );
+                    gdcm::Keywords::Rows rows;
+                    rows.SetFromDataElement( ds.GetDataElement( gdcm::Keywords::Rows::GetTag() ) );
+                    sl.dims = { int( columns.GetValue() ), int( rows.GetValue() ) };
+                }
                 zOrder[i] = sl;
             }
         } );
@@ -519,6 +533,7 @@ SeriesInfo sortDICOMFiles( std::vector<std::filesystem::path>& files, unsigned m
     }
 
     sortByOrder( files, zOrder );
+    res.sliceDims = zOrder.front().dims;
     
     if ( zOrder.size() > 1 )
     {
@@ -584,40 +599,52 @@ Expected<DicomVolume> loadSingleDicomFolder( std::vector<std::filesystem::path>&
     else
         data.dims.z = seriesInfo.numSlices;
 
-    auto firstRes = loadSingleFile( files.front(), data, 0 );
-    if ( !firstRes.success )
-        return unexpected( "loadDCMFolder: error loading first file \"" + utf8string( files.front() ) + "\"" );
-    data.min = firstRes.min;
-    data.max = firstRes.max;
-    size_t dimXY = data.dims.x * data.dims.y;
+    if ( seriesInfo.sliceDims.x <= 0 || seriesInfo.sliceDims.y <= 0 )
+        return unexpected( "loadDCMFolder: unknown dimensions of slices in file \"" + utf8string( files.front() ) + "\"" );
+    data.dims.x = seriesInfo.sliceDims.x;
+    data.dims.y = seriesInfo.sliceDims.y;
+    const size_t dimXY = size_t( data.dims.x ) * data.dims.y;
+    // the only allocation of the volume, all slices are decoded directly in their places
+    data.data.resize( dimXY * data.dims.z );
 
-    if ( !reportProgress( cb, 0.4f ) )
+    if ( !reportProgress( cb, 0.1f ) )
         return unexpected( "Loading canceled" );
 
     auto presentSlices = seriesInfo.missedSlices; 
     presentSlices.resize( data.dims.z );
     presentSlices.flip();
 
-    // other slices
+    // all slices including the first one are decoded in parallel
     bool cancelCalled = false;
-    std::vector<DCMFileLoadResult> slicesRes( files.size() - 1 );
-    tbb::task_arena limitedArena( maxNumThreads );
-    std::atomic<int> numLoadedSlices = 0;
-    limitedArena.execute( [&]
+    std::vector<DCMFileLoadResult> slicesRes( files.size() );
     {
-        cancelCalled = !ParallelFor( 0, int( slicesRes.size() ), [&] ( int i )
+        MR_NAMED_TIMER( "decode slices" )
+        tbb::enumerable_thread_specific<std::vector<char>> cacheBuffers;
+        tbb::task_arena limitedArena( maxNumThreads );
+        limitedArena.execute( [&]
         {
-            slicesRes[i] = loadSingleFile( files[i + 1], data, ( presentSlices.nthSetBit( i + 1 ) ) * dimXY );
-            ++numLoadedSlices;
-        }, subprogress( cb, 0.4f, 0.9f ), 1 );
-    } );
+            cancelCalled = !ParallelFor( 0, int( slicesRes.size() ), [&] ( int i )
+            {
+                slicesRes[i] = loadSingleFile( files[i], data, presentSlices.nthSetBit( i ) * dimXY, cacheBuffers.local() );
+            }, subprogress( cb, 0.1f, 0.9f ), 1 );
+        } );
+    }
     if ( cancelCalled )
         return unexpected( "Loading canceled" );
 
+    const auto& firstRes = slicesRes.front();
+    if ( !firstRes.success )
+        return unexpected( "loadDCMFolder: error loading first file \"" + utf8string( files.front() ) + "\"" );
+    data.voxelSize.x = firstRes.voxelSize.x;
+    data.voxelSize.y = firstRes.voxelSize.y;
+    if ( data.voxelSize.z == 0.0f )
+        data.voxelSize.z = firstRes.voxelSize.z;
+
     // fill missed slices
     int missedSlicesNum = int( seriesInfo.missedSlices.count() );
     if ( missedSlicesNum != 0 )
     {
+        MR_NAMED_TIMER( "interpolate missed slices" )
         int passedSlices = 0;
         int prevPresentSlice = -1;
         for ( auto presentSlice : presentSlices )
@@ -653,10 +680,13 @@ Expected<DicomVolume> loadSingleDicomFolder( std::vector<std::filesystem::path>&
     if ( cancelCalled )
         return unexpected( "Loading canceled" );
 
-    for ( const auto& sliceRes : slicesRes )
+    data.min = firstRes.min;
+    data.max = firstRes.max;
+    for ( size_t i = 1; i < slicesRes.size(); ++i )
     {
+        const auto& sliceRes = slicesRes[i];
         if ( !sliceRes.success )
-            return {};
+            return unexpected( "loadDCMFolder: error loading file \"" + utf8string( files[i] ) + "\"" );
         data.min = std::min( sliceRes.min, data.min );
         data.max = std::max( sliceRes.max, data.max );
     }
@@ -813,9 +843,11 @@ Expected<DicomVolume> loadDicomFile( const std::filesystem::path& path, const Pr
     SimpleVolume simpleVolume;
     simpleVolume.voxelSize = Vector3f();
     simpleVolume.dims.z = 1;
-    auto fileRes = loadSingleFile( path, simpleVolume, 0 );
+    std::vector<char> cacheBuffer;
+    auto fileRes = loadSingleFile( path, simpleVolume, 0, cacheBuffer );
     if ( !fileRes.success )
         return unexpected( "loadDCMFile: error load file: " + utf8string( path ) );
+    simpleVolume.voxelSize = fileRes.voxelSize;
     simpleVolume.max = fileRes.max;
     simpleVolume.min = fileRes.min;
     
@@ -1061,21 +1093,24 @@ struct TiffParams
 };
 
 #ifndef MRMESH_NO_TIFF
-Expected<VdbVolume> loadTiffDir( const LoadingTiffSettings& settings )
+namespace
+{
+
+Expected<std::vector<std::filesystem::path>> findTiffFiles( const std::filesystem::path& dir )
 {
     std::error_code ec;
-    if ( !std::filesystem::is_directory( settings.dir, ec ) )
+    if ( !std::filesystem::is_directory( dir, ec ) )
         return unexpected( "Given path is not directory" );
 
     int filesNum = 0;
     std::vector<std::filesystem::path> files;
-    for ( auto entry : Directory{ settings.dir, ec } )
+    for ( auto entry : Directory{ dir, ec } )
     {
         if ( entry.is_regular_file( ec ) )
             ++filesNum;
     }
     files.reserve( filesNum );
-    for ( auto entry : Directory{ settings.dir, ec } )
+    for ( auto entry : Directory{ dir, ec } )
     {
         auto filePath = entry.path();
         if ( entry.is_regular_file( ec ) && isTIFFFile( filePath ) )
@@ -1086,55 +1121,83 @@ Expected<VdbVolume> loadTiffDir( const LoadingTiffSettings& settings )
         return unexpected( "Too few TIFF files in the directory" );
     
     sortFilesByName( files );
+    return files;
+}
+
+/// reads given consecutive layers (one per file) in parallel into values, and updates min and max of the values
+VoidOrErrStr readTiffLayers( const std::vector<std::filesystem::path>& files, const TiffParameters& tp,
+    int firstLayer, int numLayers, float* values, float& min, float& max )
+{
+    MR_TIMER
+    const size_t layerSize = size_t( tp.imageSize.x ) * tp.imageSize.y;
+    std::vector<float> mins( numLayers, FLT_MAX ), maxs( numLayers, -FLT_MAX );
+    std::vector<std::string> errors( numLayers );
+    ParallelFor( 0, numLayers, [&] ( int i )
+    {
+        TiffParameters localParams;
+        RawTiffOutput output;
+        output.bytes = ( uint8_t* )( values + i * layerSize );
+        output.size = layerSize * sizeof( float );
+        output.params = &localParams;
+        output.min = &mins[i];
+        output.max = &maxs[i];
+        auto readRes = readRawTiff( files[firstLayer + i], output );
+        if ( !readRes.has_value() )
+            errors[i] = std::move( readRes.error() );
+        else if ( localParams != tp )
+            errors[i] = "Inconsistent TIFF files";
+    } );
+    for ( int i = 0; i < numLayers; ++i )
+    {
+        if ( !errors[i].empty() )
+            return unexpected( std::move( errors[i] ) );
+        min = std::min( min, mins[i] );
+        max = std::max( max, maxs[i] );
+    }
+    return {};
+}
+
+} // anonymous namespace
+
+Expected<VdbVolume> loadTiffDir( const LoadingTiffSettings& settings )
+{
+    MR_TIMER
+    auto files = findTiffFiles( settings.dir );
+    if ( !files.has_value() )
+        return unexpected( std::move( files.error() ) );
 
-    auto tpExp = readTiffParameters( files.front() );
+    auto tpExp = readTiffParameters( files->front() );
     if ( !tpExp.has_value() )
         return unexpected( tpExp.error() );
 
     auto& tp = *tpExp;
 
-    SimpleVolume outVolume;
-    outVolume.dims = { tp.imageSize.x, tp.imageSize.y, int( files.size() ) };
-    outVolume.min = FLT_MAX;
-    outVolume.max = FLT_MIN;
-
-    outVolume.voxelSize = settings.voxelSize;
-    outVolume.data.resize( outVolume.dims.x * outVolume.dims.y * outVolume.dims.z );
-
-    TiffParameters localParams;
-    RawTiffOutput output;
-    output.size = ( tp.imageSize.x * tp.imageSize.y ) * sizeof( float );
-    output.params = &localParams;
-    output.min = &outVolume.min;
-    output.max = &outVolume.max;
-    for ( int layerIndex = 0; layerIndex < files.size(); ++layerIndex )
+    VdbVolume res;
+    res.dims = { tp.imageSize.x, tp.imageSize.y, int( files->size() ) };
+    res.voxelSize = settings.voxelSize;
+    res.min = FLT_MAX;
+    res.max = -FLT_MAX;
+
+    // the layers are read by chunks and copied in the sparse grid, so the whole dense volume is never allocated
+    constexpr int cLayersPerChunk = 64;
+    SimpleVolume chunk;
+    chunk.dims = res.dims;
+    chunk.voxelSize = res.voxelSize;
+    chunk.data.resize( size_t( res.dims.x ) * res.dims.y * std::min( cLayersPerChunk, res.dims.z ) );
+
+    res.data = MakeFloatGrid( std::make_shared<openvdb::FloatGrid>( FLT_MAX ) );
+    for ( int z0 = 0; z0 < res.dims.z; z0 += cLayersPerChunk )
     {
-        output.bytes = ( uint8_t* )( outVolume.data.data() + layerIndex * tp.imageSize.x * tp.imageSize.y );
-        auto readRes = readRawTiff( files[layerIndex], output );
-
+        chunk.dims.z = std::min( cLayersPerChunk, res.dims.z - z0 );
+        auto readRes = readTiffLayers( *files, tp, z0, chunk.dims.z, chunk.data.data(), res.min, res.max );
         if ( !readRes.has_value() )
-            return unexpected( readRes.error() );
-
-        if ( localParams != tp )
-            return unexpected( "Inconsistent TIFF files" );
+            return unexpected( std::move( readRes.error() ) );
+        putSimpleVolumeInDenseGrid( res.data, { 0, 0, z0 }, chunk );
 
-        if ( settings.cb && !settings.cb( float( layerIndex ) / files.size() ) )
+        if ( !reportProgress( settings.cb, float( z0 + chunk.dims.z ) / res.dims.z ) )
             return unexpected( "Loading was cancelled" );
     }
-    
-    if ( settings.cb && !settings.cb( 1.0f ) )
-        return unexpected( "Loading was cancelled" );
-
-    if ( outVolume.data.empty() )
-        return unexpected( "No voxel data" );
-
-    VdbVolume res;
-
-    res.data = simpleVolumeToDenseGrid( outVolume );
-    res.dims = outVolume.dims;
-    res.voxelSize = outVolume.voxelSize;
-    res.min = outVolume.min;
-    res.max = outVolume.max;
+    openvdb::tools::changeBackground( res.data->tree(), 0.f );
 
     if ( settings.gridType == GridType::LevelSet )
     {
@@ -1150,6 +1213,32 @@ Expected<VdbVolume> loadTiffDir( const LoadingTiffSettings& settings )
     
     return res;
 }
+
+Expected<Mesh> meshFromTiffDir( const LoadingTiffSettings& settings, const MarchingCubesParams& params, int layersPerChunk )
+{
+    MR_TIMER
+    auto files = findTiffFiles( settings.dir );
+    if ( !files.has_value() )
+        return unexpected( std::move( files.error() ) );
+
+    auto tpExp = readTiffParameters( files->front() );
+    if ( !tpExp.has_value() )
+        return unexpected( tpExp.error() );
+    const auto& tp = *tpExp;
+
+    float min = FLT_MAX, max = -FLT_MAX;
+    auto loader = [&] ( int firstLayer, int numLayers, float* values )
+    {
+        return readTiffLayers( *files, tp, firstLayer, numLayers, values, min, max );
+    };
+
+    auto mcParams = params;
+    mcParams.cb = settings.cb;
+    auto res = marchingCubesByChunks( { tp.imageSize.x, tp.imageSize.y, int( files->size() ) }, settings.voxelSize, loader, mcParams, layersPerChunk );
+    if ( !res.has_value() && res.error() == stringOperationCanceled() )
+        return unexpected( "Loading was cancelled" );
+    return res;
+}
 #endif // MRMESH_NO_TIFF
 
 Expected<VdbVolume> fromRaw( const std::filesystem::path& file, const RawParameters& params,
@@ -135,6 +135,12 @@ struct LoadingTiffSettings
 };
 /// Load voxels from a set of TIFF files
 MRMESH_API Expected<VdbVolume> loadTiffDir( const LoadingTiffSettings& settings );
+
+/// Builds iso-surface of the volume stored in a set of TIFF files (one file per z-layer) using Marching Cubes;
+/// the files are read by chunks of given number of consecutive layers, and the whole volume is never kept in memory;
+/// settings.cb is used for progress reporting instead of params.cb
+MRMESH_API Expected<Mesh> meshFromTiffDir( const LoadingTiffSettings& settings, const MarchingCubesParams& params,
+                                           int layersPerChunk = 64 );
 #endif // MRMESH_NO_TIFF
 
 #endif // MRMESH_NO_OPENVDB
@@ -14,4 +14,16 @@ struct Writer
 
 #define MR_WRITER( obj ) MR::Writer _writer( obj );
 
+// the purpose of this struct is to invalidate only the object caches depending on point coordinates in its destructor,
+// it shall be used instead of Writer when the topology remains unchanged
+template<class T>
+struct PointsWriter
+{
+    T & obj;
+    PointsWriter( T & o ) : obj( o ) { }
+    ~PointsWriter() { obj.invalidatePointCaches(); }
+};
+
+#define MR_POINTS_WRITER( obj ) MR::PointsWriter _pointsWriter( obj );
+
 } //namespace MR
@@ -89,7 +89,10 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, Remesh, [] ( pybind11::module_& m )
         "It receives the edge being collapsed: its destination vertex will disappear,"
         "and its origin vertex will get new position (provided as the second argument) after collapse\n"
         "If the callback returns false, then the collapse is prohibited" ).
-    def_readwrite( "progressCallback", &MR::RemeshSettings::progressCallback, "Callback to report algorithm progress and cancel it by user request" );
+    def_readwrite( "progressCallback", &MR::RemeshSettings::progressCallback, "Callback to report algorithm progress and cancel it by user request" ).
+    def_readwrite( "subdivideParts", &MR::RemeshSettings::subdivideParts,
+        "If this value is more than 1, then the mesh is partitioned on approximately this number of parts,"
+        "the parts are remeshed in parallel away from their boundaries, and then the seams are remeshed sequentially" );
 
     m.def( "remesh", MR::remesh,
         pybind11::arg( "mesh" ), pybind11::arg_v( "settings", MR::RemeshSettings(), "RemeshSettings()"),
@@ -51,6 +51,8 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, ICPExposing, [] ( pybind11::module_& m )
         def_readwrite( "distThresholdSq", &MR::ICPProperties::distThresholdSq, "Points pair will be counted only if squared distance between points is lower than" ).
         def_readwrite( "farDistFactor", &MR::ICPProperties::farDistFactor,
             "Points pair will be counted only if distance between points is lower than root-mean-square distance times this factor" ).
+        def_readwrite( "trimRatio", &MR::ICPProperties::trimRatio,
+            "If positive then farDistFactor is ignored, and instead this fraction of active pairs with the largest distances between points is deactivated on each iteration (trimmed ICP)" ).
         def_readwrite( "icpMode", &MR::ICPProperties::icpMode, "Finds only translation. Rotation part is identity matrix" ).
         def_readwrite( "fixedRotationAxis", &MR::ICPProperties::fixedRotationAxis, "If this vector is not zero then rotation is allowed relative to this axis only" ).
         def_readwrite( "iterLimit", &MR::ICPProperties::iterLimit, "maximum iterations" ).
@@ -101,6 +103,9 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, ICPExposing, [] ( pybind11::module_& m )
         def( "getRef2FltPairs", &MR::ICP::getRef2FltPairs, pybind11::return_value_policy::copy, "returns current pairs formed from samples on reference object and projections on floating object" ).
         def( "calculateTransformation", &MR::ICP::calculateTransformation, "runs ICP algorithm given input objects, transformations, and parameters; "
             "returns adjusted transformation of the floating object to match reference object" ).
+        def( "calculateTransformationMultires", &MR::ICP::calculateTransformationMultires, pybind11::arg( "samplingVoxelSize" ), pybind11::arg( "numLevels" ) = 4,
+            "runs ICP algorithm from coarse to fine samples: the first level uses samples with the distance samplingVoxelSize * 2^(numLevels-1), "
+            "and each next level halves that distance and starts from the transformation found on the previous level" ).
         def( "autoSelectFloatXf", &MR::ICP::autoSelectFloatXf, "automatically selects initial transformation for the floating object based on covariance matrices of both floating and reference objects; applies the transformation to the floating object and returns it" ).
         def( "updatePointPairs", &MR::ICP::updatePointPairs, "recompute point pairs after manual change of transformations or parameters" );
 } )
@@ -109,7 +109,10 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, SelfIntersections, [] ( pybind11::module_& m
         def_readwrite( "maxExpand", &MR::SelfIntersections::Settings::maxExpand, "Maximum expand count (edge steps from self-intersecting faces), should be > 0" ).
         def_readwrite( "subdivideEdgeLen", &MR::SelfIntersections::Settings::subdivideEdgeLen,
             "Edge length for subdivision of holes covers (0.0f means auto)\n"
-            "FLT_MAX to disable subdivision" );
+            "FLT_MAX to disable subdivision" ).
+        def_readwrite( "maxCutAndFillRounds", &MR::SelfIntersections::Settings::maxCutAndFillRounds,
+            "Maximum number of rounds in `CutAndFill` method: after each round only the neighborhoods of new faces are checked,\n"
+            "and remaining self-intersections are cut out with larger margin in the next round" );
 
     m.def( "localFixSelfIntersections", MR::decorateExpected( &MR::SelfIntersections::fix ),
         pybind11::arg( "mesh" ), pybind11::arg( "settings" ),
@@ -287,7 +290,8 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, Relax, [] ( pybind11::module_& m )
 
     pybind11::class_<MeshRelaxParams, RelaxParams>( m, "MeshRelaxParams" ).
         def( pybind11::init<>() ).
-        def_readwrite( "hardSmoothTetrahedrons", &MeshRelaxParams::hardSmoothTetrahedrons, "smooth tetrahedron verts (with complete three edges ring) to base triangle (based on its edges destinations)" );
+        def_readwrite( "hardSmoothTetrahedrons", &MeshRelaxParams::hardSmoothTetrahedrons, "smooth tetrahedron verts (with complete three edges ring) to base triangle (based on its edges destinations)" ).
+        def_readwrite( "gaussSeidel", &MeshRelaxParams::gaussSeidel, "move vertices in place color by color (neighbor vertices get distinct colors), which converges faster per iteration" );
 
     pybind11::enum_<MR::RelaxApproxType>( m, "RelaxApproxType", "Approximation strategy to use during `relaxApprox`" ).
         value( "Planar", MR::RelaxApproxType::Planar, "Projects the new neighborhood points onto a best approximating plane." ).
@@ -349,7 +353,10 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, SubdivideSettings, [] ( pybind11::module_& m
         def_readwrite( "minSharpDihedralAngle", &SubdivideSettings::minSharpDihedralAngle,
             "In case of activated smoothMode, the smoothness is locally deactivated at the edges having dihedral angle at least this value" ).
         def_readwrite( "projectOnOriginalMesh", &SubdivideSettings::projectOnOriginalMesh,
-            "If true, then every new vertex will be projected on the original mesh (before smoothing)" );
+            "If true, then every new vertex will be projected on the original mesh (before smoothing)" ).
+        def_readwrite( "subdivideParts", &SubdivideSettings::subdivideParts,
+            "If this value is more than 1, then the mesh is partitioned on approximately this number of parts, "
+            "the parts are subdivided in parallel, and then the edges near the seams are subdivided sequentially" );
 
     m.def( "subdivideMesh", &MR::subdivideMesh,
         pybind11::arg( "mesh" ), pybind11::arg_v( "settings", MR::SubdivideSettings(), "SubdivideSettings()" ),
@@ -386,12 +393,20 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, LaplacianEdgeWeightsParam, [] ( pybind11::mo
         value( "CotanTimesLength", EdgeWeights::CotanTimesLength, "[deprecated] edge weight is equal to edge length times cotangent weight" ).
         value( "CotanWithAreaEqWeight", EdgeWeights::CotanWithAreaEqWeight, "cotangent edge weights and equation weights inversely proportional to square root of local area" );
 
-    m.def( "positionVertsSmoothly", &MR::positionVertsSmoothly,
+    m.def( "positionVertsSmoothly",
+        [] ( MR::Mesh& mesh, const MR::VertBitSet& verts, MR::EdgeWeights edgeWeightsType, const MR::VertBitSet* fixedSharpVertices )
+        {
+            MR::positionVertsSmoothly( mesh, verts, edgeWeightsType, fixedSharpVertices );
+        },
         pybind11::arg( "mesh" ), pybind11::arg( "verts" ), pybind11::arg_v( "edgeWeightsType", MR::EdgeWeights::Cotan, "LaplacianEdgeWeightsParam.Cotan" ),
         pybind11::arg( "fixedSharpVertices" ) = nullptr,
         "Puts given vertices in such positions to make smooth surface both inside verts-region and on its boundary" );
 
-    m.def( "positionVertsSmoothlySharpBd", &MR::positionVertsSmoothlySharpBd,
+    m.def( "positionVertsSmoothlySharpBd",
+        [] ( MR::Mesh& mesh, const MR::VertBitSet& verts, const MR::Vector<MR::Vector3f, MR::VertId>* vertShifts, const MR::VertScalars* vertStabilizers )
+        {
+            MR::positionVertsSmoothlySharpBd( mesh, verts, vertShifts, vertStabilizers );
+        },
         pybind11::arg( "mesh" ), pybind11::arg( "verts" ), pybind11::arg( "vertShifts" ) = nullptr, pybind11::arg( "vertStabilizers" ) = nullptr,
         "Puts given vertices in such positions to make smooth surface inside verts-region, but sharp on its boundary\n"
         "\tmesh - source mesh\n"
@@ -38,7 +38,12 @@ MR_ADD_PYTHON_CUSTOM_DEF( mrmeshpy, PointCloud, [] ( pybind11::module_& m )
         def_readwrite( "critAngle", &TriangulationParameters::critAngle, "Critical angle of triangles in local triangulation (angle between triangles in fan should be less then this value)" ).
         def_readwrite( "critHoleLength", &TriangulationParameters::critHoleLength,
             "Critical length of hole (all holes with length less then this value will be filled)\n"
-            "If value is subzero it is set automaticly to 0.7*bbox.diagonal()" );
+            "If value is subzero it is set automaticly to 0.7*bbox.diagonal()" ).
+        def_readwrite( "tileSize", &TriangulationParameters::tileSize,
+            "If positive and the cloud has normals then the cloud is subdivided on cubic tiles of this size triangulated independently in parallel" ).
+        def_readwrite( "tileHalo", &TriangulationParameters::tileHalo,
+            "Each tile is triangulated together with the points located not further than this distance from it;\n"
+            "if not positive then twice the radius is used, or twice the average radius of numNeighbours points if the radius is not set" );
 
     m.def( "triangulatePointCloud", &triangulatePointCloud,
         pybind11::arg( "pointCloud" ), pybind11::arg_v( "params", TriangulationParameters(), "TriangulationParameters()" ), pybind11::arg( "progressCb" ) = ProgressCallback{},